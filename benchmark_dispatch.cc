@@ -0,0 +1,125 @@
+// Per-opcode benchmark of the bytecode dispatch
+// =============================================
+
+/* Measures the cost of single bytecode instructions in Eval(), with the
+   threaded dispatch or with the switch statement. Each line evaluates an
+   unoptimized chain of 32 copies of one operation, and prints the time of
+   one copy in nanoseconds: the time of the chain minus that of evaluating
+   just "x", divided by 32 (best of 5 runs over 200k rows). The binary
+   operators need a second operand, so their copies also push a variable
+   (or a constant, on the "immed" line); comparing the "add" and "immed"
+   lines gives the difference between cVar and cImmed.
+
+   Eval() has to run the stack bytecode, so FP_NO_REGISTER_CODE must be
+   defined. Compile both versions and compare their output:
+
+   g++ -O2 -I. -DFP_NO_REGISTER_CODE -o threaded benchmark_dispatch.cc \
+       fparser*.cc ascii.cc fpoptimizer/fpoptimizer_*.cc
+   g++ -O2 -I. -DFP_NO_REGISTER_CODE -DFP_NO_THREADED_DISPATCH -o switch \
+       benchmark_dispatch.cc fparser*.cc ascii.cc fpoptimizer/fpoptimizer_*.cc
+
+   A chain repeating one opcode is the best case for the switch, since its
+   single indirect jump then always goes to the same place; the mixed
+   expressions at the end show the difference on ordinary code.
+*/
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "fpconfig.hh"
+#include "fparser.hh"
+
+#ifndef FP_NO_REGISTER_CODE
+#error "Define FP_NO_REGISTER_CODE, so that Eval() runs the bytecode."
+#endif
+
+namespace {
+const int Rows = 200000;
+const int Copies = 32;
+
+// ns per evaluation of the function, the best of 5 runs.
+double EvalTime(const std::string& function, const std::vector<double>& vars) {
+    FunctionParser parser;
+    if (parser.Parse(function, "x,y") >= 0) {
+        std::printf("%s: %s\n", function.c_str(), parser.ErrorMsg());
+        return 0;
+    }
+    double best = 1e300, sum = 0;
+    for (int run = 0; run < 5; ++run) {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int row = 0; row < Rows; ++row)
+            sum += parser.Eval(&vars[2 * row]);
+        const double seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (seconds < best)
+            best = seconds;
+    }
+    if (sum != sum)
+        std::printf("(NaN results)\n");
+    return best * 1e9 / Rows;
+}
+
+// f(f(...f(x)...)), with Copies calls.
+std::string Nested(const std::string& prefix, const std::string& suffix) {
+    std::string result = "x";
+    for (int i = 0; i < Copies; ++i)
+        result = prefix + result + suffix;
+    return result;
+}
+
+// ((x op y) op y)..., with Copies operators.
+std::string Chained(const std::string& op, const std::string& operand) {
+    std::string result = "x";
+    for (int i = 0; i < Copies; ++i)
+        result = "(" + result + op + operand + ")";
+    return result;
+}
+} // namespace
+
+int main() {
+    std::vector<double> vars(2 * Rows);
+    for (int i = 0; i < 2 * Rows; ++i)
+        vars[i] = (i * 7919LL % 1000) / 1000.0 + 0.25;
+
+#ifdef FP_USE_THREADED_DISPATCH
+    std::printf("Threaded dispatch, ns per copy:\n");
+#else
+    std::printf("Switch dispatch, ns per copy:\n");
+#endif
+
+    struct Case {
+        const char* name;
+        std::string function;
+    } const cases[] = {
+        {"add (var, add)", Chained("+", "y")},
+        {"immed (immed, add)", Chained("+", "2")},
+        {"sub (var, sub)", Chained("-", "y")},
+        {"mul (var, mul)", Chained("*", "y")},
+        {"div (var, div)", Chained("/", "y")},
+        {"less (var, less)", Chained("<", "y")},
+        {"and (var, and)", Chained("&", "y")},
+        {"min (var, min)", Nested("min(", ",y)")},
+        {"neg", Nested("-(", ")")},
+        {"abs", Nested("abs(", ")")},
+        {"sqrt", Nested("sqrt(", ")")},
+        {"sin", Nested("sin(", ")")},
+    };
+
+    const double base = EvalTime("x", vars);
+    for (unsigned i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i)
+        std::printf("  %-20s %6.2f\n", cases[i].name, (EvalTime(cases[i].function, vars) - base) / Copies);
+
+    std::printf("Mixed expressions, ns per Eval():\n");
+    const char* const mixed[] = {
+        "x*x+y*3-x/2",
+        "(x+y)*(x-y)*(y+1)*(x*y+2)-min(x,y)+max(y,x)",
+        "if(x<y, x*2+1, y*y-x)",
+        "(x<y & y<2) | (x>1 & -x<y) + abs(x-y)*2",
+    };
+    for (unsigned i = 0; i < sizeof(mixed) / sizeof(mixed[0]); ++i)
+        std::printf("  %-44s %6.2f\n", mixed[i], EvalTime(mixed[i], vars));
+    return 0;
+}
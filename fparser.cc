@@ -7,14 +7,19 @@
 #include "stdafx.h"
 #include "fpconfig.hh"
 #include "fparser.hh"
+#include "fparser_simd.hh"
+#include "fpaux.hh"
 
 using namespace FUNCTIONPARSERTYPES;
 
 #include <set>
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 #include <cmath>
 #include <cassert>
+#include <ctime>
+#include <fenv.h>
 // #include <cctype>
 #include "ascii.hh"
 // using namespace std;
@@ -25,20 +30,39 @@ using namespace FUNCTIONPARSERTYPES;
 #endif
 #endif
 
-#ifndef M_PI
-#define M_PI 3.1415926535897932384626433832795
+#ifdef FP_USE_POSIX_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#if !defined(FP_NO_EVALUATION_CHECKS) && defined(FE_DIVBYZERO) && defined(FE_INVALID) && defined(FE_OVERFLOW)
+#define FP_SUPPORT_FP_EXCEPTIONS
+#if defined(__x86_64__) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#include <x86intrin.h>
+#define FP_HAVE_RDTSC
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#define FP_HAVE_RDTSC
 #endif
 
 //=========================================================================
 // Name handling functions
 //=========================================================================
 namespace {
-bool addNewNameData(std::set<NameData>& nameData, std::map<NamePtr, const NameData*>& namePtrs, const NameData& newData) {
+template<typename Value_t>
+bool addNewNameData(std::set<NameData<Value_t> >& nameData,
+                    std::map<NamePtr, const NameData<Value_t>*>& namePtrs,
+                    const NameData<Value_t>& newData) {
     const FuncDefinition* funcDef = findFunction(NamePtr(&(newData.name[0]), unsigned(newData.name.size())));
     if (funcDef && funcDef->enabled)
         return false;
 
-    std::set<NameData>::iterator dataIter = nameData.find(newData);
+    typename std::set<NameData<Value_t> >::iterator dataIter = nameData.find(newData);
 
     if (dataIter != nameData.end()) {
         if (dataIter->type != newData.type)
@@ -185,77 +209,120 @@ bool containsOnlyValidNameChars(const std::string& name) {
     return *endPtr == '\0';
 }
 
-inline int doubleToInt(double d) {
-    return d < 0 ? -int((-d) + .5) : int(d + .5);
-}
-
-inline double Min(double d1, double d2) {
-    return d1 < d2 ? d1 : d2;
-}
-inline double Max(double d1, double d2) {
-    return d1 > d2 ? d1 : d2;
-}
-
-inline double DegreesToRadians(double degrees) {
-    return degrees * (M_PI / 180.0);
-}
-inline double RadiansToDegrees(double radians) {
-    return radians * (180.0 / M_PI);
-}
 } // namespace
 
 //=========================================================================
 // Data struct implementation
 //=========================================================================
-FunctionParser::Data::Data(const Data& rhs)
+template<typename Value_t>
+FunctionParserBase<Value_t>::Data::Data(const Data& rhs)
     : referenceCounter(0),
-      variablesString(),
+      variablesString(rhs.variablesString),
       variableRefs(),
       nameData(rhs.nameData),
       namePtrs(),
-      FuncPtrs(),
-      FuncParsers(),
+      FuncPtrs(rhs.FuncPtrs),
+      FuncParsers(rhs.FuncParsers),
       ByteCode(rhs.ByteCode),
       Immed(rhs.Immed),
-      Stack(),
-      StackSize(rhs.StackSize) {
-    Stack.resize(rhs.Stack.size());
-
-    for (std::set<NameData>::const_iterator iter = nameData.begin(); iter != nameData.end(); ++iter) {
+      StackSize(rhs.StackSize),
+      ThreadedCode(rhs.ThreadedCode),
+      RegisterCode(rhs.RegisterCode),
+      RegisterFile(rhs.RegisterFile),
+      RegisterVars(rhs.RegisterVars),
+      RegisterTemporaries(rhs.RegisterTemporaries),
+      useFPExceptions(rhs.useFPExceptions),
+      useBranchlessIfs(rhs.useBranchlessIfs),
+      useShortCircuitEvaluation(rhs.useShortCircuitEvaluation),
+      useVectorMath(rhs.useVectorMath),
+      approximation(rhs.approximation),
+      compiledFunction(0),
+      compiledCodeSize(0) {
+    for (typename std::set<NameData<Value_t> >::const_iterator iter = nameData.begin(); iter != nameData.end();
+         ++iter) {
         namePtrs[NamePtr(&(iter->name[0]), unsigned(iter->name.size()))] = &(*iter);
     }
+    // The names of the variables point to variablesString:
+    for (std::map<NamePtr, unsigned>::const_iterator iter = rhs.variableRefs.begin();
+         iter != rhs.variableRefs.end(); ++iter) {
+        const char* name = variablesString.data() + (iter->first.name - rhs.variablesString.data());
+        variableRefs[NamePtr(name, iter->first.nameLength)] = iter->second;
+    }
+}
+
+template<typename Value_t>
+FunctionParserBase<Value_t>::Data::~Data() {
+    ReleaseCompiledCode();
+}
+
+//=========================================================================
+// EvalContext implementation
+//=========================================================================
+template<typename Value_t>
+FunctionParserBase<Value_t>::EvalContext::EvalContext()
+    : Stack(), tapeSlots(), tapeEnds(), tapeOperands(), tapePartials(), tapeAdjoints(),
+      evalErrorType(0), evalRecursionLevel(0), nested(0) {
+}
+
+template<typename Value_t>
+FunctionParserBase<Value_t>::EvalContext::EvalContext(const EvalContext&)
+    : Stack(), tapeSlots(), tapeEnds(), tapeOperands(), tapePartials(), tapeAdjoints(),
+      evalErrorType(0), evalRecursionLevel(0), nested(0) {
+}
+
+template<typename Value_t>
+typename FunctionParserBase<Value_t>::EvalContext& FunctionParserBase<Value_t>::EvalContext::operator=(const EvalContext&) {
+    return *this;
+}
+
+template<typename Value_t>
+FunctionParserBase<Value_t>::EvalContext::~EvalContext() {
+    delete nested;
+}
+
+// The context used by eval() and by the calls of other parsers. It is
+// allocated once and then reused, so that evaluation does not allocate.
+template<typename Value_t>
+typename FunctionParserBase<Value_t>::EvalContext& FunctionParserBase<Value_t>::EvalContext::Nested() {
+    if (!nested)
+        nested = new EvalContext;
+    return *nested;
 }
 
 //=========================================================================
 // FunctionParser constructors, destructor and assignment
 //=========================================================================
-FunctionParser::FunctionParser()
+template<typename Value_t>
+FunctionParserBase<Value_t>::FunctionParserBase()
     : delimiterChar(0),
       parseErrorType(NO_FUNCTION_PARSED_YET),
       evalErrorType(0),
       data(new Data),
       useDegreeConversion(false),
-      evalRecursionLevel(0),
+      evalContext(),
       StackPtr(0), errorLocation(0) {
 }
 
-FunctionParser::~FunctionParser() {
+template<typename Value_t>
+FunctionParserBase<Value_t>::~FunctionParserBase() {
     if (--(data->referenceCounter) == 0)
         delete data;
 }
 
-FunctionParser::FunctionParser(const FunctionParser& cpy)
+template<typename Value_t>
+FunctionParserBase<Value_t>::FunctionParserBase(const FunctionParserBase& cpy)
     : delimiterChar(cpy.delimiterChar),
       parseErrorType(cpy.parseErrorType),
       evalErrorType(cpy.evalErrorType),
       data(cpy.data),
       useDegreeConversion(cpy.useDegreeConversion),
-      evalRecursionLevel(0),
+      evalContext(),
       StackPtr(0), errorLocation(0) {
     ++(data->referenceCounter);
 }
 
-FunctionParser& FunctionParser::operator=(const FunctionParser& cpy) {
+template<typename Value_t>
+FunctionParserBase<Value_t>& FunctionParserBase<Value_t>::operator=(const FunctionParserBase& cpy) {
     if (data != cpy.data) {
         if (--(data->referenceCounter) == 0)
             delete data;
@@ -265,7 +332,6 @@ FunctionParser& FunctionParser::operator=(const FunctionParser& cpy) {
         evalErrorType = cpy.evalErrorType;
         data = cpy.data;
         useDegreeConversion = cpy.useDegreeConversion;
-        evalRecursionLevel = cpy.evalRecursionLevel;
 
         ++(data->referenceCounter);
     }
@@ -273,14 +339,16 @@ FunctionParser& FunctionParser::operator=(const FunctionParser& cpy) {
     return *this;
 }
 
-void FunctionParser::setDelimiterChar(char c) {
+template<typename Value_t>
+void FunctionParserBase<Value_t>::setDelimiterChar(char c) {
     delimiterChar = c;
 }
 
 //---------------------------------------------------------------------------
 // Copy-on-write method
 //---------------------------------------------------------------------------
-void FunctionParser::CopyOnWrite() {
+template<typename Value_t>
+void FunctionParserBase<Value_t>::CopyOnWrite() {
     if (data->referenceCounter > 1) {
         Data* oldData = data;
         data = new Data(*oldData);
@@ -289,42 +357,93 @@ void FunctionParser::CopyOnWrite() {
     }
 }
 
-void FunctionParser::ForceDeepCopy() {
+template<typename Value_t>
+void FunctionParserBase<Value_t>::ForceDeepCopy() {
+    CopyOnWrite();
+}
+
+// The compiled code depends on the checks, so it is compiled again.
+template<typename Value_t>
+void FunctionParserBase<Value_t>::UseFloatingPointExceptions(bool enable) {
+#ifndef FP_SUPPORT_FP_EXCEPTIONS
+    enable = false;
+#endif
+    if (data->useFPExceptions == enable)
+        return;
+
+    const bool compiled = data->compiledFunction != 0;
+    CopyOnWrite();
+    data->ReleaseCompiledCode();
+    data->useFPExceptions = enable;
+    if (compiled)
+        Compile();
+}
+
+// Only used by Optimize(), so it takes effect on the next Optimize().
+template<typename Value_t>
+void FunctionParserBase<Value_t>::UseBranchlessIfs(bool enable) {
+    if (data->useBranchlessIfs == enable)
+        return;
+
+    CopyOnWrite();
+    data->useBranchlessIfs = enable;
+}
+
+// Only used by Parse(), so it takes effect on the next Parse().
+template<typename Value_t>
+void FunctionParserBase<Value_t>::UseShortCircuitEvaluation(bool enable) {
+    if (data->useShortCircuitEvaluation == enable)
+        return;
+
+    CopyOnWrite();
+    data->useShortCircuitEvaluation = enable;
+}
+
+// Only used by EvalMany() and EvalManyParallel().
+template<typename Value_t>
+void FunctionParserBase<Value_t>::UseVectorMath(bool enable) {
+    if (data->useVectorMath == enable)
+        return;
+
     CopyOnWrite();
+    data->useVectorMath = enable;
 }
 
 //=========================================================================
 // User-defined constant and function addition
 //=========================================================================
-bool FunctionParser::AddConstant(const std::string& name, double value) {
+template<typename Value_t>
+bool FunctionParserBase<Value_t>::AddConstant(const std::string& name, Value_t value) {
     if (!containsOnlyValidNameChars(name))
         return false;
 
     CopyOnWrite();
-    NameData newData(NameData::CONSTANT, name);
+    NameData<Value_t> newData(NameData<Value_t>::CONSTANT, name);
     newData.value = value;
     return addNewNameData(data->nameData, data->namePtrs, newData);
 }
 
-bool FunctionParser::AddUnit(const std::string& name, double value) {
+template<typename Value_t>
+bool FunctionParserBase<Value_t>::AddUnit(const std::string& name, Value_t value) {
     if (!containsOnlyValidNameChars(name))
         return false;
 
     CopyOnWrite();
-    NameData newData(NameData::UNIT, name);
+    NameData<Value_t> newData(NameData<Value_t>::UNIT, name);
     newData.value = value;
     return addNewNameData(data->nameData, data->namePtrs, newData);
 }
 
-bool FunctionParser::AddFunction(const std::string& name, FunctionPtr ptr, unsigned paramsAmount) {
+template<typename Value_t>
+bool FunctionParserBase<Value_t>::AddFunction(const std::string& name, FunctionPtr ptr, unsigned paramsAmount) {
     if (!containsOnlyValidNameChars(name))
         return false;
 
     CopyOnWrite();
-    NameData newData(NameData::FUNC_PTR, name);
+    NameData<Value_t> newData(NameData<Value_t>::FUNC_PTR, name);
     newData.index = unsigned(data->FuncPtrs.size());
 
-    data->FuncPtrs.push_back(Data::FuncPtrData());
+    data->FuncPtrs.push_back(typename Data::FuncPtrData());
     data->FuncPtrs.back().funcPtr = ptr;
     data->FuncPtrs.back().params = paramsAmount;
 
@@ -334,7 +453,25 @@ bool FunctionParser::AddFunction(const std::string& name, FunctionPtr ptr, unsig
     return retval;
 }
 
-bool FunctionParser::CheckRecursiveLinking(const FunctionParser* fp) const {
+// Only FunctionParser has the interval and gradient evaluations:
+template<>
+bool FunctionParser::AddFunction(const std::string& name, FunctionPtr ptr, IntervalFunctionPtr intervalPtr,
+                                 unsigned paramsAmount, DerivativeFunctionPtr derivativePtr) {
+    if (!AddFunction(name, ptr, paramsAmount))
+        return false;
+    data->FuncPtrs.back().intervalPtr = intervalPtr;
+    data->FuncPtrs.back().derivativePtr = derivativePtr;
+    return true;
+}
+
+template<>
+bool FunctionParser::AddFunction(const std::string& name, FunctionPtr ptr, DerivativeFunctionPtr derivativePtr,
+                                 unsigned paramsAmount) {
+    return AddFunction(name, ptr, IntervalFunctionPtr(0), paramsAmount, derivativePtr);
+}
+
+template<typename Value_t>
+bool FunctionParserBase<Value_t>::CheckRecursiveLinking(const FunctionParserBase* fp) const {
     if (fp == this)
         return true;
     for (unsigned i = 0; i < fp->data->FuncParsers.size(); ++i)
@@ -343,15 +480,16 @@ bool FunctionParser::CheckRecursiveLinking(const FunctionParser* fp) const {
     return false;
 }
 
-bool FunctionParser::AddFunction(const std::string& name, FunctionParser& fp) {
+template<typename Value_t>
+bool FunctionParserBase<Value_t>::AddFunction(const std::string& name, FunctionParserBase& fp) {
     if (!containsOnlyValidNameChars(name) || CheckRecursiveLinking(&fp))
         return false;
 
     CopyOnWrite();
-    NameData newData(NameData::PARSER_PTR, name);
+    NameData<Value_t> newData(NameData<Value_t>::PARSER_PTR, name);
     newData.index = unsigned(data->FuncParsers.size());
 
-    data->FuncParsers.push_back(Data::FuncPtrData());
+    data->FuncParsers.push_back(typename Data::FuncPtrData());
     data->FuncParsers.back().parserPtr = &fp;
     data->FuncParsers.back().params = unsigned(fp.data->variableRefs.size());
 
@@ -361,11 +499,12 @@ bool FunctionParser::AddFunction(const std::string& name, FunctionParser& fp) {
     return retval;
 }
 
-bool FunctionParser::RemoveIdentifier(const std::string& name) {
+template<typename Value_t>
+bool FunctionParserBase<Value_t>::RemoveIdentifier(const std::string& name) {
     CopyOnWrite();
 
-    const NameData dataToRemove(NameData::CONSTANT, name);
-    std::set<NameData>::iterator dataIter = data->nameData.find(dataToRemove);
+    const NameData<Value_t> dataToRemove(NameData<Value_t>::CONSTANT, name);
+    typename std::set<NameData<Value_t> >::iterator dataIter = data->nameData.find(dataToRemove);
 
     if (dataIter != data->nameData.end()) {
         data->namePtrs.erase(NamePtr(&(dataIter->name[0]), unsigned(dataIter->name.size())));
@@ -398,13 +537,15 @@ const char* const ParseErrorMessage[] = {
 
 // Return parse error message
 // --------------------------
-const char* FunctionParser::ErrorMsg() const {
+template<typename Value_t>
+const char* FunctionParserBase<Value_t>::ErrorMsg() const {
     return ParseErrorMessage[parseErrorType];
 }
 
 // Parse variables
 // ---------------
-bool FunctionParser::ParseVariables(const std::string& inputVarString) {
+template<typename Value_t>
+bool FunctionParserBase<Value_t>::ParseVariables(const std::string& inputVarString) {
     if (data->variablesString == inputVarString)
         return true;
 
@@ -432,7 +573,7 @@ bool FunctionParser::ParseVariables(const std::string& inputVarString) {
         if (funcDef && funcDef->enabled)
             return false;
 
-        std::map<NamePtr, const NameData*>::iterator nameIter = data->namePtrs.find(namePtr);
+        typename std::map<NamePtr, const NameData<Value_t>*>::iterator nameIter = data->namePtrs.find(namePtr);
         if (nameIter != data->namePtrs.end())
             return false;
 
@@ -446,7 +587,8 @@ bool FunctionParser::ParseVariables(const std::string& inputVarString) {
 
 // Parse interface functions
 // -------------------------
-int FunctionParser::Parse(const char* Function, const std::string& Vars, bool useDegrees) {
+template<typename Value_t>
+int FunctionParserBase<Value_t>::Parse(const char* Function, const std::string& Vars, bool useDegrees) {
     CopyOnWrite();
 
     if (!ParseVariables(Vars)) {
@@ -457,7 +599,8 @@ int FunctionParser::Parse(const char* Function, const std::string& Vars, bool us
     return ParseFunction(Function, useDegrees);
 }
 
-int FunctionParser::Parse(const std::string& Function, const std::string& Vars, bool useDegrees) {
+template<typename Value_t>
+int FunctionParserBase<Value_t>::Parse(const std::string& Function, const std::string& Vars, bool useDegrees) {
     CopyOnWrite();
 
     if (!ParseVariables(Vars)) {
@@ -470,15 +613,20 @@ int FunctionParser::Parse(const std::string& Function, const std::string& Vars,
 
 // Main parsing function
 // ---------------------
-int FunctionParser::ParseFunction(const char* function, bool useDegrees) {
+template<typename Value_t>
+int FunctionParserBase<Value_t>::ParseFunction(const char* function, bool useDegrees) {
     useDegreeConversion = useDegrees;
     parseErrorType = FP_NO_ERROR;
 
+    data->ReleaseCompiledCode();
+    data->ThreadedCode.clear();
+    data->RegisterCode.clear();
     data->ByteCode.clear();
     data->ByteCode.reserve(128);
     data->Immed.clear();
     data->Immed.reserve(128);
     data->StackSize = StackPtr = 0;
+    data->approximation.Clear();
 
     const char* ptr = CompileExpression(function);
     if (parseErrorType != FP_NO_ERROR)
@@ -491,9 +639,10 @@ int FunctionParser::ParseFunction(const char* function, bool useDegrees) {
         return int(ptr - function);
     }
 
-#ifndef FP_USE_THREAD_SAFE_EVAL
-    data->Stack.resize(data->StackSize);
+#ifdef FP_USE_THREADED_DISPATCH
+    EvalByteCode<false>(evalContext, 0, 0, true);
 #endif
+    TranslateToRegisterCode();
 
     return -1;
 }
@@ -501,13 +650,15 @@ int FunctionParser::ParseFunction(const char* function, bool useDegrees) {
 //=========================================================================
 // Parsing and bytecode compiling functions
 //=========================================================================
-inline const char* FunctionParser::SetErrorType(ParseErrorType t, const char* pos) {
+template<typename Value_t>
+inline const char* FunctionParserBase<Value_t>::SetErrorType(ParseErrorType t, const char* pos) {
     parseErrorType = t;
     errorLocation = pos;
     return 0;
 }
 
-inline void FunctionParser::incStackPtr() {
+template<typename Value_t>
+inline void FunctionParserBase<Value_t>::incStackPtr() {
     if (++StackPtr > data->StackSize)
         ++(data->StackSize);
 }
@@ -517,7 +668,8 @@ namespace FPoptimizer_ByteCode {
 extern signed char powi_table[256];
 }
 #endif
-inline bool FunctionParser::CompilePowi(int int_exponent) {
+template<typename Value_t>
+inline bool FunctionParserBase<Value_t>::CompilePowi(int int_exponent) {
     int num_muls = 0;
     while (int_exponent > 1) {
 #ifdef FP_SUPPORT_OPTIMIZER
@@ -563,11 +715,11 @@ struct MulOp {
            opposite = cDiv,
            combined = cMul,
            defval = 1 };
-    static inline void action(double& target, double value) { target *= value; }
-    static inline void combine_action(double& target, double value) { target = value / target; }
-    static inline bool valid_rvalue(double) { return true; }
-    static inline bool valid_opposite_rvalue(double v) { return v != 0.0; }
-    static inline bool is_redundant(double v) { return v == 1.0; }
+    template<typename Value_t> static inline void action(Value_t& target, Value_t value) { target *= value; }
+    template<typename Value_t> static inline void combine_action(Value_t& target, Value_t value) { target = value / target; }
+    template<typename Value_t> static inline bool valid_rvalue(Value_t) { return true; }
+    template<typename Value_t> static inline bool valid_opposite_rvalue(Value_t v) { return v != 0.0; }
+    template<typename Value_t> static inline bool is_redundant(Value_t v) { return v == 1.0; }
     static inline bool opposite_is_preferred() { return false; }
 };
 struct DivOp {
@@ -575,11 +727,11 @@ struct DivOp {
            opposite = cMul,
            combined = cMul,
            defval = 1 };
-    static inline void action(double& target, double value) { target /= value; }
-    static inline void combine_action(double& target, double value) { target = target / value; }
-    static inline bool valid_rvalue(double v) { return v != 0.0; }
-    static inline bool valid_opposite_rvalue(double) { return true; }
-    static inline bool is_redundant(double v) { return v == 1.0; }
+    template<typename Value_t> static inline void action(Value_t& target, Value_t value) { target /= value; }
+    template<typename Value_t> static inline void combine_action(Value_t& target, Value_t value) { target = target / value; }
+    template<typename Value_t> static inline bool valid_rvalue(Value_t v) { return v != 0.0; }
+    template<typename Value_t> static inline bool valid_opposite_rvalue(Value_t) { return true; }
+    template<typename Value_t> static inline bool is_redundant(Value_t v) { return v == 1.0; }
     static inline bool opposite_is_preferred() { return true; }
 };
 struct AddOp {
@@ -587,11 +739,11 @@ struct AddOp {
            opposite = cSub,
            combined = cAdd,
            defval = 0 };
-    static inline void action(double& target, double value) { target += value; }
-    static inline void combine_action(double& target, double value) { target = value - target; }
-    static inline bool valid_rvalue(double) { return true; }
-    static inline bool valid_opposite_rvalue(double) { return true; }
-    static inline bool is_redundant(double v) { return v == 0.0; }
+    template<typename Value_t> static inline void action(Value_t& target, Value_t value) { target += value; }
+    template<typename Value_t> static inline void combine_action(Value_t& target, Value_t value) { target = value - target; }
+    template<typename Value_t> static inline bool valid_rvalue(Value_t) { return true; }
+    template<typename Value_t> static inline bool valid_opposite_rvalue(Value_t) { return true; }
+    template<typename Value_t> static inline bool is_redundant(Value_t v) { return v == 0.0; }
     static inline bool opposite_is_preferred() { return false; }
 };
 struct SubOp {
@@ -599,11 +751,11 @@ struct SubOp {
            opposite = cAdd,
            combined = cAdd,
            defval = 0 };
-    static inline void action(double& target, double value) { target -= value; }
-    static inline void combine_action(double& target, double value) { target = target - value; }
-    static inline bool valid_rvalue(double) { return true; }
-    static inline bool valid_opposite_rvalue(double) { return true; }
-    static inline bool is_redundant(double v) { return v == 0.0; }
+    template<typename Value_t> static inline void action(Value_t& target, Value_t value) { target -= value; }
+    template<typename Value_t> static inline void combine_action(Value_t& target, Value_t value) { target = target - value; }
+    template<typename Value_t> static inline bool valid_rvalue(Value_t) { return true; }
+    template<typename Value_t> static inline bool valid_opposite_rvalue(Value_t) { return true; }
+    template<typename Value_t> static inline bool is_redundant(Value_t v) { return v == 0.0; }
     static inline bool opposite_is_preferred() { return true; }
 };
 struct ModOp {
@@ -611,11 +763,11 @@ struct ModOp {
            opposite = cMod,
            combined = cMod,
            defval = 1 };
-    static inline void action(double& target, double value) { target = fmod(target, value); }
-    static inline void combine_action(double& target, double value) { target = fmod(target, value); }
-    static inline bool valid_rvalue(double v) { return v != 0.0; }
-    static inline bool valid_opposite_rvalue(double v) { return v != 0.0; }
-    static inline bool is_redundant(double) { return false; }
+    template<typename Value_t> static inline void action(Value_t& target, Value_t value) { target = std::fmod(target, value); }
+    template<typename Value_t> static inline void combine_action(Value_t& target, Value_t value) { target = std::fmod(target, value); }
+    template<typename Value_t> static inline bool valid_rvalue(Value_t v) { return v != 0.0; }
+    template<typename Value_t> static inline bool valid_opposite_rvalue(Value_t v) { return v != 0.0; }
+    template<typename Value_t> static inline bool is_redundant(Value_t) { return false; }
     static inline bool opposite_is_preferred() { return false; }
 };
 
@@ -629,16 +781,17 @@ bool IsEligibleIntPowiExponent(int int_exponent) {
 }
 } // namespace
 
-inline void FunctionParser::AddFunctionOpcode(unsigned opcode) {
+template<typename Value_t>
+inline void FunctionParserBase<Value_t>::AddFunctionOpcode(unsigned opcode) {
     if (data->ByteCode.back() == cImmed) {
         switch (opcode) {
         case cAbs:
-            data->Immed.back() = fabs(data->Immed.back());
+            data->Immed.back() = std::fabs(data->Immed.back());
             return;
         case cAcos:
             if (data->Immed.back() < -1 || data->Immed.back() > 1)
                 break;
-            data->Immed.back() = acos(data->Immed.back());
+            data->Immed.back() = std::acos(data->Immed.back());
             return;
         case cAcosh:
             data->Immed.back() = fp_acosh(data->Immed.back());
@@ -646,69 +799,69 @@ inline void FunctionParser::AddFunctionOpcode(unsigned opcode) {
         case cAsin:
             if (data->Immed.back() < -1 || data->Immed.back() > 1)
                 break;
-            data->Immed.back() = asin(data->Immed.back());
+            data->Immed.back() = std::asin(data->Immed.back());
             return;
         case cAsinh:
             data->Immed.back() = fp_asinh(data->Immed.back());
             return;
         case cAtan:
-            data->Immed.back() = atan(data->Immed.back());
+            data->Immed.back() = std::atan(data->Immed.back());
             return;
         case cAtanh:
             data->Immed.back() = fp_atanh(data->Immed.back());
             return;
         case cCeil:
-            data->Immed.back() = ceil(data->Immed.back());
+            data->Immed.back() = std::ceil(data->Immed.back());
             return;
         case cCos:
-            data->Immed.back() = cos(data->Immed.back());
+            data->Immed.back() = std::cos(data->Immed.back());
             return;
         case cCosh:
-            data->Immed.back() = cosh(data->Immed.back());
+            data->Immed.back() = std::cosh(data->Immed.back());
             return;
         case cExp:
-            data->Immed.back() = exp(data->Immed.back());
+            data->Immed.back() = std::exp(data->Immed.back());
             return;
         case cExp2:
-            data->Immed.back() = pow(2.0, data->Immed.back());
+            data->Immed.back() = std::pow(Value_t(2), data->Immed.back());
             return;
         case cFloor:
-            data->Immed.back() = floor(data->Immed.back());
+            data->Immed.back() = std::floor(data->Immed.back());
             return;
         case cInt:
-            data->Immed.back() = floor(data->Immed.back() + 0.5);
+            data->Immed.back() = std::floor(data->Immed.back() + 0.5);
             return;
         case cLog:
             if (data->Immed.back() <= 0.0)
                 break;
-            data->Immed.back() = log(data->Immed.back());
+            data->Immed.back() = std::log(data->Immed.back());
             return;
         case cLog10:
             if (data->Immed.back() <= 0.0)
                 break;
-            data->Immed.back() = log10(data->Immed.back());
+            data->Immed.back() = std::log10(data->Immed.back());
             return;
         case cLog2:
             if (data->Immed.back() <= 0.0)
                 break;
-            data->Immed.back() = log(data->Immed.back()) * 1.4426950408889634074;
+            data->Immed.back() = std::log(data->Immed.back()) * Value_t(1.4426950408889634073599246810018921L);
             return;
         case cSin:
-            data->Immed.back() = sin(data->Immed.back());
+            data->Immed.back() = std::sin(data->Immed.back());
             return;
         case cSinh:
-            data->Immed.back() = sinh(data->Immed.back());
+            data->Immed.back() = std::sinh(data->Immed.back());
             return;
         case cSqrt:
             if (data->Immed.back() < 0.0)
                 break;
-            data->Immed.back() = sqrt(data->Immed.back());
+            data->Immed.back() = std::sqrt(data->Immed.back());
             return;
         case cTan:
-            data->Immed.back() = tan(data->Immed.back());
+            data->Immed.back() = std::tan(data->Immed.back());
             return;
         case cTanh:
-            data->Immed.back() = tanh(data->Immed.back());
+            data->Immed.back() = std::tanh(data->Immed.back());
             return;
         case cDeg:
             data->Immed.back() = RadiansToDegrees(data->Immed.back());
@@ -751,13 +904,13 @@ inline void FunctionParser::AddFunctionOpcode(unsigned opcode) {
                 data->ByteCode.pop_back();
                 opcode = (cInv);
             } else {
-                double original_immed = data->Immed.back();
+                Value_t original_immed = data->Immed.back();
                 int int_exponent = (int)original_immed;
 
-                if (original_immed != (double)int_exponent) {
+                if (original_immed != (Value_t)int_exponent) {
                     for (int sqrt_count = 1; sqrt_count <= 4; ++sqrt_count) {
                         int factor = 1 << sqrt_count;
-                        double changed_exponent = original_immed * (double)factor;
+                        Value_t changed_exponent = original_immed * (Value_t)factor;
                         if (IsIntegerConst(changed_exponent) &&
                             IsEligibleIntPowiExponent((int)changed_exponent)) {
                             while (sqrt_count > 0) {
@@ -790,7 +943,7 @@ inline void FunctionParser::AddFunctionOpcode(unsigned opcode) {
                 // x^y can be safely converted into exp(y * log(x))
                 // when y is _not_ integer, because we know that x >= 0.
                 // Otherwise either expression will give a NaN.
-                if (original_immed != (double)int_exponent) {
+                if (original_immed != (Value_t)int_exponent) {
                     data->Immed.pop_back();
                     data->ByteCode.pop_back();
                     AddFunctionOpcode(cLog);
@@ -846,7 +999,7 @@ inline void FunctionParser::AddFunctionOpcode(unsigned opcode) {
         if (data->ByteCode.back() == cAdd && data->ByteCode[data->ByteCode.size() - 2] == cImmed) {
             data->ByteCode[data->ByteCode.size() - 2] = cExp;
             data->ByteCode.back() = cImmed;
-            data->Immed.back() = exp(data->Immed.back());
+            data->Immed.back() = std::exp(data->Immed.back());
             opcode = cMul;
         }
         break;
@@ -855,7 +1008,7 @@ inline void FunctionParser::AddFunctionOpcode(unsigned opcode) {
         if (data->ByteCode.back() == cAdd && data->ByteCode[data->ByteCode.size() - 2] == cImmed) {
             data->ByteCode[data->ByteCode.size() - 2] = cExp2;
             data->ByteCode.back() = cImmed;
-            data->Immed.back() = pow(2.0, data->Immed.back());
+            data->Immed.back() = std::pow(Value_t(2), data->Immed.back());
             opcode = cMul;
         }
         break;
@@ -863,7 +1016,8 @@ inline void FunctionParser::AddFunctionOpcode(unsigned opcode) {
     data->ByteCode.push_back(opcode);
 }
 
-inline void FunctionParser::AddFunctionOpcode_CheckDegreesConversion(unsigned opcode) {
+template<typename Value_t>
+inline void FunctionParserBase<Value_t>::AddFunctionOpcode_CheckDegreesConversion(unsigned opcode) {
     if (useDegreeConversion)
         switch (opcode) {
         case cCos:
@@ -897,7 +1051,7 @@ inline void FunctionParser::AddFunctionOpcode_CheckDegreesConversion(unsigned op
         break;
     case cAtan2:
         if (data->ByteCode.back() == cImmed && data->ByteCode[data->ByteCode.size() - 2] == cImmed) {
-            data->Immed[data->Immed.size() - 2] = atan2(data->Immed[data->Immed.size() - 2], data->Immed.back());
+            data->Immed[data->Immed.size() - 2] = std::atan2(data->Immed[data->Immed.size() - 2], data->Immed.back());
             data->ByteCode.pop_back();
             data->Immed.pop_back();
             goto skip_op;
@@ -905,7 +1059,7 @@ inline void FunctionParser::AddFunctionOpcode_CheckDegreesConversion(unsigned op
         break;
     case cPow:
         if (data->ByteCode.back() == cImmed && data->ByteCode[data->ByteCode.size() - 2] == cImmed) {
-            data->Immed[data->Immed.size() - 2] = pow(data->Immed[data->Immed.size() - 2], data->Immed.back());
+            data->Immed[data->Immed.size() - 2] = std::pow(data->Immed[data->Immed.size() - 2], data->Immed.back());
             data->ByteCode.pop_back();
             data->Immed.pop_back();
             goto skip_op;
@@ -928,7 +1082,8 @@ skip_op:;
         }
 }
 
-inline void FunctionParser::AddMultiplicationByConst(double value) {
+template<typename Value_t>
+inline void FunctionParserBase<Value_t>::AddMultiplicationByConst(Value_t value) {
     if (data->ByteCode.back() == cImmed) {
         data->Immed.back() *= value;
     } else if (data->ByteCode.back() == cMul &&
@@ -948,8 +1103,9 @@ inline void FunctionParser::AddMultiplicationByConst(double value) {
     }
 }
 
+template<typename Value_t>
 template <typename Operation>
-inline void FunctionParser::AddBinaryOperationByConst() {
+inline void FunctionParserBase<Value_t>::AddBinaryOperationByConst() {
     // data->ByteCode.back() is assumed to be cImmed here
     // that is, data->ByteCode[data->ByteCode.size()-1]
     if (!Operation::valid_rvalue(data->Immed.back())) {
@@ -996,7 +1152,7 @@ inline void FunctionParser::AddBinaryOperationByConst() {
             // bytecode top:  ...
         }
     } else if (Operation::opposite_is_preferred()) {
-        double p = (double)Operation::defval;
+        Value_t p = (Value_t)Operation::defval;
         Operation::combine_action(p, data->Immed.back());
         data->Immed.back() = p;
         data->ByteCode.push_back(unsigned(Operation::opposite));
@@ -1014,20 +1170,65 @@ inline void FunctionParser::AddBinaryOperationByConst() {
 }
 
 namespace {
-inline FunctionParser::ParseErrorType noCommaError(char c) {
+template<typename Value_t>
+inline typename FunctionParserBase<Value_t>::ParseErrorType noCommaError(char c) {
     return c == ')' ?
-               FunctionParser::ILL_PARAMS_AMOUNT :
-               FunctionParser::SYNTAX_ERROR;
+               FunctionParserBase<Value_t>::ILL_PARAMS_AMOUNT :
+               FunctionParserBase<Value_t>::SYNTAX_ERROR;
 }
 
-inline FunctionParser::ParseErrorType noParenthError(char c) {
+template<typename Value_t>
+inline typename FunctionParserBase<Value_t>::ParseErrorType noParenthError(char c) {
     return c == ',' ?
-               FunctionParser::ILL_PARAMS_AMOUNT :
-               FunctionParser::MISSING_PARENTH;
+               FunctionParserBase<Value_t>::ILL_PARAMS_AMOUNT :
+               FunctionParserBase<Value_t>::MISSING_PARENTH;
+}
+
+// The numbers are read in the precision of the value type:
+template<typename Value_t>
+Value_t ParseLiteral(const char* str, char** endPtr);
+template<>
+inline float ParseLiteral<float>(const char* str, char** endPtr) { return strtof(str, endPtr); }
+template<>
+inline double ParseLiteral<double>(const char* str, char** endPtr) { return strtod(str, endPtr); }
+template<>
+inline long double ParseLiteral<long double>(const char* str, char** endPtr) { return strtold(str, endPtr); }
+
+unsigned OpcodeCost(unsigned opcode); // see EstimatedEvalCost()
+
+const unsigned ShortCircuitMinCost = 20; // in OpcodeCost() units
+
+/* Whether the right-hand side of & or |, compiled from index begin on, is
+   worth jumping over. Only code that cannot report an evaluation error is
+   skipped, so that the errors stay what they would be without skipping.
+*/
+bool ShortCircuitPays(const std::vector<unsigned>& byteCode, unsigned begin) {
+    unsigned cost = 0;
+    for (unsigned IP = begin; IP < byteCode.size(); ++IP) {
+        const unsigned opcode = byteCode[IP];
+        cost += OpcodeCost(opcode);
+        switch (opcode) {
+        case cIf:
+        case cJump: IP += 2; break;
+        case cFCall: IP += 1; break;
+        case cPCall:
+#ifndef FP_DISABLE_EVAL
+        case cEval:
+#endif
+#ifndef FP_NO_EVALUATION_CHECKS
+        case cAcos: case cAsin: case cCot: case cCsc: case cSec:
+        case cLog: case cLog10: case cLog2: case cSqrt: case cRSqrt:
+        case cDiv: case cMod: case cRDiv: case cInv:
+#endif
+            return false;
+        }
+    }
+    return cost >= ShortCircuitMinCost;
 }
 } // namespace
 
-const char* FunctionParser::CompileIf(const char* function) {
+template<typename Value_t>
+const char* FunctionParserBase<Value_t>::CompileIf(const char* function) {
     if (*function != '(')
         return SetErrorType(EXPECT_PARENTH_FUNC, function);
 
@@ -1035,7 +1236,7 @@ const char* FunctionParser::CompileIf(const char* function) {
     if (!function)
         return 0;
     if (*function != ',')
-        return SetErrorType(noCommaError(*function), function);
+        return SetErrorType(noCommaError<Value_t>(*function), function);
 
     data->ByteCode.push_back(cIf);
     const unsigned curByteCodeSize = unsigned(data->ByteCode.size());
@@ -1048,7 +1249,7 @@ const char* FunctionParser::CompileIf(const char* function) {
     if (!function)
         return 0;
     if (*function != ',')
-        return SetErrorType(noCommaError(*function), function);
+        return SetErrorType(noCommaError<Value_t>(*function), function);
 
     data->ByteCode.push_back(cJump);
     const unsigned curByteCodeSize2 = unsigned(data->ByteCode.size());
@@ -1062,7 +1263,7 @@ const char* FunctionParser::CompileIf(const char* function) {
     if (!function)
         return 0;
     if (*function != ')')
-        return SetErrorType(noParenthError(*function), function);
+        return SetErrorType(noParenthError<Value_t>(*function), function);
 
     data->ByteCode.push_back(cNop);
 
@@ -1078,7 +1279,8 @@ const char* FunctionParser::CompileIf(const char* function) {
     return function;
 }
 
-const char* FunctionParser::CompileFunctionParams(const char* function, unsigned requiredParams) {
+template<typename Value_t>
+const char* FunctionParserBase<Value_t>::CompileFunctionParams(const char* function, unsigned requiredParams) {
     if (*function != '(')
         return SetErrorType(EXPECT_PARENTH_FUNC, function);
 
@@ -1089,7 +1291,7 @@ const char* FunctionParser::CompileFunctionParams(const char* function, unsigned
 
         for (unsigned i = 1; i < requiredParams; ++i) {
             if (*function != ',')
-                return SetErrorType(noCommaError(*function), function);
+                return SetErrorType(noCommaError<Value_t>(*function), function);
 
             function = CompileExpression(function + 1);
             if (!function)
@@ -1105,14 +1307,15 @@ const char* FunctionParser::CompileFunctionParams(const char* function, unsigned
     }
 
     if (*function != ')')
-        return SetErrorType(noParenthError(*function), function);
+        return SetErrorType(noParenthError<Value_t>(*function), function);
     ++function;
     while (Ascii::isSpace(*function))
         ++function;
     return function;
 }
 
-const char* FunctionParser::CompileElement(const char* function) {
+template<typename Value_t>
+const char* FunctionParserBase<Value_t>::CompileElement(const char* function) {
     const char c = *function;
 
     if (c == '(') { // Expression in parentheses
@@ -1136,7 +1339,7 @@ const char* FunctionParser::CompileElement(const char* function) {
 
     if (Ascii::isDigit(c) || c == '.') { // Number
         char* endPtr;
-        const double val = strtod(function, &endPtr);
+        const Value_t val = ParseLiteral<Value_t>(function, &endPtr);
         if (endPtr == function)
             return SetErrorType(SYNTAX_ERROR, function);
 
@@ -1182,27 +1385,27 @@ const char* FunctionParser::CompileElement(const char* function) {
             return endPtr;
         }
 
-        std::map<NamePtr, const NameData*>::iterator nameIter = data->namePtrs.find(name);
+        typename std::map<NamePtr, const NameData<Value_t>*>::iterator nameIter = data->namePtrs.find(name);
         if (nameIter != data->namePtrs.end()) {
-            const NameData* nameData = nameIter->second;
+            const NameData<Value_t>* nameData = nameIter->second;
             switch (nameData->type) {
-            case NameData::CONSTANT:
+            case NameData<Value_t>::CONSTANT:
                 data->Immed.push_back(nameData->value);
                 data->ByteCode.push_back(cImmed);
                 incStackPtr();
                 return endPtr;
 
-            case NameData::UNIT:
+            case NameData<Value_t>::UNIT:
                 break;
 
-            case NameData::FUNC_PTR:
+            case NameData<Value_t>::FUNC_PTR:
                 function = CompileFunctionParams(endPtr, data->FuncPtrs[nameData->index].params);
                 data->ByteCode.push_back(cFCall);
                 data->ByteCode.push_back(nameData->index);
                 data->ByteCode.push_back(cNop);
                 return function;
 
-            case NameData::PARSER_PTR:
+            case NameData<Value_t>::PARSER_PTR:
                 function = CompileFunctionParams(endPtr, data->FuncParsers[nameData->index].params);
                 data->ByteCode.push_back(cPCall);
                 data->ByteCode.push_back(nameData->index);
@@ -1216,7 +1419,8 @@ const char* FunctionParser::CompileElement(const char* function) {
     return SetErrorType(SYNTAX_ERROR, function);
 }
 
-const char* FunctionParser::CompilePossibleUnit(const char* function) {
+template<typename Value_t>
+const char* FunctionParserBase<Value_t>::CompilePossibleUnit(const char* function) {
     const char* endPtr = readIdentifier(function);
 
     if (endPtr != function) {
@@ -1224,10 +1428,10 @@ const char* FunctionParser::CompilePossibleUnit(const char* function) {
         while (Ascii::isSpace(*endPtr))
             ++endPtr;
 
-        std::map<NamePtr, const NameData*>::iterator nameIter = data->namePtrs.find(name);
+        typename std::map<NamePtr, const NameData<Value_t>*>::iterator nameIter = data->namePtrs.find(name);
         if (nameIter != data->namePtrs.end()) {
-            const NameData* nameData = nameIter->second;
-            if (nameData->type == NameData::UNIT) {
+            const NameData<Value_t>* nameData = nameIter->second;
+            if (nameData->type == NameData<Value_t>::UNIT) {
                 AddMultiplicationByConst(nameData->value);
                 return endPtr;
             }
@@ -1237,7 +1441,8 @@ const char* FunctionParser::CompilePossibleUnit(const char* function) {
     return function;
 }
 
-const char* FunctionParser::CompilePow(const char* function) {
+template<typename Value_t>
+const char* FunctionParserBase<Value_t>::CompilePow(const char* function) {
     function = CompileElement(function);
     if (!function)
         return 0;
@@ -1249,7 +1454,7 @@ const char* FunctionParser::CompilePow(const char* function) {
             ++function;
 
         bool base_is_immed = false;
-        double base_immed = 0;
+        Value_t base_immed = 0;
         if (data->ByteCode.back() == cImmed) {
             base_is_immed = true;
             base_immed = data->Immed.back();
@@ -1265,12 +1470,12 @@ const char* FunctionParser::CompilePow(const char* function) {
         if (data->ByteCode.back() == cImmed) {
             // If operator is applied to two literals, calculate it now:
             if (base_is_immed)
-                data->Immed.back() = pow(base_immed, data->Immed.back());
+                data->Immed.back() = std::pow(base_immed, data->Immed.back());
             else
                 AddFunctionOpcode(cPow);
         } else if (base_is_immed) {
             if (base_immed > 0.0) {
-                double mulvalue = std::log(base_immed);
+                Value_t mulvalue = std::log(base_immed);
                 if (mulvalue != 1.0)
                     AddMultiplicationByConst(mulvalue);
                 AddFunctionOpcode(cExp);
@@ -1291,7 +1496,8 @@ const char* FunctionParser::CompilePow(const char* function) {
     return function;
 }
 
-const char* FunctionParser::CompileUnaryMinus(const char* function) {
+template<typename Value_t>
+const char* FunctionParserBase<Value_t>::CompileUnaryMinus(const char* function) {
     const char op = *function;
     if (op == '-' || op == '!') {
         ++function;
@@ -1331,7 +1537,8 @@ const char* FunctionParser::CompileUnaryMinus(const char* function) {
     return function;
 }
 
-inline const char* FunctionParser::CompileMult(const char* function) {
+template<typename Value_t>
+inline const char* FunctionParserBase<Value_t>::CompileMult(const char* function) {
     function = CompileUnaryMinus(function);
     if (!function)
         return 0;
@@ -1439,7 +1646,8 @@ inline const char* FunctionParser::CompileMult(const char* function) {
     return function;
 }
 
-inline const char* FunctionParser::CompileAddition(const char* function) {
+template<typename Value_t>
+inline const char* FunctionParserBase<Value_t>::CompileAddition(const char* function) {
     function = CompileMult(function);
     if (!function)
         return 0;
@@ -1546,7 +1754,8 @@ inline int getComparisonOpcode(const char*& f) {
 }
 } // namespace
 
-const char* FunctionParser::CompileComparison(const char* function) {
+template<typename Value_t>
+const char* FunctionParserBase<Value_t>::CompileComparison(const char* function) {
     function = CompileAddition(function);
     if (!function)
         return 0;
@@ -1564,7 +1773,50 @@ const char* FunctionParser::CompileComparison(const char* function) {
     return function;
 }
 
-inline const char* FunctionParser::CompileAnd(const char* function) {
+/* Turns the already compiled "a b" of "a & b" into "if(a, notnot(b), 0)"
+   and that of "a | b" into "if(not(a), notnot(b), 1)", which give the same
+   results but evaluate b only when it is needed. The code of b is moved
+   behind the inserted cIf, so its own jump indices are moved with it.
+*/
+template<typename Value_t>
+void FunctionParserBase<Value_t>::CompileShortCircuit(unsigned opcode, unsigned rhsBegin) {
+    std::vector<unsigned>& byteCode = data->ByteCode;
+    const unsigned shift = opcode == cOr ? 4 : 3;
+    unsigned lastOpcode = cNop;
+    for (unsigned IP = rhsBegin; IP < byteCode.size(); ++IP) {
+        lastOpcode = byteCode[IP];
+        switch (lastOpcode) {
+        case cIf:
+        case cJump: byteCode[IP + 1] += shift; IP += 2; break;
+        case cFCall: IP += 1; break;
+        }
+    }
+
+    unsigned head[4] = { cNot, cIf, 0, 0 };
+    byteCode.insert(byteCode.begin() + rhsBegin, head + 4 - shift, head + 4);
+    const unsigned ifPos = rhsBegin + shift - 2;
+
+    if (lastOpcode < cEqual || lastOpcode > cNotNot) // b is not already 0 or 1
+        byteCode.push_back(cNotNot);
+    byteCode.push_back(cJump);
+    const unsigned jumpPos = unsigned(byteCode.size());
+    const unsigned jumpImmedSize = unsigned(data->Immed.size());
+    byteCode.push_back(0); // Jump index; to be set later
+    byteCode.push_back(0); // Immed jump index; to be set later
+
+    byteCode.push_back(cImmed);
+    data->Immed.push_back(opcode == cOr ? 1 : 0);
+    byteCode.push_back(cNop);
+
+    // Set jump indices
+    byteCode[ifPos] = jumpPos + 1;
+    byteCode[ifPos + 1] = jumpImmedSize;
+    byteCode[jumpPos] = unsigned(byteCode.size()) - 1;
+    byteCode[jumpPos + 1] = unsigned(data->Immed.size());
+}
+
+template<typename Value_t>
+inline const char* FunctionParserBase<Value_t>::CompileAnd(const char* function) {
     function = CompileComparison(function);
     if (!function)
         return 0;
@@ -1573,16 +1825,21 @@ inline const char* FunctionParser::CompileAnd(const char* function) {
         ++function;
         while (Ascii::isSpace(*function))
             ++function;
+        const unsigned rhsBegin = unsigned(data->ByteCode.size());
         function = CompileComparison(function);
         if (!function)
             return 0;
-        data->ByteCode.push_back(cAnd);
+        if (data->useShortCircuitEvaluation && ShortCircuitPays(data->ByteCode, rhsBegin))
+            CompileShortCircuit(cAnd, rhsBegin);
+        else
+            data->ByteCode.push_back(cAnd);
         --StackPtr;
     }
     return function;
 }
 
-const char* FunctionParser::CompileExpression(const char* function) {
+template<typename Value_t>
+const char* FunctionParserBase<Value_t>::CompileExpression(const char* function) {
     while (Ascii::isSpace(*function))
         ++function;
     function = CompileAnd(function);
@@ -1593,10 +1850,14 @@ const char* FunctionParser::CompileExpression(const char* function) {
         ++function;
         while (Ascii::isSpace(*function))
             ++function;
+        const unsigned rhsBegin = unsigned(data->ByteCode.size());
         function = CompileAnd(function);
         if (!function)
             return 0;
-        data->ByteCode.push_back(cOr);
+        if (data->useShortCircuitEvaluation && ShortCircuitPays(data->ByteCode, rhsBegin))
+            CompileShortCircuit(cOr, rhsBegin);
+        else
+            data->ByteCode.push_back(cOr);
         --StackPtr;
     }
     return function;
@@ -1605,152 +1866,469 @@ const char* FunctionParser::CompileExpression(const char* function) {
 //===========================================================================
 // Function evaluation
 //===========================================================================
-double FunctionParser::Eval(const double* Vars) {
+/* Within the range of Approximate(), the piece containing the value of the
+   variable is found from the cell it falls in, and its polynomial is
+   evaluated instead of the function. See fparser_approx.cc.
+*/
+namespace {
+template<typename Approximation, typename Value_t>
+inline bool EvalApproximation(const Approximation& approximation, Value_t x, Value_t& result) {
+    if (!(x >= approximation.minValue && x <= approximation.maxValue))
+        return false;
+
+    const unsigned lastCell = unsigned(approximation.cells.size() - 1);
+    unsigned cell = unsigned((x - approximation.minValue) * approximation.cellsPerUnit);
+    if (cell > lastCell)
+        cell = lastCell;
+    unsigned index = approximation.cells[cell];
+    while (index + 1 < approximation.pieces.size() && x >= approximation.breaks[index + 1])
+        ++index;
+
+    const typename Approximation::Piece& piece = approximation.pieces[index];
+    if (piece.exact)
+        return false;
+    // The degree is odd, and the even and odd terms are summed separately
+    // (in t^2), which halves the latency of the polynomial.
+    const unsigned degree = approximation.degree;
+    const double t = (x - piece.center) * piece.inverseRadius, t2 = t * t;
+    const double* coefficients = &approximation.coefficients[index * (degree + 1)];
+    double even = coefficients[degree - 1], odd = coefficients[degree];
+    for (unsigned k = degree - 1; k > 0; k -= 2) {
+        even = even * t2 + coefficients[k - 2];
+        odd = odd * t2 + coefficients[k - 1];
+    }
+    result = Value_t(even + odd * t);
+    return true;
+}
+} // namespace
+
+template<typename Value_t>
+Value_t FunctionParserBase<Value_t>::Eval(const Value_t* Vars) {
     if (parseErrorType != FP_NO_ERROR)
         return 0.0;
 
-    const unsigned* const ByteCode = &(data->ByteCode[0]);
-    const double* const Immed = data->Immed.empty() ? 0 : &(data->Immed[0]);
-    const unsigned ByteCodeSize = unsigned(data->ByteCode.size());
-    unsigned IP, DP = 0;
-    int SP = -1;
+    Value_t approximated;
+    if (!data->approximation.pieces.empty() &&
+        EvalApproximation(data->approximation, Vars[0], approximated)) {
+        evalErrorType = 0;
+        return approximated;
+    }
 
 #ifdef FP_USE_THREAD_SAFE_EVAL
+    EvalContext context;
 #ifdef FP_USE_THREAD_SAFE_EVAL_WITH_ALLOCA
-    double* const Stack = (double*)alloca(data->StackSize * sizeof(double));
+    Value_t* const memory = (Value_t*)alloca(
+        (data->RegisterCode.empty() ? data->StackSize : data->RegisterFile.size()) * sizeof(Value_t));
+    const Value_t result = Evaluate(context, memory, Vars);
+#else
+    const Value_t result = Eval(context, Vars);
+#endif
+#else
+    EvalContext& context = evalContext;
+    const Value_t result = Eval(context, Vars);
+#endif
+    evalErrorType = context.evalErrorType;
+    return result;
+}
+
+/* Eval(context, Vars) only reads the parser, so one parser can be used by
+   any number of threads at the same time, as long as each of them uses its
+   own context. The stack (or the registers) are kept in the context and
+   only grow, so evaluation does not allocate memory after the first call.
+*/
+template<typename Value_t>
+Value_t FunctionParserBase<Value_t>::Eval(EvalContext& context, const Value_t* Vars) const {
+    if (parseErrorType != FP_NO_ERROR)
+        return 0.0;
+
+    Value_t approximated;
+    if (!data->approximation.pieces.empty() &&
+        EvalApproximation(data->approximation, Vars[0], approximated)) {
+        context.evalErrorType = 0;
+        return approximated;
+    }
+
+    const size_t size =
+        data->RegisterCode.empty() ? data->StackSize : data->RegisterFile.size();
+    if (context.Stack.size() < size)
+        context.Stack.resize(size);
+    return Evaluate(context, context.Stack.empty() ? 0 : &context.Stack[0], Vars);
+}
+
+// Only FunctionParser has the register code and the compiled code:
+template<typename Value_t>
+Value_t FunctionParserBase<Value_t>::Evaluate(EvalContext& context, Value_t* memory, const Value_t* Vars) const {
+    return EvalByteCode<false>(context, memory, Vars, false);
+}
+
+template<>
+double FunctionParser::Evaluate(EvalContext& context, double* memory, const double* Vars) const {
+#ifdef FP_SUPPORT_FP_EXCEPTIONS
+    // The recursive calls of eval() are evaluated with the checks, since
+    // repeating each level of the recursion would double the work per level.
+    if (data->useFPExceptions && context.evalRecursionLevel == 0)
+        return EvaluateWithFPExceptions(context, memory, Vars);
+#endif
+
+    // The code compiled for UseFloatingPointExceptions() has no checks.
+    if (data->compiledFunction && !data->useFPExceptions)
+        return data->compiledFunction(Vars, &context, this);
+
+    if (!data->RegisterCode.empty())
+        return EvalRegisterCode<true>(context, memory, Vars);
+
+    return EvalByteCode<false>(context, memory, Vars, false);
+}
+
+/* With UseFloatingPointExceptions() the register code (or the compiled code)
+   is run without checking the operands. Every operation the checks would
+   reject raises the division by zero or the invalid exception flag, except
+   dividing an infinite value by zero. So when none of these flags (nor the
+   overflow flag) are raised, no error was set and the result is finite,
+   the checks would not have found anything either, and the result is the
+   same. Otherwise the evaluation is simply repeated with the checks, which
+   gives exactly the result and the error code of the normal evaluation.
+   (An error can thus only be missed when an infinite value, such as a
+   variable, is divided by zero and the infinity does not reach the
+   result.)
+   The flags the caller had raised are preserved, and the flags raised by
+   the evaluation are cleared, so that the next call does not need to save
+   anything.
+*/
+#ifdef FP_SUPPORT_FP_EXCEPTIONS
+namespace {
+/* On x86-64 all the double arithmetic, the math library included, is done
+   with SSE, so the flags can be read from MXCSR directly, which is a lot
+   faster than fetestexcept() (which also reads the x87 status word).
+*/
+#if defined(__x86_64__) || defined(_M_X64)
+const unsigned MXCSRExceptionFlags = 0x0D; // invalid, division by zero, overflow
+typedef unsigned FPExceptions;
+
+inline FPExceptions RaisedFPExceptions() {
+    return _mm_getcsr() & MXCSRExceptionFlags;
+}
+
+inline void SetFPExceptions(FPExceptions flags) {
+    _mm_setcsr((_mm_getcsr() & ~MXCSRExceptionFlags) | flags);
+}
+#else
+typedef int FPExceptions;
+
+inline FPExceptions RaisedFPExceptions() {
+    return fetestexcept(FE_DIVBYZERO | FE_INVALID | FE_OVERFLOW);
+}
+
+inline void SetFPExceptions(FPExceptions flags) {
+    feclearexcept(FE_DIVBYZERO | FE_INVALID | FE_OVERFLOW);
+    if (flags)
+        feraiseexcept(flags);
+}
+#endif
+
+// Does not raise any flags, unlike comparing NaN.
+inline bool isFinite(double value) {
+    unsigned long long bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return (bits & 0x7FF0000000000000ULL) != 0x7FF0000000000000ULL;
+}
+} // namespace
+
+template<>
+double FunctionParser::EvaluateWithFPExceptions(EvalContext& context, double* memory, const double* Vars) const {
+    const FPExceptions callerFlags = RaisedFPExceptions();
+    if (callerFlags)
+        SetFPExceptions(0);
+
+    double result;
+    if (data->compiledFunction)
+        result = data->compiledFunction(Vars, &context, this);
+    else if (!data->RegisterCode.empty())
+        result = EvalRegisterCode<false>(context, memory, Vars);
+    else
+        result = EvalByteCode<false>(context, memory, Vars, false);
+
+    if (RaisedFPExceptions() || context.evalErrorType || !isFinite(result)) {
+        if (!data->RegisterCode.empty())
+            result = EvalRegisterCode<true>(context, memory, Vars);
+        else
+            result = EvalByteCode<false>(context, memory, Vars, false);
+        SetFPExceptions(callerFlags);
+    } else if (callerFlags) {
+        SetFPExceptions(callerFlags);
+    }
+    return result;
+}
+#endif
+
+/* With FP_USE_THREADED_DISPATCH the bytecode is predecoded into
+   data->ThreadedCode, which holds the address of the handler of each opcode
+   (the operand words are left null), plus the address of the end of the
+   evaluation. Each handler then jumps directly to the handler of the next
+   opcode, instead of all of them going through the single indirect jump of
+   the switch. Since the handler addresses are only known inside this
+   function, the predecoding is done by calling it with predecode=true,
+   which ParseFunction() and Optimize() do. The profiled instantiation
+   cannot use ThreadedCode, which holds the handler addresses of the other
+   one, so it looks the handler of each opcode up as it goes.
+*/
+#ifdef FP_USE_THREADED_DISPATCH
+#define FP_CASE(opcode) l_##opcode:
+#define FP_VARIABLE_CASE l_Var:
+#define FP_HANDLER(IP)                                                          \
+    (profiled ? (IP < ByteCodeSize ?                                            \
+                     handlers[ByteCode[IP] < VarBegin ? ByteCode[IP] : unsigned(VarBegin)] : \
+                     &&l_End) :                                                 \
+                Code[IP])
+#define FP_NEXT                          \
+    do {                                 \
+        if (profiled)                    \
+            profiler.Step(IP + 1);       \
+        ++IP;                            \
+        goto *FP_HANDLER(IP);            \
+    } while (0)
+#else
+#define FP_CASE(opcode) case opcode:
+#define FP_VARIABLE_CASE default:
+#define FP_NEXT break
+#endif
+
+namespace {
+inline unsigned long long ReadCycleCounter() {
+#ifdef FP_HAVE_RDTSC
+    return __rdtsc();
+#else
+    return (unsigned long long)std::clock();
+#endif
+}
+
+/* Charges the time since the previous Step() to the instruction which was
+   then started. The time of an instruction thus includes the dispatch of
+   the next one and reading the counter, which is the bulk of the time of
+   the cheapest instructions.
+*/
+template<typename Entry>
+class ByteCodeProfiler {
+public:
+    explicit ByteCodeProfiler(std::vector<Entry>* e, const std::vector<unsigned>* at)
+        : entries(e), entryAt(at), running(false), current(0), started(0) {}
+
+    inline void Step(unsigned next) {
+        const unsigned long long now = ReadCycleCounter();
+        if (running) {
+            Entry& entry = (*entries)[(*entryAt)[current]];
+            ++entry.executions;
+            entry.cycles += now - started;
+        }
+        running = true;
+        current = next;
+        started = now;
+    }
+
+private:
+    std::vector<Entry>* entries;
+    const std::vector<unsigned>* entryAt;
+    bool running;
+    unsigned current;
+    unsigned long long started;
+};
+} // namespace
+
+template<typename Value_t>
+template<bool profiled>
+Value_t FunctionParserBase<Value_t>::EvalByteCode(EvalContext& context, Value_t* Stack, const Value_t* Vars,
+                                                  bool predecode, EvalProfile* profile) const {
+#ifdef FP_USE_THREADED_DISPATCH
+    // In the order of the OPCODE enum:
+    static const void* const handlers[] = {
+        &&l_cAbs, &&l_cAcos, &&l_cAcosh, &&l_cAsin, &&l_cAsinh, &&l_cAtan,
+        &&l_cAtan2, &&l_cAtanh, &&l_cCeil, &&l_cCos, &&l_cCosh, &&l_cCot,
+        &&l_cCsc,
+#ifndef FP_DISABLE_EVAL
+        &&l_cEval,
 #else
-    std::vector<double> Stack(data->StackSize);
+        &&l_Var, // the switch would treat it as a variable, too
 #endif
+        &&l_cExp, &&l_cExp2, &&l_cFloor, &&l_cIf, &&l_cInt, &&l_cLog,
+        &&l_cLog10, &&l_cLog2, &&l_cMax, &&l_cMin, &&l_cPow, &&l_cSec,
+        &&l_cSin, &&l_cSinh, &&l_cSqrt, &&l_cTan, &&l_cTanh,
+        &&l_cImmed, &&l_cJump, &&l_cNeg, &&l_cAdd, &&l_cSub, &&l_cMul,
+        &&l_cDiv, &&l_cMod, &&l_cEqual, &&l_cNEqual, &&l_cLess,
+        &&l_cLessOrEq, &&l_cGreater, &&l_cGreaterOrEq, &&l_cNot, &&l_cAnd,
+        &&l_cOr, &&l_cNotNot, &&l_cDeg, &&l_cRad, &&l_cFCall, &&l_cPCall,
+        &&l_cRPow,
+#ifdef FP_SUPPORT_OPTIMIZER
+        &&l_cVar, &&l_cFetch, &&l_cPopNMov, &&l_cSelect,
+#endif
+        &&l_cDup, &&l_cInv, &&l_cSqr, &&l_cRDiv, &&l_cRSub, &&l_cRSqrt,
+        &&l_cNop,
+        &&l_Var // VarBegin and up
+    };
+
+    if (predecode) {
+        assert(sizeof(handlers) / sizeof(handlers[0]) == VarBegin + 1);
+        const std::vector<unsigned>& byteCode = data->ByteCode;
+        std::vector<const void*>& code = data->ThreadedCode;
+        code.assign(byteCode.size() + 1, 0);
+        for (unsigned i = 0; i < byteCode.size(); ++i) {
+            const unsigned opcode = byteCode[i];
+            code[i] = handlers[opcode < VarBegin ? opcode : unsigned(VarBegin)];
+            switch (opcode) {
+            case cIf:
+            case cJump: i += 2; break;
+            case cFCall:
+            case cPCall: i += 1; break;
+#ifdef FP_SUPPORT_OPTIMIZER
+            case cFetch: i += 1; break;
+            case cPopNMov: i += 2; break;
+#endif
+            }
+        }
+        code[byteCode.size()] = &&l_End;
+        return 0;
+    }
 #else
-    std::vector<double>& Stack = data->Stack;
+    if (predecode)
+        return 0;
 #endif
 
+    const unsigned* const ByteCode = &(data->ByteCode[0]);
+    const Value_t* const Immed = data->Immed.empty() ? 0 : &(data->Immed[0]);
+    const unsigned ByteCodeSize = unsigned(data->ByteCode.size());
+    unsigned IP, DP = 0;
+    int SP = -1;
+    ByteCodeProfiler<typename EvalProfile::Entry> profiler(profiled ? &profile->entries : 0, profiled ? &profile->entryAt : 0);
+
+#ifdef FP_USE_THREADED_DISPATCH
+    const void* const* const Code = &(data->ThreadedCode[0]);
+    IP = 0;
+    if (profiled)
+        profiler.Step(0);
+    goto *FP_HANDLER(0);
+    {
+#else
     for (IP = 0; IP < ByteCodeSize; ++IP) {
+        if (profiled)
+            profiler.Step(IP);
         switch (ByteCode[IP]) {
+#endif
             // Functions:
-        case cAbs:
-            Stack[SP] = fabs(Stack[SP]);
-            break;
+        FP_CASE(cAbs)
+            Stack[SP] = std::fabs(Stack[SP]);
+            FP_NEXT;
 
-        case cAcos:
+        FP_CASE(cAcos)
 #ifndef FP_NO_EVALUATION_CHECKS
             if (Stack[SP] < -1 || Stack[SP] > 1) {
-                evalErrorType = 4;
+                context.evalErrorType = 4;
                 return 0;
             }
 #endif
-            Stack[SP] = acos(Stack[SP]);
-            break;
+            Stack[SP] = std::acos(Stack[SP]);
+            FP_NEXT;
 
-        case cAcosh:
+        FP_CASE(cAcosh)
             Stack[SP] = fp_acosh(Stack[SP]);
-            break;
+            FP_NEXT;
 
-        case cAsin:
+        FP_CASE(cAsin)
 #ifndef FP_NO_EVALUATION_CHECKS
             if (Stack[SP] < -1 || Stack[SP] > 1) {
-                evalErrorType = 4;
+                context.evalErrorType = 4;
                 return 0;
             }
 #endif
-            Stack[SP] = asin(Stack[SP]);
-            break;
+            Stack[SP] = std::asin(Stack[SP]);
+            FP_NEXT;
 
-        case cAsinh:
+        FP_CASE(cAsinh)
             Stack[SP] = fp_asinh(Stack[SP]);
-            break;
+            FP_NEXT;
 
-        case cAtan:
-            Stack[SP] = atan(Stack[SP]);
-            break;
+        FP_CASE(cAtan)
+            Stack[SP] = std::atan(Stack[SP]);
+            FP_NEXT;
 
-        case cAtan2:
-            Stack[SP - 1] = atan2(Stack[SP - 1], Stack[SP]);
+        FP_CASE(cAtan2)
+            Stack[SP - 1] = std::atan2(Stack[SP - 1], Stack[SP]);
             --SP;
-            break;
+            FP_NEXT;
 
-        case cAtanh:
+        FP_CASE(cAtanh)
             Stack[SP] = fp_atanh(Stack[SP]);
-            break;
+            FP_NEXT;
 
-        case cCeil:
-            Stack[SP] = ceil(Stack[SP]);
-            break;
+        FP_CASE(cCeil)
+            Stack[SP] = std::ceil(Stack[SP]);
+            FP_NEXT;
 
-        case cCos:
-            Stack[SP] = cos(Stack[SP]);
-            break;
+        FP_CASE(cCos)
+            Stack[SP] = std::cos(Stack[SP]);
+            FP_NEXT;
 
-        case cCosh:
-            Stack[SP] = cosh(Stack[SP]);
-            break;
+        FP_CASE(cCosh)
+            Stack[SP] = std::cosh(Stack[SP]);
+            FP_NEXT;
 
-        case cCot: {
-            const double t = tan(Stack[SP]);
+        FP_CASE(cCot) {
+            const Value_t t = std::tan(Stack[SP]);
 #ifndef FP_NO_EVALUATION_CHECKS
             if (t == 0) {
-                evalErrorType = 1;
+                context.evalErrorType = 1;
                 return 0;
             }
 #endif
             Stack[SP] = 1 / t;
-            break;
+            FP_NEXT;
         }
 
-        case cCsc: {
-            const double s = sin(Stack[SP]);
+        FP_CASE(cCsc) {
+            const Value_t s = std::sin(Stack[SP]);
 #ifndef FP_NO_EVALUATION_CHECKS
             if (s == 0) {
-                evalErrorType = 1;
+                context.evalErrorType = 1;
                 return 0;
             }
 #endif
             Stack[SP] = 1 / s;
-            break;
+            FP_NEXT;
         }
 
 #ifndef FP_DISABLE_EVAL
-        case cEval: {
+        FP_CASE(cEval) {
             const unsigned varAmount =
                 unsigned(data->variableRefs.size());
-            double retVal = 0;
-            if (evalRecursionLevel == FP_EVAL_MAX_REC_LEVEL) {
-                evalErrorType = 5;
+            Value_t retVal = 0;
+            if (context.evalRecursionLevel == FP_EVAL_MAX_REC_LEVEL) {
+                context.evalErrorType = 5;
             } else {
-                ++evalRecursionLevel;
-#ifndef FP_USE_THREAD_SAFE_EVAL
-                std::vector<double> tmpStack(Stack.size());
-                data->Stack.swap(tmpStack);
-                retVal = Eval(&tmpStack[SP - varAmount + 1]);
-                data->Stack.swap(tmpStack);
-#else
-                retVal = Eval(&Stack[SP - varAmount + 1]);
-#endif
-                --evalRecursionLevel;
+                EvalContext& nested = context.Nested();
+                nested.evalRecursionLevel = context.evalRecursionLevel + 1;
+                retVal = Eval(nested, &Stack[SP - varAmount + 1]);
             }
             SP -= varAmount - 1;
             Stack[SP] = retVal;
-            break;
+            FP_NEXT;
         }
 #endif
 
-        case cExp:
-            Stack[SP] = exp(Stack[SP]);
-            break;
+        FP_CASE(cExp)
+            Stack[SP] = std::exp(Stack[SP]);
+            FP_NEXT;
 
-        case cExp2:
+        FP_CASE(cExp2)
             //#ifdef FP_SUPPORT_EXP2
             //  Stack[SP] = exp2(Stack[SP]);
             //#else
-            Stack[SP] = pow(2.0, Stack[SP]);
+            Stack[SP] = std::pow(Value_t(2), Stack[SP]);
             //#endif
-            break;
+            FP_NEXT;
 
-        case cFloor:
-            Stack[SP] = floor(Stack[SP]);
-            break;
+        FP_CASE(cFloor)
+            Stack[SP] = std::floor(Stack[SP]);
+            FP_NEXT;
 
-        case cIf: {
+        FP_CASE(cIf) {
             unsigned jumpAddr = ByteCode[++IP];
             unsigned immedAddr = ByteCode[++IP];
             if (doubleToInt(Stack[SP]) == 0) {
@@ -1758,269 +2336,1058 @@ double FunctionParser::Eval(const double* Vars) {
                 DP = immedAddr;
             }
             --SP;
-            break;
+            FP_NEXT;
         }
 
-        case cInt:
-            Stack[SP] = floor(Stack[SP] + .5);
-            break;
+        FP_CASE(cInt)
+            Stack[SP] = std::floor(Stack[SP] + .5);
+            FP_NEXT;
 
-        case cLog:
+        FP_CASE(cLog)
 #ifndef FP_NO_EVALUATION_CHECKS
             if (Stack[SP] <= 0) {
-                evalErrorType = 3;
+                context.evalErrorType = 3;
                 return 0;
             }
 #endif
-            Stack[SP] = log(Stack[SP]);
-            break;
+            Stack[SP] = std::log(Stack[SP]);
+            FP_NEXT;
 
-        case cLog10:
+        FP_CASE(cLog10)
 #ifndef FP_NO_EVALUATION_CHECKS
             if (Stack[SP] <= 0) {
-                evalErrorType = 3;
+                context.evalErrorType = 3;
                 return 0;
             }
 #endif
-            Stack[SP] = log10(Stack[SP]);
-            break;
+            Stack[SP] = std::log10(Stack[SP]);
+            FP_NEXT;
 
-        case cLog2:
+        FP_CASE(cLog2)
 #ifndef FP_NO_EVALUATION_CHECKS
             if (Stack[SP] <= 0) {
-                evalErrorType = 3;
+                context.evalErrorType = 3;
                 return 0;
             }
 #endif
 #ifdef FP_SUPPORT_LOG2
-            Stack[SP] = log2(Stack[SP]);
+            Stack[SP] = std::log2(Stack[SP]);
 #else
-            Stack[SP] = log(Stack[SP]) * 1.4426950408889634074;
+            Stack[SP] = std::log(Stack[SP]) * Value_t(1.4426950408889634073599246810018921L);
 #endif
-            break;
+            FP_NEXT;
 
-        case cMax:
+        FP_CASE(cMax)
             Stack[SP - 1] = Max(Stack[SP - 1], Stack[SP]);
             --SP;
-            break;
+            FP_NEXT;
 
-        case cMin:
+        FP_CASE(cMin)
             Stack[SP - 1] = Min(Stack[SP - 1], Stack[SP]);
             --SP;
-            break;
+            FP_NEXT;
 
-        case cPow:
-            Stack[SP - 1] = pow(Stack[SP - 1], Stack[SP]);
+        FP_CASE(cPow)
+            Stack[SP - 1] = std::pow(Stack[SP - 1], Stack[SP]);
             --SP;
-            break;
-        case cRPow:
-            Stack[SP - 1] = pow(Stack[SP], Stack[SP - 1]);
+            FP_NEXT;
+        FP_CASE(cRPow)
+            Stack[SP - 1] = std::pow(Stack[SP], Stack[SP - 1]);
             --SP;
-            break;
+            FP_NEXT;
 
-        case cSec: {
-            const double c = cos(Stack[SP]);
+        FP_CASE(cSec) {
+            const Value_t c = std::cos(Stack[SP]);
 #ifndef FP_NO_EVALUATION_CHECKS
             if (c == 0) {
-                evalErrorType = 1;
+                context.evalErrorType = 1;
                 return 0;
             }
 #endif
             Stack[SP] = 1 / c;
-            break;
+            FP_NEXT;
         }
 
-        case cSin:
-            Stack[SP] = sin(Stack[SP]);
-            break;
+        FP_CASE(cSin)
+            Stack[SP] = std::sin(Stack[SP]);
+            FP_NEXT;
 
-        case cSinh:
-            Stack[SP] = sinh(Stack[SP]);
-            break;
+        FP_CASE(cSinh)
+            Stack[SP] = std::sinh(Stack[SP]);
+            FP_NEXT;
 
-        case cSqrt:
+        FP_CASE(cSqrt)
 #ifndef FP_NO_EVALUATION_CHECKS
             if (Stack[SP] < 0) {
-                evalErrorType = 2;
+                context.evalErrorType = 2;
                 return 0;
             }
 #endif
-            Stack[SP] = sqrt(Stack[SP]);
-            break;
+            Stack[SP] = std::sqrt(Stack[SP]);
+            FP_NEXT;
 
-        case cTan:
-            Stack[SP] = tan(Stack[SP]);
-            break;
+        FP_CASE(cTan)
+            Stack[SP] = std::tan(Stack[SP]);
+            FP_NEXT;
 
-        case cTanh:
-            Stack[SP] = tanh(Stack[SP]);
-            break;
+        FP_CASE(cTanh)
+            Stack[SP] = std::tanh(Stack[SP]);
+            FP_NEXT;
 
             // Misc:
-        case cImmed:
+        FP_CASE(cImmed)
             Stack[++SP] = Immed[DP++];
-            break;
+            FP_NEXT;
 
-        case cJump:
+        FP_CASE(cJump)
             DP = ByteCode[IP + 2];
             IP = ByteCode[IP + 1];
-            break;
+            FP_NEXT;
 
             // Operators:
-        case cNeg:
+        FP_CASE(cNeg)
             Stack[SP] = -Stack[SP];
-            break;
-        case cAdd:
+            FP_NEXT;
+        FP_CASE(cAdd)
             Stack[SP - 1] += Stack[SP];
             --SP;
-            break;
-        case cSub:
+            FP_NEXT;
+        FP_CASE(cSub)
             Stack[SP - 1] -= Stack[SP];
             --SP;
-            break;
-        case cMul:
+            FP_NEXT;
+        FP_CASE(cMul)
             Stack[SP - 1] *= Stack[SP];
             --SP;
-            break;
+            FP_NEXT;
 
-        case cDiv:
+        FP_CASE(cDiv)
 #ifndef FP_NO_EVALUATION_CHECKS
             if (Stack[SP] == 0) {
-                evalErrorType = 1;
+                context.evalErrorType = 1;
                 return 0;
             }
 #endif
             Stack[SP - 1] /= Stack[SP];
             --SP;
-            break;
+            FP_NEXT;
 
-        case cMod:
+        FP_CASE(cMod)
 #ifndef FP_NO_EVALUATION_CHECKS
             if (Stack[SP] == 0) {
-                evalErrorType = 1;
+                context.evalErrorType = 1;
                 return 0;
             }
 #endif
-            Stack[SP - 1] = fmod(Stack[SP - 1], Stack[SP]);
+            Stack[SP - 1] = std::fmod(Stack[SP - 1], Stack[SP]);
             --SP;
-            break;
+            FP_NEXT;
 
 #ifdef FP_EPSILON
-        case cEqual:
+        FP_CASE(cEqual)
             Stack[SP - 1] =
-                (fabs(Stack[SP - 1] - Stack[SP]) <= FP_EPSILON);
+                (std::fabs(Stack[SP - 1] - Stack[SP]) <= FP_EPSILON);
             --SP;
-            break;
+            FP_NEXT;
 
-        case cNEqual:
+        FP_CASE(cNEqual)
             Stack[SP - 1] =
-                (fabs(Stack[SP - 1] - Stack[SP]) >= FP_EPSILON);
+                (std::fabs(Stack[SP - 1] - Stack[SP]) >= FP_EPSILON);
             --SP;
-            break;
+            FP_NEXT;
 
-        case cLess:
+        FP_CASE(cLess)
             Stack[SP - 1] = (Stack[SP - 1] < Stack[SP] - FP_EPSILON);
             --SP;
-            break;
+            FP_NEXT;
 
-        case cLessOrEq:
+        FP_CASE(cLessOrEq)
             Stack[SP - 1] = (Stack[SP - 1] <= Stack[SP] + FP_EPSILON);
             --SP;
-            break;
+            FP_NEXT;
 
-        case cGreater:
+        FP_CASE(cGreater)
             Stack[SP - 1] = (Stack[SP - 1] - FP_EPSILON > Stack[SP]);
             --SP;
-            break;
+            FP_NEXT;
 
-        case cGreaterOrEq:
+        FP_CASE(cGreaterOrEq)
             Stack[SP - 1] =
                 (Stack[SP - 1] + FP_EPSILON >= Stack[SP]);
             --SP;
-            break;
+            FP_NEXT;
 #else
-        case cEqual:
+        FP_CASE(cEqual)
             Stack[SP - 1] = (Stack[SP - 1] == Stack[SP]);
             --SP;
-            break;
+            FP_NEXT;
 
-        case cNEqual:
+        FP_CASE(cNEqual)
             Stack[SP - 1] = (Stack[SP - 1] != Stack[SP]);
             --SP;
-            break;
+            FP_NEXT;
 
-        case cLess:
+        FP_CASE(cLess)
             Stack[SP - 1] = (Stack[SP - 1] < Stack[SP]);
             --SP;
-            break;
+            FP_NEXT;
 
-        case cLessOrEq:
+        FP_CASE(cLessOrEq)
             Stack[SP - 1] = (Stack[SP - 1] <= Stack[SP]);
             --SP;
-            break;
+            FP_NEXT;
 
-        case cGreater:
+        FP_CASE(cGreater)
             Stack[SP - 1] = (Stack[SP - 1] > Stack[SP]);
             --SP;
+            FP_NEXT;
+
+        FP_CASE(cGreaterOrEq)
+            Stack[SP - 1] = (Stack[SP - 1] >= Stack[SP]);
+            --SP;
+            FP_NEXT;
+#endif
+
+        FP_CASE(cNot)
+            Stack[SP] = !doubleToInt(Stack[SP]);
+            FP_NEXT;
+
+        FP_CASE(cAnd)
+            Stack[SP - 1] =
+                (doubleToInt(Stack[SP - 1]) &&
+                 doubleToInt(Stack[SP]));
+            --SP;
+            FP_NEXT;
+
+        FP_CASE(cOr)
+            Stack[SP - 1] =
+                (doubleToInt(Stack[SP - 1]) ||
+                 doubleToInt(Stack[SP]));
+            --SP;
+            FP_NEXT;
+
+        FP_CASE(cNotNot)
+            Stack[SP] = !!doubleToInt(Stack[SP]);
+            FP_NEXT;
+
+            // Degrees-radians conversion:
+        FP_CASE(cDeg)
+            Stack[SP] = RadiansToDegrees(Stack[SP]);
+            FP_NEXT;
+        FP_CASE(cRad)
+            Stack[SP] = DegreesToRadians(Stack[SP]);
+            FP_NEXT;
+
+            // User-defined function calls:
+        FP_CASE(cFCall) {
+            unsigned index = ByteCode[++IP];
+            unsigned params = data->FuncPtrs[index].params;
+            Value_t retVal = data->FuncPtrs[index].funcPtr(&Stack[SP - params + 1]);
+            SP -= int(params) - 1;
+            Stack[SP] = retVal;
+            FP_NEXT;
+        }
+
+        FP_CASE(cPCall) {
+            unsigned index = ByteCode[++IP];
+            unsigned params = data->FuncParsers[index].params;
+            EvalContext& nested = context.Nested();
+            nested.evalErrorType = 0;
+            nested.evalRecursionLevel = 0;
+            Value_t retVal = data->FuncParsers[index].parserPtr->Eval(nested, &Stack[SP - params + 1]);
+            SP -= int(params) - 1;
+            Stack[SP] = retVal;
+            const int error = nested.evalErrorType;
+            if (error) {
+                context.evalErrorType = error;
+                return 0;
+            }
+            FP_NEXT;
+        }
+
+#ifdef FP_SUPPORT_OPTIMIZER
+        FP_CASE(cVar) FP_NEXT; // Paranoia. These should never exist
+
+        FP_CASE(cFetch) {
+            unsigned stackOffs = ByteCode[++IP];
+            Stack[SP + 1] = Stack[stackOffs];
+            ++SP;
+            FP_NEXT;
+        }
+
+        FP_CASE(cPopNMov) {
+            unsigned stackOffs_target = ByteCode[++IP];
+            unsigned stackOffs_source = ByteCode[++IP];
+            Stack[stackOffs_target] = Stack[stackOffs_source];
+            SP = stackOffs_target;
+            FP_NEXT;
+        }
+
+        FP_CASE(cSelect)
+            Stack[SP - 2] = doubleToInt(Stack[SP - 2]) ? Stack[SP - 1] : Stack[SP];
+            SP -= 2;
+            FP_NEXT;
+#endif // FP_SUPPORT_OPTIMIZER
+
+        FP_CASE(cDup)
+            Stack[SP + 1] = Stack[SP];
+            ++SP;
+            FP_NEXT;
+
+        FP_CASE(cInv)
+#ifndef FP_NO_EVALUATION_CHECKS
+            if (Stack[SP] == 0.0) {
+                context.evalErrorType = 1;
+                return 0;
+            }
+#endif
+            Stack[SP] = 1.0 / Stack[SP];
+            FP_NEXT;
+
+        FP_CASE(cSqr)
+            Stack[SP] = Stack[SP] * Stack[SP];
+            FP_NEXT;
+
+        FP_CASE(cRDiv)
+#ifndef FP_NO_EVALUATION_CHECKS
+            if (Stack[SP - 1] == 0) {
+                context.evalErrorType = 1;
+                return 0;
+            }
+#endif
+            Stack[SP - 1] = Stack[SP] / Stack[SP - 1];
+            --SP;
+            FP_NEXT;
+
+        FP_CASE(cRSub)
+            Stack[SP - 1] = Stack[SP] - Stack[SP - 1];
+            --SP;
+            FP_NEXT;
+
+        FP_CASE(cRSqrt)
+#ifndef FP_NO_EVALUATION_CHECKS
+            if (Stack[SP] == 0) {
+                context.evalErrorType = 1;
+                return 0;
+            }
+#endif
+            Stack[SP] = 1.0 / std::sqrt(Stack[SP]);
+            FP_NEXT;
+
+        FP_CASE(cNop)
+            FP_NEXT;
+
+            // Variables:
+        FP_VARIABLE_CASE
+            Stack[++SP] = Vars[ByteCode[IP] - VarBegin];
+            FP_NEXT;
+#ifdef FP_USE_THREADED_DISPATCH
+    }
+l_End:
+#else
+        }
+    }
+    if (profiled)
+        profiler.Step(IP);
+#endif
+
+    context.evalErrorType = 0;
+    return Stack[SP];
+}
+
+#undef FP_CASE
+#undef FP_VARIABLE_CASE
+#undef FP_HANDLER
+#undef FP_NEXT
+
+
+//===========================================================================
+// Profiled evaluation
+//===========================================================================
+template<typename Value_t>
+FunctionParserBase<Value_t>::EvalProfile::EvalProfile() : evaluations(0) {}
+
+template<typename Value_t>
+void FunctionParserBase<Value_t>::EvalProfile::Clear() {
+    entries.clear();
+    entryAt.clear();
+    evaluations = 0;
+}
+
+namespace {
+struct MoreCycles {
+    template<typename Entry>
+    bool operator()(const Entry& a, const Entry& b) const {
+        return a.cycles != b.cycles ? a.cycles > b.cycles : a.offset < b.offset;
+    }
+};
+} // namespace
+
+template<typename Value_t>
+std::vector<typename FunctionParserBase<Value_t>::EvalProfile::Entry>
+FunctionParserBase<Value_t>::EvalProfile::ByOpcode() const {
+    std::vector<Entry> result;
+    std::map<unsigned, unsigned> indices; // of the entry of each opcode
+    for (unsigned i = 0; i < entries.size(); ++i) {
+        const unsigned opcode = entries[i].opcode < VarBegin ? entries[i].opcode : unsigned(VarBegin);
+        std::map<unsigned, unsigned>::iterator iter = indices.find(opcode);
+        if (iter == indices.end()) {
+            indices[opcode] = unsigned(result.size());
+            result.push_back(entries[i]);
+            result.back().opcode = opcode;
+        } else {
+            result[iter->second].executions += entries[i].executions;
+            result[iter->second].cycles += entries[i].cycles;
+        }
+    }
+    std::sort(result.begin(), result.end(), MoreCycles());
+    return result;
+}
+
+/* Evaluates the bytecode (even when Eval() would run the register code or
+   the compiled code, since only the bytecode is shown by PrintByteCode())
+   while counting each instruction and the time it takes. The profile is
+   started anew when the bytecode it was collected from has changed size.
+*/
+template<typename Value_t>
+Value_t FunctionParserBase<Value_t>::EvalProfiled(const Value_t* Vars, EvalProfile& profile) {
+    if (parseErrorType != FP_NO_ERROR)
+        return 0.0;
+
+    const std::vector<unsigned>& byteCode = data->ByteCode;
+    if (profile.entryAt.size() != byteCode.size()) {
+        profile.Clear();
+        profile.entryAt.resize(byteCode.size());
+        for (unsigned IP = 0; IP < byteCode.size(); ++IP) {
+            const typename EvalProfile::Entry entry = { IP, byteCode[IP], 0, 0 };
+            profile.entryAt[IP] = unsigned(profile.entries.size());
+            profile.entries.push_back(entry);
+            unsigned operands = 0;
+            switch (byteCode[IP]) {
+            case cIf:
+            case cJump: operands = 2; break;
+            case cFCall:
+            case cPCall: operands = 1; break;
+#ifdef FP_SUPPORT_OPTIMIZER
+            case cFetch: operands = 1; break;
+            case cPopNMov: operands = 2; break;
+#endif
+            }
+            for (; operands > 0; --operands, ++IP)
+                profile.entryAt[IP + 1] = profile.entryAt[IP];
+        }
+    }
+
+    EvalContext context;
+    context.Stack.resize(data->StackSize);
+    const Value_t result =
+        EvalByteCode<true>(context, context.Stack.empty() ? 0 : &context.Stack[0], Vars, false, &profile);
+    evalErrorType = context.evalErrorType;
+    ++profile.evaluations;
+    return result;
+}
+
+//===========================================================================
+// Batch evaluation
+//===========================================================================
+/* EvalMany() walks the bytecode once per block of rows. The stack is kept
+   column-shaped: stack slot s of all the rows in the block is stored in
+   Stack[s*EvalManyBlockSize .. s*EvalManyBlockSize+count-1], so that each
+   opcode is dispatched once and then applied to the whole column.
+   When the rows of a block disagree on an if() condition, the block is
+   split in two and both halves continue independently from the respective
+   branch, so every row follows exactly the same path as in Eval().
+   The arithmetic opcodes and the argument checks use the SSE2/AVX2/AVX-512
+   kernels of fparser_simd.cc, selected according to the running CPU, and so
+   do the elementary functions after UseVectorMath().
+*/
+namespace {
+const unsigned EvalManyBlockSize = 64;
+}
+
+template<typename Value_t>
+template<typename Row_t>
+struct FunctionParserBase<Value_t>::EvalManyBlock {
+    unsigned count;
+    const Row_t* vars[EvalManyBlockSize];
+    size_t rows[EvalManyBlockSize];
+    int errors[EvalManyBlockSize];
+
+    inline void SetError(unsigned lane, int error) {
+        if (!errors[lane])
+            errors[lane] = error;
+    }
+};
+
+template<typename Value_t>
+template<typename Row_t>
+struct FunctionParserBase<Value_t>::EvalManyState {
+    const BatchKernels<Row_t>* kernels;
+    EvalContext* context; // for eval() and the calls of other parsers
+    Row_t* results;
+    int firstError;
+    size_t firstErrorRow;
+    std::vector<std::vector<Row_t> > stacks; // one per if() nesting level
+    std::vector<double> params; // for the calls, which take doubles
+};
+
+#define FP_COLUMN(s) (Stack + unsigned(s) * EvalManyBlockSize)
+
+template<>
+template<typename Row_t>
+void FunctionParser::EvalBlock(EvalManyState<Row_t>& state, EvalManyBlock<Row_t>& block, unsigned level, unsigned IP, unsigned DP, int SP) const {
+    const unsigned* const ByteCode = &(data->ByteCode[0]);
+    const double* const Immed = data->Immed.empty() ? 0 : &(data->Immed[0]);
+    const unsigned ByteCodeSize = unsigned(data->ByteCode.size());
+    const unsigned n = block.count;
+    Row_t* const Stack = &(state.stacks[level][0]);
+    const BatchKernels<Row_t>& kernels = *state.kernels;
+    const bool vectorMath = data->useVectorMath;
+
+    for (; IP < ByteCodeSize; ++IP) {
+        switch (ByteCode[IP]) {
+            // Functions:
+        case cAbs: {
+            Row_t* const x = FP_COLUMN(SP);
+            kernels.abs(x, n);
+            break;
+        }
+
+        case cAcos: {
+            Row_t* const x = FP_COLUMN(SP);
+#ifndef FP_NO_EVALUATION_CHECKS
+            if (kernels.anyOutsideUnit(x, n))
+                for (unsigned i = 0; i < n; ++i)
+                    if (x[i] < -1 || x[i] > 1) block.SetError(i, 4);
+#endif
+            for (unsigned i = 0; i < n; ++i) x[i] = std::acos(x[i]);
+            break;
+        }
+
+        case cAcosh: {
+            Row_t* const x = FP_COLUMN(SP);
+            for (unsigned i = 0; i < n; ++i) x[i] = fp_acosh(x[i]);
+            break;
+        }
+
+        case cAsin: {
+            Row_t* const x = FP_COLUMN(SP);
+#ifndef FP_NO_EVALUATION_CHECKS
+            if (kernels.anyOutsideUnit(x, n))
+                for (unsigned i = 0; i < n; ++i)
+                    if (x[i] < -1 || x[i] > 1) block.SetError(i, 4);
+#endif
+            for (unsigned i = 0; i < n; ++i) x[i] = std::asin(x[i]);
+            break;
+        }
+
+        case cAsinh: {
+            Row_t* const x = FP_COLUMN(SP);
+            for (unsigned i = 0; i < n; ++i) x[i] = fp_asinh(x[i]);
+            break;
+        }
+
+        case cAtan: {
+            Row_t* const x = FP_COLUMN(SP);
+            if (vectorMath)
+                kernels.atan(x, n);
+            else
+                for (unsigned i = 0; i < n; ++i) x[i] = std::atan(x[i]);
+            break;
+        }
+
+        case cAtan2: {
+            Row_t* const x = FP_COLUMN(SP - 1);
+            const Row_t* const y = FP_COLUMN(SP);
+            if (vectorMath)
+                kernels.atan2(x, y, n);
+            else
+                for (unsigned i = 0; i < n; ++i) x[i] = std::atan2(x[i], y[i]);
+            --SP;
+            break;
+        }
+
+        case cAtanh: {
+            Row_t* const x = FP_COLUMN(SP);
+            for (unsigned i = 0; i < n; ++i) x[i] = fp_atanh(x[i]);
+            break;
+        }
+
+        case cCeil: {
+            Row_t* const x = FP_COLUMN(SP);
+            for (unsigned i = 0; i < n; ++i) x[i] = std::ceil(x[i]);
+            break;
+        }
+
+        case cCos: {
+            Row_t* const x = FP_COLUMN(SP);
+            if (vectorMath)
+                kernels.cos(x, n);
+            else
+                for (unsigned i = 0; i < n; ++i) x[i] = std::cos(x[i]);
+            break;
+        }
+
+        case cCosh: {
+            Row_t* const x = FP_COLUMN(SP);
+            for (unsigned i = 0; i < n; ++i) x[i] = std::cosh(x[i]);
+            break;
+        }
+
+        case cCot: {
+            Row_t* const x = FP_COLUMN(SP);
+            if (vectorMath)
+                kernels.tan(x, n);
+            else
+                for (unsigned i = 0; i < n; ++i) x[i] = std::tan(x[i]);
+            for (unsigned i = 0; i < n; ++i) {
+#ifndef FP_NO_EVALUATION_CHECKS
+                if (x[i] == 0) block.SetError(i, 1);
+#endif
+                x[i] = 1 / x[i];
+            }
+            break;
+        }
+
+        case cCsc: {
+            Row_t* const x = FP_COLUMN(SP);
+            if (vectorMath)
+                kernels.sin(x, n);
+            else
+                for (unsigned i = 0; i < n; ++i) x[i] = std::sin(x[i]);
+            for (unsigned i = 0; i < n; ++i) {
+#ifndef FP_NO_EVALUATION_CHECKS
+                if (x[i] == 0) block.SetError(i, 1);
+#endif
+                x[i] = 1 / x[i];
+            }
+            break;
+        }
+
+#ifndef FP_DISABLE_EVAL
+        case cEval: {
+            const unsigned varAmount =
+                unsigned(data->variableRefs.size());
+            std::vector<double>& params = state.params;
+            params.resize(varAmount);
+            Row_t* const x = FP_COLUMN(SP - varAmount + 1);
+            for (unsigned i = 0; i < n; ++i) {
+                double retVal = 0;
+                if (!block.errors[i]) {
+                    for (unsigned p = 0; p < varAmount; ++p)
+                        params[p] = x[p * EvalManyBlockSize + i];
+                    EvalContext& nested = state.context->Nested();
+                    nested.evalRecursionLevel = 1;
+                    retVal = Eval(nested, &params[0]);
+                }
+                x[i] = Row_t(retVal);
+            }
+            SP -= varAmount - 1;
+            break;
+        }
+#endif
+
+        case cExp: {
+            Row_t* const x = FP_COLUMN(SP);
+            if (vectorMath)
+                kernels.exp(x, n);
+            else
+                for (unsigned i = 0; i < n; ++i) x[i] = std::exp(x[i]);
+            break;
+        }
+
+        case cExp2: {
+            Row_t* const x = FP_COLUMN(SP);
+            if (vectorMath)
+                kernels.exp2(x, n);
+            else
+                for (unsigned i = 0; i < n; ++i) x[i] = std::pow(Row_t(2), x[i]);
+            break;
+        }
+
+        case cFloor: {
+            Row_t* const x = FP_COLUMN(SP);
+            for (unsigned i = 0; i < n; ++i) x[i] = std::floor(x[i]);
+            break;
+        }
+
+        case cIf: {
+            unsigned jumpAddr = ByteCode[++IP];
+            unsigned immedAddr = ByteCode[++IP];
+            const Row_t* const x = FP_COLUMN(SP);
+            unsigned jumping = 0;
+            for (unsigned i = 0; i < n; ++i)
+                jumping += (doubleToInt(x[i]) == 0);
+            --SP;
+            if (jumping == n) {
+                IP = jumpAddr;
+                DP = immedAddr;
+            } else if (jumping != 0) {
+                // The rows diverge: continue each group separately.
+                std::vector<Row_t>& subStack = state.stacks[level + 1];
+                if (subStack.empty())
+                    subStack.resize(data->StackSize * EvalManyBlockSize);
+                for (int branch = 0; branch < 2; ++branch) {
+                    EvalManyBlock<Row_t> sub;
+                    sub.count = 0;
+                    for (unsigned i = 0; i < n; ++i) {
+                        if ((doubleToInt(x[i]) == 0) != (branch == 1))
+                            continue;
+                        for (int s = 0; s <= SP; ++s)
+                            subStack[unsigned(s) * EvalManyBlockSize + sub.count] = FP_COLUMN(s)[i];
+                        sub.vars[sub.count] = block.vars[i];
+                        sub.rows[sub.count] = block.rows[i];
+                        sub.errors[sub.count] = block.errors[i];
+                        ++sub.count;
+                    }
+                    if (branch == 0)
+                        EvalBlock(state, sub, level + 1, IP + 1, DP, SP);
+                    else
+                        EvalBlock(state, sub, level + 1, jumpAddr + 1, immedAddr, SP);
+                }
+                return;
+            }
+            break;
+        }
+
+        case cInt: {
+            Row_t* const x = FP_COLUMN(SP);
+            for (unsigned i = 0; i < n; ++i) x[i] = std::floor(x[i] + Row_t(.5));
+            break;
+        }
+
+        case cLog: {
+            Row_t* const x = FP_COLUMN(SP);
+#ifndef FP_NO_EVALUATION_CHECKS
+            if (kernels.anyNonPositive(x, n))
+                for (unsigned i = 0; i < n; ++i)
+                    if (x[i] <= 0) block.SetError(i, 3);
+#endif
+            if (vectorMath)
+                kernels.log(x, n);
+            else
+                for (unsigned i = 0; i < n; ++i) x[i] = std::log(x[i]);
+            break;
+        }
+
+        case cLog10: {
+            Row_t* const x = FP_COLUMN(SP);
+#ifndef FP_NO_EVALUATION_CHECKS
+            if (kernels.anyNonPositive(x, n))
+                for (unsigned i = 0; i < n; ++i)
+                    if (x[i] <= 0) block.SetError(i, 3);
+#endif
+            if (vectorMath)
+                kernels.log10(x, n);
+            else
+                for (unsigned i = 0; i < n; ++i) x[i] = std::log10(x[i]);
+            break;
+        }
+
+        case cLog2: {
+            Row_t* const x = FP_COLUMN(SP);
+#ifndef FP_NO_EVALUATION_CHECKS
+            if (kernels.anyNonPositive(x, n))
+                for (unsigned i = 0; i < n; ++i)
+                    if (x[i] <= 0) block.SetError(i, 3);
+#endif
+            if (vectorMath)
+                kernels.log2(x, n);
+            else
+                for (unsigned i = 0; i < n; ++i) x[i] = fp_log2(x[i]);
+            break;
+        }
+
+        case cMax: {
+            Row_t* const x = FP_COLUMN(SP - 1);
+            const Row_t* const y = FP_COLUMN(SP);
+            kernels.max(x, y, n);
+            --SP;
+            break;
+        }
+
+        case cMin: {
+            Row_t* const x = FP_COLUMN(SP - 1);
+            const Row_t* const y = FP_COLUMN(SP);
+            kernels.min(x, y, n);
+            --SP;
+            break;
+        }
+
+        case cPow: {
+            Row_t* const x = FP_COLUMN(SP - 1);
+            const Row_t* const y = FP_COLUMN(SP);
+            if (vectorMath)
+                kernels.pow(x, y, n);
+            else
+                for (unsigned i = 0; i < n; ++i) x[i] = std::pow(x[i], y[i]);
+            --SP;
+            break;
+        }
+        case cRPow: {
+            Row_t* const x = FP_COLUMN(SP - 1);
+            const Row_t* const y = FP_COLUMN(SP);
+            if (vectorMath)
+                kernels.rpow(x, y, n);
+            else
+                for (unsigned i = 0; i < n; ++i) x[i] = std::pow(y[i], x[i]);
+            --SP;
+            break;
+        }
+
+        case cSec: {
+            Row_t* const x = FP_COLUMN(SP);
+            if (vectorMath)
+                kernels.cos(x, n);
+            else
+                for (unsigned i = 0; i < n; ++i) x[i] = std::cos(x[i]);
+            for (unsigned i = 0; i < n; ++i) {
+#ifndef FP_NO_EVALUATION_CHECKS
+                if (x[i] == 0) block.SetError(i, 1);
+#endif
+                x[i] = 1 / x[i];
+            }
+            break;
+        }
+
+        case cSin: {
+            Row_t* const x = FP_COLUMN(SP);
+            if (vectorMath)
+                kernels.sin(x, n);
+            else
+                for (unsigned i = 0; i < n; ++i) x[i] = std::sin(x[i]);
+            break;
+        }
+
+        case cSinh: {
+            Row_t* const x = FP_COLUMN(SP);
+            for (unsigned i = 0; i < n; ++i) x[i] = std::sinh(x[i]);
+            break;
+        }
+
+        case cSqrt: {
+            Row_t* const x = FP_COLUMN(SP);
+#ifndef FP_NO_EVALUATION_CHECKS
+            if (kernels.anyNegative(x, n))
+                for (unsigned i = 0; i < n; ++i)
+                    if (x[i] < 0) block.SetError(i, 2);
+#endif
+            kernels.sqrt(x, n);
             break;
+        }
 
-        case cGreaterOrEq:
-            Stack[SP - 1] = (Stack[SP - 1] >= Stack[SP]);
+        case cTan: {
+            Row_t* const x = FP_COLUMN(SP);
+            if (vectorMath)
+                kernels.tan(x, n);
+            else
+                for (unsigned i = 0; i < n; ++i) x[i] = std::tan(x[i]);
+            break;
+        }
+
+        case cTanh: {
+            Row_t* const x = FP_COLUMN(SP);
+            for (unsigned i = 0; i < n; ++i) x[i] = std::tanh(x[i]);
+            break;
+        }
+
+            // Misc:
+        case cImmed: {
+            Row_t* const x = FP_COLUMN(++SP);
+            const Row_t value = Row_t(Immed[DP++]);
+            for (unsigned i = 0; i < n; ++i) x[i] = value;
+            break;
+        }
+
+        case cJump:
+            DP = ByteCode[IP + 2];
+            IP = ByteCode[IP + 1];
+            break;
+
+            // Operators:
+        case cNeg: {
+            Row_t* const x = FP_COLUMN(SP);
+            kernels.neg(x, n);
+            break;
+        }
+        case cAdd: {
+            Row_t* const x = FP_COLUMN(SP - 1);
+            const Row_t* const y = FP_COLUMN(SP);
+            kernels.add(x, y, n);
+            --SP;
+            break;
+        }
+        case cSub: {
+            Row_t* const x = FP_COLUMN(SP - 1);
+            const Row_t* const y = FP_COLUMN(SP);
+            kernels.sub(x, y, n);
+            --SP;
+            break;
+        }
+        case cMul: {
+            Row_t* const x = FP_COLUMN(SP - 1);
+            const Row_t* const y = FP_COLUMN(SP);
+            kernels.mul(x, y, n);
+            --SP;
+            break;
+        }
+
+        case cDiv: {
+            Row_t* const x = FP_COLUMN(SP - 1);
+            const Row_t* const y = FP_COLUMN(SP);
+#ifndef FP_NO_EVALUATION_CHECKS
+            if (kernels.anyZero(y, n))
+                for (unsigned i = 0; i < n; ++i)
+                    if (y[i] == 0) block.SetError(i, 1);
+#endif
+            kernels.div(x, y, n);
             --SP;
             break;
+        }
+
+        case cMod: {
+            Row_t* const x = FP_COLUMN(SP - 1);
+            const Row_t* const y = FP_COLUMN(SP);
+#ifndef FP_NO_EVALUATION_CHECKS
+            if (kernels.anyZero(y, n))
+                for (unsigned i = 0; i < n; ++i)
+                    if (y[i] == 0) block.SetError(i, 1);
 #endif
+            for (unsigned i = 0; i < n; ++i) x[i] = std::fmod(x[i], y[i]);
+            --SP;
+            break;
+        }
 
-        case cNot:
-            Stack[SP] = !doubleToInt(Stack[SP]);
+        case cEqual: {
+            Row_t* const x = FP_COLUMN(SP - 1);
+            const Row_t* const y = FP_COLUMN(SP);
+            kernels.equal(x, y, n);
+            --SP;
             break;
+        }
 
-        case cAnd:
-            Stack[SP - 1] =
-                (doubleToInt(Stack[SP - 1]) &&
-                 doubleToInt(Stack[SP]));
+        case cNEqual: {
+            Row_t* const x = FP_COLUMN(SP - 1);
+            const Row_t* const y = FP_COLUMN(SP);
+            kernels.nequal(x, y, n);
             --SP;
             break;
+        }
 
-        case cOr:
-            Stack[SP - 1] =
-                (doubleToInt(Stack[SP - 1]) ||
-                 doubleToInt(Stack[SP]));
+        case cLess: {
+            Row_t* const x = FP_COLUMN(SP - 1);
+            const Row_t* const y = FP_COLUMN(SP);
+            kernels.less(x, y, n);
             --SP;
             break;
+        }
 
-        case cNotNot:
-            Stack[SP] = !!doubleToInt(Stack[SP]);
+        case cLessOrEq: {
+            Row_t* const x = FP_COLUMN(SP - 1);
+            const Row_t* const y = FP_COLUMN(SP);
+            kernels.lessOrEq(x, y, n);
+            --SP;
+            break;
+        }
+
+        case cGreater: {
+            Row_t* const x = FP_COLUMN(SP - 1);
+            const Row_t* const y = FP_COLUMN(SP);
+            kernels.greater(x, y, n);
+            --SP;
+            break;
+        }
+
+        case cGreaterOrEq: {
+            Row_t* const x = FP_COLUMN(SP - 1);
+            const Row_t* const y = FP_COLUMN(SP);
+            kernels.greaterOrEq(x, y, n);
+            --SP;
+            break;
+        }
+
+        case cNot: {
+            Row_t* const x = FP_COLUMN(SP);
+            for (unsigned i = 0; i < n; ++i) x[i] = !doubleToInt(x[i]);
+            break;
+        }
+
+        case cAnd: {
+            Row_t* const x = FP_COLUMN(SP - 1);
+            const Row_t* const y = FP_COLUMN(SP);
+            for (unsigned i = 0; i < n; ++i) x[i] = (doubleToInt(x[i]) && doubleToInt(y[i]));
+            --SP;
+            break;
+        }
+
+        case cOr: {
+            Row_t* const x = FP_COLUMN(SP - 1);
+            const Row_t* const y = FP_COLUMN(SP);
+            for (unsigned i = 0; i < n; ++i) x[i] = (doubleToInt(x[i]) || doubleToInt(y[i]));
+            --SP;
+            break;
+        }
+
+        case cNotNot: {
+            Row_t* const x = FP_COLUMN(SP);
+            for (unsigned i = 0; i < n; ++i) x[i] = !!doubleToInt(x[i]);
             break;
+        }
 
             // Degrees-radians conversion:
-        case cDeg:
-            Stack[SP] = RadiansToDegrees(Stack[SP]);
+        case cDeg: {
+            Row_t* const x = FP_COLUMN(SP);
+            for (unsigned i = 0; i < n; ++i) x[i] = RadiansToDegrees(x[i]);
             break;
-        case cRad:
-            Stack[SP] = DegreesToRadians(Stack[SP]);
+        }
+        case cRad: {
+            Row_t* const x = FP_COLUMN(SP);
+            for (unsigned i = 0; i < n; ++i) x[i] = DegreesToRadians(x[i]);
             break;
+        }
 
             // User-defined function calls:
         case cFCall: {
             unsigned index = ByteCode[++IP];
             unsigned params = data->FuncPtrs[index].params;
-            double retVal = data->FuncPtrs[index].funcPtr(&Stack[SP - params + 1]);
+            std::vector<double>& paramValues = state.params;
+            paramValues.resize(params + 1);
+            Row_t* const x = FP_COLUMN(SP - int(params) + 1);
+            for (unsigned i = 0; i < n; ++i) {
+                double retVal = 0;
+                if (!block.errors[i]) {
+                    for (unsigned p = 0; p < params; ++p)
+                        paramValues[p] = x[p * EvalManyBlockSize + i];
+                    retVal = data->FuncPtrs[index].funcPtr(&paramValues[0]);
+                }
+                x[i] = Row_t(retVal);
+            }
             SP -= int(params) - 1;
-            Stack[SP] = retVal;
             break;
         }
 
         case cPCall: {
             unsigned index = ByteCode[++IP];
             unsigned params = data->FuncParsers[index].params;
-            double retVal = data->FuncParsers[index].parserPtr->Eval(&Stack[SP - params + 1]);
-            SP -= int(params) - 1;
-            Stack[SP] = retVal;
-            const int error = data->FuncParsers[index].parserPtr->EvalError();
-            if (error) {
-                evalErrorType = error;
-                return 0;
+            std::vector<double>& paramValues = state.params;
+            paramValues.resize(params + 1);
+            Row_t* const x = FP_COLUMN(SP - int(params) + 1);
+            for (unsigned i = 0; i < n; ++i) {
+                double retVal = 0;
+                if (!block.errors[i]) {
+                    for (unsigned p = 0; p < params; ++p)
+                        paramValues[p] = x[p * EvalManyBlockSize + i];
+                    EvalContext& nested = state.context->Nested();
+                    nested.evalErrorType = 0;
+                    nested.evalRecursionLevel = 0;
+                    retVal = data->FuncParsers[index].parserPtr->Eval(nested, &paramValues[0]);
+                    const int error = nested.evalErrorType;
+                    if (error)
+                        block.SetError(i, error);
+                }
+                x[i] = Row_t(retVal);
             }
+            SP -= int(params) - 1;
             break;
         }
 
@@ -2029,7 +3396,9 @@ double FunctionParser::Eval(const double* Vars) {
 
         case cFetch: {
             unsigned stackOffs = ByteCode[++IP];
-            Stack[SP + 1] = Stack[stackOffs];
+            Row_t* const x = FP_COLUMN(SP + 1);
+            const Row_t* const y = FP_COLUMN(stackOffs);
+            for (unsigned i = 0; i < n; ++i) x[i] = y[i];
             ++SP;
             break;
         }
@@ -2037,75 +3406,409 @@ double FunctionParser::Eval(const double* Vars) {
         case cPopNMov: {
             unsigned stackOffs_target = ByteCode[++IP];
             unsigned stackOffs_source = ByteCode[++IP];
-            Stack[stackOffs_target] = Stack[stackOffs_source];
+            Row_t* const x = FP_COLUMN(stackOffs_target);
+            const Row_t* const y = FP_COLUMN(stackOffs_source);
+            for (unsigned i = 0; i < n; ++i) x[i] = y[i];
             SP = stackOffs_target;
             break;
         }
+
+        case cSelect:
+            kernels.select(FP_COLUMN(SP - 2), FP_COLUMN(SP - 1), FP_COLUMN(SP), n);
+            SP -= 2;
+            break;
 #endif // FP_SUPPORT_OPTIMIZER
 
-        case cDup:
-            Stack[SP + 1] = Stack[SP];
+        case cDup: {
+            Row_t* const x = FP_COLUMN(SP + 1);
+            const Row_t* const y = FP_COLUMN(SP);
+            for (unsigned i = 0; i < n; ++i) x[i] = y[i];
             ++SP;
             break;
+        }
 
-        case cInv:
+        case cInv: {
+            Row_t* const x = FP_COLUMN(SP);
 #ifndef FP_NO_EVALUATION_CHECKS
-            if (Stack[SP] == 0.0) {
-                evalErrorType = 1;
-                return 0;
-            }
+            if (kernels.anyZero(x, n))
+                for (unsigned i = 0; i < n; ++i)
+                    if (x[i] == 0) block.SetError(i, 1);
 #endif
-            Stack[SP] = 1.0 / Stack[SP];
+            kernels.inv(x, n);
             break;
+        }
 
-        case cSqr:
-            Stack[SP] = Stack[SP] * Stack[SP];
+        case cSqr: {
+            Row_t* const x = FP_COLUMN(SP);
+            kernels.sqr(x, n);
             break;
+        }
 
-        case cRDiv:
+        case cRDiv: {
+            Row_t* const x = FP_COLUMN(SP - 1);
+            const Row_t* const y = FP_COLUMN(SP);
 #ifndef FP_NO_EVALUATION_CHECKS
-            if (Stack[SP - 1] == 0) {
-                evalErrorType = 1;
-                return 0;
-            }
+            if (kernels.anyZero(x, n))
+                for (unsigned i = 0; i < n; ++i)
+                    if (x[i] == 0) block.SetError(i, 1);
 #endif
-            Stack[SP - 1] = Stack[SP] / Stack[SP - 1];
+            kernels.rdiv(x, y, n);
             --SP;
             break;
+        }
 
-        case cRSub:
-            Stack[SP - 1] = Stack[SP] - Stack[SP - 1];
+        case cRSub: {
+            Row_t* const x = FP_COLUMN(SP - 1);
+            const Row_t* const y = FP_COLUMN(SP);
+            kernels.rsub(x, y, n);
             --SP;
             break;
+        }
 
-        case cRSqrt:
+        case cRSqrt: {
+            Row_t* const x = FP_COLUMN(SP);
 #ifndef FP_NO_EVALUATION_CHECKS
-            if (Stack[SP] == 0) {
-                evalErrorType = 1;
-                return 0;
-            }
+            if (kernels.anyZero(x, n))
+                for (unsigned i = 0; i < n; ++i)
+                    if (x[i] == 0) block.SetError(i, 1);
 #endif
-            Stack[SP] = 1.0 / sqrt(Stack[SP]);
+            kernels.rsqrt(x, n);
             break;
+        }
 
         case cNop:
             break;
 
             // Variables:
-        default:
-            Stack[++SP] = Vars[ByteCode[IP] - VarBegin];
+        default: {
+            Row_t* const x = FP_COLUMN(++SP);
+            const unsigned varIndex = ByteCode[IP] - VarBegin;
+            for (unsigned i = 0; i < n; ++i) x[i] = block.vars[i][varIndex];
+        }
+        }
+    }
+
+    const Row_t* const x = FP_COLUMN(SP);
+    for (unsigned i = 0; i < n; ++i) {
+        if (block.errors[i]) {
+            state.results[block.rows[i]] = 0;
+            if (!state.firstError || block.rows[i] < state.firstErrorRow) {
+                state.firstError = block.errors[i];
+                state.firstErrorRow = block.rows[i];
+            }
+        } else
+            state.results[block.rows[i]] = x[i];
+    }
+}
+
+#undef FP_COLUMN
+
+template<>
+template<typename Row_t>
+void FunctionParser::PrepareEvalMany(EvalManyState<Row_t>& state, Row_t* results) const {
+    state.kernels = &GetBatchKernels<Row_t>();
+    state.results = results;
+    state.firstError = 0;
+    state.firstErrorRow = 0;
+
+    // Each if() that splits a block needs a stack one level deeper:
+    unsigned ifCount = 0;
+    for (unsigned IP = 0; IP < data->ByteCode.size(); ++IP)
+        if (data->ByteCode[IP] == cIf)
+            ++ifCount;
+    state.stacks.resize(ifCount + 1);
+    state.stacks[0].resize(data->StackSize * EvalManyBlockSize);
+}
+
+template<>
+template<typename Row_t>
+void FunctionParser::EvalManyRange(EvalManyState<Row_t>& state, const Row_t* Vars, size_t begin, size_t end, size_t rowStride) const {
+    EvalManyBlock<Row_t> block;
+    for (; begin < end; begin += EvalManyBlockSize) {
+        block.count = unsigned(end - begin < EvalManyBlockSize ? end - begin : EvalManyBlockSize);
+        for (unsigned i = 0; i < block.count; ++i) {
+            block.vars[i] = Vars + (begin + i) * rowStride;
+            block.rows[i] = begin + i;
+            block.errors[i] = 0;
+        }
+        EvalBlock(state, block, 0, 0, 0, -1);
+    }
+}
+
+template<>
+template<typename Row_t>
+void FunctionParser::EvalManyRows(const Row_t* Vars, size_t rowCount, size_t rowStride, Row_t* results) {
+    if (parseErrorType != FP_NO_ERROR) {
+        for (size_t row = 0; row < rowCount; ++row)
+            results[row] = 0;
+        return;
+    }
+
+    // The approximation is cheaper than the blocks, one row at a time:
+    if (!data->approximation.pieces.empty()) {
+        int firstError = 0;
+        for (size_t row = 0; row < rowCount; ++row) {
+            const double x = double(Vars[row * rowStride]);
+            results[row] = Row_t(Eval(evalContext, &x));
+            if (!firstError)
+                firstError = evalContext.evalErrorType;
+        }
+        evalErrorType = firstError;
+        return;
+    }
+
+    EvalManyState<Row_t> state;
+    PrepareEvalMany(state, results);
+    state.context = &evalContext;
+    EvalManyRange(state, Vars, 0, rowCount, rowStride);
+    evalErrorType = state.firstError;
+}
+
+template<>
+void FunctionParser::EvalMany(const double* Vars, size_t rowCount, size_t rowStride, double* results) {
+    EvalManyRows(Vars, rowCount, rowStride, results);
+}
+
+template<>
+void FunctionParser::EvalMany(const float* Vars, size_t rowCount, size_t rowStride, float* results) {
+    EvalManyRows(Vars, rowCount, rowStride, results);
+}
+
+//===========================================================================
+// Parallel batch evaluation
+//===========================================================================
+/* EvalManyParallel() cuts the rows into chunks of whole blocks and gives
+   each thread a share of consecutive chunks. A thread evaluates the chunks
+   of its own share from the front, and when that is exhausted it steals the
+   back half of what is left of the share of another thread, so that all
+   the threads keep working until the end even when the rows differ in cost
+   (eg. because of if()). Each thread has its own column stacks and its own
+   EvalContext, so the parser itself is only read. The error reported is
+   the one of the lowest row, exactly as with EvalMany().
+   The chunk size follows a rough estimate of the cost of one row: a chunk
+   of a cheap expression gets enough rows that taking it costs next to
+   nothing, while an expensive one is still cut into enough chunks to
+   balance the load.
+*/
+namespace {
+unsigned OpcodeCost(unsigned opcode) {
+    switch (opcode) {
+    case cAcos: case cAcosh: case cAsin: case cAsinh: case cAtan:
+    case cAtan2: case cAtanh: case cCos: case cCosh: case cCot: case cCsc:
+    case cExp: case cExp2: case cLog: case cLog10: case cLog2: case cPow:
+    case cRPow: case cSec: case cSin: case cSinh: case cTan: case cTanh:
+        return 20;
+    case cFCall: case cPCall:
+#ifndef FP_DISABLE_EVAL
+    case cEval:
+#endif
+        return 100;
+    case cDiv: case cMod: case cRDiv: case cInv: case cSqrt: case cRSqrt:
+    case cIf:
+        return 4;
+    default:
+        return 1;
+    }
+}
+} // namespace
+
+// The cost is in OpcodeCost() units, which is that of an addition.
+template<typename Value_t>
+typename FunctionParserBase<Value_t>::CostEstimate FunctionParserBase<Value_t>::EstimateCost() const {
+    const std::vector<unsigned>& byteCode = data->ByteCode;
+    CostEstimate estimate = { 1, 0, 0, 0, 0, 0 };
+    for (unsigned IP = 0; IP < byteCode.size(); ++IP) {
+        const unsigned opcode = byteCode[IP];
+        estimate.cost += OpcodeCost(opcode);
+        ++estimate.instructions;
+        switch (opcode) {
+        case cIf: ++estimate.branches; IP += 2; break;
+        case cJump: IP += 2; break;
+        case cFCall: ++estimate.functionCalls; IP += 1; break;
+        case cPCall: ++estimate.parserCalls; IP += 1; break;
+#ifndef FP_DISABLE_EVAL
+        case cEval: ++estimate.evalCalls; break;
+#endif
+#ifdef FP_SUPPORT_OPTIMIZER
+        case cFetch: IP += 1; break;
+        case cPopNMov: IP += 2; break;
+#endif
+        }
+    }
+    return estimate;
+}
+
+// A rough estimate of the cost of one evaluation, in OpcodeCost() units.
+template<typename Value_t>
+unsigned FunctionParserBase<Value_t>::EstimatedEvalCost() const {
+    return EstimateCost().cost;
+}
+
+#ifdef FP_USE_POSIX_THREADS
+namespace {
+const unsigned ParallelChunkCost = 1U << 16; // in OpcodeCost() units
+const size_t ParallelMaxChunkBlocks = 256;
+const size_t ParallelChunksPerThread = 8;
+
+// The chunks of one thread not yet taken: [next, end)
+struct EvalManyShare {
+    pthread_mutex_t lock;
+    size_t next, end;
+};
+
+bool TakeChunk(EvalManyShare& share, size_t& chunk) {
+    pthread_mutex_lock(&share.lock);
+    const bool taken = share.next < share.end;
+    if (taken)
+        chunk = share.next++;
+    pthread_mutex_unlock(&share.lock);
+    return taken;
+}
+
+bool StealChunks(EvalManyShare* shares, unsigned shareCount, unsigned own, size_t& chunk) {
+    for (unsigned i = 1; i < shareCount; ++i) {
+        EvalManyShare& victim = shares[(own + i) % shareCount];
+        pthread_mutex_lock(&victim.lock);
+        const size_t end = victim.end;
+        const size_t begin = end - (end - victim.next + 1) / 2;
+        victim.end = begin;
+        pthread_mutex_unlock(&victim.lock);
+        if (begin < end) {
+            pthread_mutex_lock(&shares[own].lock);
+            shares[own].next = begin + 1;
+            shares[own].end = end;
+            pthread_mutex_unlock(&shares[own].lock);
+            chunk = begin;
+            return true;
         }
     }
+    return false;
+}
+} // namespace
+
+template<typename Value_t>
+template<typename Row_t>
+struct FunctionParserBase<Value_t>::EvalManyTask {
+    const FunctionParserBase* parser;
+    EvalManyShare* shares;
+    unsigned shareCount, index;
+    const Row_t* Vars;
+    Row_t* results;
+    size_t rowCount, rowStride, chunkRows;
+    EvalManyState<Row_t> state;
+    EvalContext context;
+};
+
+template<>
+template<typename Row_t>
+void* FunctionParser::EvalManyThread(void* argument) {
+    EvalManyTask<Row_t>& task = *static_cast<EvalManyTask<Row_t>*>(argument);
+    task.parser->PrepareEvalMany(task.state, task.results);
+    task.state.context = &task.context;
+
+    size_t chunk;
+    while (TakeChunk(task.shares[task.index], chunk) ||
+           StealChunks(task.shares, task.shareCount, task.index, chunk)) {
+        const size_t begin = chunk * task.chunkRows;
+        const size_t end = task.rowCount - begin < task.chunkRows ? task.rowCount : begin + task.chunkRows;
+        task.parser->EvalManyRange(task.state, task.Vars, begin, end, task.rowStride);
+    }
+    return 0;
+}
+#endif // FP_USE_POSIX_THREADS
+
+template<>
+template<typename Row_t>
+void FunctionParser::EvalManyRowsParallel(const Row_t* Vars, size_t rowCount, size_t rowStride, Row_t* results,
+                                          unsigned threadCount) {
+#ifdef FP_USE_POSIX_THREADS
+    if (threadCount == 0) {
+        const long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        threadCount = processors > 0 ? unsigned(processors) : 1;
+    }
+    const size_t blockCount = (rowCount + EvalManyBlockSize - 1) / EvalManyBlockSize;
+    size_t chunkBlocks = ParallelChunkCost / (EstimatedEvalCost() * EvalManyBlockSize);
+    if (chunkBlocks > ParallelMaxChunkBlocks)
+        chunkBlocks = ParallelMaxChunkBlocks;
+    if (chunkBlocks > blockCount / (threadCount * ParallelChunksPerThread))
+        chunkBlocks = blockCount / (threadCount * ParallelChunksPerThread);
+    if (chunkBlocks == 0)
+        chunkBlocks = 1;
+    const size_t chunkRows = chunkBlocks * EvalManyBlockSize;
+    const size_t chunkCount = (rowCount + chunkRows - 1) / chunkRows;
+    if (threadCount > chunkCount)
+        threadCount = unsigned(chunkCount);
+
+    if (parseErrorType != FP_NO_ERROR || threadCount < 2 || !data->approximation.pieces.empty()) {
+        EvalManyRows(Vars, rowCount, rowStride, results);
+        return;
+    }
+
+    std::vector<EvalManyShare> shares(threadCount);
+    std::vector<EvalManyTask<Row_t> > tasks(threadCount);
+    std::vector<pthread_t> threads(threadCount);
+    std::vector<char> started(threadCount, 0);
+    for (unsigned t = 0; t < threadCount; ++t) {
+        pthread_mutex_init(&shares[t].lock, 0);
+        shares[t].next = chunkCount * t / threadCount;
+        shares[t].end = chunkCount * (t + 1) / threadCount;
+
+        EvalManyTask<Row_t>& task = tasks[t];
+        task.parser = this;
+        task.shares = &shares[0];
+        task.shareCount = threadCount;
+        task.index = t;
+        task.Vars = Vars;
+        task.results = results;
+        task.rowCount = rowCount;
+        task.rowStride = rowStride;
+        task.chunkRows = chunkRows;
+    }
+
+    // The calling thread is the first worker. If a thread cannot be
+    // created, the others steal its share.
+    for (unsigned t = 1; t < threadCount; ++t)
+        started[t] = pthread_create(&threads[t], 0, &EvalManyThread<Row_t>, &tasks[t]) == 0;
+    EvalManyThread<Row_t>(&tasks[0]);
+
+    for (unsigned t = 1; t < threadCount; ++t)
+        if (started[t])
+            pthread_join(threads[t], 0);
 
     evalErrorType = 0;
-    return Stack[SP];
+    size_t firstErrorRow = 0;
+    for (unsigned t = 0; t < threadCount; ++t) {
+        pthread_mutex_destroy(&shares[t].lock);
+        const EvalManyState<Row_t>& state = tasks[t].state;
+        if (state.firstError && (!evalErrorType || state.firstErrorRow < firstErrorRow)) {
+            evalErrorType = state.firstError;
+            firstErrorRow = state.firstErrorRow;
+        }
+    }
+#else
+    (void)threadCount;
+    EvalManyRows(Vars, rowCount, rowStride, results);
+#endif
+}
+
+template<>
+void FunctionParser::EvalManyParallel(const double* Vars, size_t rowCount, size_t rowStride, double* results,
+                                      unsigned threadCount) {
+    EvalManyRowsParallel(Vars, rowCount, rowStride, results, threadCount);
+}
+
+template<>
+void FunctionParser::EvalManyParallel(const float* Vars, size_t rowCount, size_t rowStride, float* results,
+                                      unsigned threadCount) {
+    EvalManyRowsParallel(Vars, rowCount, rowStride, results, threadCount);
 }
 
 //===========================================================================
 // Variable deduction
 //===========================================================================
 namespace {
-int deduceVariables(FunctionParser& fParser,
+template<typename Value_t>
+int deduceVariables(FunctionParserBase<Value_t>& fParser,
                     const char* funcStr,
                     std::string& destVarString,
                     int* amountOfVariablesFound,
@@ -2148,12 +3851,14 @@ int deduceVariables(FunctionParser& fParser,
 }
 } // namespace
 
-int FunctionParser::ParseAndDeduceVariables(const std::string& function, int* amountOfVariablesFound, bool useDegrees) {
+template<typename Value_t>
+int FunctionParserBase<Value_t>::ParseAndDeduceVariables(const std::string& function, int* amountOfVariablesFound, bool useDegrees) {
     std::string varString;
     return deduceVariables(*this, function.c_str(), varString, amountOfVariablesFound, 0, useDegrees);
 }
 
-int FunctionParser::ParseAndDeduceVariables(const std::string& function, std::string& resultVarString, int* amountOfVariablesFound, bool useDegrees) {
+template<typename Value_t>
+int FunctionParserBase<Value_t>::ParseAndDeduceVariables(const std::string& function, std::string& resultVarString, int* amountOfVariablesFound, bool useDegrees) {
     std::string varString;
     const int index = deduceVariables(*this, function.c_str(), varString, amountOfVariablesFound, 0, useDegrees);
     if (index < 0)
@@ -2161,7 +3866,8 @@ int FunctionParser::ParseAndDeduceVariables(const std::string& function, std::st
     return index;
 }
 
-int FunctionParser::ParseAndDeduceVariables(const std::string& function, std::vector<std::string>& resultVars, bool useDegrees) {
+template<typename Value_t>
+int FunctionParserBase<Value_t>::ParseAndDeduceVariables(const std::string& function, std::vector<std::string>& resultVars, bool useDegrees) {
     std::string varString;
     std::vector<std::string> vars;
     const int index = deduceVariables(*this, function.c_str(), varString, 0, &vars, useDegrees);
@@ -2170,6 +3876,141 @@ int FunctionParser::ParseAndDeduceVariables(const std::string& function, std::ve
     return index;
 }
 
+//===========================================================================
+// Specialization
+//===========================================================================
+/* The fixed variables are replaced by constants in the bytecode. Since both
+   take one word, only the indices to Immed of the if()s and jumps move, by
+   the amount of constants inserted before their targets. The remaining
+   variables are renumbered in their original order, and Optimize() then
+   folds the constants.
+*/
+template<typename Value_t>
+FunctionParserBase<Value_t> FunctionParserBase<Value_t>::Specialize(unsigned variableIndex, Value_t value) const {
+    return Specialize(std::vector<unsigned>(1, variableIndex), std::vector<Value_t>(1, value));
+}
+
+template<typename Value_t>
+FunctionParserBase<Value_t> FunctionParserBase<Value_t>::Specialize(const std::vector<unsigned>& variableIndices,
+                                                                    const std::vector<Value_t>& values) const {
+    FunctionParserBase result(*this);
+    if (parseErrorType != FP_NO_ERROR)
+        return result;
+
+    const unsigned variableAmount = unsigned(data->variableRefs.size());
+    std::vector<bool> fixed(variableAmount, false);
+    std::vector<Value_t> fixedValues(variableAmount, Value_t(0));
+    for (unsigned i = 0; i < variableIndices.size() && i < values.size(); ++i) {
+        if (variableIndices[i] < variableAmount) {
+            fixed[variableIndices[i]] = true;
+            fixedValues[variableIndices[i]] = values[i];
+        }
+    }
+
+    std::vector<std::string> names(variableAmount);
+    for (std::map<NamePtr, unsigned>::const_iterator iter = data->variableRefs.begin();
+         iter != data->variableRefs.end(); ++iter)
+        names[iter->second - VarBegin].assign(iter->first.name, iter->first.nameLength);
+
+    std::string variables;
+    std::vector<unsigned> newVariable(variableAmount);
+    unsigned remaining = 0;
+    for (unsigned i = 0; i < variableAmount; ++i) {
+        if (fixed[i])
+            continue;
+        if (remaining)
+            variables += ',';
+        variables += names[i];
+        newVariable[i] = VarBegin + remaining++;
+    }
+
+    const std::vector<unsigned>& byteCode = data->ByteCode;
+    const unsigned byteCodeSize = unsigned(byteCode.size());
+
+    // The amount of constants inserted before each position:
+    std::vector<unsigned> inserted(byteCodeSize + 1, 0);
+    unsigned insertedAmount = 0;
+    for (unsigned IP = 0; IP < byteCodeSize; ++IP) {
+        inserted[IP] = insertedAmount;
+        const unsigned opcode = byteCode[IP];
+        unsigned operands = 0;
+        switch (opcode) {
+        case cIf:
+        case cJump: operands = 2; break;
+        case cFCall:
+        case cPCall: operands = 1; break;
+#ifdef FP_SUPPORT_OPTIMIZER
+        case cFetch: operands = 1; break;
+        case cPopNMov: operands = 2; break;
+#endif
+        default:
+            if (opcode >= VarBegin && fixed[opcode - VarBegin])
+                ++insertedAmount;
+        }
+        for (; operands > 0; --operands)
+            inserted[++IP] = insertedAmount;
+    }
+    inserted[byteCodeSize] = insertedAmount;
+
+    std::vector<unsigned> newByteCode;
+    std::vector<Value_t> newImmed;
+    newByteCode.reserve(byteCodeSize);
+    newImmed.reserve(data->Immed.size() + insertedAmount);
+    for (unsigned IP = 0, DP = 0; IP < byteCodeSize; ++IP) {
+        const unsigned opcode = byteCode[IP];
+        switch (opcode) {
+        case cImmed:
+            newByteCode.push_back(cImmed);
+            newImmed.push_back(data->Immed[DP++]);
+            break;
+        case cIf:
+        case cJump:
+            newByteCode.push_back(opcode);
+            newByteCode.push_back(byteCode[IP + 1]);
+            newByteCode.push_back(byteCode[IP + 2] + inserted[byteCode[IP + 1] + 1]);
+            IP += 2;
+            break;
+        case cFCall:
+        case cPCall:
+#ifdef FP_SUPPORT_OPTIMIZER
+        case cFetch:
+#endif
+            newByteCode.push_back(opcode);
+            newByteCode.push_back(byteCode[++IP]);
+            break;
+#ifdef FP_SUPPORT_OPTIMIZER
+        case cPopNMov:
+            newByteCode.push_back(opcode);
+            newByteCode.push_back(byteCode[++IP]);
+            newByteCode.push_back(byteCode[++IP]);
+            break;
+#endif
+        default:
+            if (opcode < VarBegin) {
+                newByteCode.push_back(opcode);
+            } else if (fixed[opcode - VarBegin]) {
+                newByteCode.push_back(cImmed);
+                newImmed.push_back(fixedValues[opcode - VarBegin]);
+            } else {
+                newByteCode.push_back(newVariable[opcode - VarBegin]);
+            }
+        }
+    }
+
+    result.CopyOnWrite();
+    result.ParseVariables(variables);
+    result.data->ReleaseCompiledCode();
+    result.data->approximation.Clear();
+    result.data->ByteCode.swap(newByteCode);
+    result.data->Immed.swap(newImmed);
+#ifdef FP_USE_THREADED_DISPATCH
+    result.EvalByteCode<false>(result.evalContext, 0, 0, true);
+#endif
+    result.TranslateToRegisterCode();
+    result.Optimize();
+    return result;
+}
+
 //===========================================================================
 // Debug output
 //===========================================================================
@@ -2316,14 +4157,15 @@ struct IfInfo {
 };
 } // namespace
 
-void FunctionParser::PrintByteCode(std::ostream& dest, bool showExpression) const {
+template<typename Value_t>
+void FunctionParserBase<Value_t>::PrintByteCode(std::ostream& dest, bool showExpression) const {
     dest << "Size of stack: " << data->StackSize << "\n";
 
     std::ostringstream outputBuffer;
     std::ostream& output = (showExpression ? outputBuffer : dest);
 
     const std::vector<unsigned>& ByteCode = data->ByteCode;
-    const std::vector<double>& Immed = data->Immed;
+    const std::vector<Value_t>& Immed = data->Immed;
 
     std::vector<std::pair<int, std::string> > stack;
     std::vector<IfInfo> if_stack;
@@ -2497,8 +4339,8 @@ void FunctionParser::PrintByteCode(std::ostream& dest, bool showExpression) cons
             case cFCall: {
                 const unsigned index = ByteCode[++IP];
                 params = data->FuncPtrs[index].params;
-                std::set<NameData>::const_iterator iter = data->nameData.begin();
-                while (iter->type != NameData::FUNC_PTR || iter->index != index)
+                typename std::set<NameData<Value_t> >::const_iterator iter = data->nameData.begin();
+                while (iter->type != NameData<Value_t>::FUNC_PTR || iter->index != index)
                     ++iter;
                 output << "fcall " << iter->name;
                 out_params = true;
@@ -2508,8 +4350,8 @@ void FunctionParser::PrintByteCode(std::ostream& dest, bool showExpression) cons
             case cPCall: {
                 const unsigned index = ByteCode[++IP];
                 params = data->FuncParsers[index].params;
-                std::set<NameData>::const_iterator iter = data->nameData.begin();
-                while (iter->type != NameData::PARSER_PTR || iter->index != index)
+                typename std::set<NameData<Value_t> >::const_iterator iter = data->nameData.begin();
+                while (iter->type != NameData<Value_t>::PARSER_PTR || iter->index != index)
                     ++iter;
                 output << "pcall " << iter->name;
                 out_params = true;
@@ -2616,6 +4458,10 @@ void FunctionParser::PrintByteCode(std::ostream& dest, bool showExpression) cons
                         produces = 0;
                         break;
                     }
+                    case cSelect:
+                        n = "select";
+                        params = 3;
+                        break;
 #endif
                     case cDup: {
                         if (showExpression)
@@ -2766,11 +4612,52 @@ void FunctionParser::PrintByteCode(std::ostream& dest, bool showExpression) cons
         } else
             output << std::endl;
     }
+
+    PrintRegisterCode(dest);
 }
 #endif
 
 #ifndef FP_SUPPORT_OPTIMIZER
-void FunctionParser::Optimize() {
+template<typename Value_t>
+void FunctionParserBase<Value_t>::Optimize() {
     // Do nothing if no optimizations are supported.
 }
 #endif
+
+//===========================================================================
+// Value types other than double
+//===========================================================================
+/* These have neither the register code nor the compiled code (see the
+   declarations after FunctionParserBase in fparser.hh), so the parser only
+   has the bytecode to run.
+*/
+template<typename Value_t>
+void FunctionParserBase<Value_t>::Data::ReleaseCompiledCode() {
+}
+
+template<typename Value_t>
+bool FunctionParserBase<Value_t>::Compile() {
+    return false;
+}
+
+template<typename Value_t>
+void FunctionParserBase<Value_t>::TranslateToRegisterCode() {
+}
+
+#ifdef FUNCTIONPARSER_SUPPORT_DEBUG_OUTPUT
+template<typename Value_t>
+void FunctionParserBase<Value_t>::PrintRegisterCode(std::ostream&) const {
+}
+#endif
+
+template class FunctionParserBase<double>;
+template class FunctionParserBase<float>;
+template class FunctionParserBase<long double>;
+
+template double FunctionParserBase<double>::EvalByteCode<false>(EvalContext&, double*, const double*, bool,
+                                                                EvalProfile*) const;
+template float FunctionParserBase<float>::EvalByteCode<false>(EvalContext&, float*, const float*, bool,
+                                                              EvalProfile*) const;
+template long double FunctionParserBase<long double>::EvalByteCode<false>(EvalContext&, long double*,
+                                                                          const long double*, bool,
+                                                                          EvalProfile*) const;
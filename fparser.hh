@@ -7,6 +7,7 @@
 #ifndef ONCE_FPARSER_H_
 #define ONCE_FPARSER_H_
 
+#include <cmath>
 #include <string>
 #include <vector>
 #include <map>
@@ -17,6 +18,7 @@
 #endif
 
 namespace FPoptimizer_CodeTree {
+template<typename Value_t>
 class CodeTree;
 }
 
@@ -86,6 +88,7 @@ enum OPCODE {
     cVar, /* Denotes a variable in CodeTree (not used by bytecode) */
     cFetch, /* Same as Dup, except with absolute index (next value is index) */
     cPopNMov, /* cPopNMov(x,y) moves [y] to [x] and deletes anything above [x] */
+    cSelect, /* Pop B, Pop A, Pop C, Push (C ? A : B); a branchless if() */
 #endif
 
     cDup, /* Duplicates the last value in the stack: Pop A, Push A, Push A */
@@ -183,6 +186,7 @@ struct NamePtr {
     }
 };
 
+template<typename Value_t>
 struct NameData {
     enum DataType { CONSTANT,
                     UNIT,
@@ -194,7 +198,7 @@ struct NameData {
 
     union {
         unsigned index;
-        double value;
+        Value_t value;
     };
 
     NameData(DataType t, const std::string& n) : type(t), name(n) {}
@@ -238,29 +242,106 @@ inline const FuncDefinition* findFunction(const NamePtr& functionName) {
 }
 
 #ifndef FP_SUPPORT_ASINH
-inline double fp_asinh(double x) { return log(x + sqrt(x * x + 1)); }
-inline double fp_acosh(double x) { return log(x + sqrt(x * x - 1)); }
-inline double fp_atanh(double x) { return log((1 + x) / (1 - x)) * 0.5; }
+template<typename Value_t>
+inline Value_t fp_asinh(Value_t x) { return std::log(x + std::sqrt(x * x + 1)); }
+template<typename Value_t>
+inline Value_t fp_acosh(Value_t x) { return std::log(x + std::sqrt(x * x - 1)); }
+template<typename Value_t>
+inline Value_t fp_atanh(Value_t x) { return std::log((1 + x) / (1 - x)) * Value_t(0.5); }
 #else
-inline double fp_asinh(double x) { return asinh(x); }
-inline double fp_acosh(double x) { return acosh(x); }
-inline double fp_atanh(double x) { return atanh(x); }
+template<typename Value_t>
+inline Value_t fp_asinh(Value_t x) { return std::asinh(x); }
+template<typename Value_t>
+inline Value_t fp_acosh(Value_t x) { return std::acosh(x); }
+template<typename Value_t>
+inline Value_t fp_atanh(Value_t x) { return std::atanh(x); }
 #endif // FP_SUPPORT_ASINH
 
 #ifdef FP_EPSILON
-inline bool FloatEqual(double a, double b) { return fabs(a - b) <= FP_EPSILON; }
+template<typename Value_t>
+inline bool FloatEqual(Value_t a, Value_t b) { return std::fabs(a - b) <= Value_t(FP_EPSILON); }
 #else
-inline bool FloatEqual(double a, double b) { return a == b; }
+template<typename Value_t>
+inline bool FloatEqual(Value_t a, Value_t b) { return a == b; }
 #endif // FP_EPSILON
 
-inline bool IsIntegerConst(double a) { return FloatEqual(a, (double)(long)a); }
+template<typename Value_t>
+inline bool IsIntegerConst(Value_t a) { return FloatEqual(a, Value_t((long)a)); }
 
 // #endif // ONCE_FPARSER_H_
 } // namespace FUNCTIONPARSERTYPES
 
-class FunctionParser {
+template<typename Value_t>
+class FunctionParserBase {
 public:
-    typedef double (*FunctionPtr)(const double*);
+    typedef Value_t (*FunctionPtr)(const Value_t*);
+
+    // The closed interval [lower, upper], as evaluated by EvalInterval():
+    struct Interval {
+        double lower, upper;
+
+        Interval() : lower(0), upper(0) {}
+        Interval(double value) : lower(value), upper(value) {}
+        Interval(double l, double u) : lower(l), upper(u) {}
+    };
+    typedef Interval (*IntervalFunctionPtr)(const Interval*);
+    // Stores the partial derivatives of a function by each of its parameters:
+    typedef void (*DerivativeFunctionPtr)(const double* params, double* derivatives);
+
+    // The state of an evaluation by Eval(EvalContext&, const Value_t*).
+    // Each thread evaluating concurrently needs its own context.
+    class EvalContext {
+    public:
+        EvalContext();
+        EvalContext(const EvalContext&); // the copy starts out empty
+        EvalContext& operator=(const EvalContext&); // does nothing
+        ~EvalContext();
+
+        inline int EvalError() const { return evalErrorType; }
+
+    private:
+        friend class FunctionParserBase;
+        friend class FunctionBundle;
+
+        std::vector<Value_t> Stack; // also the registers of the register code
+        // The tape of EvalWithGradient() in reverse mode:
+        std::vector<unsigned> tapeSlots, tapeEnds, tapeOperands;
+        std::vector<double> tapePartials, tapeAdjoints;
+        int evalErrorType;
+        unsigned evalRecursionLevel;
+        EvalContext* nested; // for eval() and nested parsers
+
+        EvalContext& Nested();
+    };
+
+    // The execution counts and times of the bytecode instructions,
+    // accumulated by EvalProfiled().
+    class EvalProfile {
+    public:
+        struct Entry {
+            unsigned offset; // of the instruction, as printed by PrintByteCode()
+            unsigned opcode; // VarBegin and up for the variables
+            unsigned long long executions;
+            unsigned long long cycles; // time stamp counter ticks
+        };
+
+        EvalProfile();
+
+        inline unsigned long Evaluations() const { return evaluations; }
+        // One entry per instruction, in the order of the bytecode:
+        inline const std::vector<Entry>& ByOffset() const { return entries; }
+        // One entry per opcode (the offset is that of its first instruction),
+        // the most expensive first:
+        std::vector<Entry> ByOpcode() const;
+        void Clear();
+
+    private:
+        friend class FunctionParserBase;
+
+        std::vector<Entry> entries;
+        std::vector<unsigned> entryAt; // index of the entry of each bytecode word
+        unsigned long evaluations;
+    };
 
     struct Data {
         unsigned referenceCounter;
@@ -268,24 +349,67 @@ public:
         std::string variablesString;
         std::map<FUNCTIONPARSERTYPES::NamePtr, unsigned> variableRefs;
 
-        std::set<FUNCTIONPARSERTYPES::NameData> nameData;
-        std::map<FUNCTIONPARSERTYPES::NamePtr, const FUNCTIONPARSERTYPES::NameData*> namePtrs;
+        std::set<FUNCTIONPARSERTYPES::NameData<Value_t> > nameData;
+        std::map<FUNCTIONPARSERTYPES::NamePtr, const FUNCTIONPARSERTYPES::NameData<Value_t>*> namePtrs;
 
         struct FuncPtrData {
             union {
                 FunctionPtr funcPtr;
-                FunctionParser* parserPtr;
+                FunctionParserBase* parserPtr;
             };
             unsigned params;
+            IntervalFunctionPtr intervalPtr; // of a FunctionPtr, or 0
+            DerivativeFunctionPtr derivativePtr; // of a FunctionPtr, or 0
         };
 
         std::vector<FuncPtrData> FuncPtrs;
         std::vector<FuncPtrData> FuncParsers;
 
         std::vector<unsigned> ByteCode;
-        std::vector<double> Immed;
-        std::vector<double> Stack;
+        std::vector<Value_t> Immed;
         unsigned StackSize;
+        std::vector<const void*> ThreadedCode;
+
+        struct RegisterInstruction {
+            unsigned opcode, dest, param1, param2;
+        };
+        std::vector<RegisterInstruction> RegisterCode;
+        std::vector<double> RegisterFile;
+        std::vector<unsigned> RegisterVars;
+        unsigned RegisterTemporaries; // index of the first temporary
+        bool useFPExceptions; // see UseFloatingPointExceptions()
+        bool useBranchlessIfs; // see UseBranchlessIfs()
+        bool useShortCircuitEvaluation; // see UseShortCircuitEvaluation()
+        bool useVectorMath; // see UseVectorMath()
+
+        // The piecewise polynomial built by Approximate():
+        struct Approximation {
+            struct Piece {
+                double center, inverseRadius; // t = (x - center) * inverseRadius is in [-1, 1]
+                bool exact; // evaluated without the approximation
+            };
+            double minValue, maxValue, cellsPerUnit;
+            unsigned degree; // of the polynomials of all the pieces, odd
+            std::vector<Piece> pieces;
+            std::vector<double> breaks; // piece i covers [breaks[i], breaks[i + 1])
+            std::vector<double> coefficients; // degree + 1 per piece, of t^0 first
+            std::vector<unsigned> cells; // the first piece which may contain each cell
+
+            Approximation() : minValue(0), maxValue(0), cellsPerUnit(0), degree(0) {}
+            void Clear() {
+                minValue = maxValue = cellsPerUnit = 0;
+                degree = 0;
+                pieces.clear();
+                breaks.clear();
+                coefficients.clear();
+                cells.clear();
+            }
+        };
+        Approximation approximation; // empty unless Approximate() succeeded
+
+        typedef double (*CompiledFunction)(const double*, EvalContext*, const FunctionParserBase*);
+        CompiledFunction compiledFunction;
+        size_t compiledCodeSize;
 
         Data()
             : referenceCounter(1),
@@ -297,10 +421,24 @@ public:
               FuncParsers(),
               ByteCode(),
               Immed(),
-              Stack(),
-              StackSize(0) {}
+              StackSize(0),
+              ThreadedCode(),
+              RegisterCode(),
+              RegisterFile(),
+              RegisterVars(),
+              RegisterTemporaries(0),
+              useFPExceptions(false),
+              useBranchlessIfs(false),
+              useShortCircuitEvaluation(false),
+              useVectorMath(false),
+              approximation(),
+              compiledFunction(0),
+              compiledCodeSize(0) {}
         Data(const Data&);
         Data& operator=(const Data&); // not implemented on purpose
+        ~Data();
+
+        void ReleaseCompiledCode();
     };
 
     enum ParseErrorType {
@@ -327,29 +465,121 @@ public:
     const char* ErrorMsg() const;
     inline ParseErrorType GetParseErrorType() const { return parseErrorType; }
 
-    double Eval(const double* Vars);
+    Value_t Eval(const Value_t* Vars);
+    Value_t Eval(EvalContext& context, const Value_t* Vars) const;
     inline int EvalError() const { return evalErrorType; }
+    Value_t EvalProfiled(const Value_t* Vars, EvalProfile& profile);
 
-    bool AddConstant(const std::string& name, double value);
-    bool AddUnit(const std::string& name, double value);
+    void EvalMany(const double* Vars, size_t rowCount, size_t rowStride, double* results);
+    void EvalMany(const float* Vars, size_t rowCount, size_t rowStride, float* results);
+    void EvalManyParallel(const double* Vars, size_t rowCount, size_t rowStride, double* results,
+                          unsigned threadCount = 0);
+    void EvalManyParallel(const float* Vars, size_t rowCount, size_t rowStride, float* results,
+                          unsigned threadCount = 0);
+
+    bool AddConstant(const std::string& name, Value_t value);
+    bool AddUnit(const std::string& name, Value_t value);
 
     bool AddFunction(const std::string& name, FunctionPtr, unsigned paramsAmount);
-    bool AddFunction(const std::string& name, FunctionParser&);
+    bool AddFunction(const std::string& name, FunctionPtr, IntervalFunctionPtr, unsigned paramsAmount,
+                     DerivativeFunctionPtr = 0);
+    bool AddFunction(const std::string& name, FunctionPtr, DerivativeFunctionPtr, unsigned paramsAmount);
+    bool AddFunction(const std::string& name, FunctionParserBase&);
 
     bool RemoveIdentifier(const std::string& name);
 
     void Optimize();
+    bool Compile();
+
+    FunctionParserBase Specialize(unsigned variableIndex, Value_t value) const;
+    FunctionParserBase Specialize(const std::vector<unsigned>& variableIndices,
+                                  const std::vector<Value_t>& values) const;
+
+    void UseFloatingPointExceptions(bool enable = true);
+    void UseBranchlessIfs(bool enable = true);
+    void UseShortCircuitEvaluation(bool enable = true);
+    void UseVectorMath(bool enable = true);
+
+    bool Approximate(double minValue, double maxValue, double maxAbsError);
+
+    void EvalRange(double start, double step, size_t count, double* results);
+    void EvalRange(const double* Vars, unsigned variableIndex, double start, double step, size_t count,
+                   double* results);
+
+    Interval EvalInterval(const Interval* Vars);
+    Interval EvalInterval(EvalContext& context, const Interval* Vars) const;
+
+    double EvalWithGradient(const double* Vars, double* gradient);
+    double EvalWithGradient(EvalContext& context, const double* Vars, double* gradient) const;
+    void EvalManyWithGradient(const double* Vars, size_t rowCount, size_t rowStride, double* results,
+                              double* gradients);
+
+    // A function exported by ExportC() and loaded by CompileC():
+    class CFunction {
+    public:
+        typedef double (*Function)(const double*);
+        typedef void (*ManyFunction)(const double*, size_t, size_t, double*);
+
+        CFunction();
+        ~CFunction();
+
+        inline bool IsLoaded() const { return function != 0; }
+        inline double operator()(const double* Vars) const { return function(Vars); }
+        inline void operator()(const double* Vars, size_t rowCount, size_t rowStride, double* results) const {
+            manyFunction(Vars, rowCount, rowStride, results);
+        }
+        void Unload();
+
+    private:
+        friend class FunctionParserBase;
+
+        CFunction(const CFunction&); // not implemented on purpose
+        CFunction& operator=(const CFunction&); // not implemented on purpose
+
+        void* handle;
+        Function function;
+        ManyFunction manyFunction;
+    };
+
+    bool ExportC(std::string& code, const std::string& functionName = "fparser_function") const;
+    bool CompileC(CFunction& result, const std::string& compiler = "cc -O2") const;
+
+    // A rough static estimate of what evaluating the function costs:
+    struct CostEstimate {
+        unsigned cost; // of one evaluation, in the units of an addition
+        unsigned instructions; // in the bytecode
+        unsigned branches; // if()s
+        unsigned functionCalls; // of functions added with AddFunction()
+        unsigned parserCalls; // of the functions which are FunctionParsers
+        unsigned evalCalls; // of eval()
+    };
+    CostEstimate EstimateCost() const;
+
+    enum EvalEngine {
+        BYTECODE_ENGINE, // Eval() interpreting the bytecode
+        REGISTER_ENGINE, // Eval() interpreting the register code
+        NATIVE_ENGINE, // Eval() running the code of Compile()
+        BATCH_ENGINE, // EvalMany()
+        PARALLEL_BATCH_ENGINE // EvalManyParallel()
+    };
+    struct EvalPlan {
+        EvalEngine engine;
+        double costPerRow; // estimated, in the units of CostEstimate::cost
+        std::string reason;
+    };
+    EvalPlan PlanEvaluation(size_t rowCount = 1) const;
+    void EvalPlanned(const double* Vars, size_t rowCount, size_t rowStride, double* results);
 
     int ParseAndDeduceVariables(const std::string& function, int* amountOfVariablesFound = 0, bool useDegrees = false);
     int ParseAndDeduceVariables(const std::string& function, std::string& resultVarString, int* amountOfVariablesFound = 0, bool useDegrees = false);
     int ParseAndDeduceVariables(const std::string& function, std::vector<std::string>& resultVars, bool useDegrees = false);
 
-    FunctionParser();
-    ~FunctionParser();
+    FunctionParserBase();
+    ~FunctionParserBase();
 
     // Copy constructor and assignment operator (implemented using the copy-on-write technique for efficiency):
-    FunctionParser(const FunctionParser&);
-    FunctionParser& operator=(const FunctionParser&);
+    FunctionParserBase(const FunctionParserBase&);
+    FunctionParserBase& operator=(const FunctionParserBase&);
 
     void ForceDeepCopy();
 
@@ -361,7 +591,10 @@ public:
     //========================================================================
 private:
     //========================================================================
-    friend class FPoptimizer_CodeTree::CodeTree;
+    friend class FPoptimizer_CodeTree::CodeTree<Value_t>;
+    friend class ExpressionSet;
+    friend class FunctionBundle;
+    friend class IncrementalEvaluator;
 
     // Private data:
     // ------------
@@ -373,14 +606,61 @@ private:
     Data* data;
 
     bool useDegreeConversion;
-    unsigned evalRecursionLevel;
+    EvalContext evalContext;
     unsigned StackPtr;
     const char* errorLocation;
 
     // Private methods:
     // ---------------
+    class JitCompiler;
+    friend class JitCompiler;
+
+    Value_t Evaluate(EvalContext&, Value_t* memory, const Value_t* Vars) const;
+    Value_t EvaluateWithFPExceptions(EvalContext&, Value_t* memory, const Value_t* Vars) const;
+    template<bool profiled>
+    Value_t EvalByteCode(EvalContext&, Value_t* Stack, const Value_t* Vars, bool predecode,
+                         EvalProfile* profile = 0) const;
+    void TranslateToRegisterCode();
+    template<bool checks>
+    double EvalRegisterCode(EvalContext&, double* R, const double* Vars) const;
+    template<bool checks, bool incremental>
+    double RunRegisterCode(EvalContext&, const typename Data::RegisterInstruction* code, double* R,
+                           const unsigned long long* dependencies, unsigned long long changed) const;
+#ifdef FUNCTIONPARSER_SUPPORT_DEBUG_OUTPUT
+    void PrintRegisterCode(std::ostream& dest) const;
+#endif
+
+    template<typename Row_t> struct EvalManyBlock;
+    template<typename Row_t> struct EvalManyState;
+    template<typename Row_t> struct EvalManyTask;
+    template<typename Row_t>
+    void EvalBlock(EvalManyState<Row_t>&, EvalManyBlock<Row_t>&, unsigned level, unsigned IP, unsigned DP, int SP) const;
+    template<typename Row_t>
+    void PrepareEvalMany(EvalManyState<Row_t>&, Row_t* results) const;
+    template<typename Row_t>
+    void EvalManyRange(EvalManyState<Row_t>&, const Row_t* Vars, size_t begin, size_t end, size_t rowStride) const;
+    template<typename Row_t>
+    void EvalManyRows(const Row_t* Vars, size_t rowCount, size_t rowStride, Row_t* results);
+    template<typename Row_t>
+    void EvalManyRowsParallel(const Row_t* Vars, size_t rowCount, size_t rowStride, Row_t* results,
+                              unsigned threadCount);
+    template<typename Row_t>
+    static void* EvalManyThread(void* task);
+    unsigned EstimatedEvalCost() const;
+    bool CanCompile() const;
+    bool RangePolynomial(const double* Vars, unsigned variableIndex, double start, double step,
+                         std::vector<double>& result) const;
+    void EvalIntervalCode(EvalContext& context, unsigned begin, unsigned end, unsigned DP, const Interval* Vars,
+                          std::vector<Interval>& Stack, int& SP) const;
+    bool EvalIntervalTaylor(EvalContext& context, const Interval& x, unsigned terms, Interval* result) const;
+    bool ProveApproximation(EvalContext& context, const std::vector<double>& polynomial, double begin, double end,
+                            double maxAbsError, size_t& budget) const;
+    template<typename Derivatives>
+    double EvalGradientByteCode(EvalContext& context, double* Stack, Derivatives&, const double* Vars,
+                                double* gradient) const;
+
     void CopyOnWrite();
-    bool CheckRecursiveLinking(const FunctionParser*) const;
+    bool CheckRecursiveLinking(const FunctionParserBase*) const;
     bool NameExists(const char*, unsigned);
     bool ParseVariables(const std::string&);
     int ParseFunction(const char*, bool);
@@ -388,7 +668,7 @@ private:
 
     void AddFunctionOpcode_CheckDegreesConversion(unsigned);
     void AddFunctionOpcode(unsigned);
-    inline void AddMultiplicationByConst(double value);
+    inline void AddMultiplicationByConst(Value_t value);
     template <typename Operation>
     inline void AddBinaryOperationByConst();
     inline void incStackPtr();
@@ -403,8 +683,194 @@ private:
     const char* CompileMult(const char*);
     const char* CompileAddition(const char*);
     const char* CompileComparison(const char*);
+    void CompileShortCircuit(unsigned, unsigned);
     const char* CompileAnd(const char*);
     const char* CompileExpression(const char*);
 };
 
+typedef FunctionParserBase<double> FunctionParser;
+typedef FunctionParserBase<float> FunctionParser_f;
+typedef FunctionParserBase<long double> FunctionParser_ld;
+
+/* The register code, Compile(), EvalMany(), the interval and gradient
+   evaluations, EvalRange(), Approximate(), ExportC() and PlanEvaluation()
+   work on the double arithmetic of the processor, so only FunctionParser
+   has them. The other value types parse, optimize and evaluate the bytecode
+   in their own precision (and Compile() just returns false).
+*/
+template<> void FunctionParser::Data::ReleaseCompiledCode();
+template<> void FunctionParser::EvalMany(const double*, size_t, size_t, double*);
+template<> void FunctionParser::EvalMany(const float*, size_t, size_t, float*);
+template<> void FunctionParser::EvalManyParallel(const double*, size_t, size_t, double*, unsigned);
+template<> void FunctionParser::EvalManyParallel(const float*, size_t, size_t, float*, unsigned);
+template<> bool FunctionParser::AddFunction(const std::string&, FunctionPtr, IntervalFunctionPtr, unsigned,
+                                            DerivativeFunctionPtr);
+template<> bool FunctionParser::AddFunction(const std::string&, FunctionPtr, DerivativeFunctionPtr, unsigned);
+template<> bool FunctionParser::Compile();
+template<> bool FunctionParser::Approximate(double, double, double);
+template<> void FunctionParser::EvalRange(double, double, size_t, double*);
+template<> void FunctionParser::EvalRange(const double*, unsigned, double, double, size_t, double*);
+template<> FunctionParser::Interval FunctionParser::EvalInterval(const Interval*);
+template<> FunctionParser::Interval FunctionParser::EvalInterval(EvalContext&, const Interval*) const;
+template<> double FunctionParser::EvalWithGradient(const double*, double*);
+template<> double FunctionParser::EvalWithGradient(EvalContext&, const double*, double*) const;
+template<> void FunctionParser::EvalManyWithGradient(const double*, size_t, size_t, double*, double*);
+template<> FunctionParser::CFunction::CFunction();
+template<> FunctionParser::CFunction::~CFunction();
+template<> void FunctionParser::CFunction::Unload();
+template<> bool FunctionParser::ExportC(std::string&, const std::string&) const;
+template<> bool FunctionParser::CompileC(CFunction&, const std::string&) const;
+template<> FunctionParser::EvalPlan FunctionParser::PlanEvaluation(size_t) const;
+template<> void FunctionParser::EvalPlanned(const double*, size_t, size_t, double*);
+template<> double FunctionParser::Evaluate(EvalContext&, double*, const double*) const;
+template<> double FunctionParser::EvaluateWithFPExceptions(EvalContext&, double*, const double*) const;
+template<> void FunctionParser::TranslateToRegisterCode();
+template<> template<bool checks>
+double FunctionParser::EvalRegisterCode(EvalContext&, double*, const double*) const;
+template<> template<bool checks, bool incremental>
+double FunctionParser::RunRegisterCode(EvalContext&, const Data::RegisterInstruction*, double*,
+                                       const unsigned long long*, unsigned long long) const;
+#ifdef FUNCTIONPARSER_SUPPORT_DEBUG_OUTPUT
+template<> void FunctionParser::PrintRegisterCode(std::ostream&) const;
+#endif
+template<> bool FunctionParser::CanCompile() const;
+template<> bool FunctionParser::RangePolynomial(const double*, unsigned, double, double,
+                                                std::vector<double>&) const;
+template<> void FunctionParser::EvalIntervalCode(EvalContext&, unsigned, unsigned, unsigned, const Interval*,
+                                                 std::vector<Interval>&, int&) const;
+template<> bool FunctionParser::EvalIntervalTaylor(EvalContext&, const Interval&, unsigned, Interval*) const;
+template<> bool FunctionParser::ProveApproximation(EvalContext&, const std::vector<double>&, double, double,
+                                                   double, size_t&) const;
+template<> template<typename Derivatives>
+double FunctionParser::EvalGradientByteCode(EvalContext&, double*, Derivatives&, const double*, double*) const;
+
+// Evaluates many functions of the same variables at once, using several
+// threads. See the documentation of ExpressionSet in fparser.html.
+class ExpressionSet {
+public:
+    struct LatencyStatistics {
+        unsigned long ticks;
+        double lastSeconds, minSeconds, maxSeconds, totalSeconds;
+        // Ticks by latency: histogram[i] counts the ticks which took
+        // 2^i to 2^(i+1) nanoseconds (the last one also counts longer ones).
+        unsigned long histogram[40];
+
+        double MeanSeconds() const;
+        double PercentileSeconds(double percent) const; // an upper bound
+    };
+
+    explicit ExpressionSet(unsigned threadCount = 0);
+    ~ExpressionSet();
+
+    unsigned Add(const FunctionParser&);
+    inline unsigned Size() const { return unsigned(parsers.size()); }
+    void Clear();
+
+    void Eval(const double* Vars, double* results);
+    inline int EvalError(unsigned index) const { return errors[index]; }
+
+    inline const LatencyStatistics& GetLatencyStatistics() const { return statistics; }
+    void ResetLatencyStatistics();
+
+private:
+    ExpressionSet(const ExpressionSet&); // not implemented on purpose
+    ExpressionSet& operator=(const ExpressionSet&); // not implemented on purpose
+
+    struct Pool;
+    friend struct Pool;
+
+    std::vector<FunctionParser> parsers; // in the order of Add()
+    std::vector<int> errors;
+
+    // The evaluation order: parsers sharing their data (copies of each
+    // other) form one unit, which is evaluated once. The units are grouped
+    // by their variables and sorted by cost, and consecutive units form
+    // the chunks which the threads take.
+    std::vector<unsigned> members, unitBegins, chunkBegins;
+    bool prepared;
+
+    unsigned threadCount;
+    Pool* pool;
+    LatencyStatistics statistics;
+
+    void Prepare();
+    void EvalChunk(unsigned chunk, FunctionParser::EvalContext&, const double* Vars, double* results);
+};
+
+// Evaluates several functions of the same variables at once, computing the
+// subexpressions they share only once. See the documentation of
+// FunctionBundle in fparser.html.
+class FunctionBundle {
+public:
+    FunctionBundle();
+
+    // Returns -1 if all the functions were parsed, or else the index of the
+    // first one which was not. The constants, units and functions added to
+    // the definitions can be used in the functions.
+    int Parse(const std::vector<std::string>& functions, const std::string& Vars,
+              bool useDegrees = false);
+    int Parse(const std::vector<std::string>& functions, const std::string& Vars,
+              const FunctionParser& definitions, bool useDegrees = false);
+
+    inline const char* ErrorMsg() const { return combined.ErrorMsg(); }
+    inline FunctionParser::ParseErrorType GetParseErrorType() const { return combined.GetParseErrorType(); }
+    inline unsigned Size() const { return unsigned(parsers.size()); }
+
+    void Eval(const double* Vars, double* results);
+    inline int EvalError(unsigned index) const { return errors[index]; }
+
+private:
+    FunctionBundle(const FunctionBundle&); // not implemented on purpose
+    FunctionBundle& operator=(const FunctionBundle&); // not implemented on purpose
+
+    std::vector<FunctionParser> parsers; // one for each function
+    std::vector<int> errors;
+
+    // The bytecode of all the functions, which leaves the result of
+    // function i in the stack at outputs[i] (when merged), or else the
+    // parser of the function which failed to parse.
+    FunctionParser combined;
+    std::vector<unsigned> outputs;
+    bool merged;
+    FunctionParser::EvalContext context;
+
+    bool Merge(); // in fpoptimizer_main.cc
+    void EvalSeparately(const double* Vars, double* results);
+};
+
+// Evaluates a function repeatedly, recomputing only the parts which depend
+// on the variables changed since the previous evaluation. See the
+// documentation of IncrementalEvaluator in fparser.html.
+class IncrementalEvaluator {
+public:
+    explicit IncrementalEvaluator(const FunctionParser&);
+
+    // Finds the changed variables by comparing Vars to the previous values.
+    double Eval(const double* Vars);
+    // Only the given variables (indices to Vars) are read from Vars.
+    double Eval(const double* Vars, const unsigned* changedVariables, unsigned changedAmount);
+    inline int EvalError() const { return evalErrorType; }
+
+    void Reset(); // the next Eval() computes everything
+
+private:
+    FunctionParser parser;
+
+    // Register code in which no register is reused, so that the registers
+    // keep the values of the previous evaluation, and the variables each
+    // instruction depends on (see fparser_regvm.cc):
+    std::vector<FunctionParser::Data::RegisterInstruction> code;
+    std::vector<unsigned long long> dependencies;
+    std::vector<double> registers;
+    std::vector<unsigned> variables; // the variable of each variable register
+    std::vector<unsigned> variableRegister; // the register of each variable, or ~0U
+    bool upToDate;
+
+    int evalErrorType;
+    FunctionParser::EvalContext context;
+
+    double Evaluate(unsigned long long changed);
+    double EvalDirectly(const double* Vars);
+};
+
 #endif
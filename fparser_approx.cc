@@ -0,0 +1,390 @@
+/***************************************************************************\
+|* Function Parser for C++ v3.3.2                                          *|
+|*-------------------------------------------------------------------------*|
+|* Copyright: Juha Nieminen                                                *|
+\***************************************************************************/
+
+#include "stdafx.h"
+#include "fpconfig.hh"
+#include "fparser.hh"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <limits>
+#include <queue>
+
+//=========================================================================
+// Piecewise polynomial approximation
+//=========================================================================
+/* Approximate() cuts the range into pieces by repeated halving. On each
+   piece, the function is interpolated at the Chebyshev nodes, and the
+   Chebyshev series is truncated to the lowest degree whose dropped terms
+   add up to at most a quarter of the allowed error. The truncated series is
+   converted to a polynomial in t = (x - center) / radius, and then checked
+   against the function at evenly spaced points of the piece, where it must
+   be within half of the allowed error, and then its error is proven to be
+   within the allowed one with interval arithmetic (see
+   ProveApproximation()). A piece which fails or cannot be proven is halved.
+   The pieces are only used where the proof succeeded, so the bound holds
+   for every value, not only for the points which were checked.
+   Pieces where the function has evaluation errors or non-finite values
+   (eg. near a pole) are halved too, down to a minimum width, and what is
+   left of them is evaluated without the approximation, as are the pieces
+   where it fails at every node, and the values outside of the range.
+   To find the piece of a value in constant time, the range is divided into
+   equal cells, and each cell stores the first piece which may contain its
+   values; from there at most a few pieces are skipped.
+*/
+namespace {
+const unsigned ApproximationNodes = 17;
+const unsigned ApproximationMaxDegree = 8; // higher ones are slower than more pieces
+const unsigned ApproximationChecks = 48; // points checked per piece
+const unsigned ApproximationTaylorTerms = ApproximationMaxDegree + 4; // of the error bound, up to h^(terms-1)
+const unsigned ApproximationProofCells = 8; // the first subdivision of a piece in the proof
+const unsigned ApproximationProofSplits = 256; // per piece, before it is given up and halved
+const size_t ApproximationProofBudget = 1 << 20; // splits in all, before Approximate() gives up
+const unsigned ApproximationMaxDepth = 20; // of the halving
+const size_t ApproximationMaxIntervals = 131072; // fitted, so at most half as many pieces
+const size_t ApproximationMaxCells = 65536;
+const double Infinity = std::numeric_limits<double>::infinity();
+
+inline bool IsFinite(double x) { return x - x == 0; }
+
+struct PendingInterval {
+    double begin, end;
+    unsigned depth;
+};
+
+inline double EvalPolynomial(const std::vector<double>& polynomial, double t) {
+    double result = polynomial.back();
+    for (size_t k = polynomial.size() - 1; k-- > 0;)
+        result = result * t + polynomial[k];
+    return result;
+}
+
+/* The coefficients of the polynomial in powers of (t - t0), and bounds of
+   their rounding errors, including those of an error of t0 of a few ulps
+   (|t0| is at most about 1). */
+void Shift(const std::vector<double>& polynomial, double t0, std::vector<double>& result,
+           std::vector<double>& rounding) {
+    const size_t size = polynomial.size();
+    const double magnitude = std::max(1.0, std::fabs(t0));
+    result = polynomial;
+    for (size_t i = 0; i < size; ++i)
+        for (size_t j = size - 1; j > i; --j)
+            result[j - 1] += t0 * result[j];
+    // C(i, j) |a_i| magnitude^(i-j) (size + 2 + i - j) times a few ulps:
+    rounding.assign(size, 0.0);
+    for (size_t i = 0; i < size; ++i) {
+        double binomial = 1, power = 1;
+        for (size_t j = i + 1; j-- > 0;) {
+            rounding[j] += binomial * std::fabs(polynomial[i]) * power * double(size + 2 + i - j);
+            binomial = binomial * double(j) / double(i - j + 1);
+            power *= magnitude;
+        }
+    }
+    for (size_t j = 0; j < size; ++j)
+        rounding[j] *= 4 * DBL_EPSILON;
+}
+
+// The sum of |a_k|, or of k |a_k| when weighted, which bound the polynomial
+// and its derivative on [-1, 1].
+double CoefficientSum(const std::vector<double>& polynomial, bool weighted) {
+    double sum = 0;
+    for (size_t k = 0; k < polynomial.size(); ++k)
+        sum += std::fabs(polynomial[k]) * (weighted ? double(k) : 1.0);
+    return sum;
+}
+
+// Moves the bounds outwards by a few rounding errors of their computation.
+inline FunctionParser::Interval Widen(const FunctionParser::Interval& x) {
+    return FunctionParser::Interval(x.lower - 4 * DBL_EPSILON * std::fabs(x.lower),
+                                    x.upper + 4 * DBL_EPSILON * std::fabs(x.upper));
+}
+
+// Bounds the polynomial on [t0, t1], within [-1, 1], by its value at the
+// middle and a bound of its derivative, give or take its rounding.
+FunctionParser::Interval PolynomialRange(const std::vector<double>& polynomial, double t0, double t1,
+                                         double rounding) {
+    const double middle = 0.5 * (t0 + t1), halfWidth = 0.5 * (t1 - t0);
+    const double magnitude = std::max(std::fabs(t0), std::fabs(t1));
+    double slope = 0, power = 1;
+    for (size_t k = 1; k < polynomial.size(); ++k) {
+        slope += k * std::fabs(polynomial[k]) * power;
+        power *= magnitude;
+    }
+    const double value = EvalPolynomial(polynomial, middle);
+    const double spread = (slope * halfWidth + rounding) * (1 + 4 * DBL_EPSILON);
+    return Widen(FunctionParser::Interval(value - spread, value + spread));
+}
+
+// The largest distance between the points of a and b, infinite if one is.
+inline double Distance(const FunctionParser::Interval& a, const FunctionParser::Interval& b) {
+    const double distance = std::max(a.upper - b.lower, b.upper - a.lower);
+    return distance <= Infinity ? distance : Infinity;
+}
+
+struct ProofCell {
+    double bound, begin, end;
+    bool operator<(const ProofCell& rhs) const { return bound < rhs.bound; }
+};
+} // namespace
+
+template<>
+bool FunctionParser::Approximate(double minValue, double maxValue, double maxAbsError) {
+    if (parseErrorType != FP_NO_ERROR || data->variableRefs.size() != 1)
+        return false;
+    if (!(minValue < maxValue) || !IsFinite(maxValue - minValue) || !(maxAbsError > 0) ||
+        !IsFinite(maxAbsError))
+        return false;
+
+    // The function must be sampled without the previous approximation.
+    CopyOnWrite();
+    data->approximation.Clear();
+
+    Data::Approximation approximation;
+    approximation.minValue = minValue;
+    approximation.maxValue = maxValue;
+    EvalContext context;
+    const double pi = 3.14159265358979323846;
+
+    // The Chebyshev polynomials T_0 ... T_n as polynomials in t:
+    std::vector<std::vector<double> > chebyshev(ApproximationNodes);
+    chebyshev[0].assign(1, 1.0);
+    chebyshev[1].assign(2, 0.0);
+    chebyshev[1][1] = 1.0;
+    for (unsigned k = 2; k < ApproximationNodes; ++k) {
+        chebyshev[k].assign(k + 1, 0.0);
+        for (unsigned i = 0; i < k; ++i)
+            chebyshev[k][i + 1] += 2 * chebyshev[k - 1][i];
+        for (unsigned i = 0; i + 1 < k; ++i)
+            chebyshev[k][i] -= chebyshev[k - 2][i];
+    }
+
+    std::vector<PendingInterval> pending(1);
+    pending[0].begin = minValue;
+    pending[0].end = maxValue;
+    pending[0].depth = 0;
+    std::vector<std::vector<double> > polynomials; // of the pieces
+    double values[ApproximationNodes], series[ApproximationNodes];
+    size_t budget = ApproximationProofBudget;
+    for (size_t fitted = 0; !pending.empty(); ++fitted) {
+        if (fitted == ApproximationMaxIntervals)
+            return false;
+        const PendingInterval interval = pending.back();
+        pending.pop_back();
+        const double center = 0.5 * (interval.begin + interval.end);
+        const double radius = 0.5 * (interval.end - interval.begin);
+
+        // Interpolate at the nodes:
+        unsigned failures = 0;
+        for (unsigned j = 0; j < ApproximationNodes; ++j) {
+            const double x = center + radius * std::cos(pi * (j + 0.5) / ApproximationNodes);
+            values[j] = Eval(context, &x);
+            if (context.evalErrorType != 0 || !IsFinite(values[j]))
+                ++failures;
+        }
+        bool valid = failures == 0;
+        unsigned degree = ApproximationNodes;
+        if (valid) {
+            for (unsigned k = 0; k < ApproximationNodes; ++k) {
+                double sum = 0;
+                for (unsigned j = 0; j < ApproximationNodes; ++j)
+                    sum += values[j] * std::cos(pi * k * (j + 0.5) / ApproximationNodes);
+                series[k] = (k == 0 ? 1.0 : 2.0) * sum / ApproximationNodes;
+            }
+            double dropped = 0;
+            for (degree = ApproximationNodes - 1; degree > 0; --degree) {
+                dropped += std::fabs(series[degree]);
+                if (dropped > 0.25 * maxAbsError)
+                    break;
+            }
+            if (degree > ApproximationMaxDegree)
+                degree = ApproximationNodes; // the series does not converge fast enough
+        }
+
+        std::vector<double> polynomial;
+        if (degree < ApproximationNodes) {
+            polynomial.assign(degree + 1, 0.0);
+            for (unsigned k = 0; k <= degree; ++k)
+                for (unsigned i = 0; i <= k; ++i)
+                    polynomial[i] += series[k] * chebyshev[k][i];
+
+            const double inverseRadius = 1 / radius;
+            for (unsigned i = 0; i <= ApproximationChecks && valid; ++i) {
+                const double x = interval.begin + (interval.end - interval.begin) * i / ApproximationChecks;
+                const double approximated = EvalPolynomial(polynomial, (x - center) * inverseRadius);
+                const double exact = Eval(context, &x);
+                valid = context.evalErrorType == 0 && std::fabs(approximated - exact) <= 0.5 * maxAbsError;
+            }
+            valid = valid && ProveApproximation(context, polynomial, interval.begin, interval.end, maxAbsError,
+                                                budget);
+            if (budget == 0)
+                return false;
+        } else {
+            valid = false;
+        }
+
+        // Halving does not help where the function fails everywhere.
+        if (!valid && interval.depth < ApproximationMaxDepth && failures < ApproximationNodes) {
+            PendingInterval half = { center, interval.end, interval.depth + 1 };
+            pending.push_back(half);
+            half.begin = interval.begin;
+            half.end = center;
+            pending.push_back(half);
+            continue;
+        }
+
+        // Consecutive exact pieces are merged.
+        if (!valid && !approximation.pieces.empty() && approximation.pieces.back().exact)
+            continue;
+        Data::Approximation::Piece piece;
+        piece.center = center;
+        piece.inverseRadius = 1 / radius;
+        piece.exact = !valid;
+        approximation.pieces.push_back(piece);
+        approximation.breaks.push_back(interval.begin);
+        polynomials.push_back(valid ? polynomial : std::vector<double>());
+        if (valid && degree > approximation.degree)
+            approximation.degree = degree;
+    }
+    if (approximation.pieces.size() == 1 && approximation.pieces[0].exact)
+        return false;
+    approximation.breaks.push_back(maxValue);
+
+    // All the pieces get the same degree, so that the evaluation does not
+    // mispredict the length of the polynomial, and it is odd for the
+    // evaluation to pair the terms.
+    approximation.degree |= 1;
+    const unsigned stride = approximation.degree + 1;
+    approximation.coefficients.assign(approximation.pieces.size() * stride, 0.0);
+    for (unsigned index = 0; index < approximation.pieces.size(); ++index)
+        for (unsigned k = 0; k < polynomials[index].size(); ++k)
+            approximation.coefficients[index * stride + k] = polynomials[index][k];
+
+    // A power of two cells, about eight per piece:
+    size_t cellCount = 1;
+    while (cellCount < 8 * approximation.pieces.size() && cellCount < ApproximationMaxCells)
+        cellCount *= 2;
+    approximation.cellsPerUnit = cellCount / (maxValue - minValue);
+    approximation.cells.resize(cellCount);
+    // The first piece which may contain a cell is the first one ending in
+    // it or after it, computing the cells as the evaluation does.
+    unsigned cell = 0;
+    for (unsigned index = 0; index < approximation.pieces.size(); ++index) {
+        const double end = (approximation.breaks[index + 1] - minValue) * approximation.cellsPerUnit;
+        const unsigned endCell = index + 1 == approximation.pieces.size() || end >= cellCount - 1 ?
+                                     unsigned(cellCount - 1) : unsigned(end);
+        for (; cell <= endCell && cell < cellCount; ++cell)
+            approximation.cells[cell] = index;
+    }
+
+    data->approximation = approximation;
+    return true;
+}
+
+/* Proves that the polynomial of the piece [begin, end] is within
+   maxAbsError of the function at every point, as Eval() of the piece
+   computes it. The piece is cut into cells, and the error on each cell is
+   bounded in two ways, of which the smaller one is taken:
+   - the distance between the intervals of the function and of the
+     polynomial on the cell, which is coarse but needs no derivatives;
+   - the Taylor expansion of the error e = f - q around the middle m of the
+     cell, |e(x)| <= sum |e_j| h^j + max|f_n| h^n, where e_j = f_j - q_j
+     are the coefficients at m, f_n that of order n over the cell (q has a
+     lower degree), all from EvalIntervalTaylor(); it is tight where the
+     function is smooth.
+   The rounding errors of the polynomial and of t take a fixed part of the
+   allowed error (the intervals of the function already contain both its
+   exact value and that of Eval()). The cell with the largest bound is
+   halved until every cell is within the rest, which fails if the error at
+   the middle of a cell is already too large, if a cell cannot be halved
+   anymore (eg. at a jump of the function), or when the splits run out.
+*/
+template<>
+bool FunctionParser::ProveApproximation(EvalContext& context, const std::vector<double>& polynomial,
+                                        double begin, double end, double maxAbsError, size_t& budget) const {
+    // The same center and inverse radius as the piece stores:
+    const double center = 0.5 * (begin + end), inverseRadius = 1 / (0.5 * (end - begin));
+
+    // The evaluation of the pieces pairs the terms of a polynomial of the
+    // odd degree at most ApproximationMaxDegree + 1, and t is rounded by a
+    // few ulps, which moves the polynomial by at most its slope times that.
+    const double rounding = 4 * (ApproximationMaxDegree + 2) * DBL_EPSILON * CoefficientSum(polynomial, false) +
+                            4 * DBL_EPSILON * CoefficientSum(polynomial, true);
+    const double limit = maxAbsError - rounding * (1 + 1e-14);
+    if (!(limit > 0))
+        return false;
+
+    std::vector<ProofCell> fresh; // cells whose bound is not computed yet
+    std::priority_queue<ProofCell> open; // cells whose bound is too large
+    for (unsigned i = 0; i < ApproximationProofCells; ++i) {
+        const ProofCell cell = { Infinity, begin + (end - begin) * i / ApproximationProofCells,
+                                 i + 1 == ApproximationProofCells ?
+                                     end : begin + (end - begin) * (i + 1) / ApproximationProofCells };
+        fresh.push_back(cell);
+    }
+
+    Interval series[ApproximationTaylorTerms + 1], middleSeries[ApproximationTaylorTerms];
+    std::vector<double> shifted, shiftRounding;
+    for (unsigned splits = 0;; ++splits) {
+        while (!fresh.empty()) {
+            ProofCell cell = fresh.back();
+            fresh.pop_back();
+            const double a = cell.begin, b = cell.end, m = 0.5 * (a + b);
+            double t0 = (a - center) * inverseRadius, t1 = (b - center) * inverseRadius;
+            t0 -= 4 * DBL_EPSILON * std::max(1.0, std::fabs(t0));
+            t1 += 4 * DBL_EPSILON * std::max(1.0, std::fabs(t1));
+
+            double bound = Infinity;
+            if (EvalIntervalTaylor(context, Interval(a, b), ApproximationTaylorTerms + 1, series)) {
+                bound = Distance(series[0], PolynomialRange(polynomial, t0, t1, rounding));
+                if (EvalIntervalTaylor(context, Interval(m), ApproximationTaylorTerms, middleSeries)) {
+                    // The coefficients of q at m are those of the polynomial
+                    // at t(m), times inverseRadius^j.
+                    Shift(polynomial, (m - center) * inverseRadius, shifted, shiftRounding);
+                    const double h = std::max(m - a, b - m) * (1 + 4 * DBL_EPSILON);
+                    const Interval& last = series[ApproximationTaylorTerms];
+                    double taylor = 0, power = 1, scale = 1;
+                    for (unsigned j = 0; j < ApproximationTaylorTerms; ++j) {
+                        const double q = j < shifted.size() ? shifted[j] * scale : 0;
+                        const double qRounding =
+                            j < shifted.size() ? shiftRounding[j] * scale + 2 * (j + 1) * DBL_EPSILON * std::fabs(q) : 0;
+                        taylor += (Distance(middleSeries[j], Interval(q)) + qRounding) * power;
+                        power *= h;
+                        scale *= inverseRadius;
+                    }
+                    taylor += std::max(std::fabs(last.lower), std::fabs(last.upper)) * power;
+                    bound = std::min(bound, taylor);
+                }
+            } else {
+                const Interval x(a, b);
+                const Interval value = EvalInterval(context, &x);
+                if (context.evalErrorType == 0)
+                    bound = Distance(value, PolynomialRange(polynomial, t0, t1, rounding));
+            }
+            cell.bound = bound * (1 + 1e-14); // the rounding of the bound itself
+            if (!(cell.bound <= limit))
+                open.push(cell);
+        }
+        if (open.empty())
+            return true;
+        if (splits == ApproximationProofSplits || budget == 0)
+            return false;
+        --budget;
+
+        const ProofCell worst = open.top();
+        open.pop();
+        const double middle = 0.5 * (worst.begin + worst.end);
+        if (!(worst.begin < middle && middle < worst.end))
+            return false;
+        const double exact = Eval(context, &middle);
+        const double approximated = EvalPolynomial(polynomial, (middle - center) * inverseRadius);
+        if (context.evalErrorType != 0 || !(std::fabs(approximated - exact) <= 0.5 * maxAbsError))
+            return false;
+        const ProofCell lower = { Infinity, worst.begin, middle }, upper = { Infinity, middle, worst.end };
+        fresh.push_back(lower);
+        fresh.push_back(upper);
+    }
+}
@@ -0,0 +1,86 @@
+/***************************************************************************\
+|* Function Parser for C++ v3.3.2                                          *|
+|*-------------------------------------------------------------------------*|
+|* Copyright: Juha Nieminen                                                *|
+\***************************************************************************/
+
+#include "stdafx.h"
+#include "fpconfig.hh"
+#include "fparser.hh"
+
+//=========================================================================
+// FunctionBundle
+//=========================================================================
+/* The functions are parsed separately, and then Merge() (which needs the
+   optimizer) turns them into one bytecode, in which the subexpressions
+   occurring in several functions are computed once and then duplicated
+   where needed. The bytecode leaves the results in the stack, from where
+   Eval() picks them. If an error occurs, the functions are evaluated again
+   one by one, to find out which of them had the error (and the results of
+   the others).
+*/
+FunctionBundle::FunctionBundle() : merged(false) {}
+
+int FunctionBundle::Parse(const std::vector<std::string>& functions, const std::string& Vars,
+                          bool useDegrees) {
+    return Parse(functions, Vars, FunctionParser(), useDegrees);
+}
+
+int FunctionBundle::Parse(const std::vector<std::string>& functions, const std::string& Vars,
+                          const FunctionParser& definitions, bool useDegrees) {
+    parsers.assign(functions.size(), definitions);
+    errors.assign(functions.size(), 0);
+    outputs.clear();
+    merged = false;
+
+    for (unsigned i = 0; i < parsers.size(); ++i) {
+        if (parsers[i].Parse(functions[i], Vars, useDegrees) >= 0) {
+            combined = parsers[i];
+            parsers.clear();
+            errors.clear();
+            return int(i);
+        }
+    }
+
+    if (!parsers.empty()) {
+        combined = parsers[0];
+        merged = Merge();
+    }
+    return -1;
+}
+
+void FunctionBundle::EvalSeparately(const double* Vars, double* results) {
+    for (unsigned i = 0; i < parsers.size(); ++i) {
+        results[i] = parsers[i].Eval(context, Vars);
+        errors[i] = context.EvalError();
+    }
+}
+
+void FunctionBundle::Eval(const double* Vars, double* results) {
+    if (!merged) {
+        EvalSeparately(Vars, results);
+        return;
+    }
+
+    const FunctionParser::Data& data = *combined.data;
+    if (context.Stack.size() < data.StackSize)
+        context.Stack.resize(data.StackSize);
+    double* const Stack = &context.Stack[0];
+    combined.EvalByteCode<false>(context, Stack, Vars, false);
+    if (context.evalErrorType) {
+        EvalSeparately(Vars, results);
+        return;
+    }
+
+    for (unsigned i = 0; i < outputs.size(); ++i) {
+        results[i] = Stack[outputs[i]];
+        errors[i] = 0;
+    }
+}
+
+#ifndef FP_SUPPORT_OPTIMIZER
+bool FunctionBundle::Merge() {
+    // The functions are evaluated separately without the optimizer.
+    return false;
+}
+#endif
@@ -0,0 +1,379 @@
+/***************************************************************************\
+|* Function Parser for C++ v3.3.2                                          *|
+|*-------------------------------------------------------------------------*|
+|* Copyright: Juha Nieminen                                                *|
+\***************************************************************************/
+
+#include "stdafx.h"
+#include "fpconfig.hh"
+#include "fparser.hh"
+#include "fpaux.hh"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <vector>
+
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(__CYGWIN__)
+#define FP_SUPPORT_DLOPEN
+#include <dlfcn.h>
+#include <unistd.h>
+#endif
+
+using namespace FUNCTIONPARSERTYPES;
+
+//=========================================================================
+// Export as C source code
+//=========================================================================
+/* ExportC() translates the bytecode into a C function. Each stack slot
+   becomes a local variable s<n>, so the values the optimizer reuses with
+   cDup and cFetch (the common subexpressions) are computed once and then
+   read from their variable. if() becomes a conditional goto.
+   Every operation is written exactly like Eval() performs it, but without
+   the evaluation checks, so where Eval() reports no error the results are
+   identical (as long as the C compiler is not allowed to contract
+   multiplications and additions into fused multiply-adds).
+   User-defined functions, other parsers and eval() cannot be exported.
+*/
+namespace {
+// The same helpers as in fpaux.hh and fparser.hh, guarded so that several
+// exported functions can be put in the same file.
+const char* const exportedHelpers =
+    "#include <math.h>\n"
+    "#include <stddef.h>\n"
+    "\n"
+    "#ifndef FPARSER_EXPORTED_HELPERS\n"
+    "#define FPARSER_EXPORTED_HELPERS\n"
+    "static inline int fp_truth(double d) { return d < 0 ? -(int)((-d) + .5) : (int)(d + .5); }\n"
+#ifndef FP_SUPPORT_ASINH
+    "static inline double fp_asinh(double x) { return log(x + sqrt(x * x + 1)); }\n"
+    "static inline double fp_acosh(double x) { return log(x + sqrt(x * x - 1)); }\n"
+    "static inline double fp_atanh(double x) { return log((1 + x) / (1 - x)) * 0.5; }\n"
+#else
+    "static inline double fp_asinh(double x) { return asinh(x); }\n"
+    "static inline double fp_acosh(double x) { return acosh(x); }\n"
+    "static inline double fp_atanh(double x) { return atanh(x); }\n"
+#endif
+    "#endif\n";
+
+std::string Literal(double value) {
+    if (value != value)
+        return "NAN";
+    if (value > 0 && value * 0.5 == value)
+        return "HUGE_VAL";
+    if (value < 0 && value * 0.5 == value)
+        return "(-HUGE_VAL)";
+
+    std::ostringstream result;
+    result.precision(17);
+    result << value;
+    std::string text = result.str();
+    if (text.find_first_of(".e") == std::string::npos)
+        text += ".0";
+    return value < 0 ? "(" + text + ")" : text;
+}
+
+std::string Slot(int slot) {
+    std::ostringstream name;
+    name << 's' << slot;
+    return name.str();
+}
+} // namespace
+
+template<>
+bool FunctionParser::ExportC(std::string& code, const std::string& functionName) const {
+    if (parseErrorType != FP_NO_ERROR)
+        return false;
+
+    const std::vector<unsigned>& ByteCode = data->ByteCode;
+    const unsigned ByteCodeSize = unsigned(ByteCode.size());
+
+    // Stack pointer and immediate index at the jump targets:
+    std::vector<int> targetSP(ByteCodeSize + 1, -2);
+    std::vector<unsigned> targetDP(ByteCodeSize + 1, 0);
+
+    std::ostringstream body;
+    unsigned IP, DP = 0;
+    int SP = -1;
+    bool reachable = true;
+
+    for (IP = 0; IP <= ByteCodeSize; ++IP) {
+        if (targetSP[IP] != -2) {
+            // After an unconditional jump the state comes from the jumps here.
+            if (!reachable) {
+                SP = targetSP[IP];
+                DP = targetDP[IP];
+            }
+            reachable = true;
+            body << "L" << IP << ":\n";
+        }
+        if (IP == ByteCodeSize)
+            break;
+
+        const std::string x = SP >= 0 ? Slot(SP) : std::string();
+        const std::string y = SP >= 1 ? Slot(SP - 1) : std::string();
+
+        body << "    ";
+        switch (ByteCode[IP]) {
+            // Functions:
+        case cAbs: body << x << " = fabs(" << x << ");\n"; break;
+        case cAcos: body << x << " = acos(" << x << ");\n"; break;
+        case cAcosh: body << x << " = fp_acosh(" << x << ");\n"; break;
+        case cAsin: body << x << " = asin(" << x << ");\n"; break;
+        case cAsinh: body << x << " = fp_asinh(" << x << ");\n"; break;
+        case cAtan: body << x << " = atan(" << x << ");\n"; break;
+        case cAtan2: body << y << " = atan2(" << y << ", " << x << ");\n"; --SP; break;
+        case cAtanh: body << x << " = fp_atanh(" << x << ");\n"; break;
+        case cCeil: body << x << " = ceil(" << x << ");\n"; break;
+        case cCos: body << x << " = cos(" << x << ");\n"; break;
+        case cCosh: body << x << " = cosh(" << x << ");\n"; break;
+        case cCot: body << x << " = 1 / tan(" << x << ");\n"; break;
+        case cCsc: body << x << " = 1 / sin(" << x << ");\n"; break;
+        case cExp: body << x << " = exp(" << x << ");\n"; break;
+        case cExp2: body << x << " = pow(2.0, " << x << ");\n"; break;
+        case cFloor: body << x << " = floor(" << x << ");\n"; break;
+
+        case cIf: {
+            const unsigned jumpAddr = ByteCode[++IP];
+            const unsigned immedAddr = ByteCode[++IP];
+            body << "if (fp_truth(" << x << ") == 0) goto L" << jumpAddr + 1 << ";\n";
+            --SP;
+            targetSP[jumpAddr + 1] = SP;
+            targetDP[jumpAddr + 1] = immedAddr;
+            break;
+        }
+
+        case cInt: body << x << " = floor(" << x << " + .5);\n"; break;
+        case cLog: body << x << " = log(" << x << ");\n"; break;
+        case cLog10: body << x << " = log10(" << x << ");\n"; break;
+#ifdef FP_SUPPORT_LOG2
+        case cLog2: body << x << " = log2(" << x << ");\n"; break;
+#else
+        case cLog2: body << x << " = log(" << x << ") * 1.4426950408889634074;\n"; break;
+#endif
+        case cMax: body << y << " = " << y << " > " << x << " ? " << y << " : " << x << ";\n"; --SP; break;
+        case cMin: body << y << " = " << y << " < " << x << " ? " << y << " : " << x << ";\n"; --SP; break;
+        case cPow: body << y << " = pow(" << y << ", " << x << ");\n"; --SP; break;
+        case cRPow: body << y << " = pow(" << x << ", " << y << ");\n"; --SP; break;
+        case cSec: body << x << " = 1 / cos(" << x << ");\n"; break;
+        case cSin: body << x << " = sin(" << x << ");\n"; break;
+        case cSinh: body << x << " = sinh(" << x << ");\n"; break;
+        case cSqrt: body << x << " = sqrt(" << x << ");\n"; break;
+        case cTan: body << x << " = tan(" << x << ");\n"; break;
+        case cTanh: body << x << " = tanh(" << x << ");\n"; break;
+
+            // Misc:
+        case cImmed:
+            body << Slot(++SP) << " = " << Literal(data->Immed[DP++]) << ";\n";
+            break;
+
+        case cJump:
+            targetSP[ByteCode[IP + 1] + 1] = SP;
+            targetDP[ByteCode[IP + 1] + 1] = ByteCode[IP + 2];
+            body << "goto L" << ByteCode[IP + 1] + 1 << ";\n";
+            IP += 2;
+            reachable = false;
+            break;
+
+            // Operators:
+        case cNeg: body << x << " = -" << x << ";\n"; break;
+        case cAdd: body << y << " += " << x << ";\n"; --SP; break;
+        case cSub: body << y << " -= " << x << ";\n"; --SP; break;
+        case cMul: body << y << " *= " << x << ";\n"; --SP; break;
+        case cDiv: body << y << " /= " << x << ";\n"; --SP; break;
+        case cMod: body << y << " = fmod(" << y << ", " << x << ");\n"; --SP; break;
+
+#ifdef FP_EPSILON
+        case cEqual:
+            body << y << " = (fabs(" << y << " - " << x << ") <= " << Literal(FP_EPSILON) << ");\n";
+            --SP;
+            break;
+        case cNEqual:
+            body << y << " = (fabs(" << y << " - " << x << ") >= " << Literal(FP_EPSILON) << ");\n";
+            --SP;
+            break;
+        case cLess:
+            body << y << " = (" << y << " < " << x << " - " << Literal(FP_EPSILON) << ");\n";
+            --SP;
+            break;
+        case cLessOrEq:
+            body << y << " = (" << y << " <= " << x << " + " << Literal(FP_EPSILON) << ");\n";
+            --SP;
+            break;
+        case cGreater:
+            body << y << " = (" << y << " - " << Literal(FP_EPSILON) << " > " << x << ");\n";
+            --SP;
+            break;
+        case cGreaterOrEq:
+            body << y << " = (" << y << " + " << Literal(FP_EPSILON) << " >= " << x << ");\n";
+            --SP;
+            break;
+#else
+        case cEqual: body << y << " = (" << y << " == " << x << ");\n"; --SP; break;
+        case cNEqual: body << y << " = (" << y << " != " << x << ");\n"; --SP; break;
+        case cLess: body << y << " = (" << y << " < " << x << ");\n"; --SP; break;
+        case cLessOrEq: body << y << " = (" << y << " <= " << x << ");\n"; --SP; break;
+        case cGreater: body << y << " = (" << y << " > " << x << ");\n"; --SP; break;
+        case cGreaterOrEq: body << y << " = (" << y << " >= " << x << ");\n"; --SP; break;
+#endif
+
+        case cNot: body << x << " = !fp_truth(" << x << ");\n"; break;
+        case cAnd:
+            body << y << " = (fp_truth(" << y << ") && fp_truth(" << x << "));\n";
+            --SP;
+            break;
+        case cOr:
+            body << y << " = (fp_truth(" << y << ") || fp_truth(" << x << "));\n";
+            --SP;
+            break;
+        case cNotNot: body << x << " = !!fp_truth(" << x << ");\n"; break;
+
+            // Degrees-radians conversion:
+        case cDeg: body << x << " = " << x << " * " << Literal(180.0 / M_PI) << ";\n"; break;
+        case cRad: body << x << " = " << x << " * " << Literal(M_PI / 180.0) << ";\n"; break;
+
+#ifdef FP_SUPPORT_OPTIMIZER
+        case cVar: body << ";\n"; break; // Paranoia. These should never exist
+
+        case cFetch:
+            body << Slot(SP + 1) << " = " << Slot(ByteCode[++IP]) << ";\n";
+            ++SP;
+            break;
+
+        case cPopNMov: {
+            const unsigned target = ByteCode[++IP];
+            const unsigned source = ByteCode[++IP];
+            body << Slot(target) << " = " << Slot(source) << ";\n";
+            SP = int(target);
+            break;
+        }
+
+        case cSelect:
+            body << Slot(SP - 2) << " = fp_truth(" << Slot(SP - 2) << ") ? " << y << " : " << x << ";\n";
+            SP -= 2;
+            break;
+#endif // FP_SUPPORT_OPTIMIZER
+
+        case cDup: body << Slot(SP + 1) << " = " << x << ";\n"; ++SP; break;
+        case cInv: body << x << " = 1.0 / " << x << ";\n"; break;
+        case cSqr: body << x << " = " << x << " * " << x << ";\n"; break;
+        case cRDiv: body << y << " = " << x << " / " << y << ";\n"; --SP; break;
+        case cRSub: body << y << " = " << x << " - " << y << ";\n"; --SP; break;
+        case cRSqrt: body << x << " = 1.0 / sqrt(" << x << ");\n"; break;
+        case cNop: body << ";\n"; break;
+
+        case cFCall:
+        case cPCall:
+#ifndef FP_DISABLE_EVAL
+        case cEval:
+#endif
+            return false;
+
+            // Variables:
+        default:
+            body << Slot(++SP) << " = vars[" << ByteCode[IP] - VarBegin << "];\n";
+            break;
+        }
+    }
+
+    std::ostringstream result;
+    result << exportedHelpers << "\n";
+    result << "/* Variables: " << data->variablesString << " */\n";
+    result << "static inline double " << functionName << "_eval(const double* vars)\n{\n";
+    if (data->StackSize) {
+        result << "    double s0";
+        for (unsigned i = 1; i < data->StackSize; ++i)
+            result << ", " << Slot(int(i));
+        result << ";\n";
+    }
+    result << body.str();
+    result << "    return " << Slot(SP) << ";\n}\n\n";
+
+    result << "#ifdef __cplusplus\nextern \"C\" {\n#endif\n";
+    result << "double " << functionName << "(const double* vars)\n{\n"
+           << "    return " << functionName << "_eval(vars);\n}\n\n";
+    result << "void " << functionName
+           << "_many(const double* vars, size_t rowCount, size_t rowStride, double* results)\n{\n"
+           << "    size_t i;\n"
+           << "    for (i = 0; i < rowCount; ++i)\n"
+           << "        results[i] = " << functionName << "_eval(vars + i * rowStride);\n}\n";
+    result << "#ifdef __cplusplus\n}\n#endif\n";
+
+    code = result.str();
+    return true;
+}
+
+//=========================================================================
+// Building and loading the exported code
+//=========================================================================
+template<>
+FunctionParser::CFunction::CFunction()
+    : handle(0), function(0), manyFunction(0) {
+}
+
+template<>
+FunctionParser::CFunction::~CFunction() {
+    Unload();
+}
+
+template<>
+void FunctionParser::CFunction::Unload() {
+#ifdef FP_SUPPORT_DLOPEN
+    if (handle)
+        dlclose(handle);
+#endif
+    handle = 0;
+    function = 0;
+    manyFunction = 0;
+}
+
+/* The source is written to a fresh temporary directory, compiled into a
+   shared library there and loaded. The files are removed right away; the
+   loaded library stays mapped until the CFunction unloads it.
+*/
+template<>
+bool FunctionParser::CompileC(CFunction& result, const std::string& compiler) const {
+    result.Unload();
+
+#ifdef FP_SUPPORT_DLOPEN
+    std::string code;
+    if (!ExportC(code, "fparser_function"))
+        return false;
+
+    const char* const tmpdir = std::getenv("TMPDIR");
+    std::string directory = std::string(tmpdir && *tmpdir ? tmpdir : "/tmp") + "/fparserXXXXXX";
+    if (!mkdtemp(&directory[0]))
+        return false;
+    const std::string source = directory + "/function.c";
+    const std::string library = directory + "/function.so";
+
+    void* handle = 0;
+    if (FILE* file = std::fopen(source.c_str(), "w")) {
+        const bool written = std::fwrite(code.data(), 1, code.size(), file) == code.size();
+        if (std::fclose(file) == 0 && written) {
+            const std::string command = compiler + " -shared -fPIC -o '" + library +
+                                        "' '" + source + "' -lm";
+            if (std::system(command.c_str()) == 0)
+                handle = dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+        }
+    }
+    std::remove(source.c_str());
+    std::remove(library.c_str());
+    rmdir(directory.c_str());
+    if (!handle)
+        return false;
+
+    result.handle = handle;
+    result.function = reinterpret_cast<CFunction::Function>(dlsym(handle, "fparser_function"));
+    result.manyFunction = reinterpret_cast<CFunction::ManyFunction>(dlsym(handle, "fparser_function_many"));
+    if (!result.function || !result.manyFunction) {
+        result.Unload();
+        return false;
+    }
+    return true;
+#else
+    (void)compiler;
+    return false;
+#endif
+}
@@ -0,0 +1,330 @@
+/***************************************************************************\
+|* Function Parser for C++ v3.3.2                                          *|
+|*-------------------------------------------------------------------------*|
+|* Copyright: Juha Nieminen                                                *|
+\***************************************************************************/
+
+#include "stdafx.h"
+#include "fpconfig.hh"
+#include "fparser.hh"
+
+#include <algorithm>
+#include <functional>
+#include <cmath>
+#include <ctime>
+#include <vector>
+
+#ifdef FP_USE_POSIX_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+//=========================================================================
+// ExpressionSet
+//=========================================================================
+/* The parsers are evaluated in units: copies of one parser share their
+   data, so they are evaluated only once and the result is copied to all of
+   them. The units are ordered by their variables (so that the functions of
+   the same variables, which typically come from the same source, are
+   evaluated one after the other) and then by decreasing cost, and cut into
+   chunks of roughly equal estimated cost. On each Eval() the threads of the
+   pool take the chunks one at a time, so the expensive chunks, which come
+   first, are spread over the threads and the cheap ones fill the gaps at
+   the end. Each thread uses its own EvalContext for all its evaluations,
+   which keeps its stack in the cache.
+*/
+namespace {
+const unsigned ExpressionSetMaxChunkCost = 4096; // in EstimatedEvalCost() units
+const unsigned ExpressionSetChunksPerThread = 8;
+const unsigned LatencyBuckets = 40;
+
+struct UnitOrder {
+    const std::vector<const std::string*>& variables;
+    const std::vector<unsigned>& costs;
+    const std::vector<const void*>& datas;
+
+    UnitOrder(const std::vector<const std::string*>& v, const std::vector<unsigned>& c,
+              const std::vector<const void*>& d) : variables(v), costs(c), datas(d) {}
+
+    bool operator()(unsigned a, unsigned b) const {
+        if (*variables[a] != *variables[b])
+            return *variables[a] < *variables[b];
+        if (costs[a] != costs[b])
+            return costs[a] > costs[b];
+        if (datas[a] != datas[b])
+            return std::less<const void*>()(datas[a], datas[b]);
+        return a < b;
+    }
+};
+
+double CurrentSeconds() {
+#ifdef FP_USE_POSIX_THREADS
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return double(now.tv_sec) + double(now.tv_nsec) * 1e-9;
+#else
+    return double(std::clock()) / CLOCKS_PER_SEC;
+#endif
+}
+
+unsigned DefaultThreadCount() {
+#ifdef FP_USE_POSIX_THREADS
+    const long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    return processors > 0 ? unsigned(processors) : 1;
+#else
+    return 1;
+#endif
+}
+} // namespace
+
+struct ExpressionSet::Pool {
+    struct Worker {
+        Pool* pool;
+        FunctionParser::EvalContext context;
+#ifdef FP_USE_POSIX_THREADS
+        pthread_t thread;
+        bool started;
+#endif
+    };
+
+    ExpressionSet* set;
+    std::vector<Worker> workers; // the first one is the calling thread
+
+#ifdef FP_USE_POSIX_THREADS
+    pthread_mutex_t lock;
+    pthread_cond_t start, done;
+    unsigned long generation;
+    bool stopping;
+    unsigned nextChunk, busyThreads;
+    const double* Vars;
+    double* results;
+
+    bool TakeChunk(unsigned& chunk) {
+        pthread_mutex_lock(&lock);
+        const bool taken = nextChunk + 1 < set->chunkBegins.size();
+        if (taken)
+            chunk = nextChunk++;
+        pthread_mutex_unlock(&lock);
+        return taken;
+    }
+
+    void EvalChunks(Worker& worker) {
+        unsigned chunk;
+        while (TakeChunk(chunk))
+            set->EvalChunk(chunk, worker.context, Vars, results);
+    }
+
+    static void* Run(void* argument) {
+        Worker& worker = *static_cast<Worker*>(argument);
+        Pool& pool = *worker.pool;
+        unsigned long seen = 0;
+        pthread_mutex_lock(&pool.lock);
+        for (;;) {
+            while (pool.generation == seen && !pool.stopping)
+                pthread_cond_wait(&pool.start, &pool.lock);
+            if (pool.stopping)
+                break;
+            seen = pool.generation;
+            pthread_mutex_unlock(&pool.lock);
+
+            pool.EvalChunks(worker);
+
+            pthread_mutex_lock(&pool.lock);
+            if (--pool.busyThreads == 0)
+                pthread_cond_signal(&pool.done);
+        }
+        pthread_mutex_unlock(&pool.lock);
+        return 0;
+    }
+#endif
+};
+
+ExpressionSet::ExpressionSet(unsigned threads)
+    : prepared(false),
+      threadCount(threads ? threads : DefaultThreadCount()),
+      pool(0) {
+    ResetLatencyStatistics();
+}
+
+ExpressionSet::~ExpressionSet() {
+    if (!pool)
+        return;
+#ifdef FP_USE_POSIX_THREADS
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    for (unsigned t = 1; t < pool->workers.size(); ++t)
+        if (pool->workers[t].started)
+            pthread_join(pool->workers[t].thread, 0);
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->lock);
+#endif
+    delete pool;
+}
+
+unsigned ExpressionSet::Add(const FunctionParser& parser) {
+    parsers.push_back(parser);
+    errors.push_back(0);
+    prepared = false;
+    return unsigned(parsers.size() - 1);
+}
+
+void ExpressionSet::Clear() {
+    parsers.clear();
+    errors.clear();
+    prepared = false;
+}
+
+void ExpressionSet::Prepare() {
+    const unsigned count = unsigned(parsers.size());
+    std::vector<const std::string*> variables(count);
+    std::vector<unsigned> costs(count);
+    std::vector<const void*> datas(count);
+    members.resize(count);
+    for (unsigned i = 0; i < count; ++i) {
+        variables[i] = &parsers[i].data->variablesString;
+        costs[i] = parsers[i].EstimatedEvalCost();
+        datas[i] = parsers[i].data;
+        members[i] = i;
+    }
+    std::sort(members.begin(), members.end(), UnitOrder(variables, costs, datas));
+
+    unitBegins.clear();
+    unsigned long totalCost = 0;
+    for (unsigned m = 0; m < count; ++m) {
+        if (m == 0 || datas[members[m]] != datas[members[m - 1]]) {
+            unitBegins.push_back(m);
+            totalCost += costs[members[m]];
+        }
+    }
+    const unsigned unitCount = unsigned(unitBegins.size());
+    unitBegins.push_back(count);
+
+    unsigned long chunkCost = totalCost / (threadCount * ExpressionSetChunksPerThread);
+    if (chunkCost > ExpressionSetMaxChunkCost)
+        chunkCost = ExpressionSetMaxChunkCost;
+    chunkBegins.clear();
+    unsigned long cost = chunkCost;
+    for (unsigned u = 0; u < unitCount; ++u) {
+        if (cost >= chunkCost) {
+            chunkBegins.push_back(u);
+            cost = 0;
+        }
+        cost += costs[members[unitBegins[u]]];
+    }
+    chunkBegins.push_back(unitCount);
+    prepared = true;
+}
+
+void ExpressionSet::EvalChunk(unsigned chunk, FunctionParser::EvalContext& context,
+                              const double* Vars, double* results) {
+    for (unsigned u = chunkBegins[chunk]; u < chunkBegins[chunk + 1]; ++u) {
+        const FunctionParser& parser = parsers[members[unitBegins[u]]];
+        double result = 0;
+        int error = 0;
+        if (parser.parseErrorType == FunctionParser::FP_NO_ERROR) {
+            result = parser.Eval(context, Vars);
+            error = context.EvalError();
+        }
+        for (unsigned m = unitBegins[u]; m < unitBegins[u + 1]; ++m) {
+            results[members[m]] = result;
+            errors[members[m]] = error;
+        }
+    }
+}
+
+void ExpressionSet::Eval(const double* Vars, double* results) {
+    const double startTime = CurrentSeconds();
+
+    if (!prepared)
+        Prepare();
+    if (!pool) {
+        pool = new Pool;
+        pool->set = this;
+        pool->workers.resize(threadCount);
+        pool->workers[0].pool = pool;
+#ifdef FP_USE_POSIX_THREADS
+        pthread_mutex_init(&pool->lock, 0);
+        pthread_cond_init(&pool->start, 0);
+        pthread_cond_init(&pool->done, 0);
+        pool->generation = 0;
+        pool->stopping = false;
+        pool->nextChunk = 0;
+        pool->busyThreads = 0;
+        pool->workers[0].started = false;
+        for (unsigned t = 1; t < threadCount; ++t) {
+            Pool::Worker& worker = pool->workers[t];
+            worker.pool = pool;
+            worker.started = pthread_create(&worker.thread, 0, &Pool::Run, &worker) == 0;
+        }
+#endif
+    }
+
+    const unsigned chunkCount = unsigned(chunkBegins.size() - 1);
+#ifdef FP_USE_POSIX_THREADS
+    if (threadCount > 1 && chunkCount > 1) {
+        pthread_mutex_lock(&pool->lock);
+        pool->Vars = Vars;
+        pool->results = results;
+        pool->nextChunk = 0;
+        pool->busyThreads = 0;
+        for (unsigned t = 1; t < threadCount; ++t)
+            pool->busyThreads += pool->workers[t].started;
+        ++pool->generation;
+        pthread_cond_broadcast(&pool->start);
+        pthread_mutex_unlock(&pool->lock);
+
+        pool->EvalChunks(pool->workers[0]);
+
+        pthread_mutex_lock(&pool->lock);
+        while (pool->busyThreads > 0)
+            pthread_cond_wait(&pool->done, &pool->lock);
+        pthread_mutex_unlock(&pool->lock);
+    } else
+#endif
+    {
+        for (unsigned chunk = 0; chunk < chunkCount; ++chunk)
+            EvalChunk(chunk, pool->workers[0].context, Vars, results);
+    }
+
+    const double seconds = CurrentSeconds() - startTime;
+    if (statistics.ticks == 0 || seconds < statistics.minSeconds)
+        statistics.minSeconds = seconds;
+    if (seconds > statistics.maxSeconds)
+        statistics.maxSeconds = seconds;
+    statistics.lastSeconds = seconds;
+    statistics.totalSeconds += seconds;
+    ++statistics.ticks;
+    unsigned bucket = 0;
+    for (double limit = 2e-9; seconds >= limit && bucket + 1 < LatencyBuckets; limit *= 2)
+        ++bucket;
+    ++statistics.histogram[bucket];
+}
+
+void ExpressionSet::ResetLatencyStatistics() {
+    statistics.ticks = 0;
+    statistics.lastSeconds = statistics.minSeconds = 0;
+    statistics.maxSeconds = statistics.totalSeconds = 0;
+    for (unsigned i = 0; i < LatencyBuckets; ++i)
+        statistics.histogram[i] = 0;
+}
+
+double ExpressionSet::LatencyStatistics::MeanSeconds() const {
+    return ticks ? totalSeconds / double(ticks) : 0;
+}
+
+double ExpressionSet::LatencyStatistics::PercentileSeconds(double percent) const {
+    if (ticks == 0)
+        return 0;
+    const double wanted = double(ticks) * percent / 100;
+    unsigned long count = 0;
+    double limit = 2e-9;
+    for (unsigned i = 0; i + 1 < LatencyBuckets; ++i, limit *= 2) {
+        count += histogram[i];
+        if (double(count) >= wanted)
+            return limit < maxSeconds ? limit : maxSeconds;
+    }
+    return maxSeconds;
+}
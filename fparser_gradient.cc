@@ -0,0 +1,793 @@
+/***************************************************************************\
+|* Function Parser for C++ v3.3.2                                          *|
+|*-------------------------------------------------------------------------*|
+|* Copyright: Juha Nieminen                                                *|
+\***************************************************************************/
+
+#include "stdafx.h"
+#include "fpconfig.hh"
+#include "fparser.hh"
+#include "fpaux.hh"
+
+#include <cmath>
+#include <vector>
+
+using namespace FUNCTIONPARSERTYPES;
+
+//=========================================================================
+// Evaluation with the gradient
+//=========================================================================
+/* EvalWithGradient() is automatic differentiation: the bytecode is run as
+   by Eval(), and each instruction also applies the chain rule with the
+   partial derivatives by its operands. The values are computed exactly as
+   in Eval(), and so are the evaluation errors. The interpreter is the same
+   for the two modes below; it only tells them which stack slots are
+   combined, with which derivatives:
+
+   - Forward mode (Tangents): each stack slot has a tangent, which holds
+     the partial derivatives of its value by each of the variables. Every
+     instruction costs one loop over the variables, so this is for
+     functions of a few variables.
+   - Reverse mode (Tape): each stack slot has the node of the tape which
+     computed it, and every instruction which is not constant records a new
+     node with its operand nodes and the partial derivatives by them. After
+     the evaluation, a backward sweep over the tape accumulates the
+     adjoints (the derivatives of the result by each node) down to the
+     variables, so the whole gradient costs a few evaluations regardless of
+     the number of variables. The tape is kept in the context, and reused
+     without allocating by the next evaluation.
+
+   Functions added with AddFunction() get their partial derivatives from
+   their derivative function if they have one, or else from central
+   differences. Nested parsers and eval() are differentiated recursively.
+*/
+namespace {
+const double DifferenceStep = 6.0554544523933395e-6; // cbrt(DBL_EPSILON), relative
+
+// From this many variables on, reverse mode is faster.
+const unsigned ReverseModeVariables = 4;
+
+// A term of the chain rule. It is 0 wherever the tangent is 0, even if the
+// derivative is infinite (eg. that of sqrt(x) at 0, for the tangent of
+// another variable).
+inline double Product(double derivative, double tangent) { return tangent == 0 ? 0 : derivative * tangent; }
+
+inline void Zero(double* values, unsigned n) {
+    for (unsigned k = 0; k < n; ++k)
+        values[k] = 0;
+}
+
+// The result of an evaluation error.
+inline double Fail(double* gradient, unsigned n) {
+    Zero(gradient, n);
+    return 0;
+}
+
+// Central differences, when a function pointer has no derivative function.
+void Differences(FunctionParser::FunctionPtr function, const double* params, unsigned paramsAmount,
+                 double* derivatives) {
+    std::vector<double> shifted(params, params + paramsAmount);
+    for (unsigned j = 0; j < paramsAmount; ++j) {
+        const double h = DifferenceStep * Max(fabs(params[j]), 1.0);
+        shifted[j] = params[j] + h;
+        const double upper = function(&shifted[0]), upperParam = shifted[j];
+        shifted[j] = params[j] - h;
+        const double lower = function(&shifted[0]);
+        derivatives[j] = (upper - lower) / (upperParam - shifted[j]);
+        shifted[j] = params[j];
+    }
+}
+
+/* The operations of both modes, by stack slots:
+   Constant(slot), Variable(slot, index): the slot was set to a constant
+     (or a value whose derivatives are 0), or to a variable.
+   Copy(to, from): the value of a slot was copied to another.
+   Scale(slot, d): the slot was set to a function of its value, whose
+     derivative is d.
+   Combine(a, da, b, db): slot a was set to a function of the values of
+     slots a and b, whose partial derivatives are da and db.
+   Call(params): returns where a function call writes its partial
+     derivatives, before Return(first, params), when slot first was set to
+     the result of the call of the slots first...first+params-1.
+   Gradient(slot, gradient): writes the gradient of the slot.
+*/
+class Tangents {
+public:
+    // The tangents come after the values in the stack, and scratch holds
+    // the partial derivatives of the calls.
+    Tangents(double* tangents, unsigned n, std::vector<double>& scratch)
+        : tangents(tangents), n(n), scratch(scratch) {}
+
+    void Constant(int slot) { Zero(At(slot), n); }
+
+    void Variable(int slot, unsigned index) {
+        Zero(At(slot), n);
+        At(slot)[index] = 1;
+    }
+
+    void Copy(int to, int from) {
+        const double* const source = At(from);
+        double* const target = At(to);
+        for (unsigned k = 0; k < n; ++k)
+            target[k] = source[k];
+    }
+
+    void Scale(int slot, double derivative) {
+        double* const tangent = At(slot);
+        for (unsigned k = 0; k < n; ++k)
+            tangent[k] = Product(derivative, tangent[k]);
+    }
+
+    void Combine(int a, double da, int b, double db) {
+        double* const ta = At(a);
+        const double* const tb = At(b);
+        for (unsigned k = 0; k < n; ++k)
+            ta[k] = Product(da, ta[k]) + Product(db, tb[k]);
+    }
+
+    double* Call(unsigned params) {
+        if (scratch.size() < params + n)
+            scratch.resize(params + n);
+        return &scratch[0];
+    }
+
+    void Return(int first, unsigned params) {
+        if (!params) {
+            Constant(first);
+            return;
+        }
+        double* const sum = &scratch[params];
+        Zero(sum, n);
+        for (unsigned j = 0; j < params; ++j) {
+            const double* const tangent = At(first + j);
+            for (unsigned k = 0; k < n; ++k)
+                sum[k] += Product(scratch[j], tangent[k]);
+        }
+        double* const result = At(first);
+        for (unsigned k = 0; k < n; ++k)
+            result[k] = sum[k];
+    }
+
+    void Gradient(int slot, double* gradient) {
+        const double* const tangent = At(slot);
+        for (unsigned k = 0; k < n; ++k)
+            gradient[k] = tangent[k];
+    }
+
+private:
+    double* At(int slot) { return tangents + slot * n; }
+
+    double* const tangents;
+    const unsigned n;
+    std::vector<double>& scratch;
+};
+
+class Tape {
+public:
+    // The nodes 0...n-1 are the variables, and node n stands for all the
+    // constants. The operands of node i are operands[ends[i-1]...ends[i]-1].
+    // Since the bytecode only jumps forwards, each instruction is run at
+    // most once, and adds at most one node and two operands (besides the
+    // calls), so the buffers are sized once and then written without
+    // checks.
+    Tape(unsigned n, unsigned stackSize, unsigned codeSize, std::vector<unsigned>& slots,
+         std::vector<unsigned>& ends, std::vector<unsigned>& operands, std::vector<double>& partials,
+         std::vector<double>& adjoints)
+        : n(n), codeSize(codeSize), nodes(n + 1), edges(0),
+          slots(slots), ends(ends), operands(operands), partials(partials), adjoints(adjoints) {
+        if (slots.size() < stackSize)
+            slots.resize(stackSize);
+        if (ends.size() < nodes + codeSize)
+            ends.resize(nodes + codeSize);
+        for (unsigned node = 0; node < nodes; ++node)
+            ends[node] = 0;
+        Reserve(0);
+    }
+
+    void Constant(int slot) { slots[slot] = n; }
+    void Variable(int slot, unsigned index) { slots[slot] = index; }
+    void Copy(int to, int from) { slots[to] = slots[from]; }
+
+    void Scale(int slot, double derivative) {
+        if (slots[slot] == n)
+            return;
+        Operand(slots[slot], derivative);
+        slots[slot] = Node();
+    }
+
+    void Combine(int a, double da, int b, double db) {
+        const unsigned nodeA = slots[a], nodeB = slots[b];
+        if (nodeA != n)
+            Operand(nodeA, da);
+        if (nodeB != n)
+            Operand(nodeB, db);
+        if (nodeA != n || nodeB != n)
+            slots[a] = Node();
+    }
+
+    double* Call(unsigned params) {
+        Reserve(params);
+        return &partials[edges];
+    }
+
+    void Return(int first, unsigned params) {
+        if (!params) {
+            Constant(first);
+            return;
+        }
+        for (unsigned j = 0; j < params; ++j)
+            operands[edges++] = slots[first + j];
+        slots[first] = Node();
+    }
+
+    void Gradient(int slot, double* gradient) {
+        if (adjoints.size() < nodes)
+            adjoints.resize(nodes);
+        for (unsigned node = 0; node < nodes; ++node)
+            adjoints[node] = 0;
+        adjoints[slots[slot]] = 1;
+        for (unsigned node = nodes - 1; node > n; --node) {
+            const double adjoint = adjoints[node];
+            if (adjoint == 0)
+                continue;
+            for (unsigned i = ends[node - 1]; i < ends[node]; ++i)
+                adjoints[operands[i]] += partials[i] * adjoint;
+        }
+        for (unsigned k = 0; k < n; ++k)
+            gradient[k] = adjoints[k];
+    }
+
+private:
+    // Makes room for the operands of a call and of the rest of the code.
+    void Reserve(unsigned params) {
+        const size_t size = edges + params + 2 * size_t(codeSize);
+        if (partials.size() < size) {
+            operands.resize(size);
+            partials.resize(size);
+        }
+    }
+
+    void Operand(unsigned node, double partial) {
+        operands[edges] = node;
+        partials[edges] = partial;
+        ++edges;
+    }
+
+    unsigned Node() {
+        ends[nodes] = edges;
+        return nodes++;
+    }
+
+    const unsigned n, codeSize;
+    unsigned nodes, edges;
+    std::vector<unsigned>& slots; // the node of each stack slot
+    std::vector<unsigned>& ends;
+    std::vector<unsigned>& operands;
+    std::vector<double>& partials;
+    std::vector<double>& adjoints;
+};
+} // namespace
+
+template<>
+template<typename Derivatives>
+double FunctionParser::EvalGradientByteCode(EvalContext& context, double* Stack, Derivatives& derivatives,
+                                            const double* Vars, double* gradient) const {
+    const std::vector<unsigned>& byteCode = data->ByteCode;
+    const unsigned N = unsigned(data->variableRefs.size());
+    unsigned DP = 0;
+    int SP = -1;
+
+#ifndef FP_NO_EVALUATION_CHECKS
+#define FP_CHECK(condition, error)     \
+    if (condition) {                   \
+        context.evalErrorType = error; \
+        return Fail(gradient, N);      \
+    }
+#else
+#define FP_CHECK(condition, error)
+#endif
+
+    for (unsigned IP = 0; IP < byteCode.size(); ++IP) {
+        const unsigned opcode = byteCode[IP];
+        const double x = SP >= 0 ? Stack[SP] : 0;
+        switch (opcode) {
+            // Functions:
+        case cAbs:
+            derivatives.Scale(SP, x < 0 ? -1 : x > 0 ? 1 : 0);
+            Stack[SP] = fabs(x);
+            break;
+
+        case cAcos:
+            FP_CHECK(x < -1 || x > 1, 4);
+            derivatives.Scale(SP, -1 / sqrt(1 - x * x));
+            Stack[SP] = acos(x);
+            break;
+
+        case cAcosh:
+            derivatives.Scale(SP, 1 / sqrt(x * x - 1));
+            Stack[SP] = fp_acosh(x);
+            break;
+
+        case cAsin:
+            FP_CHECK(x < -1 || x > 1, 4);
+            derivatives.Scale(SP, 1 / sqrt(1 - x * x));
+            Stack[SP] = asin(x);
+            break;
+
+        case cAsinh:
+            derivatives.Scale(SP, 1 / sqrt(x * x + 1));
+            Stack[SP] = fp_asinh(x);
+            break;
+
+        case cAtan:
+            derivatives.Scale(SP, 1 / (1 + x * x));
+            Stack[SP] = atan(x);
+            break;
+
+        case cAtan2: {
+            const double y = Stack[SP - 1], r = x * x + y * y;
+            derivatives.Combine(SP - 1, x / r, SP, -y / r);
+            Stack[SP - 1] = atan2(y, x);
+            --SP;
+            break;
+        }
+
+        case cAtanh:
+            derivatives.Scale(SP, 1 / (1 - x * x));
+            Stack[SP] = fp_atanh(x);
+            break;
+
+        case cCeil:
+            derivatives.Constant(SP);
+            Stack[SP] = ceil(x);
+            break;
+
+        case cCos:
+            derivatives.Scale(SP, -sin(x));
+            Stack[SP] = cos(x);
+            break;
+
+        case cCosh:
+            derivatives.Scale(SP, sinh(x));
+            Stack[SP] = cosh(x);
+            break;
+
+        case cCot: {
+            const double tangent = tan(x);
+            FP_CHECK(tangent == 0, 1);
+            const double value = 1 / tangent;
+            derivatives.Scale(SP, -(1 + value * value));
+            Stack[SP] = value;
+            break;
+        }
+
+        case cCsc: {
+            const double s = sin(x);
+            FP_CHECK(s == 0, 1);
+            derivatives.Scale(SP, -cos(x) / (s * s));
+            Stack[SP] = 1 / s;
+            break;
+        }
+
+#ifndef FP_DISABLE_EVAL
+        case cEval: {
+            const unsigned first = SP - N + 1;
+            double retVal = 0;
+            if (context.evalRecursionLevel == FP_EVAL_MAX_REC_LEVEL) {
+                context.evalErrorType = 5;
+                derivatives.Constant(first);
+            } else {
+                EvalContext& nested = context.Nested();
+                nested.evalRecursionLevel = context.evalRecursionLevel + 1;
+                retVal = EvalWithGradient(nested, &Stack[first], N ? derivatives.Call(N) : 0);
+                derivatives.Return(first, N);
+            }
+            SP = first;
+            Stack[SP] = retVal;
+            break;
+        }
+#endif
+
+        case cExp: {
+            const double value = exp(x);
+            derivatives.Scale(SP, value);
+            Stack[SP] = value;
+            break;
+        }
+
+        case cExp2: {
+            const double value = pow(2.0, x);
+            derivatives.Scale(SP, value * 0.69314718055994530942);
+            Stack[SP] = value;
+            break;
+        }
+
+        case cFloor:
+            derivatives.Constant(SP);
+            Stack[SP] = floor(x);
+            break;
+
+        case cIf: {
+            const unsigned jumpAddr = byteCode[++IP];
+            const unsigned immedAddr = byteCode[++IP];
+            if (doubleToInt(x) == 0) {
+                IP = jumpAddr;
+                DP = immedAddr;
+            }
+            --SP;
+            break;
+        }
+
+        case cInt:
+            derivatives.Constant(SP);
+            Stack[SP] = floor(x + .5);
+            break;
+
+        case cLog:
+            FP_CHECK(x <= 0, 3);
+            derivatives.Scale(SP, 1 / x);
+            Stack[SP] = log(x);
+            break;
+
+        case cLog10:
+            FP_CHECK(x <= 0, 3);
+            derivatives.Scale(SP, 0.43429448190325182765 / x);
+            Stack[SP] = log10(x);
+            break;
+
+        case cLog2:
+            FP_CHECK(x <= 0, 3);
+            derivatives.Scale(SP, 1.4426950408889634074 / x);
+#ifdef FP_SUPPORT_LOG2
+            Stack[SP] = log2(x);
+#else
+            Stack[SP] = log(x) * 1.4426950408889634074;
+#endif
+            break;
+
+        case cMax:
+            if (!(Stack[SP - 1] > x))
+                derivatives.Copy(SP - 1, SP);
+            Stack[SP - 1] = Max(Stack[SP - 1], x);
+            --SP;
+            break;
+
+        case cMin:
+            if (!(Stack[SP - 1] < x))
+                derivatives.Copy(SP - 1, SP);
+            Stack[SP - 1] = Min(Stack[SP - 1], x);
+            --SP;
+            break;
+
+        case cPow:
+        case cRPow: {
+            // base^exponent, whose derivative by the exponent only exists
+            // for a positive base (or is 0 at 0).
+            const bool reversed = opcode == cRPow;
+            const double base = reversed ? x : Stack[SP - 1], exponent = reversed ? Stack[SP - 1] : x;
+            const double value = pow(base, exponent);
+            const double byBase = exponent == 0 ? 0 : exponent * pow(base, exponent - 1);
+            const double byExponent = base > 0 ? value * log(base) : base == 0 ? 0 : log(base);
+            derivatives.Combine(SP - 1, reversed ? byExponent : byBase, SP, reversed ? byBase : byExponent);
+            Stack[SP - 1] = value;
+            --SP;
+            break;
+        }
+
+        case cSec: {
+            const double c = cos(x);
+            FP_CHECK(c == 0, 1);
+            derivatives.Scale(SP, sin(x) / (c * c));
+            Stack[SP] = 1 / c;
+            break;
+        }
+
+        case cSin:
+            derivatives.Scale(SP, cos(x));
+            Stack[SP] = sin(x);
+            break;
+
+        case cSinh:
+            derivatives.Scale(SP, cosh(x));
+            Stack[SP] = sinh(x);
+            break;
+
+        case cSqrt: {
+            FP_CHECK(x < 0, 2);
+            const double value = sqrt(x);
+            derivatives.Scale(SP, 0.5 / value);
+            Stack[SP] = value;
+            break;
+        }
+
+        case cTan: {
+            const double value = tan(x);
+            derivatives.Scale(SP, 1 + value * value);
+            Stack[SP] = value;
+            break;
+        }
+
+        case cTanh: {
+            const double value = tanh(x);
+            derivatives.Scale(SP, 1 - value * value);
+            Stack[SP] = value;
+            break;
+        }
+
+            // Misc:
+        case cImmed:
+            Stack[++SP] = data->Immed[DP++];
+            derivatives.Constant(SP);
+            break;
+
+        case cJump:
+            DP = byteCode[IP + 2];
+            IP = byteCode[IP + 1];
+            break;
+
+            // Operators:
+        case cNeg:
+            derivatives.Scale(SP, -1);
+            Stack[SP] = -x;
+            break;
+
+        case cAdd:
+            derivatives.Combine(SP - 1, 1, SP, 1);
+            Stack[SP - 1] += x;
+            --SP;
+            break;
+
+        case cSub:
+            derivatives.Combine(SP - 1, 1, SP, -1);
+            Stack[SP - 1] -= x;
+            --SP;
+            break;
+
+        case cMul:
+            derivatives.Combine(SP - 1, x, SP, Stack[SP - 1]);
+            Stack[SP - 1] *= x;
+            --SP;
+            break;
+
+        case cDiv: {
+            FP_CHECK(x == 0, 1);
+            const double value = Stack[SP - 1] / x;
+            derivatives.Combine(SP - 1, 1 / x, SP, -value / x);
+            Stack[SP - 1] = value;
+            --SP;
+            break;
+        }
+
+        case cMod: {
+            // fmod(a, b) = a - n*b, n being a/b rounded towards 0.
+            FP_CHECK(x == 0, 1);
+            const double value = fmod(Stack[SP - 1], x);
+            derivatives.Combine(SP - 1, 1, SP, -((Stack[SP - 1] - value) / x));
+            Stack[SP - 1] = value;
+            --SP;
+            break;
+        }
+
+#ifdef FP_EPSILON
+        case cEqual: Stack[SP - 1] = (fabs(Stack[SP - 1] - x) <= FP_EPSILON); goto comparison;
+        case cNEqual: Stack[SP - 1] = (fabs(Stack[SP - 1] - x) >= FP_EPSILON); goto comparison;
+        case cLess: Stack[SP - 1] = (Stack[SP - 1] < x - FP_EPSILON); goto comparison;
+        case cLessOrEq: Stack[SP - 1] = (Stack[SP - 1] <= x + FP_EPSILON); goto comparison;
+        case cGreater: Stack[SP - 1] = (Stack[SP - 1] - FP_EPSILON > x); goto comparison;
+        case cGreaterOrEq: Stack[SP - 1] = (Stack[SP - 1] + FP_EPSILON >= x); goto comparison;
+#else
+        case cEqual: Stack[SP - 1] = (Stack[SP - 1] == x); goto comparison;
+        case cNEqual: Stack[SP - 1] = (Stack[SP - 1] != x); goto comparison;
+        case cLess: Stack[SP - 1] = (Stack[SP - 1] < x); goto comparison;
+        case cLessOrEq: Stack[SP - 1] = (Stack[SP - 1] <= x); goto comparison;
+        case cGreater: Stack[SP - 1] = (Stack[SP - 1] > x); goto comparison;
+        case cGreaterOrEq: Stack[SP - 1] = (Stack[SP - 1] >= x); goto comparison;
+#endif
+        case cAnd: Stack[SP - 1] = (doubleToInt(Stack[SP - 1]) && doubleToInt(x)); goto comparison;
+        case cOr:
+            Stack[SP - 1] = (doubleToInt(Stack[SP - 1]) || doubleToInt(x));
+        comparison:
+            // The logical values are constant almost everywhere.
+            derivatives.Constant(SP - 1);
+            --SP;
+            break;
+
+        case cNot:
+            derivatives.Constant(SP);
+            Stack[SP] = !doubleToInt(x);
+            break;
+
+        case cNotNot:
+            derivatives.Constant(SP);
+            Stack[SP] = !!doubleToInt(x);
+            break;
+
+            // Degrees-radians conversion:
+        case cDeg:
+            derivatives.Scale(SP, 180.0 / M_PI);
+            Stack[SP] = RadiansToDegrees(x);
+            break;
+
+        case cRad:
+            derivatives.Scale(SP, M_PI / 180.0);
+            Stack[SP] = DegreesToRadians(x);
+            break;
+
+            // User-defined function calls:
+        case cFCall: {
+            const Data::FuncPtrData& function = data->FuncPtrs[byteCode[++IP]];
+            const unsigned params = function.params, first = SP - params + 1;
+            const double retVal = function.funcPtr(&Stack[first]);
+            if (params) {
+                double* const partials = derivatives.Call(params);
+                if (function.derivativePtr)
+                    function.derivativePtr(&Stack[first], partials);
+                else
+                    Differences(function.funcPtr, &Stack[first], params, partials);
+            }
+            derivatives.Return(first, params);
+            SP = first;
+            Stack[SP] = retVal;
+            break;
+        }
+
+        case cPCall: {
+            const Data::FuncPtrData& function = data->FuncParsers[byteCode[++IP]];
+            const unsigned params = function.params, first = SP - params + 1;
+            EvalContext& nested = context.Nested();
+            nested.evalErrorType = 0;
+            nested.evalRecursionLevel = 0;
+            const double retVal =
+                function.parserPtr->EvalWithGradient(nested, &Stack[first], params ? derivatives.Call(params) : 0);
+            derivatives.Return(first, params);
+            SP = first;
+            Stack[SP] = retVal;
+            const int error = nested.evalErrorType;
+            if (error) {
+                context.evalErrorType = error;
+                return Fail(gradient, N);
+            }
+            break;
+        }
+
+#ifdef FP_SUPPORT_OPTIMIZER
+        case cVar: break; // Paranoia. These should never exist
+
+        case cFetch: {
+            const unsigned stackOffs = byteCode[++IP];
+            Stack[SP + 1] = Stack[stackOffs];
+            derivatives.Copy(SP + 1, stackOffs);
+            ++SP;
+            break;
+        }
+
+        case cPopNMov: {
+            const unsigned stackOffs_target = byteCode[++IP];
+            const unsigned stackOffs_source = byteCode[++IP];
+            Stack[stackOffs_target] = Stack[stackOffs_source];
+            derivatives.Copy(stackOffs_target, stackOffs_source);
+            SP = stackOffs_target;
+            break;
+        }
+
+        case cSelect: {
+            const int selected = doubleToInt(Stack[SP - 2]) ? SP - 1 : SP;
+            Stack[SP - 2] = Stack[selected];
+            derivatives.Copy(SP - 2, selected);
+            SP -= 2;
+            break;
+        }
+#endif // FP_SUPPORT_OPTIMIZER
+
+        case cDup:
+            Stack[SP + 1] = x;
+            derivatives.Copy(SP + 1, SP);
+            ++SP;
+            break;
+
+        case cInv: {
+            FP_CHECK(x == 0.0, 1);
+            const double value = 1.0 / x;
+            derivatives.Scale(SP, -value * value);
+            Stack[SP] = value;
+            break;
+        }
+
+        case cSqr:
+            derivatives.Scale(SP, 2 * x);
+            Stack[SP] = x * x;
+            break;
+
+        case cRDiv: {
+            const double divisor = Stack[SP - 1];
+            FP_CHECK(divisor == 0, 1);
+            const double value = x / divisor;
+            derivatives.Combine(SP - 1, -value / divisor, SP, 1 / divisor);
+            Stack[SP - 1] = value;
+            --SP;
+            break;
+        }
+
+        case cRSub:
+            derivatives.Combine(SP - 1, -1, SP, 1);
+            Stack[SP - 1] = x - Stack[SP - 1];
+            --SP;
+            break;
+
+        case cRSqrt: {
+            FP_CHECK(x == 0, 1);
+            const double value = 1.0 / sqrt(x);
+            derivatives.Scale(SP, -0.5 * value / x);
+            Stack[SP] = value;
+            break;
+        }
+
+        case cNop: break;
+
+            // Variables:
+        default:
+            Stack[++SP] = Vars[opcode - VarBegin];
+            derivatives.Variable(SP, opcode - VarBegin);
+        }
+    }
+
+#undef FP_CHECK
+
+    derivatives.Gradient(SP, gradient);
+    context.evalErrorType = 0;
+    return Stack[SP];
+}
+
+//=========================================================================
+// EvalWithGradient() and EvalManyWithGradient()
+//=========================================================================
+template<>
+double FunctionParser::EvalWithGradient(const double* Vars, double* gradient) {
+#ifdef FP_USE_THREAD_SAFE_EVAL
+    EvalContext context;
+#else
+    EvalContext& context = evalContext;
+#endif
+    const double result = EvalWithGradient(context, Vars, gradient);
+    evalErrorType = context.evalErrorType;
+    return result;
+}
+
+template<>
+double FunctionParser::EvalWithGradient(EvalContext& context, const double* Vars, double* gradient) const {
+    const unsigned variableAmount = unsigned(data->variableRefs.size());
+    if (parseErrorType != FP_NO_ERROR) {
+        context.evalErrorType = 0;
+        Zero(gradient, variableAmount);
+        return 0;
+    }
+
+    if (variableAmount >= ReverseModeVariables) {
+        if (context.Stack.size() < data->StackSize)
+            context.Stack.resize(data->StackSize);
+        Tape tape(variableAmount, data->StackSize, unsigned(data->ByteCode.size()), context.tapeSlots,
+                  context.tapeEnds, context.tapeOperands, context.tapePartials, context.tapeAdjoints);
+        return EvalGradientByteCode(context, &context.Stack[0], tape, Vars, gradient);
+    }
+
+    // The values, then the tangents:
+    const size_t size = data->StackSize * size_t(variableAmount + 1);
+    if (context.Stack.size() < size)
+        context.Stack.resize(size);
+    double* const Stack = &context.Stack[0];
+    Tangents tangents(Stack + data->StackSize, variableAmount, context.tapePartials);
+    return EvalGradientByteCode(context, Stack, tangents, Vars, gradient);
+}
+
+template<>
+void FunctionParser::EvalManyWithGradient(const double* Vars, size_t rowCount, size_t rowStride, double* results,
+                                          double* gradients) {
+    const size_t variableAmount = data->variableRefs.size();
+    int firstError = 0;
+    for (size_t row = 0; row < rowCount; ++row) {
+        results[row] = EvalWithGradient(evalContext, Vars + row * rowStride, gradients + row * variableAmount);
+        if (!firstError)
+            firstError = evalContext.evalErrorType;
+    }
+    evalErrorType = firstError;
+}
@@ -0,0 +1,1233 @@
+/***************************************************************************\
+|* Function Parser for C++ v3.3.2                                          *|
+|*-------------------------------------------------------------------------*|
+|* Copyright: Juha Nieminen                                                *|
+\***************************************************************************/
+
+#include "stdafx.h"
+#include "fpconfig.hh"
+#include "fparser.hh"
+#include "fpaux.hh"
+
+#include <cfloat>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+using namespace FUNCTIONPARSERTYPES;
+
+//=========================================================================
+// Interval evaluation
+//=========================================================================
+/* EvalInterval() runs the bytecode with an interval in each stack slot
+   instead of a value. Each operation returns an interval containing its
+   results for all the values of its operands, so the final interval
+   contains the value of the function at every point of the box of the
+   variables. The bounds are rounded outwards: +, -, *, / and sqrt() round
+   to nearest, and their rounding error, which is computed exactly with the
+   error-free transformations of Knuth and Dekker, tells if the exact bound
+   is below or above; the other functions come from the math library, which
+   is accurate to an ulp or two, so their bounds are widened by a few ulps.
+   Since rounding is monotonic, an interval containing the exact results
+   also contains the rounded ones, so the intervals contain both the exact
+   values and the values computed by Eval().
+   Monotonic functions are evaluated at the bounds; the others (cos(),
+   pow(), ...) also look for their extrema inside the interval. An if()
+   whose condition is not known evaluates both branches and takes the union
+   of their results. The points where the evaluation fails (eg. sqrt() of a
+   negative value) or gives NaN are left out of the intervals, and the
+   error code is that of the first check which may fail.
+*/
+namespace {
+typedef FunctionParser::Interval Interval;
+
+const double Infinity = std::numeric_limits<double>::infinity();
+const double LibraryError = 4 * DBL_EPSILON; // relative, of the math library and of Eval() together
+const double PhaseLimit = 1e15; // of sin(), cos() and tan(), beyond which the phase is not known
+const double SplitLimit = 1e290; // of the error-free products (2^-969 to 2^995, with a margin)
+const double SplitMinimum = 1e-280;
+
+inline bool IsFinite(double x) { return x - x == 0; }
+
+inline Interval Whole() { return Interval(-Infinity, Infinity); }
+
+inline Interval Union(const Interval& a, const Interval& b) {
+    return Interval(Min(a.lower, b.lower), Max(a.upper, b.upper));
+}
+
+// Restricts x to the domain [lower, upper], or to its closest bound when
+// x is outside (no point of x is then left, so any value would do).
+inline Interval Restrict(const Interval& x, double lower, double upper) {
+    return Interval(Min(Max(x.lower, lower), upper), Max(Min(x.upper, upper), lower));
+}
+
+inline void EvaluationCheck(int& error, int code) {
+#ifndef FP_NO_EVALUATION_CHECKS
+    if (!error)
+        error = code;
+#else
+    (void)error;
+    (void)code;
+#endif
+}
+
+// Moves a bound down or up by at least relative*|x| (and at least a
+// subnormal). NaN becomes infinite, and an infinity which may have
+// overflowed the largest finite value.
+inline double Down(double x, double relative = DBL_EPSILON) {
+    if (x != x)
+        return -Infinity;
+    if (x == Infinity)
+        return DBL_MAX;
+    if (x == -Infinity)
+        return x;
+    return x - (fabs(x) * relative + std::numeric_limits<double>::denorm_min());
+}
+
+inline double Up(double x, double relative = DBL_EPSILON) {
+    if (x != x)
+        return Infinity;
+    if (x == -Infinity)
+        return -DBL_MAX;
+    if (x == Infinity)
+        return x;
+    return x + (fabs(x) * relative + std::numeric_limits<double>::denorm_min());
+}
+
+// A rounded result moved in the given direction unless its rounding error
+// (the exact result minus the rounded one, NaN if unknown) shows it is
+// already on that side.
+inline double Directed(double value, double error, bool up) {
+    if (up)
+        return error > 0 || error != error ? Up(value) : value;
+    return error < 0 || error != error ? Down(value) : value;
+}
+
+// The rounding error of the product p = a*b (Dekker), if it can be computed.
+inline double ProductError(double a, double b, double p) {
+    if (!(fabs(p) > SplitMinimum && fabs(p) < SplitLimit && fabs(a) < SplitLimit && fabs(b) < SplitLimit))
+        return std::numeric_limits<double>::quiet_NaN();
+    const double ca = 134217729.0 * a, cb = 134217729.0 * b;
+    const double ah = ca - (ca - a), al = a - ah, bh = cb - (cb - b), bl = b - bh;
+    return ((ah * bh - p) + ah * bl + al * bh) + al * bl;
+}
+
+inline double AddBound(double a, double b, bool up) {
+    const double s = a + b, bb = s - a;
+    return Directed(s, (a - (s - bb)) + (b - bb), up);
+}
+
+// 0 times anything (even an infinity) is 0 for the bounds.
+inline double MulBound(double a, double b, bool up) {
+    if (a == 0 || b == 0)
+        return 0;
+    const double p = a * b;
+    return Directed(p, ProductError(a, b, p), up);
+}
+
+// b is not 0; the rounding error of q = a/b has the sign of (a - q*b)/b,
+// whose numerator is exact.
+inline double DivBound(double a, double b, bool up) {
+    if (a == 0 || (IsFinite(a) && !IsFinite(b)))
+        return 0;
+    const double q = a / b, p = q * b, remainder = (a - p) - ProductError(q, b, p);
+    return Directed(q, b > 0 ? remainder : -remainder, up);
+}
+
+// x is not negative; the rounding error of q = sqrt(x) has the sign of
+// x - q*q.
+inline double SqrtBound(double x, bool up) {
+    const double q = sqrt(x);
+    if (x == 0 || x == Infinity)
+        return q;
+    const double p = q * q;
+    return Directed(q, (x - p) - ProductError(q, q, p), up);
+}
+
+//-------------------------------------------------------------------------
+// Operators
+//-------------------------------------------------------------------------
+inline Interval Neg(const Interval& x) { return Interval(-x.upper, -x.lower); }
+
+inline Interval Add(const Interval& a, const Interval& b) {
+    return Interval(AddBound(a.lower, b.lower, false), AddBound(a.upper, b.upper, true));
+}
+
+inline Interval Sub(const Interval& a, const Interval& b) { return Add(a, Neg(b)); }
+
+Interval Mul(const Interval& a, const Interval& b) {
+    return Interval(Min(Min(MulBound(a.lower, b.lower, false), MulBound(a.lower, b.upper, false)),
+                        Min(MulBound(a.upper, b.lower, false), MulBound(a.upper, b.upper, false))),
+                    Max(Max(MulBound(a.lower, b.lower, true), MulBound(a.lower, b.upper, true)),
+                        Max(MulBound(a.upper, b.lower, true), MulBound(a.upper, b.upper, true))));
+}
+
+inline Interval Abs(const Interval& x) {
+    if (x.lower >= 0)
+        return x;
+    if (x.upper <= 0)
+        return Neg(x);
+    return Interval(0, Max(-x.lower, x.upper));
+}
+
+inline Interval Sqr(const Interval& x) {
+    const Interval a = Abs(x);
+    return Interval(MulBound(a.lower, a.lower, false), MulBound(a.upper, a.upper, true));
+}
+
+// The division by 0 is the failing point.
+Interval Inv(const Interval& x, int& error) {
+    if (x.lower > 0 || x.upper < 0)
+        return Interval(DivBound(1, x.upper, false), DivBound(1, x.lower, true));
+    EvaluationCheck(error, 1);
+    if (x.lower == 0 && x.upper > 0)
+        return Interval(DivBound(1, x.upper, false), Infinity);
+    if (x.upper == 0 && x.lower < 0)
+        return Interval(-Infinity, DivBound(1, x.lower, true));
+    return Whole();
+}
+
+Interval Div(const Interval& a, const Interval& b, int& error) {
+    if (!(b.lower > 0 || b.upper < 0))
+        return Mul(a, Inv(b, error));
+    return Interval(Min(Min(DivBound(a.lower, b.lower, false), DivBound(a.lower, b.upper, false)),
+                        Min(DivBound(a.upper, b.lower, false), DivBound(a.upper, b.upper, false))),
+                    Max(Max(DivBound(a.lower, b.lower, true), DivBound(a.lower, b.upper, true)),
+                        Max(DivBound(a.upper, b.lower, true), DivBound(a.upper, b.upper, true))));
+}
+
+// fmod(a, b) is exact, has the sign of a, and is smaller than both |a| and
+// |b| (it is a when |a| < |b|).
+Interval Mod(const Interval& a, const Interval& b, int& error) {
+    if (b.lower <= 0 && b.upper >= 0)
+        EvaluationCheck(error, 1);
+    if (a.lower == a.upper && b.lower == b.upper && b.lower != 0)
+        return Interval(fmod(a.lower, b.lower));
+    const double aMax = Max(-a.lower, a.upper), bMax = Max(-b.lower, b.upper);
+    const double bMin = b.lower > 0 ? b.lower : b.upper < 0 ? -b.upper : 0;
+    if (aMax < bMin)
+        return a;
+    const double bound = Min(aMax, bMax);
+    return Interval(a.lower >= 0 ? 0 : -bound, a.upper <= 0 ? 0 : bound);
+}
+
+// Whether doubleToInt(x) is non-zero for all of x (1), none of it (-1), or
+// not known (0). Values just below 0.5 may round up in doubleToInt().
+inline int Truth(const Interval& x) {
+    if (x.lower >= .5 || x.upper <= -.5)
+        return 1;
+    if (x.lower > -.5 + DBL_EPSILON && x.upper < .5 - DBL_EPSILON)
+        return -1;
+    return 0;
+}
+
+inline Interval Boolean(int truth) { return truth > 0 ? Interval(1) : truth < 0 ? Interval(0) : Interval(0, 1); }
+
+// The comparisons are certainly true or false where the intervals do not
+// overlap (with the margin of FP_EPSILON, computed as Eval() does).
+Interval Compare(unsigned opcode, const Interval& a, const Interval& b) {
+    int truth = 0;
+#ifdef FP_EPSILON
+    const Interval epsilon(FP_EPSILON);
+    switch (opcode) {
+    case cEqual: {
+        const Interval distance = Abs(Sub(a, b));
+        truth = distance.upper <= FP_EPSILON ? 1 : distance.lower > FP_EPSILON ? -1 : 0;
+        break;
+    }
+    case cNEqual: {
+        const Interval distance = Abs(Sub(a, b));
+        truth = distance.lower >= FP_EPSILON ? 1 : distance.upper < FP_EPSILON ? -1 : 0;
+        break;
+    }
+    case cLess: {
+        const Interval limit = Sub(b, epsilon);
+        truth = a.upper < limit.lower ? 1 : a.lower >= limit.upper ? -1 : 0;
+        break;
+    }
+    case cLessOrEq: {
+        const Interval limit = Add(b, epsilon);
+        truth = a.upper <= limit.lower ? 1 : a.lower > limit.upper ? -1 : 0;
+        break;
+    }
+    case cGreater: {
+        const Interval shifted = Sub(a, epsilon);
+        truth = shifted.lower > b.upper ? 1 : shifted.upper <= b.lower ? -1 : 0;
+        break;
+    }
+    case cGreaterOrEq: {
+        const Interval shifted = Add(a, epsilon);
+        truth = shifted.lower >= b.upper ? 1 : shifted.upper < b.lower ? -1 : 0;
+        break;
+    }
+    }
+#else
+    switch (opcode) {
+    case cEqual:
+    case cNEqual:
+        truth = a.lower == a.upper && b.lower == b.upper && a.lower == b.lower ? 1 :
+                a.upper < b.lower || b.upper < a.lower ? -1 : 0;
+        if (opcode == cNEqual)
+            truth = -truth;
+        break;
+    case cLess: truth = a.upper < b.lower ? 1 : a.lower >= b.upper ? -1 : 0; break;
+    case cLessOrEq: truth = a.upper <= b.lower ? 1 : a.lower > b.upper ? -1 : 0; break;
+    case cGreater: truth = a.lower > b.upper ? 1 : a.upper <= b.lower ? -1 : 0; break;
+    case cGreaterOrEq: truth = a.lower >= b.upper ? 1 : a.upper < b.lower ? -1 : 0; break;
+    }
+#endif
+    return Boolean(truth);
+}
+
+//-------------------------------------------------------------------------
+// Functions
+//-------------------------------------------------------------------------
+typedef double (*MathFunction)(double);
+
+inline double Exp2(double x) { return pow(2.0, x); }
+
+inline Interval Increasing(MathFunction f, const Interval& x) {
+    return Interval(Down(f(x.lower), LibraryError), Up(f(x.upper), LibraryError));
+}
+
+inline Interval Decreasing(MathFunction f, const Interval& x) {
+    return Interval(Down(f(x.upper), LibraryError), Up(f(x.lower), LibraryError));
+}
+
+inline Interval Sqrt(const Interval& x, int& error) {
+    if (x.lower < 0)
+        EvaluationCheck(error, 2);
+    const Interval domain = Restrict(x, 0, Infinity);
+    return Interval(SqrtBound(domain.lower, false), SqrtBound(domain.upper, true));
+}
+
+// log(), log10() and log2():
+inline Interval Log(MathFunction f, const Interval& x, int& error) {
+    if (x.lower <= 0)
+        EvaluationCheck(error, 3);
+    return Increasing(f, Restrict(x, 0, Infinity));
+}
+
+#ifdef FP_SUPPORT_ASINH
+inline Interval Asinh(const Interval& x) { return Increasing(fp_asinh, x); }
+inline Interval Acosh(const Interval& x) { return Increasing(fp_acosh, Restrict(x, 1, Infinity)); }
+inline Interval Atanh(const Interval& x) { return Increasing(fp_atanh, Restrict(x, -1, 1)); }
+#else
+// The formulas of fp_asinh() and others lose precision (or even fail), so
+// they are evaluated step by step. Their failures give NaNs or infinities
+// in Eval(), not errors.
+Interval Asinh(const Interval& x) {
+    int ignored = 0;
+    return Log(log, Add(x, Sqrt(Add(Sqr(x), Interval(1)), ignored)), ignored);
+}
+
+Interval Acosh(const Interval& x) {
+    int ignored = 0;
+    return Log(log, Add(x, Sqrt(Sub(Sqr(x), Interval(1)), ignored)), ignored);
+}
+
+Interval Atanh(const Interval& x) {
+    int ignored = 0;
+    const Interval quotient = Div(Add(Interval(1), x), Sub(Interval(1), x), ignored);
+    return Mul(Log(log, quotient, ignored), Interval(0.5));
+}
+#endif
+
+// The image of x by cos() (phase 0) or sin() (phase 0.5), which have their
+// maxima at x/pi - phase = 2k and their minima at 2k+1. The extrema are
+// looked for with a margin for the rounding of x/pi.
+Interval Periodic(MathFunction f, const Interval& x, double phase) {
+    if (!(x.lower >= -PhaseLimit && x.upper <= PhaseLimit))
+        return Interval(-1, 1);
+    double first = x.lower / M_PI - phase, last = x.upper / M_PI - phase;
+    first -= (fabs(first) + 1) * 8 * DBL_EPSILON;
+    last += (fabs(last) + 1) * 8 * DBL_EPSILON;
+    const double a = f(x.lower), b = f(x.upper), extremum = ceil(first);
+    Interval result(Down(Min(a, b), LibraryError), Up(Max(a, b), LibraryError));
+    if (extremum + 1 <= last)
+        return Interval(-1, 1);
+    if (extremum <= last) {
+        if (fmod(extremum, 2) == 0)
+            result.upper = 1;
+        else
+            result.lower = -1;
+    }
+    return Restrict(result, -1, 1);
+}
+
+// The poles of tan() are at x/pi - 0.5 = k.
+Interval Tan(const Interval& x) {
+    if (!(x.lower >= -PhaseLimit && x.upper <= PhaseLimit))
+        return Whole();
+    double first = x.lower / M_PI - 0.5, last = x.upper / M_PI - 0.5;
+    first -= (fabs(first) + 1) * 8 * DBL_EPSILON;
+    last += (fabs(last) + 1) * 8 * DBL_EPSILON;
+    if (ceil(first) <= last)
+        return Whole();
+    return Increasing(tan, x);
+}
+
+Interval Cosh(const Interval& x) {
+    if (x.lower >= 0)
+        return Restrict(Increasing(cosh, x), 1, Infinity);
+    if (x.upper <= 0)
+        return Restrict(Decreasing(cosh, x), 1, Infinity);
+    return Interval(1, Up(Max(cosh(x.lower), cosh(x.upper)), LibraryError));
+}
+
+// The angle of the points of a box is in [-pi, pi] if the box touches the
+// negative x axis (where atan2() jumps from pi to -pi) or the origin;
+// elsewhere it is continuous, and its extrema are at the corners.
+Interval Atan2(const Interval& y, const Interval& x) {
+    const double pi = Up(M_PI);
+    if (x.lower <= 0 && y.lower <= 0 && y.upper >= 0)
+        return Interval(-pi, pi);
+    const double a = atan2(y.lower, x.lower), b = atan2(y.lower, x.upper);
+    const double c = atan2(y.upper, x.lower), d = atan2(y.upper, x.upper);
+    return Restrict(Interval(Down(Min(Min(a, b), Min(c, d)), LibraryError),
+                             Up(Max(Max(a, b), Max(c, d)), LibraryError)),
+                    -pi, pi);
+}
+
+// pow(x, y) is monotonic in x and in y for x >= 0, so its extrema are at
+// the corners. For x < 0 it is only defined at integer values of y, where
+// its absolute value is pow(-x, y); with a single integer exponent it is
+// monotonic again. Zero is taken with both signs, which only matter for
+// odd exponents.
+Interval PowCorners(const Interval& x, const Interval& y) {
+    const double a = pow(x.lower, y.lower), b = pow(x.lower, y.upper);
+    const double c = pow(x.upper, y.lower), d = pow(x.upper, y.upper);
+    return Interval(Down(Min(Min(a, b), Min(c, d)), LibraryError), Up(Max(Max(a, b), Max(c, d)), LibraryError));
+}
+
+Interval Pow(const Interval& x, const Interval& y) {
+    const bool integerExponent = y.lower == y.upper && fabs(y.lower) < PhaseLimit && y.lower == floor(y.lower);
+    if (integerExponent && y.lower == 0)
+        return Interval(1);
+    bool empty = true;
+    Interval result;
+    if (x.upper >= 0) {
+        result = PowCorners(Interval(Max(x.lower, 0.0), x.upper), y);
+        empty = false;
+    }
+    if (x.lower <= 0 && (integerExponent || floor(y.upper) >= ceil(y.lower))) {
+        const Interval negative(x.lower, Min(x.upper, -0.0));
+        Interval part;
+        if (integerExponent) {
+            part = PowCorners(negative, y);
+        } else {
+            const Interval magnitude = PowCorners(Neg(negative), y);
+            part = Interval(-magnitude.upper, magnitude.upper);
+        }
+        result = empty ? part : Union(result, part);
+        empty = false;
+    }
+    return empty ? Interval(1) : result;
+}
+} // namespace
+
+//=========================================================================
+// The interpreter
+//=========================================================================
+template<>
+FunctionParser::Interval FunctionParser::EvalInterval(const Interval* Vars) {
+    EvalContext context;
+    const Interval result = EvalInterval(context, Vars);
+    evalErrorType = context.evalErrorType;
+    return result;
+}
+
+template<>
+FunctionParser::Interval FunctionParser::EvalInterval(EvalContext& context, const Interval* Vars) const {
+    context.evalErrorType = 0;
+    if (parseErrorType != FP_NO_ERROR)
+        return Interval();
+
+    std::vector<Interval> Stack(data->StackSize);
+    int SP = -1;
+    EvalIntervalCode(context, 0, unsigned(data->ByteCode.size()), 0, Vars, Stack, SP);
+    return Stack[SP];
+}
+
+/* Runs the bytecode from begin to end, with the immediates from DP. The
+   branches of an if() whose condition is not known are run by recursive
+   calls: the then branch ends with the jump over the else branch, which
+   ends where the jump goes.
+*/
+template<>
+void FunctionParser::EvalIntervalCode(EvalContext& context, unsigned begin, unsigned end, unsigned DP,
+                                      const Interval* Vars, std::vector<Interval>& Stack, int& SP) const {
+    const std::vector<unsigned>& byteCode = data->ByteCode;
+    int& error = context.evalErrorType;
+
+    for (unsigned IP = begin; IP < end; ++IP) {
+        const unsigned opcode = byteCode[IP];
+        switch (opcode) {
+            // Functions:
+        case cAbs: Stack[SP] = Abs(Stack[SP]); break;
+
+        case cAcos:
+        case cAsin:
+            if (Stack[SP].lower < -1 || Stack[SP].upper > 1)
+                EvaluationCheck(error, 4);
+            Stack[SP] = opcode == cAcos ? Decreasing(acos, Restrict(Stack[SP], -1, 1)) :
+                                          Increasing(asin, Restrict(Stack[SP], -1, 1));
+            break;
+
+        case cAcosh: Stack[SP] = Acosh(Stack[SP]); break;
+        case cAsinh: Stack[SP] = Asinh(Stack[SP]); break;
+        case cAtan: Stack[SP] = Increasing(atan, Stack[SP]); break;
+
+        case cAtan2:
+            Stack[SP - 1] = Atan2(Stack[SP - 1], Stack[SP]);
+            --SP;
+            break;
+
+        case cAtanh: Stack[SP] = Atanh(Stack[SP]); break;
+        case cCeil: Stack[SP] = Interval(ceil(Stack[SP].lower), ceil(Stack[SP].upper)); break;
+        case cCos: Stack[SP] = Periodic(cos, Stack[SP], 0); break;
+        case cCosh: Stack[SP] = Cosh(Stack[SP]); break;
+        case cCot: Stack[SP] = Inv(Tan(Stack[SP]), error); break;
+        case cCsc: Stack[SP] = Inv(Periodic(sin, Stack[SP], 0.5), error); break;
+
+#ifndef FP_DISABLE_EVAL
+        case cEval:
+            // The recursion is not followed, and could fail at any depth.
+            SP -= int(data->variableRefs.size()) - 1;
+            Stack[SP] = Whole();
+            if (!error)
+                error = 5;
+            break;
+#endif
+
+        case cExp: Stack[SP] = Restrict(Increasing(exp, Stack[SP]), 0, Infinity); break;
+        case cExp2: Stack[SP] = Restrict(Increasing(Exp2, Stack[SP]), 0, Infinity); break;
+        case cFloor: Stack[SP] = Interval(floor(Stack[SP].lower), floor(Stack[SP].upper)); break;
+
+        case cIf: {
+            const unsigned jumpAddr = byteCode[++IP], immedAddr = byteCode[++IP];
+            const int truth = Truth(Stack[SP--]);
+            if (truth < 0) {
+                IP = jumpAddr;
+                DP = immedAddr;
+            } else if (truth == 0) {
+                const unsigned endAddr = byteCode[jumpAddr - 1] + 1, endImmed = byteCode[jumpAddr];
+                std::vector<Interval> elseStack(Stack);
+                int elseSP = SP;
+                EvalIntervalCode(context, IP + 1, jumpAddr - 2, DP, Vars, Stack, SP);
+                EvalIntervalCode(context, jumpAddr + 1, endAddr, immedAddr, Vars, elseStack, elseSP);
+                for (int k = 0; k <= SP && k <= elseSP; ++k)
+                    Stack[k] = Union(Stack[k], elseStack[k]);
+                IP = endAddr - 1;
+                DP = endImmed;
+            }
+            break;
+        }
+
+        case cInt: {
+            const Interval shifted = Add(Stack[SP], Interval(.5));
+            Stack[SP] = Interval(floor(shifted.lower), floor(shifted.upper));
+            break;
+        }
+
+        case cLog: Stack[SP] = Log(log, Stack[SP], error); break;
+        case cLog10: Stack[SP] = Log(log10, Stack[SP], error); break;
+        case cLog2: Stack[SP] = Log(fp_log2, Stack[SP], error); break;
+
+        case cMax:
+            Stack[SP - 1] = Interval(Max(Stack[SP - 1].lower, Stack[SP].lower),
+                                     Max(Stack[SP - 1].upper, Stack[SP].upper));
+            --SP;
+            break;
+
+        case cMin:
+            Stack[SP - 1] = Interval(Min(Stack[SP - 1].lower, Stack[SP].lower),
+                                     Min(Stack[SP - 1].upper, Stack[SP].upper));
+            --SP;
+            break;
+
+        case cPow:
+            Stack[SP - 1] = Pow(Stack[SP - 1], Stack[SP]);
+            --SP;
+            break;
+
+        case cRPow:
+            Stack[SP - 1] = Pow(Stack[SP], Stack[SP - 1]);
+            --SP;
+            break;
+
+        case cSec: Stack[SP] = Inv(Periodic(cos, Stack[SP], 0), error); break;
+        case cSin: Stack[SP] = Periodic(sin, Stack[SP], 0.5); break;
+        case cSinh: Stack[SP] = Increasing(sinh, Stack[SP]); break;
+        case cSqrt: Stack[SP] = Sqrt(Stack[SP], error); break;
+        case cTan: Stack[SP] = Tan(Stack[SP]); break;
+        case cTanh: Stack[SP] = Restrict(Increasing(tanh, Stack[SP]), -1, 1); break;
+
+            // Misc:
+        case cImmed: Stack[++SP] = Interval(data->Immed[DP++]); break;
+
+        case cJump:
+            DP = byteCode[IP + 2];
+            IP = byteCode[IP + 1];
+            break;
+
+            // Operators:
+        case cNeg: Stack[SP] = Neg(Stack[SP]); break;
+
+        case cAdd:
+            Stack[SP - 1] = Add(Stack[SP - 1], Stack[SP]);
+            --SP;
+            break;
+
+        case cSub:
+            Stack[SP - 1] = Sub(Stack[SP - 1], Stack[SP]);
+            --SP;
+            break;
+
+        case cMul:
+            Stack[SP - 1] = Mul(Stack[SP - 1], Stack[SP]);
+            --SP;
+            break;
+
+        case cDiv:
+            Stack[SP - 1] = Div(Stack[SP - 1], Stack[SP], error);
+            --SP;
+            break;
+
+        case cMod:
+            Stack[SP - 1] = Mod(Stack[SP - 1], Stack[SP], error);
+            --SP;
+            break;
+
+        case cEqual:
+        case cNEqual:
+        case cLess:
+        case cLessOrEq:
+        case cGreater:
+        case cGreaterOrEq:
+            Stack[SP - 1] = Compare(opcode, Stack[SP - 1], Stack[SP]);
+            --SP;
+            break;
+
+        case cNot: Stack[SP] = Boolean(-Truth(Stack[SP])); break;
+
+        case cAnd: {
+            const int a = Truth(Stack[SP - 1]), b = Truth(Stack[SP]);
+            Stack[SP - 1] = Boolean(a < 0 || b < 0 ? -1 : a > 0 && b > 0 ? 1 : 0);
+            --SP;
+            break;
+        }
+
+        case cOr: {
+            const int a = Truth(Stack[SP - 1]), b = Truth(Stack[SP]);
+            Stack[SP - 1] = Boolean(a > 0 || b > 0 ? 1 : a < 0 && b < 0 ? -1 : 0);
+            --SP;
+            break;
+        }
+
+        case cNotNot: Stack[SP] = Boolean(Truth(Stack[SP])); break;
+
+            // Degrees-radians conversion:
+        case cDeg: Stack[SP] = Mul(Stack[SP], Interval(180.0 / M_PI)); break;
+        case cRad: Stack[SP] = Mul(Stack[SP], Interval(M_PI / 180.0)); break;
+
+            // User-defined function calls:
+        case cFCall: {
+            const Data::FuncPtrData& function = data->FuncPtrs[byteCode[++IP]];
+            SP -= int(function.params) - 1;
+            Stack[SP] = function.intervalPtr ? function.intervalPtr(&Stack[SP]) : Whole();
+            break;
+        }
+
+        case cPCall: {
+            const Data::FuncPtrData& function = data->FuncParsers[byteCode[++IP]];
+            EvalContext& nested = context.Nested();
+            SP -= int(function.params) - 1;
+            Stack[SP] = function.parserPtr->EvalInterval(nested, &Stack[SP]);
+            if (nested.evalErrorType && !error)
+                error = nested.evalErrorType;
+            break;
+        }
+
+#ifdef FP_SUPPORT_OPTIMIZER
+        case cVar: break;
+
+        case cFetch: {
+            const unsigned stackOffs = byteCode[++IP];
+            Stack[SP + 1] = Stack[stackOffs];
+            ++SP;
+            break;
+        }
+
+        case cPopNMov: {
+            const unsigned stackOffs_target = byteCode[++IP];
+            const unsigned stackOffs_source = byteCode[++IP];
+            Stack[stackOffs_target] = Stack[stackOffs_source];
+            SP = stackOffs_target;
+            break;
+        }
+
+        case cSelect: {
+            const int truth = Truth(Stack[SP - 2]);
+            Stack[SP - 2] = truth > 0 ? Stack[SP - 1] : truth < 0 ? Stack[SP] : Union(Stack[SP - 1], Stack[SP]);
+            SP -= 2;
+            break;
+        }
+#endif // FP_SUPPORT_OPTIMIZER
+
+        case cDup:
+            Stack[SP + 1] = Stack[SP];
+            ++SP;
+            break;
+
+        case cInv: Stack[SP] = Inv(Stack[SP], error); break;
+        case cSqr: Stack[SP] = Sqr(Stack[SP]); break;
+
+        case cRDiv:
+            Stack[SP - 1] = Div(Stack[SP], Stack[SP - 1], error);
+            --SP;
+            break;
+
+        case cRSub:
+            Stack[SP - 1] = Sub(Stack[SP], Stack[SP - 1]);
+            --SP;
+            break;
+
+        case cRSqrt: {
+            // Negative values give NaN, and only 0 fails.
+            int ignored = 0;
+            Stack[SP] = Inv(Sqrt(Stack[SP], ignored), error);
+            break;
+        }
+
+        case cNop: break;
+
+            // Variables:
+        default: Stack[++SP] = Vars[opcode - VarBegin];
+        }
+    }
+}
+
+//=========================================================================
+// Taylor intervals
+//=========================================================================
+/* EvalIntervalTaylor() runs the bytecode of a function of one variable
+   with a truncated Taylor series in each stack slot: the coefficients
+   f^(k)(x) / k! of the powers of the variable, each an interval over x,
+   for Approximate() to bound the error of its polynomials (see
+   fparser_approx.cc). The series of the functions follow from those of
+   their arguments with the usual recurrences (eg. w = exp(u) gives
+   w_k = sum j u_j w_(k-j) / k, from w' = u' w), computed with the
+   operations above, so all the bounds are rounded outwards; the constant
+   terms are the intervals of EvalInterval(). Where the function may not be
+   smooth over x (an if() whose condition is not known, abs() around 0,
+   sqrt() down to 0, ...) or may fail, and for the functions whose series
+   are not known here (user-defined functions, eval(), %, atan2()), it
+   returns false.
+*/
+namespace {
+const unsigned TaylorMaxTerms = 16;
+
+struct Taylor {
+    unsigned terms;
+    Interval c[TaylorMaxTerms];
+
+    Taylor() : terms(0) {}
+    Taylor(unsigned n, const Interval& value) : terms(n) {
+        c[0] = value;
+        for (unsigned k = 1; k < n; ++k)
+            c[k] = Interval(0);
+    }
+};
+
+// A rounded constant:
+inline Interval Around(double x) { return Interval(Down(x), Up(x)); }
+
+inline Interval Over(const Interval& x, unsigned k) {
+    int ignored = 0;
+    return Div(x, Interval(k), ignored);
+}
+
+inline bool ContainsZero(const Interval& x) { return !(x.lower > 0 || x.upper < 0); }
+
+bool IsConstant(const Taylor& u) {
+    for (unsigned k = 1; k < u.terms; ++k)
+        if (u.c[k].lower != 0 || u.c[k].upper != 0)
+            return false;
+    return true;
+}
+
+Taylor Neg(Taylor u) {
+    for (unsigned k = 0; k < u.terms; ++k)
+        u.c[k] = Neg(u.c[k]);
+    return u;
+}
+
+Taylor Add(Taylor a, const Taylor& b) {
+    for (unsigned k = 0; k < a.terms; ++k)
+        a.c[k] = Add(a.c[k], b.c[k]);
+    return a;
+}
+
+inline Taylor Sub(const Taylor& a, const Taylor& b) { return Add(a, Neg(b)); }
+
+Taylor Scale(const Interval& factor, Taylor u) {
+    for (unsigned k = 0; k < u.terms; ++k)
+        u.c[k] = Mul(factor, u.c[k]);
+    return u;
+}
+
+Taylor Mul(const Taylor& a, const Taylor& b) {
+    Taylor result(a.terms, Mul(a.c[0], b.c[0]));
+    for (unsigned k = 1; k < a.terms; ++k)
+        for (unsigned j = 0; j <= k; ++j)
+            result.c[k] = Add(result.c[k], Mul(a.c[j], b.c[k - j]));
+    return result;
+}
+
+// a / b, where b is not 0:
+Taylor Div(const Taylor& a, const Taylor& b) {
+    int ignored = 0;
+    Taylor result(a.terms, Div(a.c[0], b.c[0], ignored));
+    for (unsigned k = 1; k < a.terms; ++k) {
+        Interval sum = a.c[k];
+        for (unsigned j = 1; j <= k; ++j)
+            sum = Sub(sum, Mul(b.c[j], result.c[k - j]));
+        result.c[k] = Div(sum, b.c[0], ignored);
+    }
+    return result;
+}
+
+// The series w with w' = g u' and the constant term value, where g is the
+// series of the derivative of the function at u.
+Taylor Primitive(const Taylor& u, const Interval& value, const Taylor& g) {
+    Taylor result(u.terms, value);
+    for (unsigned k = 1; k < u.terms; ++k) {
+        Interval sum(0);
+        for (unsigned j = 1; j <= k; ++j)
+            sum = Add(sum, Mul(Mul(Interval(j), u.c[j]), g.c[k - j]));
+        result.c[k] = Over(sum, k);
+    }
+    return result;
+}
+
+// exp(factor u), whose constant term is value:
+Taylor Exp(const Taylor& u, const Interval& value, const Interval& factor) {
+    const Taylor v = Scale(factor, u);
+    Taylor result(u.terms, value);
+    for (unsigned k = 1; k < u.terms; ++k) {
+        Interval sum(0);
+        for (unsigned j = 1; j <= k; ++j)
+            sum = Add(sum, Mul(Mul(Interval(j), v.c[j]), result.c[k - j]));
+        result.c[k] = Over(sum, k);
+    }
+    return result;
+}
+
+// The solution of w' = (a + b w^2) u' whose constant term is value, for
+// tan() (a = b = 1), cot() (a = b = -1) and tanh() (a = 1, b = -1).
+Taylor Riccati(const Taylor& u, const Interval& value, double a, double b) {
+    Taylor result(u.terms, value), g(u.terms, Interval(0));
+    for (unsigned k = 1; k < u.terms; ++k) {
+        Interval square(0);
+        for (unsigned i = 0; i < k; ++i)
+            square = Add(square, Mul(result.c[i], result.c[k - 1 - i]));
+        g.c[k - 1] = Add(Interval(k == 1 ? a : 0), Mul(Interval(b), square));
+        Interval sum(0);
+        for (unsigned j = 1; j <= k; ++j)
+            sum = Add(sum, Mul(Mul(Interval(j), u.c[j]), g.c[k - j]));
+        result.c[k] = Over(sum, k);
+    }
+    return result;
+}
+
+// sin() and cos(), or sinh() and cosh() when hyperbolic, of u.
+void SinCos(const Taylor& u, bool hyperbolic, Taylor& sine, Taylor& cosine) {
+    const Interval& x = u.c[0];
+    sine = Taylor(u.terms, hyperbolic ? Increasing(sinh, x) : Periodic(sin, x, 0.5));
+    cosine = Taylor(u.terms, hyperbolic ? Cosh(x) : Periodic(cos, x, 0));
+    for (unsigned k = 1; k < u.terms; ++k) {
+        Interval sinSum(0), cosSum(0);
+        for (unsigned j = 1; j <= k; ++j) {
+            const Interval ju = Mul(Interval(j), u.c[j]);
+            sinSum = Add(sinSum, Mul(ju, cosine.c[k - j]));
+            cosSum = Add(cosSum, Mul(ju, sine.c[k - j]));
+        }
+        sine.c[k] = Over(sinSum, k);
+        cosine.c[k] = Over(hyperbolic ? cosSum : Neg(cosSum), k);
+    }
+}
+
+/* u^c for a constant c, whose constant term is value, from w' u = c u' w:
+   u is not 0, and positive unless c is an integer. The factors (c+1) j - k
+   are exact for the small integers, and rounded outwards otherwise. */
+Taylor Pow(const Taylor& u, double c, const Interval& value) {
+    const bool exact = c == floor(c) && fabs(c) < 1e7;
+    int ignored = 0;
+    const Interval inverse = Inv(u.c[0], ignored);
+    Taylor result(u.terms, value);
+    for (unsigned k = 1; k < u.terms; ++k) {
+        Interval sum(0);
+        for (unsigned j = 1; j <= k; ++j) {
+            const double factor = (c + 1) * j - double(k);
+            sum = Add(sum, Mul(Mul(exact ? Interval(factor) : Around(factor), u.c[j]), result.c[k - j]));
+        }
+        result.c[k] = Mul(Over(sum, k), inverse);
+    }
+    return result;
+}
+
+// u^n for a positive integer n, by squaring (u may contain 0):
+Taylor PowInteger(const Taylor& u, double n) {
+    Taylor result(u.terms, Interval(1)), power = u;
+    for (bool first = true; n > 0; n = floor(n / 2)) {
+        if (fmod(n, 2) == 1) {
+            result = first ? power : Mul(result, power);
+            first = false;
+        }
+        if (n > 1)
+            power = Mul(power, power);
+    }
+    result.c[0] = Pow(u.c[0], Interval(n));
+    return result;
+}
+
+// (a + b u^2)^c, for the derivatives of the inverse functions; valid if
+// a + b u^2 is positive.
+Taylor Quadratic(const Taylor& u, double a, double b, double c, bool& valid) {
+    Taylor square = Mul(u, u);
+    square.c[0] = Sqr(u.c[0]);
+    const Taylor base = Add(Taylor(u.terms, Interval(a)), Scale(Interval(b), square));
+    valid = base.c[0].lower > 0;
+    return valid ? Pow(base, c, Pow(base.c[0], Interval(c))) : base;
+}
+
+// The unary functions; false where the series are not known.
+bool TaylorFunction(unsigned opcode, Taylor& u) {
+    const Interval x = u.c[0];
+    int error = 0;
+    bool valid = true;
+    switch (opcode) {
+    case cAbs:
+        if (x.upper < 0)
+            u = Neg(u);
+        return x.lower > 0 || x.upper < 0;
+
+    case cAcos:
+    case cAsin: {
+        if (!(x.lower > -1 && x.upper < 1))
+            return false;
+        const Taylor g = Quadratic(u, 1, -1, -0.5, valid);
+        u = opcode == cAsin ? Primitive(u, Increasing(asin, x), g) :
+                              Primitive(u, Decreasing(acos, x), Neg(g));
+        break;
+    }
+
+    case cAcosh:
+    case cAsinh: {
+        if (opcode == cAcosh && !(x.lower > 1))
+            return false;
+        const Taylor g = opcode == cAcosh ? Quadratic(u, -1, 1, -0.5, valid) : Quadratic(u, 1, 1, -0.5, valid);
+        u = Primitive(u, opcode == cAcosh ? Acosh(x) : Asinh(x), g);
+        break;
+    }
+
+    case cAtan: u = Primitive(u, Increasing(atan, x), Quadratic(u, 1, 1, -1, valid)); break;
+
+    case cAtanh:
+        if (!(x.lower > -1 && x.upper < 1))
+            return false;
+        u = Primitive(u, Atanh(x), Quadratic(u, 1, -1, -1, valid));
+        break;
+
+    case cCeil:
+    case cFloor:
+    case cInt: {
+        const Interval shifted = opcode == cInt ? Add(x, Interval(.5)) : x;
+        const double lower = opcode == cCeil ? ceil(shifted.lower) : floor(shifted.lower);
+        const double upper = opcode == cCeil ? ceil(shifted.upper) : floor(shifted.upper);
+        if (lower != upper)
+            return false;
+        u = Taylor(u.terms, Interval(lower));
+        break;
+    }
+
+    case cCos:
+    case cSin:
+    case cCosh:
+    case cSinh: {
+        Taylor sine, cosine;
+        SinCos(u, opcode == cCosh || opcode == cSinh, sine, cosine);
+        u = opcode == cSin || opcode == cSinh ? sine : cosine;
+        break;
+    }
+
+    case cSec:
+    case cCsc: {
+        Taylor sine, cosine;
+        SinCos(u, false, sine, cosine);
+        const Taylor& divisor = opcode == cSec ? cosine : sine;
+        if (ContainsZero(divisor.c[0]))
+            return false;
+        u = Div(Taylor(u.terms, Interval(1)), divisor);
+        break;
+    }
+
+    case cTan:
+    case cCot: {
+        Interval g = Tan(x);
+        if (!IsFinite(g.lower) || !IsFinite(g.upper) || (opcode == cCot && ContainsZero(g)))
+            return false;
+        if (opcode == cCot)
+            g = Inv(g, error);
+        u = opcode == cTan ? Riccati(u, g, 1, 1) : Riccati(u, g, -1, -1);
+        break;
+    }
+
+    case cTanh: u = Riccati(u, Restrict(Increasing(tanh, x), -1, 1), 1, -1); break;
+
+    case cExp: u = Exp(u, Restrict(Increasing(exp, x), 0, Infinity), Interval(1)); break;
+    case cExp2:
+        u = Exp(u, Restrict(Increasing(Exp2, x), 0, Infinity), Around(0.69314718055994531));
+        break;
+
+    case cLog:
+    case cLog2:
+    case cLog10: {
+        if (!(x.lower > 0))
+            return false;
+        const Interval factor = opcode == cLog ? Interval(1) :
+                                opcode == cLog2 ? Around(1.4426950408889634) : Around(0.43429448190325183);
+        const MathFunction f = opcode == cLog ? MathFunction(log) : opcode == cLog2 ? MathFunction(fp_log2) :
+                                                                                      MathFunction(log10);
+        const Interval value = Log(f, x, error);
+        u = Primitive(u, value, Scale(factor, Div(Taylor(u.terms, Interval(1)), u)));
+        break;
+    }
+
+    case cSqrt:
+    case cRSqrt: {
+        if (!(x.lower > 0))
+            return false;
+        const Interval root = Sqrt(x, error);
+        u = opcode == cSqrt ? Pow(u, 0.5, root) : Pow(u, -0.5, Inv(root, error));
+        break;
+    }
+
+    case cInv:
+        if (ContainsZero(x))
+            return false;
+        u = Div(Taylor(u.terms, Interval(1)), u);
+        break;
+
+    case cSqr:
+        u = Mul(u, u);
+        u.c[0] = Sqr(x);
+        break;
+
+    case cNeg: u = Neg(u); break;
+    case cDeg: u = Scale(Around(180.0 / M_PI), u); break;
+    case cRad: u = Scale(Around(M_PI / 180.0), u); break;
+
+    default: return false;
+    }
+    return valid && error == 0;
+}
+
+// a^b; false where a may not be positive, unless b is a constant integer.
+bool TaylorPow(const Taylor& a, const Taylor& b, Taylor& result) {
+    if (b.c[0].lower == b.c[0].upper && IsConstant(b)) {
+        const double c = b.c[0].lower;
+        if (c == 0) {
+            result = Taylor(a.terms, Interval(1));
+            return true;
+        }
+        const bool integer = fabs(c) < PhaseLimit && c == floor(c);
+        if (integer && c > 0) {
+            result = PowInteger(a, c);
+            return true;
+        }
+        if (a.c[0].lower > 0 || (integer && !ContainsZero(a.c[0]))) {
+            result = Pow(a, c, Pow(a.c[0], Interval(c)));
+            return true;
+        }
+        return false;
+    }
+    if (!(a.c[0].lower > 0))
+        return false;
+    Taylor exponent = a;
+    if (!TaylorFunction(cLog, exponent))
+        return false;
+    result = Mul(b, exponent);
+    return TaylorFunction(cExp, result);
+}
+} // namespace
+
+template<>
+bool FunctionParser::EvalIntervalTaylor(EvalContext& context, const Interval& x, unsigned terms,
+                                        Interval* result) const {
+    context.evalErrorType = 0;
+    if (parseErrorType != FP_NO_ERROR || data->variableRefs.size() != 1 || terms == 0 || terms > TaylorMaxTerms)
+        return false;
+
+    const std::vector<unsigned>& byteCode = data->ByteCode;
+    std::vector<Taylor> Stack(data->StackSize);
+    unsigned DP = 0;
+    int SP = -1;
+    for (unsigned IP = 0; IP < byteCode.size(); ++IP) {
+        const unsigned opcode = byteCode[IP];
+        switch (opcode) {
+        case cIf: {
+            const int truth = Truth(Stack[SP--].c[0]);
+            if (truth == 0)
+                return false;
+            if (truth < 0) {
+                DP = byteCode[IP + 2];
+                IP = byteCode[IP + 1];
+            } else {
+                IP += 2;
+            }
+            break;
+        }
+
+        case cJump:
+            DP = byteCode[IP + 2];
+            IP = byteCode[IP + 1];
+            break;
+
+        case cImmed: Stack[++SP] = Taylor(terms, Interval(data->Immed[DP++])); break;
+
+        case cAdd:
+            Stack[SP - 1] = Add(Stack[SP - 1], Stack[SP]);
+            --SP;
+            break;
+
+        case cSub:
+            Stack[SP - 1] = Sub(Stack[SP - 1], Stack[SP]);
+            --SP;
+            break;
+
+        case cRSub:
+            Stack[SP - 1] = Sub(Stack[SP], Stack[SP - 1]);
+            --SP;
+            break;
+
+        case cMul:
+            Stack[SP - 1] = Mul(Stack[SP - 1], Stack[SP]);
+            --SP;
+            break;
+
+        case cDiv:
+        case cRDiv: {
+            const Taylor& divisor = Stack[opcode == cDiv ? SP : SP - 1];
+            if (ContainsZero(divisor.c[0]))
+                return false;
+            Stack[SP - 1] = opcode == cDiv ? Div(Stack[SP - 1], Stack[SP]) : Div(Stack[SP], Stack[SP - 1]);
+            --SP;
+            break;
+        }
+
+        case cPow:
+        case cRPow:
+            if (!(opcode == cPow ? TaylorPow(Stack[SP - 1], Stack[SP], Stack[SP - 1]) :
+                                   TaylorPow(Stack[SP], Stack[SP - 1], Stack[SP - 1])))
+                return false;
+            --SP;
+            break;
+
+        case cMin:
+        case cMax: {
+            const Interval& a = Stack[SP - 1].c[0];
+            const Interval& b = Stack[SP].c[0];
+            if (!(a.upper <= b.lower || b.upper <= a.lower))
+                return false;
+            const bool aIsSmaller = a.upper <= b.lower;
+            if (aIsSmaller != (opcode == cMin))
+                Stack[SP - 1] = Stack[SP];
+            --SP;
+            break;
+        }
+
+            // The logical operators are constant where their result is known:
+        case cEqual:
+        case cNEqual:
+        case cLess:
+        case cLessOrEq:
+        case cGreater:
+        case cGreaterOrEq:
+        case cAnd:
+        case cOr: {
+            const Interval a = Stack[SP - 1].c[0], b = Stack[SP].c[0];
+            Interval value;
+            if (opcode == cAnd || opcode == cOr) {
+                const int ta = Truth(a), tb = Truth(b);
+                value = opcode == cAnd ? Boolean(ta < 0 || tb < 0 ? -1 : ta > 0 && tb > 0 ? 1 : 0) :
+                                         Boolean(ta > 0 || tb > 0 ? 1 : ta < 0 && tb < 0 ? -1 : 0);
+            } else {
+                value = Compare(opcode, a, b);
+            }
+            if (value.lower != value.upper)
+                return false;
+            Stack[--SP] = Taylor(terms, value);
+            break;
+        }
+
+        case cNot:
+        case cNotNot: {
+            const int truth = Truth(Stack[SP].c[0]);
+            if (truth == 0)
+                return false;
+            Stack[SP] = Taylor(terms, Boolean(opcode == cNot ? -truth : truth));
+            break;
+        }
+
+#ifdef FP_SUPPORT_OPTIMIZER
+        case cVar: break;
+
+        case cFetch: {
+            const unsigned stackOffs = byteCode[++IP];
+            Stack[SP + 1] = Stack[stackOffs];
+            ++SP;
+            break;
+        }
+
+        case cPopNMov: {
+            const unsigned stackOffs_target = byteCode[++IP];
+            const unsigned stackOffs_source = byteCode[++IP];
+            Stack[stackOffs_target] = Stack[stackOffs_source];
+            SP = stackOffs_target;
+            break;
+        }
+
+        case cSelect: {
+            const int truth = Truth(Stack[SP - 2].c[0]);
+            if (truth == 0)
+                return false;
+            Stack[SP - 2] = truth > 0 ? Stack[SP - 1] : Stack[SP];
+            SP -= 2;
+            break;
+        }
+#endif // FP_SUPPORT_OPTIMIZER
+
+        case cDup:
+            Stack[SP + 1] = Stack[SP];
+            ++SP;
+            break;
+
+        case cNop: break;
+
+        default:
+            if (opcode >= VarBegin) {
+                Stack[++SP] = Taylor(terms, x);
+                if (terms > 1)
+                    Stack[SP].c[1] = Interval(1);
+                break;
+            }
+            if (!TaylorFunction(opcode, Stack[SP]))
+                return false;
+        }
+    }
+    for (unsigned k = 0; k < terms; ++k)
+        result[k] = Stack[SP].c[k];
+    return true;
+}
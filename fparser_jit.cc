@@ -0,0 +1,1052 @@
+/***************************************************************************\
+|* Function Parser for C++ v3.3.2                                          *|
+|*-------------------------------------------------------------------------*|
+|* Copyright: Juha Nieminen                                                *|
+\***************************************************************************/
+
+#include "stdafx.h"
+#include "fpconfig.hh"
+#include "fparser.hh"
+#include "fpaux.hh"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <map>
+
+#if defined(__x86_64__) && (defined(__unix__) || defined(__APPLE__)) && !defined(__CYGWIN__)
+#define FP_JIT_X86_64
+#include <sys/mman.h>
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#endif
+
+using namespace FUNCTIONPARSERTYPES;
+
+//=========================================================================
+// Native code compilation
+//=========================================================================
+/* Compile() translates the bytecode into x86-64 machine code (System V
+   calling convention) which Eval() then calls instead of interpreting the
+   bytecode. The generated function is
+
+     double f(const double* Vars, EvalContext* context, const FunctionParser* parser);
+
+   Stack slot s lives in register xmm<s> if s < JitRegisterSlots, and in
+   the native stack frame otherwise. xmm14 and xmm15 are scratch registers.
+   Around calls (math library functions, user-defined functions and
+   parsers, eval()) the slots in registers are spilled to the frame, which
+   also gives the calls a contiguous array of parameters.
+   The evaluation checks jump to small stubs at the end of the code which
+   store the error code in the context and return 0, like Eval() does.
+   Every operation is performed with the same instructions or the same
+   library functions as in Eval(), so the results are identical.
+*/
+#ifdef FP_JIT_X86_64
+namespace {
+const unsigned JitRegisterSlots = 14;
+
+enum GpRegister { RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7,
+                  R8, R9, R10, R11, R12, R13, R14, R15 };
+enum XmmRegister { XMM0 = 0, XMM1 = 1, XMM14 = 14, XMM15 = 15 };
+
+// Prefixes and opcodes (after 0F) of the SSE2 instructions used:
+enum SsePrefix { PD = 0x66, SD = 0xF2 };
+enum SseOpcode {
+    MOVSD_LOAD = 0x10, MOVSD_STORE = 0x11, MOVAPD = 0x28, CVTSI2SD = 0x2A,
+    CVTTSD2SI = 0x2C, UCOMISD = 0x2E, SQRTSD = 0x51, ANDPD = 0x54, XORPD = 0x57,
+    ADDSD = 0x58, MULSD = 0x59, SUBSD = 0x5C, MINSD = 0x5D, DIVSD = 0x5E,
+    MAXSD = 0x5F, CMPSD = 0xC2
+};
+enum CmpPredicate { CMP_EQ = 0, CMP_LT = 1, CMP_LE = 2, CMP_NEQ = 4 };
+enum Condition { COND_AE = 0x3, COND_E = 0x4, COND_NE = 0x5, COND_A = 0x7 };
+
+// Operand of an SSE instruction: a register, [base+disp] or a constant.
+struct Operand {
+    enum Kind { Register, Memory, Constant } kind;
+    unsigned reg;   // Register: xmm or general purpose register number
+    unsigned base;  // Memory: base register
+    int disp;       // Memory: displacement; Constant: index in the pool
+
+    static Operand Reg(unsigned r) { Operand o = { Register, r, 0, 0 }; return o; }
+    static Operand Mem(unsigned b, int d) { Operand o = { Memory, 0, b, d }; return o; }
+    static Operand Const(unsigned index) { Operand o = { Constant, 0, 0, int(index) }; return o; }
+};
+
+// Library functions are called through these so that the generated code
+// uses exactly the same implementations as Eval().
+double JitAcos(double x) { return acos(x); }
+double JitAcosh(double x) { return fp_acosh(x); }
+double JitAsin(double x) { return asin(x); }
+double JitAsinh(double x) { return fp_asinh(x); }
+double JitAtan(double x) { return atan(x); }
+double JitAtan2(double x, double y) { return atan2(x, y); }
+double JitAtanh(double x) { return fp_atanh(x); }
+double JitCeil(double x) { return ceil(x); }
+double JitCos(double x) { return cos(x); }
+double JitCosh(double x) { return cosh(x); }
+double JitExp(double x) { return exp(x); }
+double JitFloor(double x) { return floor(x); }
+double JitFmod(double x, double y) { return fmod(x, y); }
+double JitLog(double x) { return log(x); }
+double JitLog10(double x) { return log10(x); }
+#ifdef FP_SUPPORT_LOG2
+double JitLog2(double x) { return log2(x); }
+#endif
+double JitPow(double x, double y) { return pow(x, y); }
+double JitSin(double x) { return sin(x); }
+double JitSinh(double x) { return sinh(x); }
+double JitTan(double x) { return tan(x); }
+double JitTanh(double x) { return tanh(x); }
+} // namespace
+
+template<>
+class FunctionParser::JitCompiler {
+public:
+    JitCompiler(FunctionParser::Data& data);
+
+    bool Generate();
+    bool Install();
+
+    static double EvalThunk(const FunctionParser*, const double*, EvalContext*);
+    static double PCallThunk(const FunctionParser*, const double*, EvalContext*);
+
+private:
+    FunctionParser::Data& data;
+    int errorOffset; // of EvalContext::evalErrorType
+    bool checks; // false with UseFloatingPointExceptions()
+
+    std::vector<unsigned char> code;
+    std::vector<unsigned> labels; // code offset of each bytecode address
+    struct JumpFixup {
+        size_t position;
+        unsigned target;
+    };
+    std::vector<JumpFixup> jumps; // to bytecode addresses
+    std::vector<JumpFixup> errorJumps; // to the stub of an error code
+    struct ConstantFixup {
+        size_t position, instructionEnd;
+        unsigned index;
+    };
+    std::vector<ConstantFixup> constantFixups;
+    std::vector<unsigned long long> constants;
+    std::map<unsigned long long, unsigned> constantIndex;
+
+    // Encoding:
+    void Byte(unsigned b) { code.push_back((unsigned char)b); }
+    void Dword(unsigned d) {
+        for (int i = 0; i < 4; ++i) Byte((d >> (8 * i)) & 0xFF);
+    }
+    void Qword(unsigned long long q) {
+        for (int i = 0; i < 8; ++i) Byte(unsigned(q >> (8 * i)) & 0xFF);
+    }
+    void Sse(unsigned prefix, unsigned opcode, unsigned reg, const Operand& rm, int imm8 = -1);
+
+    unsigned ConstantBits(unsigned long long bits);
+    Operand ConstantValue(double value);
+
+    // Stack slots:
+    static Operand Slot(int s) {
+        return unsigned(s) < JitRegisterSlots ? Operand::Reg(unsigned(s)) : Frame(s);
+    }
+    static Operand Frame(int s) { return Operand::Mem(RSP, 8 * s); }
+
+    void Load(unsigned xmm, const Operand& src);
+    void Store(const Operand& dst, unsigned xmm);
+    void Move(const Operand& dst, const Operand& src);
+    unsigned BeginUpdate(int s);
+    void EndUpdate(int s, unsigned xmm);
+    void Binary(SseOpcode, int dst, const Operand& src);
+    void Compare(CmpPredicate, const Operand& lhs, const Operand& rhs, int dst);
+    void Truth(unsigned gpr, const Operand& value);
+    void BooleanFromAl(int dst);
+    void Reciprocal(int s);
+
+    void SpillSlots(int count);
+    void ReloadSlots(int count);
+    void CallAddress(const void* function);
+    void CallUnary(double (*)(double), int s);
+    void CallBinary(double (*)(double, double), int first, int second, int dst);
+    void PointerToFrame(unsigned gpr, int s);
+
+    void Jump(unsigned target);
+    void JumpIf(Condition, unsigned target);
+    void ErrorIf(Condition, int error);
+#ifndef FP_NO_EVALUATION_CHECKS
+    void ErrorIfZero(const Operand& value, int error);
+    void ErrorIfNegative(const Operand& value, int error, bool orZero);
+    void ErrorIfOutsideUnit(const Operand& value, int error);
+#endif
+};
+
+//---------------------------------------------------------------------------
+// Instruction encoding
+//---------------------------------------------------------------------------
+void FunctionParser::JitCompiler::Sse(unsigned prefix, unsigned opcode, unsigned reg, const Operand& rm, int imm8) {
+    Byte(prefix);
+    unsigned rex = (reg >> 3) << 2;
+    if (rm.kind == Operand::Register)
+        rex |= rm.reg >> 3;
+    else if (rm.kind == Operand::Memory)
+        rex |= rm.base >> 3;
+    if (rex)
+        Byte(0x40 | rex);
+    Byte(0x0F);
+    Byte(opcode);
+
+    size_t dispPosition = 0;
+    switch (rm.kind) {
+    case Operand::Register:
+        Byte(0xC0 | ((reg & 7) << 3) | (rm.reg & 7));
+        break;
+    case Operand::Memory:
+        Byte(0x80 | ((reg & 7) << 3) | (rm.base & 7));
+        if ((rm.base & 7) == RSP)
+            Byte(0x24); // SIB: no index
+        Dword(unsigned(rm.disp));
+        break;
+    case Operand::Constant:
+        Byte(((reg & 7) << 3) | 5); // [rip+disp32]
+        dispPosition = code.size();
+        Dword(0);
+        break;
+    }
+    if (imm8 >= 0)
+        Byte(unsigned(imm8));
+
+    if (rm.kind == Operand::Constant) {
+        ConstantFixup fixup = { dispPosition, code.size(), unsigned(rm.disp) };
+        constantFixups.push_back(fixup);
+    }
+}
+
+// Every constant takes 16 bytes so that it can also be used as the memory
+// operand of the packed bitwise instructions.
+unsigned FunctionParser::JitCompiler::ConstantBits(unsigned long long bits) {
+    std::map<unsigned long long, unsigned>::iterator iter = constantIndex.find(bits);
+    if (iter != constantIndex.end())
+        return iter->second;
+    constants.push_back(bits);
+    return constantIndex[bits] = unsigned(constants.size() - 1);
+}
+
+Operand FunctionParser::JitCompiler::ConstantValue(double value) {
+    unsigned long long bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return Operand::Const(ConstantBits(bits));
+}
+
+//---------------------------------------------------------------------------
+// Slot access
+//---------------------------------------------------------------------------
+void FunctionParser::JitCompiler::Load(unsigned xmm, const Operand& src) {
+    if (src.kind == Operand::Register) {
+        if (src.reg != xmm)
+            Sse(PD, MOVAPD, xmm, src);
+    } else
+        Sse(SD, MOVSD_LOAD, xmm, src);
+}
+
+void FunctionParser::JitCompiler::Store(const Operand& dst, unsigned xmm) {
+    if (dst.kind == Operand::Register)
+        Load(dst.reg, Operand::Reg(xmm));
+    else
+        Sse(SD, MOVSD_STORE, xmm, dst);
+}
+
+void FunctionParser::JitCompiler::Move(const Operand& dst, const Operand& src) {
+    if (dst.kind == Operand::Register)
+        Load(dst.reg, src);
+    else if (src.kind == Operand::Register)
+        Store(dst, src.reg);
+    else {
+        Load(XMM15, src);
+        Store(dst, XMM15);
+    }
+}
+
+// Returns a register holding slot s which can be modified in place.
+unsigned FunctionParser::JitCompiler::BeginUpdate(int s) {
+    const Operand slot = Slot(s);
+    if (slot.kind == Operand::Register)
+        return slot.reg;
+    Load(XMM15, slot);
+    return XMM15;
+}
+
+void FunctionParser::JitCompiler::EndUpdate(int s, unsigned xmm) {
+    Store(Slot(s), xmm);
+}
+
+void FunctionParser::JitCompiler::Binary(SseOpcode opcode, int dst, const Operand& src) {
+    const unsigned reg = BeginUpdate(dst);
+    Sse(SD, opcode, reg, src);
+    EndUpdate(dst, reg);
+}
+
+// Slot dst = (lhs <predicate> rhs) ? 1 : 0
+void FunctionParser::JitCompiler::Compare(CmpPredicate predicate, const Operand& lhs, const Operand& rhs, int dst) {
+    Load(XMM15, lhs);
+    Sse(SD, CMPSD, XMM15, rhs, predicate);
+    Sse(PD, ANDPD, XMM15, ConstantValue(1.0));
+    Store(Slot(dst), XMM15);
+}
+
+// Sets gpr to the magnitude of doubleToInt(value), which is zero exactly
+// when doubleToInt(value) is: cvttsd2si(fabs(value) + 0.5).
+void FunctionParser::JitCompiler::Truth(unsigned gpr, const Operand& value) {
+    Load(XMM15, value);
+    Sse(PD, ANDPD, XMM15, Operand::Const(ConstantBits(0x7FFFFFFFFFFFFFFFULL)));
+    Sse(SD, ADDSD, XMM15, ConstantValue(0.5));
+    Sse(SD, CVTTSD2SI, gpr, Operand::Reg(XMM15));
+}
+
+// Slot dst = al (which is 0 or 1)
+void FunctionParser::JitCompiler::BooleanFromAl(int dst) {
+    Byte(0x0F); Byte(0xB6); Byte(0xC0); // movzx eax, al
+    Sse(SD, CVTSI2SD, XMM15, Operand::Reg(RAX));
+    Store(Slot(dst), XMM15);
+}
+
+// Slot s = 1 / slot s
+void FunctionParser::JitCompiler::Reciprocal(int s) {
+    Load(XMM14, ConstantValue(1.0));
+    Sse(SD, DIVSD, XMM14, Slot(s));
+    Store(Slot(s), XMM14);
+}
+
+//---------------------------------------------------------------------------
+// Calls
+//---------------------------------------------------------------------------
+void FunctionParser::JitCompiler::SpillSlots(int count) {
+    for (int s = 0; s < count && unsigned(s) < JitRegisterSlots; ++s)
+        Sse(SD, MOVSD_STORE, unsigned(s), Frame(s));
+}
+
+void FunctionParser::JitCompiler::ReloadSlots(int count) {
+    for (int s = 0; s < count && unsigned(s) < JitRegisterSlots; ++s)
+        Sse(SD, MOVSD_LOAD, unsigned(s), Frame(s));
+}
+
+void FunctionParser::JitCompiler::CallAddress(const void* function) {
+    Byte(0x48); Byte(0xB8); // mov rax, imm64
+    unsigned long long address;
+    std::memcpy(&address, &function, sizeof(address));
+    Qword(address);
+    Byte(0xFF); Byte(0xD0); // call rax
+}
+
+void FunctionParser::JitCompiler::CallUnary(double (*function)(double), int s) {
+    SpillSlots(s);
+    Load(XMM0, Slot(s));
+    CallAddress(reinterpret_cast<const void*>(function));
+    Load(XMM15, Operand::Reg(XMM0));
+    ReloadSlots(s);
+    Store(Slot(s), XMM15);
+}
+
+// Slot dst = function(first, second); the slots from dst up are discarded.
+void FunctionParser::JitCompiler::CallBinary(double (*function)(double, double), int first, int second, int dst) {
+    SpillSlots(dst);
+    Load(XMM14, Slot(first));
+    Load(XMM15, Slot(second));
+    Load(XMM0, Operand::Reg(XMM14));
+    Load(XMM1, Operand::Reg(XMM15));
+    CallAddress(reinterpret_cast<const void*>(function));
+    Load(XMM15, Operand::Reg(XMM0));
+    ReloadSlots(dst);
+    Store(Slot(dst), XMM15);
+}
+
+// lea gpr, [rsp + 8*s]  (gpr must be rdi, rsi or rdx)
+void FunctionParser::JitCompiler::PointerToFrame(unsigned gpr, int s) {
+    Byte(0x48); Byte(0x8D); Byte(0x84 | (gpr << 3)); Byte(0x24);
+    Dword(unsigned(8 * s));
+}
+
+//---------------------------------------------------------------------------
+// Jumps and evaluation checks
+//---------------------------------------------------------------------------
+void FunctionParser::JitCompiler::Jump(unsigned target) {
+    Byte(0xE9);
+    JumpFixup fixup = { code.size(), target };
+    jumps.push_back(fixup);
+    Dword(0);
+}
+
+void FunctionParser::JitCompiler::JumpIf(Condition condition, unsigned target) {
+    Byte(0x0F); Byte(0x80 | condition);
+    JumpFixup fixup = { code.size(), target };
+    jumps.push_back(fixup);
+    Dword(0);
+}
+
+void FunctionParser::JitCompiler::ErrorIf(Condition condition, int error) {
+    Byte(0x0F); Byte(0x80 | condition);
+    JumpFixup fixup = { code.size(), unsigned(error) };
+    errorJumps.push_back(fixup);
+    Dword(0);
+}
+
+#ifndef FP_NO_EVALUATION_CHECKS
+// ucomisd reports unordered operands as equal, so NaNs are excluded first.
+void FunctionParser::JitCompiler::ErrorIfZero(const Operand& value, int error) {
+    if (!checks)
+        return;
+    Sse(PD, XORPD, XMM14, Operand::Reg(XMM14));
+    Sse(PD, UCOMISD, XMM14, value);
+    Byte(0x7A); Byte(0x06); // jp over the following je
+    ErrorIf(COND_E, error);
+}
+
+void FunctionParser::JitCompiler::ErrorIfNegative(const Operand& value, int error, bool orZero) {
+    if (!checks)
+        return;
+    Sse(PD, XORPD, XMM14, Operand::Reg(XMM14));
+    Sse(PD, UCOMISD, XMM14, value); // 0 > value, or 0 >= value
+    ErrorIf(orZero ? COND_AE : COND_A, error);
+}
+
+void FunctionParser::JitCompiler::ErrorIfOutsideUnit(const Operand& value, int error) {
+    if (!checks)
+        return;
+    Load(XMM14, ConstantValue(-1.0));
+    Sse(PD, UCOMISD, XMM14, value); // -1 > value
+    ErrorIf(COND_A, error);
+    Load(XMM14, value);
+    Sse(PD, UCOMISD, XMM14, ConstantValue(1.0)); // value > 1
+    ErrorIf(COND_A, error);
+}
+#endif
+
+//---------------------------------------------------------------------------
+// Code generation
+//---------------------------------------------------------------------------
+FunctionParser::JitCompiler::JitCompiler(FunctionParser::Data& data)
+    : data(data), checks(!data.useFPExceptions) {
+    const EvalContext probe;
+    errorOffset = int(reinterpret_cast<const char*>(&probe.evalErrorType) -
+                      reinterpret_cast<const char*>(&probe));
+}
+
+bool FunctionParser::JitCompiler::Generate() {
+    const std::vector<unsigned>& ByteCode = data.ByteCode;
+    const unsigned ByteCodeSize = unsigned(ByteCode.size());
+    const unsigned frameSize = (8 * data.StackSize + 15) & ~15U;
+
+    // Stack pointer and immediate index at the jump targets:
+    std::vector<int> targetSP(ByteCodeSize + 1, -2);
+    std::vector<unsigned> targetDP(ByteCodeSize + 1, 0);
+    labels.assign(ByteCodeSize + 1, 0);
+
+    // Prologue. After the three pushes the stack is 16-byte aligned.
+    Byte(0x53); // push rbx
+    Byte(0x41); Byte(0x54); // push r12
+    Byte(0x41); Byte(0x55); // push r13
+    Byte(0x48); Byte(0x89); Byte(0xF3); // mov rbx, rsi  (context)
+    Byte(0x49); Byte(0x89); Byte(0xFC); // mov r12, rdi  (Vars)
+    Byte(0x49); Byte(0x89); Byte(0xD5); // mov r13, rdx  (parser)
+    Byte(0x48); Byte(0x81); Byte(0xEC); Dword(frameSize); // sub rsp, frameSize
+    Byte(0xC7); Byte(0x83); Dword(errorOffset); Dword(0); // mov dword [rbx+error], 0
+
+    unsigned IP, DP = 0;
+    int SP = -1;
+    bool reachable = true;
+
+    for (IP = 0; IP < ByteCodeSize; ++IP) {
+        labels[IP] = unsigned(code.size());
+        if (targetSP[IP] != -2) {
+            // After an unconditional jump the state comes from the jumps here.
+            if (!reachable) {
+                SP = targetSP[IP];
+                DP = targetDP[IP];
+            }
+            reachable = true;
+        }
+
+        switch (ByteCode[IP]) {
+            // Functions:
+        case cAbs: {
+            const unsigned reg = BeginUpdate(SP);
+            Sse(PD, ANDPD, reg, Operand::Const(ConstantBits(0x7FFFFFFFFFFFFFFFULL)));
+            EndUpdate(SP, reg);
+            break;
+        }
+
+        case cAcos:
+#ifndef FP_NO_EVALUATION_CHECKS
+            ErrorIfOutsideUnit(Slot(SP), 4);
+#endif
+            CallUnary(JitAcos, SP);
+            break;
+
+        case cAcosh: CallUnary(JitAcosh, SP); break;
+
+        case cAsin:
+#ifndef FP_NO_EVALUATION_CHECKS
+            ErrorIfOutsideUnit(Slot(SP), 4);
+#endif
+            CallUnary(JitAsin, SP);
+            break;
+
+        case cAsinh: CallUnary(JitAsinh, SP); break;
+        case cAtan: CallUnary(JitAtan, SP); break;
+
+        case cAtan2:
+            CallBinary(JitAtan2, SP - 1, SP, SP - 1);
+            --SP;
+            break;
+
+        case cAtanh: CallUnary(JitAtanh, SP); break;
+        case cCeil: CallUnary(JitCeil, SP); break;
+        case cCos: CallUnary(JitCos, SP); break;
+        case cCosh: CallUnary(JitCosh, SP); break;
+
+        case cCot:
+            CallUnary(JitTan, SP);
+#ifndef FP_NO_EVALUATION_CHECKS
+            ErrorIfZero(Slot(SP), 1);
+#endif
+            Reciprocal(SP);
+            break;
+
+        case cCsc:
+            CallUnary(JitSin, SP);
+#ifndef FP_NO_EVALUATION_CHECKS
+            ErrorIfZero(Slot(SP), 1);
+#endif
+            Reciprocal(SP);
+            break;
+
+#ifndef FP_DISABLE_EVAL
+        case cEval: {
+            const int varAmount = int(data.variableRefs.size());
+            const int first = SP - varAmount + 1;
+            SpillSlots(SP + 1);
+            Byte(0x4C); Byte(0x89); Byte(0xEF); // mov rdi, r13
+            PointerToFrame(RSI, first);
+            Byte(0x48); Byte(0x89); Byte(0xDA); // mov rdx, rbx
+            CallAddress(reinterpret_cast<const void*>(&EvalThunk));
+            Load(XMM15, Operand::Reg(XMM0));
+            ReloadSlots(first);
+            Store(Slot(first), XMM15);
+            SP = first;
+            break;
+        }
+#endif
+
+        case cExp: CallUnary(JitExp, SP); break;
+
+        case cExp2: {
+            SpillSlots(SP);
+            Load(XMM15, Slot(SP));
+            Load(XMM0, ConstantValue(2.0));
+            Load(XMM1, Operand::Reg(XMM15));
+            CallAddress(reinterpret_cast<const void*>(&JitPow));
+            Load(XMM15, Operand::Reg(XMM0));
+            ReloadSlots(SP);
+            Store(Slot(SP), XMM15);
+            break;
+        }
+
+        case cFloor: CallUnary(JitFloor, SP); break;
+
+        case cIf: {
+            const unsigned jumpAddr = ByteCode[++IP];
+            const unsigned immedAddr = ByteCode[++IP];
+            Truth(RAX, Slot(SP));
+            Byte(0x85); Byte(0xC0); // test eax, eax
+            --SP;
+            JumpIf(COND_E, jumpAddr + 1);
+            targetSP[jumpAddr + 1] = SP;
+            targetDP[jumpAddr + 1] = immedAddr;
+            break;
+        }
+
+        case cInt:
+            Binary(ADDSD, SP, ConstantValue(.5));
+            CallUnary(JitFloor, SP);
+            break;
+
+        case cLog:
+#ifndef FP_NO_EVALUATION_CHECKS
+            ErrorIfNegative(Slot(SP), 3, true);
+#endif
+            CallUnary(JitLog, SP);
+            break;
+
+        case cLog10:
+#ifndef FP_NO_EVALUATION_CHECKS
+            ErrorIfNegative(Slot(SP), 3, true);
+#endif
+            CallUnary(JitLog10, SP);
+            break;
+
+        case cLog2:
+#ifndef FP_NO_EVALUATION_CHECKS
+            ErrorIfNegative(Slot(SP), 3, true);
+#endif
+#ifdef FP_SUPPORT_LOG2
+            CallUnary(JitLog2, SP);
+#else
+            CallUnary(JitLog, SP);
+            Binary(MULSD, SP, ConstantValue(1.4426950408889634074));
+#endif
+            break;
+
+        // minsd/maxsd return the second operand unless the comparison holds,
+        // which is exactly what Min() and Max() do.
+        case cMax:
+            Binary(MAXSD, SP - 1, Slot(SP));
+            --SP;
+            break;
+
+        case cMin:
+            Binary(MINSD, SP - 1, Slot(SP));
+            --SP;
+            break;
+
+        case cPow:
+            CallBinary(JitPow, SP - 1, SP, SP - 1);
+            --SP;
+            break;
+
+        case cRPow:
+            CallBinary(JitPow, SP, SP - 1, SP - 1);
+            --SP;
+            break;
+
+        case cSec:
+            CallUnary(JitCos, SP);
+#ifndef FP_NO_EVALUATION_CHECKS
+            ErrorIfZero(Slot(SP), 1);
+#endif
+            Reciprocal(SP);
+            break;
+
+        case cSin: CallUnary(JitSin, SP); break;
+        case cSinh: CallUnary(JitSinh, SP); break;
+
+        case cSqrt:
+#ifndef FP_NO_EVALUATION_CHECKS
+            ErrorIfNegative(Slot(SP), 2, false);
+#endif
+            Binary(SQRTSD, SP, Slot(SP));
+            break;
+
+        case cTan: CallUnary(JitTan, SP); break;
+        case cTanh: CallUnary(JitTanh, SP); break;
+
+            // Misc:
+        case cImmed:
+            Move(Slot(++SP), ConstantValue(data.Immed[DP++]));
+            break;
+
+        case cJump:
+            targetSP[ByteCode[IP + 1] + 1] = SP;
+            targetDP[ByteCode[IP + 1] + 1] = ByteCode[IP + 2];
+            Jump(ByteCode[IP + 1] + 1);
+            IP += 2;
+            reachable = false;
+            break;
+
+            // Operators:
+        case cNeg: {
+            const unsigned reg = BeginUpdate(SP);
+            Sse(PD, XORPD, reg, Operand::Const(ConstantBits(0x8000000000000000ULL)));
+            EndUpdate(SP, reg);
+            break;
+        }
+
+        case cAdd:
+            Binary(ADDSD, SP - 1, Slot(SP));
+            --SP;
+            break;
+
+        case cSub:
+            Binary(SUBSD, SP - 1, Slot(SP));
+            --SP;
+            break;
+
+        case cMul:
+            Binary(MULSD, SP - 1, Slot(SP));
+            --SP;
+            break;
+
+        case cDiv:
+#ifndef FP_NO_EVALUATION_CHECKS
+            ErrorIfZero(Slot(SP), 1);
+#endif
+            Binary(DIVSD, SP - 1, Slot(SP));
+            --SP;
+            break;
+
+        case cMod:
+#ifndef FP_NO_EVALUATION_CHECKS
+            ErrorIfZero(Slot(SP), 1);
+#endif
+            CallBinary(JitFmod, SP - 1, SP, SP - 1);
+            --SP;
+            break;
+
+#ifdef FP_EPSILON
+        case cEqual: // |x-y| <= eps
+            Load(XMM14, Slot(SP - 1));
+            Sse(SD, SUBSD, XMM14, Slot(SP));
+            Sse(PD, ANDPD, XMM14, Operand::Const(ConstantBits(0x7FFFFFFFFFFFFFFFULL)));
+            Compare(CMP_LE, Operand::Reg(XMM14), ConstantValue(FP_EPSILON), SP - 1);
+            --SP;
+            break;
+
+        case cNEqual: // eps <= |x-y|
+            Load(XMM14, Slot(SP - 1));
+            Sse(SD, SUBSD, XMM14, Slot(SP));
+            Sse(PD, ANDPD, XMM14, Operand::Const(ConstantBits(0x7FFFFFFFFFFFFFFFULL)));
+            Compare(CMP_LE, ConstantValue(FP_EPSILON), Operand::Reg(XMM14), SP - 1);
+            --SP;
+            break;
+
+        case cLess: // x < y-eps
+            Load(XMM14, Slot(SP));
+            Sse(SD, SUBSD, XMM14, ConstantValue(FP_EPSILON));
+            Compare(CMP_LT, Slot(SP - 1), Operand::Reg(XMM14), SP - 1);
+            --SP;
+            break;
+
+        case cLessOrEq: // x <= y+eps
+            Load(XMM14, Slot(SP));
+            Sse(SD, ADDSD, XMM14, ConstantValue(FP_EPSILON));
+            Compare(CMP_LE, Slot(SP - 1), Operand::Reg(XMM14), SP - 1);
+            --SP;
+            break;
+
+        case cGreater: // y < x-eps
+            Load(XMM14, Slot(SP - 1));
+            Sse(SD, SUBSD, XMM14, ConstantValue(FP_EPSILON));
+            Compare(CMP_LT, Slot(SP), Operand::Reg(XMM14), SP - 1);
+            --SP;
+            break;
+
+        case cGreaterOrEq: // y <= x+eps
+            Load(XMM14, Slot(SP - 1));
+            Sse(SD, ADDSD, XMM14, ConstantValue(FP_EPSILON));
+            Compare(CMP_LE, Slot(SP), Operand::Reg(XMM14), SP - 1);
+            --SP;
+            break;
+#else
+        case cEqual:
+            Compare(CMP_EQ, Slot(SP - 1), Slot(SP), SP - 1);
+            --SP;
+            break;
+
+        case cNEqual:
+            Compare(CMP_NEQ, Slot(SP - 1), Slot(SP), SP - 1);
+            --SP;
+            break;
+
+        case cLess:
+            Compare(CMP_LT, Slot(SP - 1), Slot(SP), SP - 1);
+            --SP;
+            break;
+
+        case cLessOrEq:
+            Compare(CMP_LE, Slot(SP - 1), Slot(SP), SP - 1);
+            --SP;
+            break;
+
+        case cGreater:
+            Compare(CMP_LT, Slot(SP), Slot(SP - 1), SP - 1);
+            --SP;
+            break;
+
+        case cGreaterOrEq:
+            Compare(CMP_LE, Slot(SP), Slot(SP - 1), SP - 1);
+            --SP;
+            break;
+#endif
+
+        case cNot:
+            Truth(RAX, Slot(SP));
+            Byte(0x85); Byte(0xC0); // test eax, eax
+            Byte(0x0F); Byte(0x94); Byte(0xC0); // sete al
+            BooleanFromAl(SP);
+            break;
+
+        case cAnd:
+        case cOr:
+            Truth(RAX, Slot(SP - 1));
+            Truth(RCX, Slot(SP));
+            Byte(0x85); Byte(0xC0); // test eax, eax
+            Byte(0x0F); Byte(0x95); Byte(0xC0); // setne al
+            Byte(0x85); Byte(0xC9); // test ecx, ecx
+            Byte(0x0F); Byte(0x95); Byte(0xC1); // setne cl
+            Byte(ByteCode[IP] == cAnd ? 0x20 : 0x08); Byte(0xC8); // and/or al, cl
+            BooleanFromAl(SP - 1);
+            --SP;
+            break;
+
+        case cNotNot:
+            Truth(RAX, Slot(SP));
+            Byte(0x85); Byte(0xC0); // test eax, eax
+            Byte(0x0F); Byte(0x95); Byte(0xC0); // setne al
+            BooleanFromAl(SP);
+            break;
+
+            // Degrees-radians conversion:
+        case cDeg: Binary(MULSD, SP, ConstantValue(RadiansToDegrees(1.0))); break;
+        case cRad: Binary(MULSD, SP, ConstantValue(DegreesToRadians(1.0))); break;
+
+            // User-defined function calls:
+        case cFCall: {
+            const unsigned index = ByteCode[++IP];
+            const int first = SP - int(data.FuncPtrs[index].params) + 1;
+            SpillSlots(SP + 1);
+            PointerToFrame(RDI, first);
+            CallAddress(reinterpret_cast<const void*>(data.FuncPtrs[index].funcPtr));
+            Load(XMM15, Operand::Reg(XMM0));
+            ReloadSlots(first);
+            Store(Slot(first), XMM15);
+            SP = first;
+            break;
+        }
+
+        case cPCall: {
+            const unsigned index = ByteCode[++IP];
+            const int first = SP - int(data.FuncParsers[index].params) + 1;
+            SpillSlots(SP + 1);
+            Byte(0x48); Byte(0xBF); // mov rdi, imm64
+            Qword(reinterpret_cast<unsigned long long>(data.FuncParsers[index].parserPtr));
+            PointerToFrame(RSI, first);
+            Byte(0x48); Byte(0x89); Byte(0xDA); // mov rdx, rbx
+            CallAddress(reinterpret_cast<const void*>(&PCallThunk));
+            Load(XMM15, Operand::Reg(XMM0));
+            ReloadSlots(first);
+            Store(Slot(first), XMM15);
+            SP = first;
+            Byte(0x83); Byte(0xBB); Dword(errorOffset); Byte(0x00); // cmp dword [rbx+error], 0
+            ErrorIf(COND_NE, 0); // the error code is already stored
+            break;
+        }
+
+#ifdef FP_SUPPORT_OPTIMIZER
+        case cVar: break; // Paranoia. These should never exist
+
+        case cFetch:
+            Move(Slot(SP + 1), Slot(ByteCode[++IP]));
+            ++SP;
+            break;
+
+        case cPopNMov: {
+            const unsigned target = ByteCode[++IP];
+            const unsigned source = ByteCode[++IP];
+            Move(Slot(target), Slot(source));
+            SP = int(target);
+            break;
+        }
+
+        case cSelect:
+            // b ^ ((a ^ b) & mask), with the mask all ones if the condition is true
+            Truth(RAX, Slot(SP - 2));
+            Byte(0x85); Byte(0xC0); // test eax, eax
+            Byte(0x0F); Byte(0x95); Byte(0xC0); // setne al
+            Byte(0x0F); Byte(0xB6); Byte(0xC0); // movzx eax, al
+            Byte(0x48); Byte(0xF7); Byte(0xD8); // neg rax
+            Load(XMM14, Slot(SP - 1));
+            Load(XMM15, Slot(SP));
+            Sse(PD, XORPD, XMM14, Operand::Reg(XMM15));
+            Byte(0x66); Byte(0x4C); Byte(0x0F); Byte(0x7E); Byte(0xF1); // movq rcx, xmm14
+            Byte(0x48); Byte(0x21); Byte(0xC1); // and rcx, rax
+            Byte(0x66); Byte(0x4C); Byte(0x0F); Byte(0x6E); Byte(0xF1); // movq xmm14, rcx
+            Sse(PD, XORPD, XMM15, Operand::Reg(XMM14));
+            Store(Slot(SP - 2), XMM15);
+            SP -= 2;
+            break;
+#endif // FP_SUPPORT_OPTIMIZER
+
+        case cDup:
+            Move(Slot(SP + 1), Slot(SP));
+            ++SP;
+            break;
+
+        case cInv:
+#ifndef FP_NO_EVALUATION_CHECKS
+            ErrorIfZero(Slot(SP), 1);
+#endif
+            Reciprocal(SP);
+            break;
+
+        case cSqr: {
+            const unsigned reg = BeginUpdate(SP);
+            Sse(SD, MULSD, reg, Operand::Reg(reg));
+            EndUpdate(SP, reg);
+            break;
+        }
+
+        case cRDiv:
+#ifndef FP_NO_EVALUATION_CHECKS
+            ErrorIfZero(Slot(SP - 1), 1);
+#endif
+            Load(XMM14, Slot(SP));
+            Sse(SD, DIVSD, XMM14, Slot(SP - 1));
+            Store(Slot(SP - 1), XMM14);
+            --SP;
+            break;
+
+        case cRSub:
+            Load(XMM14, Slot(SP));
+            Sse(SD, SUBSD, XMM14, Slot(SP - 1));
+            Store(Slot(SP - 1), XMM14);
+            --SP;
+            break;
+
+        case cRSqrt:
+#ifndef FP_NO_EVALUATION_CHECKS
+            ErrorIfZero(Slot(SP), 1);
+#endif
+            Binary(SQRTSD, SP, Slot(SP));
+            Reciprocal(SP);
+            break;
+
+        case cNop:
+            break;
+
+            // Variables:
+        default:
+            if (ByteCode[IP] < VarBegin)
+                return false; // Not supported; Eval() interprets the bytecode
+            Move(Slot(++SP), Operand::Mem(R12, 8 * int(ByteCode[IP] - VarBegin)));
+        }
+    }
+    labels[ByteCodeSize] = unsigned(code.size());
+    if (targetSP[ByteCodeSize] != -2 && !reachable)
+        SP = targetSP[ByteCodeSize];
+
+    // Epilogue
+    Load(XMM0, Slot(SP));
+    const size_t epilogue = code.size();
+    Byte(0x48); Byte(0x81); Byte(0xC4); Dword(frameSize); // add rsp, frameSize
+    Byte(0x41); Byte(0x5D); // pop r13
+    Byte(0x41); Byte(0x5C); // pop r12
+    Byte(0x5B); // pop rbx
+    Byte(0xC3); // ret
+
+    // Error stubs: store the error code (unless 0) and return 0.
+    std::map<unsigned, size_t> errorStubs;
+    for (size_t i = 0; i < errorJumps.size(); ++i) {
+        const unsigned error = errorJumps[i].target;
+        if (errorStubs.find(error) != errorStubs.end())
+            continue;
+        errorStubs[error] = code.size();
+        if (error) {
+            Byte(0xC7); Byte(0x83); Dword(errorOffset); Dword(error); // mov dword [rbx+error], error
+        }
+        Sse(PD, XORPD, XMM0, Operand::Reg(XMM0));
+        Byte(0xE9); Dword(unsigned(epilogue - (code.size() + 4))); // jmp epilogue
+    }
+
+    // Constant pool
+    while (code.size() % 16) Byte(0xCC);
+    const size_t pool = code.size();
+    for (size_t i = 0; i < constants.size(); ++i) {
+        Qword(constants[i]);
+        Qword(constants[i]);
+    }
+
+    // Resolve the relative displacements
+    for (size_t i = 0; i < jumps.size(); ++i) {
+        const unsigned rel = unsigned(labels[jumps[i].target] - (jumps[i].position + 4));
+        std::memcpy(&code[jumps[i].position], &rel, 4);
+    }
+    for (size_t i = 0; i < errorJumps.size(); ++i) {
+        const unsigned rel = unsigned(errorStubs[errorJumps[i].target] - (errorJumps[i].position + 4));
+        std::memcpy(&code[errorJumps[i].position], &rel, 4);
+    }
+    for (size_t i = 0; i < constantFixups.size(); ++i) {
+        const ConstantFixup& fixup = constantFixups[i];
+        const unsigned rel = unsigned(pool + 16 * fixup.index - fixup.instructionEnd);
+        std::memcpy(&code[fixup.position], &rel, 4);
+    }
+    return true;
+}
+
+bool FunctionParser::JitCompiler::Install() {
+    void* memory = mmap(0, code.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+        return false;
+    std::memcpy(memory, &code[0], code.size());
+    if (mprotect(memory, code.size(), PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, code.size());
+        return false;
+    }
+    data.compiledFunction = reinterpret_cast<Data::CompiledFunction>(memory);
+    data.compiledCodeSize = code.size();
+    return true;
+}
+
+//---------------------------------------------------------------------------
+// Helpers called from the generated code
+//---------------------------------------------------------------------------
+double FunctionParser::JitCompiler::EvalThunk(const FunctionParser* parser, const double* Vars,
+                                              EvalContext* context) {
+    if (context->evalRecursionLevel == FP_EVAL_MAX_REC_LEVEL)
+        return 0;
+    EvalContext& nested = context->Nested();
+    nested.evalRecursionLevel = context->evalRecursionLevel + 1;
+    return parser->Eval(nested, Vars);
+}
+
+double FunctionParser::JitCompiler::PCallThunk(const FunctionParser* parser, const double* Vars,
+                                               EvalContext* context) {
+    EvalContext& nested = context->Nested();
+    nested.evalErrorType = 0;
+    nested.evalRecursionLevel = 0;
+    const double retVal = parser->Eval(nested, Vars);
+    context->evalErrorType = nested.evalErrorType;
+    return retVal;
+}
+#endif // FP_JIT_X86_64
+
+//---------------------------------------------------------------------------
+// Public interface
+//---------------------------------------------------------------------------
+template<>
+bool FunctionParser::Compile() {
+    if (parseErrorType != FP_NO_ERROR)
+        return false;
+    if (data->compiledFunction)
+        return true;
+
+#ifdef FP_JIT_X86_64
+    JitCompiler compiler(*data);
+    return compiler.Generate() && compiler.Install();
+#else
+    return false;
+#endif
+}
+
+// Whether Compile() would succeed (unless it runs out of memory).
+template<>
+bool FunctionParser::CanCompile() const {
+    if (parseErrorType != FP_NO_ERROR)
+        return false;
+    if (data->compiledFunction)
+        return true;
+
+#ifdef FP_JIT_X86_64
+    JitCompiler compiler(*data);
+    return compiler.Generate();
+#else
+    return false;
+#endif
+}
+
+template<>
+void FunctionParser::Data::ReleaseCompiledCode() {
+#ifdef FP_JIT_X86_64
+    if (compiledFunction)
+        munmap(reinterpret_cast<void*>(compiledFunction), compiledCodeSize);
+#endif
+    compiledFunction = 0;
+    compiledCodeSize = 0;
+}
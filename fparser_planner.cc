@@ -0,0 +1,154 @@
+/***************************************************************************\
+|* Function Parser for C++ v3.3.2                                          *|
+|*-------------------------------------------------------------------------*|
+|* Copyright: Juha Nieminen                                                *|
+\***************************************************************************/
+
+#include "stdafx.h"
+#include "fpconfig.hh"
+#include "fparser.hh"
+
+#include <sstream>
+#include <string>
+
+#ifdef FP_USE_POSIX_THREADS
+#include <unistd.h>
+#endif
+
+//=========================================================================
+// Evaluation planning
+//=========================================================================
+/* PlanEvaluation() estimates the cost of one row with each engine from the
+   EstimateCost() of the bytecode, and picks the cheapest one:
+   - The interpreters pay for the call of Eval() and for the dispatch of
+     each instruction, on top of the operations themselves.
+   - The native code of Compile() only pays for a cheaper call.
+   - EvalMany() pays once per call for setting up the blocks and dispatches
+     each instruction once per block, and its kernels do the simple
+     operations for several rows at once. The other operations are done one
+     row at a time, and each if() splits the blocks whose rows disagree.
+   - EvalManyParallel() divides the cost of EvalMany() between the
+     processors, but pays for starting the threads.
+   The weights were measured on x86-64 and are only meant to rank the
+   engines (and functions), not to predict times.
+*/
+namespace {
+const double InterpreterCallCost = 10;
+const double BytecodeDispatchCost = 1.5; // per instruction
+const double RegisterDispatchCost = 1;
+const double NativeCallCost = 5;
+const double BatchCallCost = 150;
+const double BatchRowCost = 3;
+const double BatchInstructionCost = 0.5; // per row
+const double BatchBranchCost = 8; // per row
+const double ThreadStartCost = 20000;
+
+unsigned ProcessorCount() {
+#ifdef FP_USE_POSIX_THREADS
+    const long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    return processors > 1 ? unsigned(processors) : 1;
+#else
+    return 1;
+#endif
+}
+} // namespace
+
+template<>
+FunctionParser::EvalPlan FunctionParser::PlanEvaluation(size_t rowCount) const {
+    EvalPlan plan;
+    plan.costPerRow = 0;
+    if (parseErrorType != FP_NO_ERROR) {
+        plan.engine = BYTECODE_ENGINE;
+        plan.reason = "the function has not been parsed successfully";
+        return plan;
+    }
+    if (rowCount == 0)
+        rowCount = 1;
+
+    const CostEstimate estimate = EstimateCost();
+    const double work = estimate.cost;
+    const double instructions = estimate.instructions;
+    std::ostringstream reason;
+
+    // One row at a time:
+    if (CanCompile()) {
+        plan.engine = NATIVE_ENGINE;
+        plan.costPerRow = NativeCallCost + work;
+        reason << "native code avoids dispatching " << estimate.instructions << " instructions";
+    } else if (!data->RegisterCode.empty()) {
+        plan.engine = REGISTER_ENGINE;
+        plan.costPerRow = InterpreterCallCost + work + RegisterDispatchCost * instructions;
+        reason << "the bytecode cannot be compiled to native code here";
+    } else {
+        plan.engine = BYTECODE_ENGINE;
+        plan.costPerRow = InterpreterCallCost + work + BytecodeDispatchCost * instructions;
+        reason << "the bytecode can neither be compiled nor translated to register code";
+    }
+
+    // Many rows at once:
+    if (rowCount > 1) {
+        const double batchCost =
+            BatchCallCost / double(rowCount) + BatchRowCost + BatchInstructionCost * instructions +
+            (work - instructions) + BatchBranchCost * estimate.branches;
+        if (batchCost < plan.costPerRow) {
+            reason.str("");
+            reason << rowCount << " rows amortize setting up the blocks";
+            if (work > 2 * instructions)
+                reason << ", and the expensive operations cost the same in every engine";
+            else
+                reason << ", and the simple operations are vectorized";
+            plan.engine = BATCH_ENGINE;
+            plan.costPerRow = batchCost;
+        } else if (estimate.branches > 0) {
+            reason << ", and the " << estimate.branches << " if()s would split the blocks of EvalMany()";
+        } else {
+            reason << ", and " << rowCount << " rows are too few for EvalMany()";
+        }
+
+        const unsigned processors = ProcessorCount();
+        const double parallelCost =
+            batchCost / processors + ThreadStartCost * (processors - 1) / double(rowCount);
+        if (processors > 1 && parallelCost < plan.costPerRow) {
+            reason.str("");
+            reason << rowCount << " rows keep " << processors << " processors busy long enough to pay for "
+                   << "starting the threads";
+            plan.engine = PARALLEL_BATCH_ENGINE;
+            plan.costPerRow = parallelCost;
+        }
+    }
+
+    if (estimate.functionCalls || estimate.parserCalls || estimate.evalCalls)
+        reason << " (calls of other functions dominate the cost in all engines)";
+    plan.reason = reason.str();
+    return plan;
+}
+
+/* Evaluates the rows with the engine chosen by PlanEvaluation(rowCount),
+   compiling the function first if needed. As with EvalMany(), the error
+   reported is that of the lowest row.
+*/
+template<>
+void FunctionParser::EvalPlanned(const double* Vars, size_t rowCount, size_t rowStride, double* results) {
+    const EvalPlan plan = PlanEvaluation(rowCount);
+    switch (plan.engine) {
+    case PARALLEL_BATCH_ENGINE:
+        EvalManyParallel(Vars, rowCount, rowStride, results);
+        return;
+    case BATCH_ENGINE:
+        EvalMany(Vars, rowCount, rowStride, results);
+        return;
+    case NATIVE_ENGINE:
+        Compile();
+        break;
+    default:
+        break;
+    }
+
+    int firstError = 0;
+    for (size_t row = 0; row < rowCount; ++row) {
+        results[row] = Eval(Vars + row * rowStride);
+        if (!firstError)
+            firstError = evalErrorType;
+    }
+    evalErrorType = firstError;
+}
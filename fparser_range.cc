@@ -0,0 +1,432 @@
+/***************************************************************************\
+|* Function Parser for C++ v3.3.2                                          *|
+|*-------------------------------------------------------------------------*|
+|* Copyright: Juha Nieminen                                                *|
+\***************************************************************************/
+
+#include "stdafx.h"
+#include "fpconfig.hh"
+#include "fparser.hh"
+#include "fpaux.hh"
+#include "fparser_simd.hh"
+
+#include <cmath>
+#include <vector>
+
+using namespace FUNCTIONPARSERTYPES;
+
+//=========================================================================
+// Range evaluation
+//=========================================================================
+/* EvalRange() evaluates the function at start, start + step, start +
+   2*step, ... of one variable, the others being fixed. The bytecode is
+   first interpreted symbolically, with a polynomial in the index i of the
+   point in each stack slot: the swept variable is start + step*i, and the
+   other variables and the constants are polynomials of degree 0. Only the
+   operations which keep a polynomial a polynomial are accepted (+, -, *,
+   division by a constant, integer powers), as are the functions whose
+   arguments are all constants. If the whole bytecode can be interpreted
+   this way, the function is a polynomial P(i) of degree d, and the points
+   are computed by forward differencing: the table of the differences of
+   P(0) ... P(d) is built once, after which each point only takes d
+   additions, whatever the size of the expression. To use SIMD, the
+   differences kernel steps DifferenceLanes interleaved sequences at once,
+   each of which computes every DifferenceLanes-th point.
+   Forward differencing accumulates the rounding errors of the additions,
+   which grow as i^d, so the coefficients and the differences are kept in
+   double-double precision (an unevaluated sum of two doubles); this keeps
+   the results within rounding of the exact polynomial for any practical
+   number of points. Anything else (if(), comparisons, functions of the
+   swept variable, ...) is evaluated with EvalMany() instead.
+*/
+namespace {
+const unsigned RangeMaxDegree = 16;
+const size_t RangeRenormalization = 8; // steps of the differences kernel
+const size_t RangeBatchRows = 256; // of the fallback to EvalMany()
+
+// Double-double arithmetic (see Dekker, "A floating-point technique for
+// extending the available precision", 1971):
+struct DoubleDouble {
+    double hi, lo;
+};
+
+inline DoubleDouble MakeDoubleDouble(double value) {
+    const DoubleDouble result = { value, 0 };
+    return result;
+}
+
+inline DoubleDouble TwoSum(double a, double b) {
+    const double s = a + b, bb = s - a;
+    const DoubleDouble result = { s, (a - (s - bb)) + (b - bb) };
+    return result;
+}
+
+inline DoubleDouble FastTwoSum(double a, double b) {
+    const double s = a + b;
+    const DoubleDouble result = { s, b - (s - a) };
+    return result;
+}
+
+// Written so that a fused multiply-add cannot change the result:
+inline void Split(double a, double& hi, double& lo) {
+    const double c = a * 134217728.0 + a; // 2^27 + 1
+    hi = c - (c - a);
+    lo = a - hi;
+}
+
+inline DoubleDouble TwoProduct(double a, double b) {
+    const double p = a * b;
+    double ah, al, bh, bl;
+    Split(a, ah, al);
+    Split(b, bh, bl);
+    const DoubleDouble result = { p, ((ah * bh - p) + ah * bl + al * bh) + al * bl };
+    return result;
+}
+
+inline DoubleDouble Add(const DoubleDouble& a, const DoubleDouble& b) {
+    DoubleDouble s = TwoSum(a.hi, b.hi);
+    const DoubleDouble t = TwoSum(a.lo, b.lo);
+    s.lo += t.hi;
+    s = FastTwoSum(s.hi, s.lo);
+    s.lo += t.lo;
+    return FastTwoSum(s.hi, s.lo);
+}
+
+inline DoubleDouble Negate(const DoubleDouble& a) {
+    const DoubleDouble result = { -a.hi, -a.lo };
+    return result;
+}
+
+inline DoubleDouble Multiply(const DoubleDouble& a, const DoubleDouble& b) {
+    DoubleDouble p = TwoProduct(a.hi, b.hi);
+    p.lo += a.hi * b.lo + a.lo * b.hi;
+    return FastTwoSum(p.hi, p.lo);
+}
+
+inline DoubleDouble Divide(const DoubleDouble& a, const DoubleDouble& b) {
+    const double q1 = a.hi / b.hi;
+    const DoubleDouble r = Add(a, Negate(Multiply(b, MakeDoubleDouble(q1))));
+    const double q2 = r.hi / b.hi;
+    return FastTwoSum(q1, q2);
+}
+
+typedef std::vector<DoubleDouble> Polynomial; // coefficient of i^0 first
+
+Polynomial AddPolynomials(const Polynomial& a, const Polynomial& b) {
+    Polynomial result(a.size() > b.size() ? a : b);
+    const Polynomial& shorter = a.size() > b.size() ? b : a;
+    for (unsigned k = 0; k < shorter.size(); ++k)
+        result[k] = Add(result[k], shorter[k]);
+    return result;
+}
+
+Polynomial NegatePolynomial(Polynomial a) {
+    for (unsigned k = 0; k < a.size(); ++k)
+        a[k] = Negate(a[k]);
+    return a;
+}
+
+Polynomial MultiplyPolynomials(const Polynomial& a, const Polynomial& b) {
+    Polynomial result(a.size() + b.size() - 1, MakeDoubleDouble(0));
+    for (unsigned j = 0; j < a.size(); ++j)
+        for (unsigned k = 0; k < b.size(); ++k)
+            result[j + k] = Add(result[j + k], Multiply(a[j], b[k]));
+    return result;
+}
+
+Polynomial ScalePolynomial(Polynomial a, const DoubleDouble& factor) {
+    for (unsigned k = 0; k < a.size(); ++k)
+        a[k] = Multiply(a[k], factor);
+    return a;
+}
+
+inline bool IsConstant(const Polynomial& a) { return a.size() == 1; }
+
+inline bool IsFinite(double x) { return x - x == 0; }
+
+/* The value of a function whose arguments are constants, computed as
+   EvalByteCode() does. Returns false for the functions which are not
+   supported here, and for the arguments which would be evaluation errors.
+*/
+bool EvalConstantFunction(unsigned opcode, const double* args, double& result) {
+    const double x = args[0];
+    switch (opcode) {
+    case cAbs: result = fabs(x); return true;
+    case cAtan: result = atan(x); return true;
+    case cAtan2: result = atan2(args[0], args[1]); return true;
+    case cCeil: result = ceil(x); return true;
+    case cCos: result = cos(x); return true;
+    case cCosh: result = cosh(x); return true;
+    case cExp: result = exp(x); return true;
+    case cExp2: result = pow(2.0, x); return true;
+    case cFloor: result = floor(x); return true;
+    case cInt: result = floor(x + .5); return true;
+    case cLog: result = log(x); return x > 0;
+    case cLog10: result = log10(x); return x > 0;
+    case cLog2: result = fp_log2(x); return x > 0;
+    case cMax: result = Max(args[0], args[1]); return true;
+    case cMin: result = Min(args[0], args[1]); return true;
+    case cSin: result = sin(x); return true;
+    case cSinh: result = sinh(x); return true;
+    case cSqrt: result = sqrt(x); return x >= 0;
+    case cTan: result = tan(x); return true;
+    case cTanh: result = tanh(x); return true;
+    default: return false;
+    }
+}
+
+/* Builds the table of the differences kernel (see fparser_simd.hh) from
+   the coefficients of P, given as pairs of doubles. Lane l computes every
+   DifferenceLanes-th point from the l-th one, so it differences
+   Q(m) = P(l + DifferenceLanes*m). The k-th difference of m^j at m = 0 is
+   the number of surjections from j to k elements, S(j, k) =
+   k * (S(j-1, k) + S(j-1, k-1)), so the differences of Q at 0 are sums of
+   its coefficients times S(j, k). (Differencing Q(0) ... Q(d) instead would
+   lose the small high-order differences to cancellation, and forward
+   differencing multiplies their errors by up to m^d.)
+*/
+bool LaneDifferences(const std::vector<double>& coefficients, std::vector<double>& hi, std::vector<double>& lo) {
+    const unsigned degree = unsigned(coefficients.size() / 2 - 1);
+    hi.resize((degree + 1) * DifferenceLanes);
+    lo.resize((degree + 1) * DifferenceLanes);
+    Polynomial index(2);
+    index[1] = MakeDoubleDouble(DifferenceLanes);
+    for (unsigned lane = 0; lane < DifferenceLanes; ++lane) {
+        index[0] = MakeDoubleDouble(lane);
+        Polynomial lanePolynomial(1, MakeDoubleDouble(0));
+        for (unsigned j = degree + 1; j-- > 0;) {
+            const DoubleDouble coefficient = { coefficients[2 * j], coefficients[2 * j + 1] };
+            lanePolynomial = AddPolynomials(MultiplyPolynomials(lanePolynomial, index),
+                                            Polynomial(1, coefficient));
+        }
+        lanePolynomial.resize(degree + 1, MakeDoubleDouble(0));
+
+        Polynomial surjections(degree + 1, MakeDoubleDouble(0)), differences(degree + 1, MakeDoubleDouble(0));
+        surjections[0] = MakeDoubleDouble(1);
+        differences[0] = lanePolynomial[0];
+        for (unsigned j = 1; j <= degree; ++j) {
+            for (unsigned k = j; k > 0; --k)
+                surjections[k] = Multiply(MakeDoubleDouble(k), Add(surjections[k], surjections[k - 1]));
+            surjections[0] = MakeDoubleDouble(0);
+            for (unsigned k = 1; k <= j; ++k)
+                differences[k] = Add(differences[k], Multiply(lanePolynomial[j], surjections[k]));
+        }
+        for (unsigned k = 0; k <= degree; ++k) {
+            if (!IsFinite(differences[k].hi))
+                return false;
+            hi[k * DifferenceLanes + lane] = differences[k].hi;
+            lo[k * DifferenceLanes + lane] = differences[k].lo;
+        }
+    }
+    return true;
+}
+} // namespace
+
+/* Interprets the bytecode symbolically, as explained above, and stores the
+   coefficients of P in result, as pairs of doubles. Returns
+   false if the function is not a polynomial in the swept variable (as far
+   as can be seen here). The other variables are 0 if Vars is null.
+*/
+template<>
+bool FunctionParser::RangePolynomial(const double* Vars, unsigned variableIndex, double start, double step,
+                                     std::vector<double>& result) const {
+    const std::vector<unsigned>& byteCode = data->ByteCode;
+    const std::vector<double>& immed = data->Immed;
+    std::vector<Polynomial> stack;
+    stack.reserve(data->StackSize);
+    unsigned DP = 0;
+
+    for (unsigned IP = 0; IP < byteCode.size(); ++IP) {
+        const unsigned opcode = byteCode[IP];
+        if (opcode >= VarBegin) {
+            if (opcode - VarBegin == variableIndex) {
+                Polynomial swept(2);
+                swept[0] = MakeDoubleDouble(start);
+                swept[1] = MakeDoubleDouble(step);
+                stack.push_back(swept);
+            } else {
+                const double value = Vars ? Vars[opcode - VarBegin] : 0;
+                stack.push_back(Polynomial(1, MakeDoubleDouble(value)));
+            }
+            continue;
+        }
+
+        switch (opcode) {
+        case cImmed:
+            stack.push_back(Polynomial(1, MakeDoubleDouble(immed[DP++])));
+            break;
+        case cNeg:
+            stack.back() = NegatePolynomial(stack.back());
+            break;
+        case cAdd:
+        case cSub:
+        case cRSub: {
+            Polynomial right = stack.back();
+            stack.pop_back();
+            if (opcode == cSub)
+                right = NegatePolynomial(right);
+            else if (opcode == cRSub)
+                stack.back() = NegatePolynomial(stack.back());
+            stack.back() = AddPolynomials(stack.back(), right);
+            break;
+        }
+        case cMul: {
+            const Polynomial right = stack.back();
+            stack.pop_back();
+            stack.back() = MultiplyPolynomials(stack.back(), right);
+            break;
+        }
+        case cSqr:
+            stack.back() = MultiplyPolynomials(stack.back(), stack.back());
+            break;
+        case cDiv:
+        case cRDiv: {
+            Polynomial right = stack.back();
+            stack.pop_back();
+            if (opcode == cRDiv)
+                right.swap(stack.back());
+            if (!IsConstant(right) || right[0].hi == 0)
+                return false;
+            stack.back() = ScalePolynomial(stack.back(), Divide(MakeDoubleDouble(1), right[0]));
+            break;
+        }
+        case cInv:
+            if (!IsConstant(stack.back()) || stack.back()[0].hi == 0)
+                return false;
+            stack.back()[0] = Divide(MakeDoubleDouble(1), stack.back()[0]);
+            break;
+        case cDeg:
+            stack.back() = ScalePolynomial(stack.back(), MakeDoubleDouble(RadiansToDegrees(1.0)));
+            break;
+        case cRad:
+            stack.back() = ScalePolynomial(stack.back(), MakeDoubleDouble(DegreesToRadians(1.0)));
+            break;
+        case cPow:
+        case cRPow: {
+            Polynomial exponent = stack.back();
+            stack.pop_back();
+            if (opcode == cRPow)
+                exponent.swap(stack.back());
+            if (!IsConstant(exponent))
+                return false;
+            Polynomial& base = stack.back();
+            const double power = exponent[0].hi;
+            if (IsConstant(base)) {
+                base[0] = MakeDoubleDouble(pow(base[0].hi, power));
+                break;
+            }
+            if (power < 0 || power != floor(power) || (base.size() - 1) * power > RangeMaxDegree)
+                return false;
+            Polynomial product(1, MakeDoubleDouble(1));
+            for (unsigned k = 0; k < unsigned(power); ++k)
+                product = MultiplyPolynomials(product, base);
+            base.swap(product);
+            break;
+        }
+        case cDup:
+            stack.push_back(stack.back());
+            break;
+#ifdef FP_SUPPORT_OPTIMIZER
+        case cFetch:
+            stack.push_back(stack[byteCode[++IP]]);
+            break;
+        case cPopNMov: {
+            const unsigned target = byteCode[++IP];
+            const unsigned source = byteCode[++IP];
+            stack[target] = stack[source];
+            stack.resize(target + 1);
+            break;
+        }
+#endif
+        case cNop:
+            break;
+        default: {
+            if (opcode >= cImmed || opcode == cIf || opcode == cEval)
+                return false;
+            const unsigned params = Functions[opcode - cAbs].params;
+            double args[2];
+            for (unsigned k = 0; k < params; ++k) {
+                const Polynomial& argument = stack[stack.size() - params + k];
+                if (!IsConstant(argument))
+                    return false;
+                args[k] = argument[0].hi;
+            }
+            double value;
+            if (!EvalConstantFunction(opcode, args, value))
+                return false;
+            stack.resize(stack.size() - params + 1);
+            stack.back() = Polynomial(1, MakeDoubleDouble(value));
+            break;
+        }
+        }
+
+        if (stack.back().size() > RangeMaxDegree + 1)
+            return false;
+    }
+
+    // Trailing zero coefficients (eg. of x*x - x^2) do not count:
+    Polynomial& polynomial = stack.back();
+    while (polynomial.size() > 1 && polynomial.back().hi == 0)
+        polynomial.pop_back();
+
+    const unsigned degree = unsigned(polynomial.size() - 1);
+    result.resize(2 * (degree + 1));
+    for (unsigned k = 0; k <= degree; ++k) {
+        result[2 * k] = polynomial[k].hi;
+        result[2 * k + 1] = polynomial[k].lo;
+    }
+    return true;
+}
+
+template<>
+void FunctionParser::EvalRange(double start, double step, size_t count, double* results) {
+    EvalRange(0, 0, start, step, count, results);
+}
+
+template<>
+void FunctionParser::EvalRange(const double* Vars, unsigned variableIndex, double start, double step,
+                               size_t count, double* results) {
+    const unsigned variableAmount = unsigned(data->variableRefs.size());
+    if (parseErrorType != FP_NO_ERROR || variableIndex >= variableAmount) {
+        for (size_t i = 0; i < count; ++i)
+            results[i] = 0;
+        return;
+    }
+
+    std::vector<double> coefficients, hi, lo;
+    if (RangePolynomial(Vars, variableIndex, start, step, coefficients) &&
+        LaneDifferences(coefficients, hi, lo)) {
+        // In chunks, after which the kernel renormalizes the differences:
+        const BatchKernels<double>& kernels = GetBatchKernels<double>();
+        const unsigned degree = unsigned(coefficients.size() / 2 - 1);
+        const size_t steps = count / DifferenceLanes;
+        for (size_t i = 0; i < steps; i += RangeRenormalization) {
+            const size_t chunk = steps - i < RangeRenormalization ? steps - i : RangeRenormalization;
+            kernels.differences(&hi[0], &lo[0], degree, unsigned(chunk), results + i * DifferenceLanes);
+        }
+        if (count % DifferenceLanes) {
+            double last[DifferenceLanes];
+            kernels.differences(&hi[0], &lo[0], degree, 1, last);
+            for (size_t i = steps * DifferenceLanes; i < count; ++i)
+                results[i] = last[i - steps * DifferenceLanes];
+        }
+        evalErrorType = 0;
+        return;
+    }
+
+    // The rows of the fallback, in batches:
+    std::vector<double> rows(RangeBatchRows * variableAmount);
+    for (size_t row = 0; row < RangeBatchRows; ++row)
+        for (unsigned k = 0; k < variableAmount; ++k)
+            rows[row * variableAmount + k] = Vars ? Vars[k] : 0;
+    int firstError = 0;
+    for (size_t begin = 0; begin < count; begin += RangeBatchRows) {
+        const size_t batch = count - begin < RangeBatchRows ? count - begin : RangeBatchRows;
+        for (size_t row = 0; row < batch; ++row)
+            rows[row * variableAmount + variableIndex] = start + double(begin + row) * step;
+        EvalMany(&rows[0], batch, variableAmount, results + begin);
+        if (!firstError)
+            firstError = evalErrorType;
+    }
+    evalErrorType = firstError;
+}
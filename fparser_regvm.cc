@@ -0,0 +1,1383 @@
+/***************************************************************************\
+|* Function Parser for C++ v3.3.2                                          *|
+|*-------------------------------------------------------------------------*|
+|* Copyright: Juha Nieminen                                                *|
+\***************************************************************************/
+
+#include "stdafx.h"
+#include "fpconfig.hh"
+#include "fparser.hh"
+#include "fpaux.hh"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+using namespace FUNCTIONPARSERTYPES;
+
+//=========================================================================
+// Register code
+//=========================================================================
+/* The stack bytecode is translated into three-address code operating on a
+   file of registers, which is laid out as
+
+     [ variables used | constants | temporaries ]
+
+   Pushing a variable or a constant does not generate an instruction: the
+   stack slot just refers to its register, and the operation consuming the
+   slot reads the register directly. cDup, cFetch, cPopNMov and cNop only
+   rearrange which registers the stack slots refer to, so they do not
+   generate instructions either. For example x*2+y becomes the single
+   instruction "t0 = x * 2" followed by "t0 = t0 + y".
+   cSelect becomes a conditional move "t0 = c ? a : t0", so the false value
+   is first computed in (or moved to) the result register.
+   Temporaries are reference counted by the stack slots referring to them
+   and reused as soon as they are free. Both branches of an if() leave their
+   result in the same register. Parameters of function calls are moved to
+   consecutive registers, which is then the array passed to the function.
+   An if() whose condition is a comparison computed just for it becomes a
+   single compare-and-branch instruction, and jumps to the end of the code
+   return right away instead.
+   Every operation is performed with the same code as in Eval(), so the
+   results are identical.
+*/
+namespace {
+enum RegisterOpcode {
+    rAbs, rAcos, rAcosh, rAsin, rAsinh, rAtan, rAtan2, rAtanh, rCeil, rCos,
+    rCosh, rCot, rCsc, rEval, rExp, rExp2, rFloor, rIf, rInt, rLog, rLog10,
+    rLog2, rMax, rMin, rPow, rSec, rSin, rSinh, rSqrt, rTan, rTanh,
+    rMov, rJump, rNeg, rAdd, rSub, rMul, rDiv, rMod, rEqual, rNEqual, rLess,
+    rLessOrEq, rGreater, rGreaterOrEq, rNot, rAnd, rOr, rNotNot, rDeg, rRad,
+    rFCall, rPCall, rInv, rSqr, rRSqrt, rSelect,
+
+    // Superinstructions: if() on the result of a comparison
+    rIfEqual, rIfNEqual, rIfLess, rIfLessOrEq, rIfGreater, rIfGreaterOrEq,
+
+    rEnd
+};
+
+#if !defined(FP_NO_REGISTER_CODE) || defined(FUNCTIONPARSER_SUPPORT_DEBUG_OUTPUT)
+bool isBinaryOpcode(unsigned opcode) {
+    switch (opcode) {
+    case rAtan2: case rMax: case rMin: case rPow: case rAdd: case rSub:
+    case rMul: case rDiv: case rMod: case rEqual: case rNEqual: case rLess:
+    case rLessOrEq: case rGreater: case rGreaterOrEq: case rAnd: case rOr:
+    case rSelect: case rIfEqual: case rIfNEqual: case rIfLess: case rIfLessOrEq:
+    case rIfGreater: case rIfGreaterOrEq:
+        return true;
+    default:
+        return false;
+    }
+}
+#endif
+
+#ifndef FP_NO_REGISTER_CODE
+class RegisterTranslator {
+public:
+    typedef FunctionParser::Data Data;
+    typedef Data::RegisterInstruction Instruction;
+
+    // Without reuseTemporaries every instruction gets a register of its
+    // own (except for the results of the if()s), as IncrementalEvaluator
+    // keeps the values of the previous evaluation in them.
+    RegisterTranslator(const Data& data, bool reuseTemporaries = true)
+        : data(data), reuseTemporaries(reuseTemporaries), firstRetargetable(0),
+          varRegister(), constants(), refCount(), code() {}
+
+    bool Translate(std::vector<Instruction>& resultCode,
+                   std::vector<double>& registers,
+                   std::vector<unsigned>& variables,
+                   unsigned& firstTemporary);
+
+private:
+    // Registers are numbered in the order of the constants, variables and
+    // temporaries vectors until Translate() relocates them to the final
+    // layout. These are the bases of that numbering:
+    enum { ConstantBase = 0x00000000, VariableBase = 0x40000000,
+           TemporaryBase = 0x80000000, KindMask = 0xC0000000 };
+
+    struct Branch {
+        unsigned elseStart, mergeAt;
+        unsigned ifInstruction, jumpInstruction, elseInstruction;
+        unsigned result;
+        std::vector<unsigned> stack;
+    };
+
+    const Data& data;
+    bool reuseTemporaries;
+    unsigned firstRetargetable;
+    std::vector<unsigned> varRegister;
+    std::vector<double> constants;
+    std::vector<unsigned> refCount;
+    std::vector<Instruction> code;
+    std::vector<unsigned> stack;
+
+    unsigned Constant(double value) {
+        for (unsigned i = 0; i < constants.size(); ++i)
+            if (std::memcmp(&constants[i], &value, sizeof(double)) == 0)
+                return ConstantBase + i;
+        constants.push_back(value);
+        return ConstantBase + unsigned(constants.size() - 1);
+    }
+
+    unsigned Variable(unsigned index) {
+        if (index >= varRegister.size())
+            varRegister.resize(index + 1, ~0U);
+        if (varRegister[index] == ~0U) {
+            unsigned amount = 0;
+            for (unsigned i = 0; i < varRegister.size(); ++i)
+                if (varRegister[i] != ~0U)
+                    ++amount;
+            varRegister[index] = VariableBase + amount;
+        }
+        return varRegister[index];
+    }
+
+    static bool IsTemporary(unsigned reg) {
+        return (reg & KindMask) == TemporaryBase;
+    }
+
+    unsigned Allocate(unsigned amount = 1) {
+        unsigned first = 0, run = 0;
+        for (unsigned i = 0; reuseTemporaries && i < refCount.size() && run < amount; ++i) {
+            if (refCount[i]) {
+                run = 0;
+            } else if (run++ == 0) {
+                first = i;
+            }
+        }
+        if (run == 0)
+            first = unsigned(refCount.size());
+        if (first + amount > refCount.size())
+            refCount.resize(first + amount, 0);
+        for (unsigned i = 0; i < amount; ++i)
+            refCount[first + i] = 1;
+        return TemporaryBase + first;
+    }
+
+    void AddRef(unsigned reg) {
+        if (IsTemporary(reg))
+            ++refCount[reg - TemporaryBase];
+    }
+    void Release(unsigned reg) {
+        if (IsTemporary(reg))
+            --refCount[reg - TemporaryBase];
+    }
+    unsigned RefCount(unsigned reg) const {
+        return IsTemporary(reg) ? refCount[reg - TemporaryBase] : 0;
+    }
+
+    unsigned Pop() {
+        const unsigned reg = stack.back();
+        stack.pop_back();
+        Release(reg);
+        return reg;
+    }
+
+    unsigned Emit(unsigned opcode, unsigned dest, unsigned param1 = 0,
+                  unsigned param2 = 0) {
+        const Instruction instruction = { opcode, dest, param1, param2 };
+        code.push_back(instruction);
+        return unsigned(code.size() - 1);
+    }
+
+    void Unary(RegisterOpcode opcode) {
+        const unsigned param = Pop();
+        const unsigned dest = Allocate();
+        Emit(opcode, dest, param);
+        stack.push_back(dest);
+    }
+
+    void Binary(RegisterOpcode opcode, bool reversed = false) {
+        unsigned param2 = Pop();
+        unsigned param1 = Pop();
+        if (reversed)
+            std::swap(param1, param2);
+        const unsigned dest = Allocate();
+        Emit(opcode, dest, param1, param2);
+        stack.push_back(dest);
+    }
+
+    // Emits the conditional jump of an if(). When the condition was computed
+    // by the previous instruction and is not used elsewhere, that comparison
+    // is turned into the jump instead.
+    unsigned EmitIf(unsigned condition) {
+        if (!code.empty() && code.size() - 1 >= firstRetargetable &&
+            code.back().dest == condition && RefCount(condition) == 0 &&
+            code.back().opcode >= rEqual && code.back().opcode <= rGreaterOrEq) {
+            code.back().opcode += rIfEqual - rEqual;
+            return unsigned(code.size() - 1);
+        }
+        return Emit(rIf, 0, condition);
+    }
+
+    // Moves the topmost params slots to consecutive registers and replaces
+    // them with the result of the call.
+    void Call(RegisterOpcode opcode, unsigned params, unsigned index) {
+        const unsigned first = Allocate(params ? params : 1);
+        for (unsigned i = 0; i < params; ++i)
+            Emit(rMov, first + i, stack[stack.size() - params + i]);
+        for (unsigned i = 0; i < params; ++i)
+            Pop();
+        for (unsigned i = 0; i < (params ? params : 1); ++i)
+            Release(first + i);
+        const unsigned dest = Allocate();
+        Emit(opcode, dest, first, index);
+        stack.push_back(dest);
+    }
+
+    unsigned Relocate(unsigned reg, unsigned constantsStart,
+                      unsigned temporariesStart) const {
+        switch (reg & KindMask) {
+        case ConstantBase: return constantsStart + (reg - ConstantBase);
+        case VariableBase: return reg - VariableBase;
+        default: return temporariesStart + (reg - TemporaryBase);
+        }
+    }
+};
+
+bool RegisterTranslator::Translate(std::vector<Instruction>& resultCode,
+                                   std::vector<double>& registers,
+                                   std::vector<unsigned>& variables,
+                                   unsigned& firstTemporary) {
+    const std::vector<unsigned>& ByteCode = data.ByteCode;
+    const std::vector<double>& Immed = data.Immed;
+    const unsigned ByteCodeSize = unsigned(ByteCode.size());
+    unsigned DP = 0;
+    std::vector<Branch> branches;
+
+    for (unsigned IP = 0; IP <= ByteCodeSize; ++IP) {
+        // Join the branches of the if()s ending here:
+        while (!branches.empty() && branches.back().mergeAt == IP) {
+            Branch& branch = branches.back();
+            if (stack.size() != branch.stack.size() + 1 ||
+                !std::equal(branch.stack.begin(), branch.stack.end(), stack.begin()))
+                return false;
+
+            // If the else branch computed its result in the last instruction,
+            // make that instruction write the result register directly:
+            const unsigned reg = stack.back();
+            const unsigned last = unsigned(code.size()) - 1;
+            if (RefCount(reg) == 1 && !code.empty() && last >= branch.elseInstruction &&
+                last >= firstRetargetable && code[last].dest == reg &&
+                code[last].opcode != rIf && code[last].opcode != rJump &&
+                code[last].opcode != rSelect)
+                code[last].dest = branch.result;
+            else
+                Emit(rMov, branch.result, reg);
+            Pop();
+            stack.push_back(branch.result);
+
+            code[branch.jumpInstruction].dest = unsigned(code.size());
+            firstRetargetable = unsigned(code.size());
+            branches.pop_back();
+        }
+        if (IP == ByteCodeSize)
+            break;
+
+        const unsigned opcode = ByteCode[IP];
+        if (opcode >= VarBegin) {
+            stack.push_back(Variable(opcode - VarBegin));
+            continue;
+        }
+
+        switch (opcode) {
+        case cImmed: stack.push_back(Constant(Immed[DP++])); break;
+        case cNop: break;
+
+        case cDup:
+            if (stack.empty())
+                return false;
+            AddRef(stack.back());
+            stack.push_back(stack.back());
+            break;
+
+#ifdef FP_SUPPORT_OPTIMIZER
+        case cFetch: {
+            const unsigned source = ByteCode[++IP];
+            if (source >= stack.size())
+                return false;
+            AddRef(stack[source]);
+            stack.push_back(stack[source]);
+            break;
+        }
+
+        case cPopNMov: {
+            const unsigned target = ByteCode[++IP];
+            const unsigned source = ByteCode[++IP];
+            if (source >= stack.size() || target > source)
+                return false;
+            const unsigned reg = stack[source];
+            AddRef(reg);
+            while (stack.size() > target)
+                Pop();
+            stack.push_back(reg);
+            break;
+        }
+
+        case cSelect: {
+            if (stack.size() < 3)
+                return false;
+            // If the false value was computed by the last instruction just
+            // for this, the result is selected in its register.
+            unsigned dest = stack.back();
+            const unsigned last = unsigned(code.size()) - 1;
+            if (RefCount(dest) == 1 && !code.empty() && last >= firstRetargetable &&
+                code[last].dest == dest && code[last].opcode < rIfEqual &&
+                code[last].opcode != rIf && code[last].opcode != rJump &&
+                code[last].opcode != rSelect) {
+                stack.pop_back(); // its reference is now the result's
+            } else {
+                dest = Allocate();
+                Emit(rMov, dest, Pop());
+            }
+            const unsigned trueValue = Pop();
+            Emit(rSelect, dest, Pop(), trueValue);
+            stack.push_back(dest);
+            break;
+        }
+#endif
+
+        case cIf: {
+            if (stack.empty())
+                return false;
+            Branch branch;
+            branch.elseStart = ByteCode[IP + 1] + 1;
+            branch.mergeAt = ~0U;
+            branch.ifInstruction = EmitIf(Pop());
+            branch.jumpInstruction = branch.elseInstruction = 0;
+            branch.result = 0;
+            branch.stack = stack;
+            branches.push_back(branch);
+            IP += 2;
+            break;
+        }
+
+        case cJump: {
+            if (branches.empty())
+                return false;
+            Branch& branch = branches.back();
+            if (branch.mergeAt != ~0U || branch.elseStart != IP + 3 ||
+                stack.size() != branch.stack.size() + 1 ||
+                !std::equal(branch.stack.begin(), branch.stack.end(), stack.begin()))
+                return false;
+
+            // The result register stays allocated through the else branch:
+            const unsigned reg = stack.back();
+            if (RefCount(reg) == 1) {
+                branch.result = reg;
+                stack.pop_back();
+            } else {
+                branch.result = Allocate();
+                Emit(rMov, branch.result, Pop());
+            }
+            branch.mergeAt = ByteCode[IP + 1] + 1;
+            branch.jumpInstruction = Emit(rJump, 0);
+            branch.elseInstruction = unsigned(code.size());
+            code[branch.ifInstruction].dest = branch.elseInstruction;
+            IP += 2;
+            if (branch.mergeAt <= IP)
+                return false;
+            break;
+        }
+
+        case cFCall: {
+            const unsigned index = ByteCode[++IP];
+            Call(rFCall, data.FuncPtrs[index].params, index);
+            break;
+        }
+
+        case cPCall: {
+            const unsigned index = ByteCode[++IP];
+            Call(rPCall, data.FuncParsers[index].params, index);
+            break;
+        }
+
+#ifndef FP_DISABLE_EVAL
+        case cEval:
+            Call(rEval, unsigned(data.variableRefs.size()), 0);
+            break;
+#endif
+
+        case cAbs: Unary(rAbs); break;
+        case cAcos: Unary(rAcos); break;
+        case cAcosh: Unary(rAcosh); break;
+        case cAsin: Unary(rAsin); break;
+        case cAsinh: Unary(rAsinh); break;
+        case cAtan: Unary(rAtan); break;
+        case cAtanh: Unary(rAtanh); break;
+        case cCeil: Unary(rCeil); break;
+        case cCos: Unary(rCos); break;
+        case cCosh: Unary(rCosh); break;
+        case cCot: Unary(rCot); break;
+        case cCsc: Unary(rCsc); break;
+        case cExp: Unary(rExp); break;
+        case cExp2: Unary(rExp2); break;
+        case cFloor: Unary(rFloor); break;
+        case cInt: Unary(rInt); break;
+        case cLog: Unary(rLog); break;
+        case cLog10: Unary(rLog10); break;
+        case cLog2: Unary(rLog2); break;
+        case cSec: Unary(rSec); break;
+        case cSin: Unary(rSin); break;
+        case cSinh: Unary(rSinh); break;
+        case cSqrt: Unary(rSqrt); break;
+        case cTan: Unary(rTan); break;
+        case cTanh: Unary(rTanh); break;
+        case cNeg: Unary(rNeg); break;
+        case cNot: Unary(rNot); break;
+        case cNotNot: Unary(rNotNot); break;
+        case cDeg: Unary(rDeg); break;
+        case cRad: Unary(rRad); break;
+        case cInv: Unary(rInv); break;
+        case cSqr: Unary(rSqr); break;
+        case cRSqrt: Unary(rRSqrt); break;
+
+        case cAtan2: Binary(rAtan2); break;
+        case cMax: Binary(rMax); break;
+        case cMin: Binary(rMin); break;
+        case cPow: Binary(rPow); break;
+        case cRPow: Binary(rPow, true); break;
+        case cAdd: Binary(rAdd); break;
+        case cSub: Binary(rSub); break;
+        case cRSub: Binary(rSub, true); break;
+        case cMul: Binary(rMul); break;
+        case cDiv: Binary(rDiv); break;
+        case cRDiv: Binary(rDiv, true); break;
+        case cMod: Binary(rMod); break;
+        case cEqual: Binary(rEqual); break;
+        case cNEqual: Binary(rNEqual); break;
+        case cLess: Binary(rLess); break;
+        case cLessOrEq: Binary(rLessOrEq); break;
+        case cGreater: Binary(rGreater); break;
+        case cGreaterOrEq: Binary(rGreaterOrEq); break;
+        case cAnd: Binary(rAnd); break;
+        case cOr: Binary(rOr); break;
+
+        default: return false;
+        }
+    }
+
+    if (stack.size() != 1 || !branches.empty())
+        return false;
+    Emit(rEnd, 0, stack.back());
+
+    // Make the jumps go directly to their final destination, and return
+    // right away if that is the end:
+    for (unsigned i = 0; i < code.size(); ++i)
+        if (code[i].opcode == rJump) {
+            unsigned target = code[i].dest;
+            while (code[target].opcode == rJump)
+                target = code[target].dest;
+            if (code[target].opcode == rEnd)
+                code[i] = code[target];
+            else
+                code[i].dest = target;
+        }
+
+    // Relocate the registers to the final layout:
+    variables.clear();
+    for (unsigned i = 0; i < varRegister.size(); ++i)
+        if (varRegister[i] != ~0U) {
+            if (variables.size() <= varRegister[i] - VariableBase)
+                variables.resize(varRegister[i] - VariableBase + 1);
+            variables[varRegister[i] - VariableBase] = i;
+        }
+    const unsigned constantsStart = unsigned(variables.size());
+    const unsigned temporariesStart = constantsStart + unsigned(constants.size());
+
+    registers.assign(temporariesStart + refCount.size() + 1, 0.0);
+    for (unsigned i = 0; i < constants.size(); ++i)
+        registers[constantsStart + i] = constants[i];
+
+    for (unsigned i = 0; i < code.size(); ++i) {
+        Instruction& instruction = code[i];
+        switch (instruction.opcode) {
+        case rIf:
+            instruction.param1 = Relocate(instruction.param1, constantsStart, temporariesStart);
+            break;
+        case rJump:
+            break;
+        case rIfEqual:
+        case rIfNEqual:
+        case rIfLess:
+        case rIfLessOrEq:
+        case rIfGreater:
+        case rIfGreaterOrEq:
+            instruction.param1 = Relocate(instruction.param1, constantsStart, temporariesStart);
+            instruction.param2 = Relocate(instruction.param2, constantsStart, temporariesStart);
+            break;
+        case rEnd:
+            instruction.param1 = Relocate(instruction.param1, constantsStart, temporariesStart);
+            break;
+        case rFCall:
+        case rPCall:
+        case rEval:
+            instruction.dest = Relocate(instruction.dest, constantsStart, temporariesStart);
+            instruction.param1 = Relocate(instruction.param1, constantsStart, temporariesStart);
+            break;
+        default:
+            instruction.dest = Relocate(instruction.dest, constantsStart, temporariesStart);
+            instruction.param1 = Relocate(instruction.param1, constantsStart, temporariesStart);
+            instruction.param2 = Relocate(instruction.param2, constantsStart, temporariesStart);
+        }
+    }
+
+    resultCode.swap(code);
+    firstTemporary = temporariesStart;
+    return true;
+}
+#endif
+} // namespace
+
+//=========================================================================
+// Register code translation and evaluation
+//=========================================================================
+template<>
+void FunctionParser::TranslateToRegisterCode() {
+    data->RegisterCode.clear();
+    data->RegisterFile.clear();
+    data->RegisterVars.clear();
+    data->RegisterTemporaries = 0;
+
+#ifndef FP_NO_REGISTER_CODE
+    RegisterTranslator translator(*data);
+    if (!translator.Translate(data->RegisterCode, data->RegisterFile,
+                              data->RegisterVars, data->RegisterTemporaries)) {
+        data->RegisterCode.clear();
+        data->RegisterFile.clear();
+        data->RegisterVars.clear();
+        data->RegisterTemporaries = 0;
+    }
+#endif
+}
+
+/* With checks false the operands are not checked, and errors only show up
+   as floating point exceptions; see EvaluateWithFPExceptions().
+*/
+template<>
+template<bool checks>
+double FunctionParser::EvalRegisterCode(EvalContext& context, double* R, const double* Vars) const {
+    const unsigned* const variables = data->RegisterVars.empty() ? 0 : &(data->RegisterVars[0]);
+    const unsigned variableAmount = unsigned(data->RegisterVars.size());
+
+    for (unsigned i = 0; i < variableAmount; ++i)
+        R[i] = Vars[variables[i]];
+    for (unsigned i = variableAmount; i < data->RegisterTemporaries; ++i)
+        R[i] = data->RegisterFile[i];
+
+    return RunRegisterCode<checks, false>(context, &(data->RegisterCode[0]), R, 0, 0);
+}
+
+/* With incremental true only the instructions whose dependencies (see
+   IncrementalEvaluator below) include some of the changed variables are
+   executed; the registers written by the others still hold their values.
+   The control instructions depend on everything.
+*/
+#ifdef FP_USE_THREADED_DISPATCH
+#define FP_CASE(opcode) l_##opcode:
+#define FP_NEXT                                                \
+    do {                                                       \
+        ++IP;                                                  \
+        if (incremental)                                       \
+            while (!(dependencies[IP - code] & changed))       \
+                ++IP;                                          \
+        goto *handlers[IP->opcode];                            \
+    } while (0)
+#else
+#define FP_CASE(opcode) case opcode:
+#define FP_NEXT break
+#endif
+
+template<>
+template<bool checks, bool incremental>
+double FunctionParser::RunRegisterCode(EvalContext& context, const Data::RegisterInstruction* code, double* R,
+                                       const unsigned long long* dependencies,
+                                       unsigned long long changed) const {
+    const Data::RegisterInstruction* IP = code - 1;
+
+#ifdef FP_USE_THREADED_DISPATCH
+    // In the order of the RegisterOpcode enum:
+    static const void* const handlers[] = {
+        &&l_rAbs, &&l_rAcos, &&l_rAcosh, &&l_rAsin, &&l_rAsinh, &&l_rAtan,
+        &&l_rAtan2, &&l_rAtanh, &&l_rCeil, &&l_rCos, &&l_rCosh, &&l_rCot,
+        &&l_rCsc, &&l_rEval, &&l_rExp, &&l_rExp2, &&l_rFloor, &&l_rIf,
+        &&l_rInt, &&l_rLog, &&l_rLog10, &&l_rLog2, &&l_rMax, &&l_rMin,
+        &&l_rPow, &&l_rSec, &&l_rSin, &&l_rSinh, &&l_rSqrt, &&l_rTan,
+        &&l_rTanh,
+        &&l_rMov, &&l_rJump, &&l_rNeg, &&l_rAdd, &&l_rSub, &&l_rMul,
+        &&l_rDiv, &&l_rMod, &&l_rEqual, &&l_rNEqual, &&l_rLess,
+        &&l_rLessOrEq, &&l_rGreater, &&l_rGreaterOrEq, &&l_rNot, &&l_rAnd,
+        &&l_rOr, &&l_rNotNot, &&l_rDeg, &&l_rRad, &&l_rFCall, &&l_rPCall,
+        &&l_rInv, &&l_rSqr, &&l_rRSqrt, &&l_rSelect,
+        &&l_rIfEqual, &&l_rIfNEqual, &&l_rIfLess, &&l_rIfLessOrEq,
+        &&l_rIfGreater, &&l_rIfGreaterOrEq,
+        &&l_rEnd
+    };
+
+    FP_NEXT;
+    {
+#else
+    for (++IP;; ++IP) {
+        if (incremental && !(dependencies[IP - code] & changed))
+            continue;
+        switch (IP->opcode) {
+#endif
+#define D R[IP->dest]
+#define A R[IP->param1]
+#define B R[IP->param2]
+            // Functions:
+        FP_CASE(rAbs)
+            D = fabs(A);
+            FP_NEXT;
+
+        FP_CASE(rAcos)
+#ifndef FP_NO_EVALUATION_CHECKS
+            if (checks && (A < -1 || A > 1)) {
+                context.evalErrorType = 4;
+                return 0;
+            }
+#endif
+            D = acos(A);
+            FP_NEXT;
+
+        FP_CASE(rAcosh)
+            D = fp_acosh(A);
+            FP_NEXT;
+
+        FP_CASE(rAsin)
+#ifndef FP_NO_EVALUATION_CHECKS
+            if (checks && (A < -1 || A > 1)) {
+                context.evalErrorType = 4;
+                return 0;
+            }
+#endif
+            D = asin(A);
+            FP_NEXT;
+
+        FP_CASE(rAsinh)
+            D = fp_asinh(A);
+            FP_NEXT;
+
+        FP_CASE(rAtan)
+            D = atan(A);
+            FP_NEXT;
+
+        FP_CASE(rAtan2)
+            D = atan2(A, B);
+            FP_NEXT;
+
+        FP_CASE(rAtanh)
+            D = fp_atanh(A);
+            FP_NEXT;
+
+        FP_CASE(rCeil)
+            D = ceil(A);
+            FP_NEXT;
+
+        FP_CASE(rCos)
+            D = cos(A);
+            FP_NEXT;
+
+        FP_CASE(rCosh)
+            D = cosh(A);
+            FP_NEXT;
+
+        FP_CASE(rCot) {
+            const double t = tan(A);
+#ifndef FP_NO_EVALUATION_CHECKS
+            if (checks && t == 0) {
+                context.evalErrorType = 1;
+                return 0;
+            }
+#endif
+            D = 1 / t;
+            FP_NEXT;
+        }
+
+        FP_CASE(rCsc) {
+            const double s = sin(A);
+#ifndef FP_NO_EVALUATION_CHECKS
+            if (checks && s == 0) {
+                context.evalErrorType = 1;
+                return 0;
+            }
+#endif
+            D = 1 / s;
+            FP_NEXT;
+        }
+
+        FP_CASE(rEval) {
+#ifndef FP_DISABLE_EVAL
+            double retVal = 0;
+            if (context.evalRecursionLevel == FP_EVAL_MAX_REC_LEVEL) {
+                context.evalErrorType = 5;
+            } else {
+                EvalContext& nested = context.Nested();
+                nested.evalRecursionLevel = context.evalRecursionLevel + 1;
+                retVal = Eval(nested, &A);
+            }
+            D = retVal;
+#endif
+            FP_NEXT;
+        }
+
+        FP_CASE(rExp)
+            D = exp(A);
+            FP_NEXT;
+
+        FP_CASE(rExp2)
+            D = pow(2.0, A);
+            FP_NEXT;
+
+        FP_CASE(rFloor)
+            D = floor(A);
+            FP_NEXT;
+
+        FP_CASE(rIf)
+            if (doubleToInt(A) == 0)
+                IP = code + IP->dest - 1;
+            FP_NEXT;
+
+        FP_CASE(rInt)
+            D = floor(A + .5);
+            FP_NEXT;
+
+        FP_CASE(rLog)
+#ifndef FP_NO_EVALUATION_CHECKS
+            if (checks && A <= 0) {
+                context.evalErrorType = 3;
+                return 0;
+            }
+#endif
+            D = log(A);
+            FP_NEXT;
+
+        FP_CASE(rLog10)
+#ifndef FP_NO_EVALUATION_CHECKS
+            if (checks && A <= 0) {
+                context.evalErrorType = 3;
+                return 0;
+            }
+#endif
+            D = log10(A);
+            FP_NEXT;
+
+        FP_CASE(rLog2)
+#ifndef FP_NO_EVALUATION_CHECKS
+            if (checks && A <= 0) {
+                context.evalErrorType = 3;
+                return 0;
+            }
+#endif
+#ifdef FP_SUPPORT_LOG2
+            D = log2(A);
+#else
+            D = log(A) * 1.4426950408889634074;
+#endif
+            FP_NEXT;
+
+        FP_CASE(rMax)
+            D = Max(A, B);
+            FP_NEXT;
+
+        FP_CASE(rMin)
+            D = Min(A, B);
+            FP_NEXT;
+
+        FP_CASE(rPow)
+            D = pow(A, B);
+            FP_NEXT;
+
+        FP_CASE(rSec) {
+            const double c = cos(A);
+#ifndef FP_NO_EVALUATION_CHECKS
+            if (checks && c == 0) {
+                context.evalErrorType = 1;
+                return 0;
+            }
+#endif
+            D = 1 / c;
+            FP_NEXT;
+        }
+
+        FP_CASE(rSin)
+            D = sin(A);
+            FP_NEXT;
+
+        FP_CASE(rSinh)
+            D = sinh(A);
+            FP_NEXT;
+
+        FP_CASE(rSqrt)
+#ifndef FP_NO_EVALUATION_CHECKS
+            if (checks && A < 0) {
+                context.evalErrorType = 2;
+                return 0;
+            }
+#endif
+            D = sqrt(A);
+            FP_NEXT;
+
+        FP_CASE(rTan)
+            D = tan(A);
+            FP_NEXT;
+
+        FP_CASE(rTanh)
+            D = tanh(A);
+            FP_NEXT;
+
+            // Misc:
+        FP_CASE(rMov)
+            D = A;
+            FP_NEXT;
+
+        FP_CASE(rJump)
+            IP = code + IP->dest - 1;
+            FP_NEXT;
+
+            // Operators:
+        FP_CASE(rNeg)
+            D = -A;
+            FP_NEXT;
+        FP_CASE(rAdd)
+            D = A + B;
+            FP_NEXT;
+        FP_CASE(rSub)
+            D = A - B;
+            FP_NEXT;
+        FP_CASE(rMul)
+            D = A * B;
+            FP_NEXT;
+
+        FP_CASE(rDiv)
+#ifndef FP_NO_EVALUATION_CHECKS
+            if (checks && B == 0) {
+                context.evalErrorType = 1;
+                return 0;
+            }
+#endif
+            D = A / B;
+            FP_NEXT;
+
+        FP_CASE(rMod)
+#ifndef FP_NO_EVALUATION_CHECKS
+            if (checks && B == 0) {
+                context.evalErrorType = 1;
+                return 0;
+            }
+#endif
+            D = fmod(A, B);
+            FP_NEXT;
+
+#ifdef FP_EPSILON
+        FP_CASE(rEqual)
+            D = (fabs(A - B) <= FP_EPSILON);
+            FP_NEXT;
+        FP_CASE(rNEqual)
+            D = (fabs(A - B) >= FP_EPSILON);
+            FP_NEXT;
+        FP_CASE(rLess)
+            D = (A < B - FP_EPSILON);
+            FP_NEXT;
+        FP_CASE(rLessOrEq)
+            D = (A <= B + FP_EPSILON);
+            FP_NEXT;
+        FP_CASE(rGreater)
+            D = (A - FP_EPSILON > B);
+            FP_NEXT;
+        FP_CASE(rGreaterOrEq)
+            D = (A + FP_EPSILON >= B);
+            FP_NEXT;
+#else
+        FP_CASE(rEqual)
+            D = (A == B);
+            FP_NEXT;
+        FP_CASE(rNEqual)
+            D = (A != B);
+            FP_NEXT;
+        FP_CASE(rLess)
+            D = (A < B);
+            FP_NEXT;
+        FP_CASE(rLessOrEq)
+            D = (A <= B);
+            FP_NEXT;
+        FP_CASE(rGreater)
+            D = (A > B);
+            FP_NEXT;
+        FP_CASE(rGreaterOrEq)
+            D = (A >= B);
+            FP_NEXT;
+#endif
+
+        FP_CASE(rNot)
+            D = !doubleToInt(A);
+            FP_NEXT;
+        FP_CASE(rAnd)
+            D = (doubleToInt(A) && doubleToInt(B));
+            FP_NEXT;
+        FP_CASE(rOr)
+            D = (doubleToInt(A) || doubleToInt(B));
+            FP_NEXT;
+        FP_CASE(rNotNot)
+            D = !!doubleToInt(A);
+            FP_NEXT;
+
+            // Degrees-radians conversion:
+        FP_CASE(rDeg)
+            D = RadiansToDegrees(A);
+            FP_NEXT;
+        FP_CASE(rRad)
+            D = DegreesToRadians(A);
+            FP_NEXT;
+
+            // User-defined function calls:
+        FP_CASE(rFCall)
+            D = data->FuncPtrs[IP->param2].funcPtr(&A);
+            FP_NEXT;
+
+        FP_CASE(rPCall) {
+            EvalContext& nested = context.Nested();
+            nested.evalErrorType = 0;
+            nested.evalRecursionLevel = 0;
+            const double retVal = data->FuncParsers[IP->param2].parserPtr->Eval(nested, &A);
+            const int error = nested.evalErrorType;
+            if (error) {
+                context.evalErrorType = error;
+                return 0;
+            }
+            D = retVal;
+            FP_NEXT;
+        }
+
+        FP_CASE(rInv)
+#ifndef FP_NO_EVALUATION_CHECKS
+            if (checks && A == 0.0) {
+                context.evalErrorType = 1;
+                return 0;
+            }
+#endif
+            D = 1.0 / A;
+            FP_NEXT;
+
+        FP_CASE(rSqr)
+            D = A * A;
+            FP_NEXT;
+
+        FP_CASE(rRSqrt)
+#ifndef FP_NO_EVALUATION_CHECKS
+            if (checks && A == 0) {
+                context.evalErrorType = 1;
+                return 0;
+            }
+#endif
+            D = 1.0 / sqrt(A);
+            FP_NEXT;
+
+        FP_CASE(rSelect)
+            D = doubleToInt(A) ? B : D;
+            FP_NEXT;
+
+            // Superinstructions:
+#ifdef FP_EPSILON
+        FP_CASE(rIfEqual)
+            if (!(fabs(A - B) <= FP_EPSILON))
+                IP = code + IP->dest - 1;
+            FP_NEXT;
+        FP_CASE(rIfNEqual)
+            if (!(fabs(A - B) >= FP_EPSILON))
+                IP = code + IP->dest - 1;
+            FP_NEXT;
+        FP_CASE(rIfLess)
+            if (!(A < B - FP_EPSILON))
+                IP = code + IP->dest - 1;
+            FP_NEXT;
+        FP_CASE(rIfLessOrEq)
+            if (!(A <= B + FP_EPSILON))
+                IP = code + IP->dest - 1;
+            FP_NEXT;
+        FP_CASE(rIfGreater)
+            if (!(A - FP_EPSILON > B))
+                IP = code + IP->dest - 1;
+            FP_NEXT;
+        FP_CASE(rIfGreaterOrEq)
+            if (!(A + FP_EPSILON >= B))
+                IP = code + IP->dest - 1;
+            FP_NEXT;
+#else
+        FP_CASE(rIfEqual)
+            if (!(A == B))
+                IP = code + IP->dest - 1;
+            FP_NEXT;
+        FP_CASE(rIfNEqual)
+            if (!(A != B))
+                IP = code + IP->dest - 1;
+            FP_NEXT;
+        FP_CASE(rIfLess)
+            if (!(A < B))
+                IP = code + IP->dest - 1;
+            FP_NEXT;
+        FP_CASE(rIfLessOrEq)
+            if (!(A <= B))
+                IP = code + IP->dest - 1;
+            FP_NEXT;
+        FP_CASE(rIfGreater)
+            if (!(A > B))
+                IP = code + IP->dest - 1;
+            FP_NEXT;
+        FP_CASE(rIfGreaterOrEq)
+            if (!(A >= B))
+                IP = code + IP->dest - 1;
+            FP_NEXT;
+#endif
+
+        FP_CASE(rEnd)
+            context.evalErrorType = 0;
+            return A;
+#undef D
+#undef A
+#undef B
+#ifdef FP_USE_THREADED_DISPATCH
+    }
+#else
+        }
+    }
+#endif
+}
+
+#undef FP_CASE
+#undef FP_NEXT
+
+template double FunctionParser::EvalRegisterCode<true>(EvalContext&, double*, const double*) const;
+template double FunctionParser::EvalRegisterCode<false>(EvalContext&, double*, const double*) const;
+
+//=========================================================================
+// Incremental evaluation
+//=========================================================================
+/* IncrementalEvaluator translates the function into register code of its
+   own, in which no register is reused, so after an evaluation each
+   register still holds the value its instruction computed. Each
+   instruction gets a mask of the variables its value depends on (bit i for
+   the variable in register i, with the variables from register 62 on
+   sharing bit 62). The control instructions have all the bits set,
+   including bit 63, which is always included in the changed variables.
+   An instruction inside an if() also depends on the variables of the
+   condition: as long as they do not change, the same branch is taken and
+   the registers written in it are up to date. So on the next evaluation
+   only the instructions depending on a changed variable are executed.
+   After an error nothing is known about the registers, so the next
+   evaluation computes everything again.
+*/
+namespace {
+const unsigned long long AllVariables = ~0ULL;
+const unsigned long long ControlBit = 1ULL << 63;
+
+inline unsigned long long VariableBit(unsigned reg) {
+    return 1ULL << (reg < 62 ? reg : 62);
+}
+
+#ifndef FP_NO_REGISTER_CODE
+struct Condition {
+    unsigned end; // of the else branch
+    unsigned long long dependencies;
+};
+
+void FindDependencies(const FunctionParser::Data& data,
+                      const std::vector<FunctionParser::Data::RegisterInstruction>& code,
+                      unsigned variableAmount, unsigned registerAmount,
+                      std::vector<unsigned long long>& dependencies) {
+    std::vector<unsigned long long> registerDependencies(registerAmount, 0);
+    for (unsigned i = 0; i < variableAmount; ++i)
+        registerDependencies[i] = VariableBit(i);
+
+    // The if()s which the current instruction is inside of:
+    std::vector<Condition> conditions;
+
+    dependencies.assign(code.size(), AllVariables);
+    for (unsigned i = 0; i < code.size(); ++i) {
+        unsigned long long enclosing = 0;
+        for (unsigned c = unsigned(conditions.size()); c-- > 0;) {
+            if (conditions[c].end <= i)
+                conditions.erase(conditions.begin() + c);
+            else
+                enclosing |= conditions[c].dependencies;
+        }
+
+        const FunctionParser::Data::RegisterInstruction& instruction = code[i];
+        switch (instruction.opcode) {
+        case rJump:
+        case rEnd:
+            break;
+
+        case rIf: case rIfEqual: case rIfNEqual: case rIfLess:
+        case rIfLessOrEq: case rIfGreater: case rIfGreaterOrEq: {
+            // Both branches end where the jump at the end of the first
+            // one goes (or at the end, if it returns):
+            Condition condition;
+            const FunctionParser::Data::RegisterInstruction& jump = code[instruction.dest - 1];
+            condition.end = jump.opcode == rJump ? jump.dest : unsigned(code.size());
+            condition.dependencies = enclosing | registerDependencies[instruction.param1];
+            if (isBinaryOpcode(instruction.opcode))
+                condition.dependencies |= registerDependencies[instruction.param2];
+            conditions.push_back(condition);
+            break;
+        }
+
+        case rFCall:
+        case rPCall:
+        case rEval: {
+            unsigned params =
+                instruction.opcode == rFCall ? data.FuncPtrs[instruction.param2].params :
+                instruction.opcode == rPCall ? data.FuncParsers[instruction.param2].params :
+                unsigned(data.variableRefs.size());
+            unsigned long long result = enclosing;
+            for (unsigned p = 0; p < params; ++p)
+                result |= registerDependencies[instruction.param1 + p];
+            dependencies[i] = result;
+            registerDependencies[instruction.dest] |= result;
+            break;
+        }
+
+        case rSelect: {
+            // The false value is in the destination, written by the previous
+            // instruction, which has to be executed again along with this one.
+            const unsigned long long result = enclosing | registerDependencies[instruction.param1] |
+                registerDependencies[instruction.param2] | dependencies[i - 1];
+            dependencies[i - 1] = dependencies[i] = result;
+            registerDependencies[instruction.dest] |= result;
+            break;
+        }
+
+        default: {
+            unsigned long long result = enclosing | registerDependencies[instruction.param1];
+            if (isBinaryOpcode(instruction.opcode))
+                result |= registerDependencies[instruction.param2];
+            dependencies[i] = result;
+            // The result of an if() is written in both branches:
+            registerDependencies[instruction.dest] |= result;
+        }
+        }
+    }
+}
+#endif
+} // namespace
+
+IncrementalEvaluator::IncrementalEvaluator(const FunctionParser& function)
+    : parser(function), upToDate(false), evalErrorType(0) {
+#ifndef FP_NO_REGISTER_CODE
+    if (parser.GetParseErrorType() != FunctionParser::FP_NO_ERROR)
+        return;
+
+    const FunctionParser::Data& data = *parser.data;
+    unsigned firstTemporary = 0;
+    RegisterTranslator translator(data, false);
+    if (!translator.Translate(code, registers, variables, firstTemporary)) {
+        code.clear();
+        return;
+    }
+    FindDependencies(data, code, unsigned(variables.size()), unsigned(registers.size()),
+                     dependencies);
+
+    for (unsigned i = 0; i < variables.size(); ++i) {
+        if (variableRegister.size() <= variables[i])
+            variableRegister.resize(variables[i] + 1, ~0U);
+        variableRegister[variables[i]] = i;
+    }
+#endif
+}
+
+void IncrementalEvaluator::Reset() {
+    upToDate = false;
+}
+
+double IncrementalEvaluator::Eval(const double* Vars) {
+    if (code.empty())
+        return EvalDirectly(Vars);
+
+    unsigned long long changed = 0;
+    for (unsigned i = 0; i < variables.size(); ++i) {
+        const double value = Vars[variables[i]];
+        if (std::memcmp(&registers[i], &value, sizeof(double)) != 0) {
+            registers[i] = value;
+            changed |= VariableBit(i);
+        }
+    }
+    return Evaluate(changed);
+}
+
+double IncrementalEvaluator::Eval(const double* Vars, const unsigned* changedVariables,
+                                  unsigned changedAmount) {
+    if (code.empty())
+        return EvalDirectly(Vars);
+
+    if (!upToDate) {
+        for (unsigned i = 0; i < variables.size(); ++i)
+            registers[i] = Vars[variables[i]];
+        return Evaluate(AllVariables);
+    }
+
+    unsigned long long changed = 0;
+    for (unsigned i = 0; i < changedAmount; ++i) {
+        const unsigned variable = changedVariables[i];
+        if (variable < variableRegister.size() && variableRegister[variable] != ~0U) {
+            const unsigned reg = variableRegister[variable];
+            registers[reg] = Vars[variable];
+            changed |= VariableBit(reg);
+        }
+    }
+    return Evaluate(changed);
+}
+
+double IncrementalEvaluator::Evaluate(unsigned long long changed) {
+    const double result = upToDate ?
+        parser.RunRegisterCode<true, true>(context, &code[0], &registers[0],
+                                           &dependencies[0], changed | ControlBit) :
+        parser.RunRegisterCode<true, false>(context, &code[0], &registers[0], 0, 0);
+    evalErrorType = context.EvalError();
+    upToDate = evalErrorType == 0;
+    return result;
+}
+
+// Without the register code the function is just evaluated every time.
+double IncrementalEvaluator::EvalDirectly(const double* Vars) {
+    const double result = parser.Eval(context, Vars);
+    evalErrorType = context.EvalError();
+    return result;
+}
+
+//=========================================================================
+// Debug output
+//=========================================================================
+#ifdef FUNCTIONPARSER_SUPPORT_DEBUG_OUTPUT
+#include <iomanip>
+
+namespace {
+// In the order of the RegisterOpcode enum:
+const char* const registerOpcodeNames[] = {
+    "abs", "acos", "acosh", "asin", "asinh", "atan", "atan2", "atanh",
+    "ceil", "cos", "cosh", "cot", "csc", "call 0", "exp", "exp2", "floor",
+    "jz", "int", "log", "log10", "log2", "max", "min", "pow", "sec", "sin",
+    "sinh", "sqrt", "tan", "tanh",
+    "mov", "jump", "neg", "add", "sub", "mul", "div", "mod", "eq", "neq",
+    "lt", "le", "gt", "ge", "not", "and", "or", "notnot", "deg", "rad",
+    "fcall", "pcall", "inv", "sqr", "rsqrt", "select",
+    "jz eq", "jz neq", "jz lt", "jz le", "jz gt", "jz ge",
+    "ret"
+};
+
+void printRegister(std::ostream& dest, unsigned reg) {
+    dest << 'r' << reg;
+}
+
+void printAddress(std::ostream& dest, unsigned address) {
+    const std::ios::fmtflags flags = dest.flags();
+    dest << std::setw(4) << std::setfill('0') << std::hex << address;
+    dest.flags(flags);
+    dest.fill(' ');
+}
+} // namespace
+
+template<>
+void FunctionParser::PrintRegisterCode(std::ostream& dest) const {
+    const std::vector<Data::RegisterInstruction>& code = data->RegisterCode;
+    if (code.empty()) {
+        dest << "No register code\n";
+        return;
+    }
+
+    // The registers which are read but never written hold the constants:
+    const unsigned variableAmount = unsigned(data->RegisterVars.size());
+    std::vector<bool> read(data->RegisterFile.size(), false);
+    std::vector<bool> written(data->RegisterFile.size(), false);
+    for (unsigned i = 0; i < code.size(); ++i) {
+        const Data::RegisterInstruction& instruction = code[i];
+        switch (instruction.opcode) {
+        case rJump:
+            break;
+        case rIf: case rEnd:
+            read[instruction.param1] = true;
+            break;
+        default:
+            if (isBinaryOpcode(instruction.opcode))
+                read[instruction.param2] = true;
+            if (instruction.opcode < rIfEqual || instruction.opcode > rIfGreaterOrEq)
+                written[instruction.dest] = true;
+            read[instruction.param1] = true;
+        }
+    }
+
+    dest << "Register code:\n";
+    for (unsigned i = 0; i < variableAmount; ++i) {
+        std::map<NamePtr, unsigned>::const_iterator iter = data->variableRefs.begin();
+        while (iter != data->variableRefs.end() &&
+               iter->second != VarBegin + data->RegisterVars[i])
+            ++iter;
+        dest << "      ";
+        printRegister(dest, i);
+        dest << " = ";
+        if (iter != data->variableRefs.end())
+            dest << std::string(iter->first.name, iter->first.nameLength);
+        else
+            dest << "Var" << data->RegisterVars[i];
+        dest << "\n";
+    }
+    for (unsigned i = variableAmount; i < written.size(); ++i)
+        if (read[i] && !written[i]) {
+            dest << "      ";
+            printRegister(dest, i);
+            dest.precision(8);
+            dest << " = " << data->RegisterFile[i] << "\n";
+        }
+
+    for (unsigned i = 0; i < code.size(); ++i) {
+        const Data::RegisterInstruction& instruction = code[i];
+        printAddress(dest, i);
+        dest << ": " << registerOpcodeNames[instruction.opcode];
+
+        switch (instruction.opcode) {
+        case rJump:
+            dest << ' ';
+            printAddress(dest, instruction.dest);
+            break;
+        case rIf:
+            dest << ' ';
+            printRegister(dest, instruction.param1);
+            dest << ", ";
+            printAddress(dest, instruction.dest);
+            break;
+        case rIfEqual: case rIfNEqual: case rIfLess:
+        case rIfLessOrEq: case rIfGreater: case rIfGreaterOrEq:
+            dest << ' ';
+            printRegister(dest, instruction.param1);
+            dest << ", ";
+            printRegister(dest, instruction.param2);
+            dest << ", ";
+            printAddress(dest, instruction.dest);
+            break;
+        case rEnd:
+            dest << ' ';
+            printRegister(dest, instruction.param1);
+            break;
+        case rFCall: case rPCall: case rEval:
+            dest << ' ';
+            printRegister(dest, instruction.dest);
+            dest << ", [";
+            printRegister(dest, instruction.param1);
+            dest << "...]";
+            if (instruction.opcode != rEval)
+                dest << ", " << instruction.param2;
+            break;
+        default:
+            dest << ' ';
+            printRegister(dest, instruction.dest);
+            dest << ", ";
+            printRegister(dest, instruction.param1);
+            if (isBinaryOpcode(instruction.opcode)) {
+                dest << ", ";
+                printRegister(dest, instruction.param2);
+            }
+        }
+        dest << "\n";
+    }
+}
+#endif
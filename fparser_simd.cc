@@ -0,0 +1,857 @@
+/***************************************************************************\
+|* Function Parser for C++ v3.3.2                                          *|
+|*-------------------------------------------------------------------------*|
+|* Copyright: Juha Nieminen                                                *|
+\***************************************************************************/
+
+#include "stdafx.h"
+#include "fpconfig.hh"
+#include "fparser_simd.hh"
+#include "fpaux.hh"
+
+#include <cmath>
+
+#if !defined(FP_NO_SIMD_KERNELS) && (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define FP_SIMD_KERNELS_X86
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+using namespace FUNCTIONPARSERTYPES;
+
+//=========================================================================
+// Scalar operations
+//=========================================================================
+/* These define the exact semantics of every kernel. The vector versions
+   must produce the same bits (except those of the math kernels, which are
+   only within the error bounds documented for UseVectorMath()), and they use
+   these for the elements which do not fill a whole vector. The float kernels compute
+   in single precision throughout, including the FP_EPSILON comparisons.
+*/
+namespace {
+template<typename T> inline T OpAdd(T x, T y) { return x + y; }
+template<typename T> inline T OpSub(T x, T y) { return x - y; }
+template<typename T> inline T OpRSub(T x, T y) { return y - x; }
+template<typename T> inline T OpMul(T x, T y) { return x * y; }
+template<typename T> inline T OpDiv(T x, T y) { return x / y; }
+template<typename T> inline T OpRDiv(T x, T y) { return y / x; }
+template<typename T> inline T OpMin(T x, T y) { return x < y ? x : y; }
+template<typename T> inline T OpMax(T x, T y) { return x > y ? x : y; }
+#ifdef FP_EPSILON
+template<typename T> inline T OpEqual(T x, T y) { return std::fabs(x - y) <= T(FP_EPSILON); }
+template<typename T> inline T OpNEqual(T x, T y) { return std::fabs(x - y) >= T(FP_EPSILON); }
+template<typename T> inline T OpLess(T x, T y) { return x < y - T(FP_EPSILON); }
+template<typename T> inline T OpLessOrEq(T x, T y) { return x <= y + T(FP_EPSILON); }
+template<typename T> inline T OpGreater(T x, T y) { return x - T(FP_EPSILON) > y; }
+template<typename T> inline T OpGreaterOrEq(T x, T y) { return x + T(FP_EPSILON) >= y; }
+#else
+template<typename T> inline T OpEqual(T x, T y) { return x == y; }
+template<typename T> inline T OpNEqual(T x, T y) { return x != y; }
+template<typename T> inline T OpLess(T x, T y) { return x < y; }
+template<typename T> inline T OpLessOrEq(T x, T y) { return x <= y; }
+template<typename T> inline T OpGreater(T x, T y) { return x > y; }
+template<typename T> inline T OpGreaterOrEq(T x, T y) { return x >= y; }
+#endif
+
+template<typename T> inline T OpNeg(T x) { return -x; }
+template<typename T> inline T OpAbs(T x) { return std::fabs(x); }
+template<typename T> inline T OpSqr(T x) { return x * x; }
+template<typename T> inline T OpSqrt(T x) { return std::sqrt(x); }
+template<typename T> inline T OpInv(T x) { return T(1) / x; }
+template<typename T> inline T OpRSqrt(T x) { return T(1) / std::sqrt(x); }
+
+template<typename T> inline T OpExp(T x) { return std::exp(x); }
+template<typename T> inline T OpExp2(T x) { return std::pow(T(2), x); }
+template<typename T> inline T OpLog(T x) { return std::log(x); }
+template<typename T> inline T OpLog2(T x) { return fp_log2(x); }
+template<typename T> inline T OpLog10(T x) { return std::log10(x); }
+template<typename T> inline T OpSin(T x) { return std::sin(x); }
+template<typename T> inline T OpCos(T x) { return std::cos(x); }
+template<typename T> inline T OpTan(T x) { return std::tan(x); }
+template<typename T> inline T OpAtan(T x) { return std::atan(x); }
+template<typename T> inline T OpPow(T x, T y) { return std::pow(x, y); }
+template<typename T> inline T OpRPow(T x, T y) { return std::pow(y, x); }
+template<typename T> inline T OpAtan2(T x, T y) { return std::atan2(x, y); }
+
+// The truth of x is that of if(): doubleToInt(x) != 0, which holds unless
+// |x|+0.5 < 1 (a NaN is true). For a float this is |x| < 0.5.
+template<typename T> inline T OpSelect(T x, T y, T z) { return doubleToInt(x) ? y : z; }
+
+template<typename T> inline bool IsZero(T x) { return x == 0; }
+template<typename T> inline bool IsNegative(T x) { return x < 0; }
+template<typename T> inline bool IsNonPositive(T x) { return x <= 0; }
+template<typename T> inline bool IsOutsideUnit(T x) { return x < -1 || x > 1; }
+} // namespace
+
+//=========================================================================
+// Kernel generation
+//=========================================================================
+/* Every kernel set is generated from the same lists. Before expanding
+   FP_DEFINE_KERNEL_SET the instruction set section defines the value type,
+   vector type and width, loads and stores, and a <Name>_vec function (Is<Name>_vec
+   for the checks) for each entry of the lists; fparser_vmath.hh defines
+   those of the math lists. The double and the float kernels of a set are
+   overloads of each other.
+*/
+#define FP_FOR_EACH_BINARY_KERNEL(m) \
+    m(add, Add) m(sub, Sub) m(rsub, RSub) m(mul, Mul) m(div, Div) m(rdiv, RDiv) \
+    m(min, Min) m(max, Max) m(equal, Equal) m(nequal, NEqual) m(less, Less) \
+    m(lessOrEq, LessOrEq) m(greater, Greater) m(greaterOrEq, GreaterOrEq)
+#define FP_FOR_EACH_UNARY_KERNEL(m) \
+    m(neg, Neg) m(abs, Abs) m(sqr, Sqr) m(sqrt, Sqrt) m(inv, Inv) m(rsqrt, RSqrt)
+#define FP_FOR_EACH_CHECK_KERNEL(m) \
+    m(anyZero, Zero) m(anyNegative, Negative) m(anyNonPositive, NonPositive) \
+    m(anyOutsideUnit, OutsideUnit)
+#define FP_FOR_EACH_MATH_UNARY_KERNEL(m) \
+    m(exp, Exp) m(exp2, Exp2) m(log, Log) m(log2, Log2) m(log10, Log10) \
+    m(sin, Sin) m(cos, Cos) m(tan, Tan) m(atan, Atan)
+#define FP_FOR_EACH_MATH_BINARY_KERNEL(m) \
+    m(pow, Pow) m(rpow, RPow) m(atan2, Atan2)
+
+#define FP_BINARY_KERNEL(name, op) \
+    FP_KERNEL_TARGET void name##_kernel(FP_KERNEL_VALUE* x, const FP_KERNEL_VALUE* y, unsigned n) { \
+        unsigned i = 0; \
+        for (; i + FP_VEC_WIDTH <= n; i += FP_VEC_WIDTH) \
+            FP_VEC_STORE(x + i, op##_vec(FP_VEC_LOAD(x + i), FP_VEC_LOAD(y + i))); \
+        for (; i < n; ++i) \
+            x[i] = Op##op(x[i], y[i]); \
+    }
+
+#define FP_UNARY_KERNEL(name, op) \
+    FP_KERNEL_TARGET void name##_kernel(FP_KERNEL_VALUE* x, unsigned n) { \
+        unsigned i = 0; \
+        for (; i + FP_VEC_WIDTH <= n; i += FP_VEC_WIDTH) \
+            FP_VEC_STORE(x + i, op##_vec(FP_VEC_LOAD(x + i))); \
+        for (; i < n; ++i) \
+            x[i] = Op##op(x[i]); \
+    }
+
+#define FP_CHECK_KERNEL(name, op) \
+    FP_KERNEL_TARGET bool name##_kernel(const FP_KERNEL_VALUE* x, unsigned n) { \
+        unsigned i = 0; \
+        for (; i + FP_VEC_WIDTH <= n; i += FP_VEC_WIDTH) \
+            if (Is##op##_vec(FP_VEC_LOAD(x + i))) \
+                return true; \
+        for (; i < n; ++i) \
+            if (Is##op(x[i])) \
+                return true; \
+        return false; \
+    }
+
+#define FP_SELECT_KERNEL \
+    FP_KERNEL_TARGET void select_kernel(FP_KERNEL_VALUE* x, const FP_KERNEL_VALUE* y, \
+                                        const FP_KERNEL_VALUE* z, unsigned n) { \
+        unsigned i = 0; \
+        for (; i + FP_VEC_WIDTH <= n; i += FP_VEC_WIDTH) \
+            FP_VEC_STORE(x + i, Select_vec(FP_VEC_LOAD(x + i), FP_VEC_LOAD(y + i), FP_VEC_LOAD(z + i))); \
+        for (; i < n; ++i) \
+            x[i] = OpSelect(x[i], y[i], z[i]); \
+    }
+
+// Lanes which do not fill a whole vector (eg. of the 16 floats of
+// AVX-512) are done one at a time.
+#define FP_DIFFERENCES_KERNEL \
+    FP_KERNEL_TARGET void differences_kernel(FP_KERNEL_VALUE* hi, FP_KERNEL_VALUE* lo, unsigned degree, \
+                                             unsigned n, FP_KERNEL_VALUE* results) { \
+        for (; n > 0; --n, results += DifferenceLanes) { \
+            unsigned j = 0; \
+            for (; j + FP_VEC_WIDTH <= DifferenceLanes; j += FP_VEC_WIDTH) { \
+                FP_VEC_STORE(results + j, Add_vec(FP_VEC_LOAD(hi + j), FP_VEC_LOAD(lo + j))); \
+                for (unsigned k = 0; k < degree; ++k) { \
+                    FP_KERNEL_VALUE* const h = hi + k * DifferenceLanes + j; \
+                    FP_KERNEL_VALUE* const l = lo + k * DifferenceLanes + j; \
+                    const FP_VEC_TYPE a = FP_VEC_LOAD(h), b = FP_VEC_LOAD(h + DifferenceLanes); \
+                    const FP_VEC_TYPE sum = Add_vec(a, b), bb = Sub_vec(sum, a); \
+                    const FP_VEC_TYPE error = Add_vec(Sub_vec(a, Sub_vec(sum, bb)), Sub_vec(b, bb)); \
+                    FP_VEC_STORE(l, Add_vec(FP_VEC_LOAD(l), Add_vec(error, FP_VEC_LOAD(l + DifferenceLanes)))); \
+                    FP_VEC_STORE(h, sum); \
+                } \
+            } \
+            for (; j < DifferenceLanes; ++j) { \
+                results[j] = hi[j] + lo[j]; \
+                for (unsigned k = 0; k < degree; ++k) { \
+                    FP_KERNEL_VALUE* const h = hi + k * DifferenceLanes + j; \
+                    FP_KERNEL_VALUE* const l = lo + k * DifferenceLanes + j; \
+                    const FP_KERNEL_VALUE a = h[0], b = h[DifferenceLanes]; \
+                    const FP_KERNEL_VALUE sum = a + b, bb = sum - a; \
+                    l[0] += ((a - (sum - bb)) + (b - bb)) + l[DifferenceLanes]; \
+                    h[0] = sum; \
+                } \
+            } \
+        } \
+        for (unsigned i = 0; i < degree * DifferenceLanes; ++i) { \
+            const FP_KERNEL_VALUE sum = hi[i] + lo[i]; \
+            lo[i] -= sum - hi[i]; \
+            hi[i] = sum; \
+        } \
+    }
+
+#define FP_KERNEL_ENTRY(name, op) &name##_kernel,
+
+#define FP_DEFINE_KERNEL_SET(isa, set) \
+    FP_FOR_EACH_BINARY_KERNEL(FP_BINARY_KERNEL) \
+    FP_SELECT_KERNEL \
+    FP_FOR_EACH_UNARY_KERNEL(FP_UNARY_KERNEL) \
+    FP_FOR_EACH_CHECK_KERNEL(FP_CHECK_KERNEL) \
+    FP_FOR_EACH_MATH_UNARY_KERNEL(FP_UNARY_KERNEL) \
+    FP_FOR_EACH_MATH_BINARY_KERNEL(FP_BINARY_KERNEL) \
+    FP_DIFFERENCES_KERNEL \
+    const BatchKernels<FP_KERNEL_VALUE> set = { \
+        isa, \
+        FP_FOR_EACH_BINARY_KERNEL(FP_KERNEL_ENTRY) \
+        &select_kernel, \
+        FP_FOR_EACH_UNARY_KERNEL(FP_KERNEL_ENTRY) \
+        FP_FOR_EACH_CHECK_KERNEL(FP_KERNEL_ENTRY) \
+        FP_FOR_EACH_MATH_UNARY_KERNEL(FP_KERNEL_ENTRY) \
+        FP_FOR_EACH_MATH_BINARY_KERNEL(FP_KERNEL_ENTRY) \
+        &differences_kernel, \
+    };
+
+#ifndef FP_SIMD_KERNELS_X86
+//=========================================================================
+// Portable kernels
+//=========================================================================
+#define FP_KERNEL_TARGET
+#define FP_VEC_WIDTH 1
+#define FP_VEC_TYPE FP_KERNEL_VALUE
+#define FP_VEC_LOAD(p) (*(p))
+#define FP_VEC_STORE(p, v) (*(p) = (v))
+namespace {
+namespace generic_kernels {
+// With a width of one the "vector" operations are the scalar ones.
+#define FP_SCALAR_VEC(name, op) \
+    template<typename T> inline T op##_vec(T x, T y) { return Op##op(x, y); }
+FP_FOR_EACH_BINARY_KERNEL(FP_SCALAR_VEC)
+FP_FOR_EACH_MATH_BINARY_KERNEL(FP_SCALAR_VEC)
+#undef FP_SCALAR_VEC
+template<typename T> inline T Select_vec(T x, T y, T z) { return OpSelect(x, y, z); }
+#define FP_SCALAR_VEC(name, op) \
+    template<typename T> inline T op##_vec(T x) { return Op##op(x); }
+FP_FOR_EACH_UNARY_KERNEL(FP_SCALAR_VEC)
+FP_FOR_EACH_MATH_UNARY_KERNEL(FP_SCALAR_VEC)
+#undef FP_SCALAR_VEC
+#define FP_SCALAR_VEC(name, op) \
+    template<typename T> inline bool Is##op##_vec(T x) { return Is##op(x); }
+FP_FOR_EACH_CHECK_KERNEL(FP_SCALAR_VEC)
+#undef FP_SCALAR_VEC
+
+#define FP_KERNEL_VALUE double
+FP_DEFINE_KERNEL_SET("generic", kernels)
+#undef FP_KERNEL_VALUE
+#define FP_KERNEL_VALUE float
+FP_DEFINE_KERNEL_SET("generic", floatKernels)
+#undef FP_KERNEL_VALUE
+} // namespace generic_kernels
+} // namespace
+#undef FP_KERNEL_TARGET
+#undef FP_VEC_WIDTH
+#undef FP_VEC_TYPE
+#undef FP_VEC_LOAD
+#undef FP_VEC_STORE
+
+#else // FP_SIMD_KERNELS_X86
+//=========================================================================
+// SSE2 kernels
+//=========================================================================
+// SSE2 is part of the x86-64 baseline (and required for 32-bit builds).
+#define FP_KERNEL_TARGET
+namespace {
+namespace sse2_kernels {
+inline __m128d Bool(__m128d mask) { return _mm_and_pd(mask, _mm_set1_pd(1.0)); }
+
+inline __m128d Add_vec(__m128d x, __m128d y) { return _mm_add_pd(x, y); }
+inline __m128d Sub_vec(__m128d x, __m128d y) { return _mm_sub_pd(x, y); }
+inline __m128d RSub_vec(__m128d x, __m128d y) { return _mm_sub_pd(y, x); }
+inline __m128d Mul_vec(__m128d x, __m128d y) { return _mm_mul_pd(x, y); }
+inline __m128d Div_vec(__m128d x, __m128d y) { return _mm_div_pd(x, y); }
+inline __m128d RDiv_vec(__m128d x, __m128d y) { return _mm_div_pd(y, x); }
+// minpd/maxpd return the second operand unless the comparison holds,
+// exactly like x<y?x:y and x>y?x:y (including NaNs and signed zeros).
+inline __m128d Min_vec(__m128d x, __m128d y) { return _mm_min_pd(x, y); }
+inline __m128d Max_vec(__m128d x, __m128d y) { return _mm_max_pd(x, y); }
+inline __m128d Neg_vec(__m128d x) { return _mm_xor_pd(x, _mm_set1_pd(-0.0)); }
+inline __m128d Abs_vec(__m128d x) { return _mm_andnot_pd(_mm_set1_pd(-0.0), x); }
+inline __m128d Sqr_vec(__m128d x) { return _mm_mul_pd(x, x); }
+inline __m128d Sqrt_vec(__m128d x) { return _mm_sqrt_pd(x); }
+inline __m128d Inv_vec(__m128d x) { return _mm_div_pd(_mm_set1_pd(1.0), x); }
+inline __m128d RSqrt_vec(__m128d x) { return _mm_div_pd(_mm_set1_pd(1.0), _mm_sqrt_pd(x)); }
+inline __m128d Select_vec(__m128d x, __m128d y, __m128d z) {
+    const __m128d mask = _mm_cmpnlt_pd(_mm_add_pd(Abs_vec(x), _mm_set1_pd(0.5)), _mm_set1_pd(1.0));
+    return _mm_or_pd(_mm_and_pd(mask, y), _mm_andnot_pd(mask, z));
+}
+#ifdef FP_EPSILON
+inline __m128d Equal_vec(__m128d x, __m128d y) {
+    return Bool(_mm_cmple_pd(Abs_vec(_mm_sub_pd(x, y)), _mm_set1_pd(FP_EPSILON)));
+}
+inline __m128d NEqual_vec(__m128d x, __m128d y) {
+    return Bool(_mm_cmpge_pd(Abs_vec(_mm_sub_pd(x, y)), _mm_set1_pd(FP_EPSILON)));
+}
+inline __m128d Less_vec(__m128d x, __m128d y) {
+    return Bool(_mm_cmplt_pd(x, _mm_sub_pd(y, _mm_set1_pd(FP_EPSILON))));
+}
+inline __m128d LessOrEq_vec(__m128d x, __m128d y) {
+    return Bool(_mm_cmple_pd(x, _mm_add_pd(y, _mm_set1_pd(FP_EPSILON))));
+}
+inline __m128d Greater_vec(__m128d x, __m128d y) {
+    return Bool(_mm_cmpgt_pd(_mm_sub_pd(x, _mm_set1_pd(FP_EPSILON)), y));
+}
+inline __m128d GreaterOrEq_vec(__m128d x, __m128d y) {
+    return Bool(_mm_cmpge_pd(_mm_add_pd(x, _mm_set1_pd(FP_EPSILON)), y));
+}
+#else
+inline __m128d Equal_vec(__m128d x, __m128d y) { return Bool(_mm_cmpeq_pd(x, y)); }
+inline __m128d NEqual_vec(__m128d x, __m128d y) { return Bool(_mm_cmpneq_pd(x, y)); }
+inline __m128d Less_vec(__m128d x, __m128d y) { return Bool(_mm_cmplt_pd(x, y)); }
+inline __m128d LessOrEq_vec(__m128d x, __m128d y) { return Bool(_mm_cmple_pd(x, y)); }
+inline __m128d Greater_vec(__m128d x, __m128d y) { return Bool(_mm_cmpgt_pd(x, y)); }
+inline __m128d GreaterOrEq_vec(__m128d x, __m128d y) { return Bool(_mm_cmpge_pd(x, y)); }
+#endif
+inline bool IsZero_vec(__m128d x) { return _mm_movemask_pd(_mm_cmpeq_pd(x, _mm_setzero_pd())) != 0; }
+inline bool IsNegative_vec(__m128d x) { return _mm_movemask_pd(_mm_cmplt_pd(x, _mm_setzero_pd())) != 0; }
+inline bool IsNonPositive_vec(__m128d x) { return _mm_movemask_pd(_mm_cmple_pd(x, _mm_setzero_pd())) != 0; }
+inline bool IsOutsideUnit_vec(__m128d x) {
+    return _mm_movemask_pd(_mm_or_pd(_mm_cmplt_pd(x, _mm_set1_pd(-1.0)), _mm_cmpgt_pd(x, _mm_set1_pd(1.0)))) != 0;
+}
+
+typedef __m128d VD;
+typedef __m128 VF;
+typedef __m128i VI;
+typedef unsigned long long VU __attribute__((vector_size(16)));
+inline bool AnyLane(VI mask) { return _mm_movemask_pd(_mm_castsi128_pd(mask)) != 0; }
+inline VD LowHalf(VF x) { return _mm_cvtps_pd(x); }
+inline VD HighHalf(VF x) { return _mm_cvtps_pd(_mm_movehl_ps(x, x)); }
+inline VF ToFloats(VD low, VD high) { return _mm_movelh_ps(_mm_cvtpd_ps(low), _mm_cvtpd_ps(high)); }
+#include "fparser_vmath.hh"
+
+#define FP_KERNEL_VALUE double
+#define FP_VEC_WIDTH 2
+#define FP_VEC_TYPE __m128d
+#define FP_VEC_LOAD(p) _mm_loadu_pd(p)
+#define FP_VEC_STORE(p, v) _mm_storeu_pd(p, v)
+FP_DEFINE_KERNEL_SET("sse2", kernels)
+#undef FP_KERNEL_VALUE
+#undef FP_VEC_WIDTH
+#undef FP_VEC_TYPE
+#undef FP_VEC_LOAD
+#undef FP_VEC_STORE
+
+inline __m128 Bool(__m128 mask) { return _mm_and_ps(mask, _mm_set1_ps(1.0f)); }
+
+inline __m128 Add_vec(__m128 x, __m128 y) { return _mm_add_ps(x, y); }
+inline __m128 Sub_vec(__m128 x, __m128 y) { return _mm_sub_ps(x, y); }
+inline __m128 RSub_vec(__m128 x, __m128 y) { return _mm_sub_ps(y, x); }
+inline __m128 Mul_vec(__m128 x, __m128 y) { return _mm_mul_ps(x, y); }
+inline __m128 Div_vec(__m128 x, __m128 y) { return _mm_div_ps(x, y); }
+inline __m128 RDiv_vec(__m128 x, __m128 y) { return _mm_div_ps(y, x); }
+inline __m128 Min_vec(__m128 x, __m128 y) { return _mm_min_ps(x, y); }
+inline __m128 Max_vec(__m128 x, __m128 y) { return _mm_max_ps(x, y); }
+inline __m128 Neg_vec(__m128 x) { return _mm_xor_ps(x, _mm_set1_ps(-0.0f)); }
+inline __m128 Abs_vec(__m128 x) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), x); }
+inline __m128 Sqr_vec(__m128 x) { return _mm_mul_ps(x, x); }
+inline __m128 Sqrt_vec(__m128 x) { return _mm_sqrt_ps(x); }
+inline __m128 Inv_vec(__m128 x) { return _mm_div_ps(_mm_set1_ps(1.0f), x); }
+inline __m128 RSqrt_vec(__m128 x) { return _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(x)); }
+inline __m128 Select_vec(__m128 x, __m128 y, __m128 z) {
+    const __m128 mask = _mm_cmpnlt_ps(Abs_vec(x), _mm_set1_ps(0.5f));
+    return _mm_or_ps(_mm_and_ps(mask, y), _mm_andnot_ps(mask, z));
+}
+#ifdef FP_EPSILON
+inline __m128 Equal_vec(__m128 x, __m128 y) {
+    return Bool(_mm_cmple_ps(Abs_vec(_mm_sub_ps(x, y)), _mm_set1_ps(float(FP_EPSILON))));
+}
+inline __m128 NEqual_vec(__m128 x, __m128 y) {
+    return Bool(_mm_cmpge_ps(Abs_vec(_mm_sub_ps(x, y)), _mm_set1_ps(float(FP_EPSILON))));
+}
+inline __m128 Less_vec(__m128 x, __m128 y) {
+    return Bool(_mm_cmplt_ps(x, _mm_sub_ps(y, _mm_set1_ps(float(FP_EPSILON)))));
+}
+inline __m128 LessOrEq_vec(__m128 x, __m128 y) {
+    return Bool(_mm_cmple_ps(x, _mm_add_ps(y, _mm_set1_ps(float(FP_EPSILON)))));
+}
+inline __m128 Greater_vec(__m128 x, __m128 y) {
+    return Bool(_mm_cmpgt_ps(_mm_sub_ps(x, _mm_set1_ps(float(FP_EPSILON))), y));
+}
+inline __m128 GreaterOrEq_vec(__m128 x, __m128 y) {
+    return Bool(_mm_cmpge_ps(_mm_add_ps(x, _mm_set1_ps(float(FP_EPSILON))), y));
+}
+#else
+inline __m128 Equal_vec(__m128 x, __m128 y) { return Bool(_mm_cmpeq_ps(x, y)); }
+inline __m128 NEqual_vec(__m128 x, __m128 y) { return Bool(_mm_cmpneq_ps(x, y)); }
+inline __m128 Less_vec(__m128 x, __m128 y) { return Bool(_mm_cmplt_ps(x, y)); }
+inline __m128 LessOrEq_vec(__m128 x, __m128 y) { return Bool(_mm_cmple_ps(x, y)); }
+inline __m128 Greater_vec(__m128 x, __m128 y) { return Bool(_mm_cmpgt_ps(x, y)); }
+inline __m128 GreaterOrEq_vec(__m128 x, __m128 y) { return Bool(_mm_cmpge_ps(x, y)); }
+#endif
+inline bool IsZero_vec(__m128 x) { return _mm_movemask_ps(_mm_cmpeq_ps(x, _mm_setzero_ps())) != 0; }
+inline bool IsNegative_vec(__m128 x) { return _mm_movemask_ps(_mm_cmplt_ps(x, _mm_setzero_ps())) != 0; }
+inline bool IsNonPositive_vec(__m128 x) { return _mm_movemask_ps(_mm_cmple_ps(x, _mm_setzero_ps())) != 0; }
+inline bool IsOutsideUnit_vec(__m128 x) {
+    return _mm_movemask_ps(_mm_or_ps(_mm_cmplt_ps(x, _mm_set1_ps(-1.0f)), _mm_cmpgt_ps(x, _mm_set1_ps(1.0f)))) != 0;
+}
+
+#define FP_KERNEL_VALUE float
+#define FP_VEC_WIDTH 4
+#define FP_VEC_TYPE __m128
+#define FP_VEC_LOAD(p) _mm_loadu_ps(p)
+#define FP_VEC_STORE(p, v) _mm_storeu_ps(p, v)
+FP_DEFINE_KERNEL_SET("sse2", floatKernels)
+#undef FP_KERNEL_VALUE
+#undef FP_VEC_WIDTH
+#undef FP_VEC_TYPE
+#undef FP_VEC_LOAD
+#undef FP_VEC_STORE
+} // namespace sse2_kernels
+} // namespace
+#undef FP_KERNEL_TARGET
+
+//=========================================================================
+// AVX2 kernels
+//=========================================================================
+#define FP_KERNEL_TARGET __attribute__((target("avx2")))
+namespace {
+namespace avx2_kernels {
+FP_KERNEL_TARGET inline __m256d Bool(__m256d mask) { return _mm256_and_pd(mask, _mm256_set1_pd(1.0)); }
+#define FP_AVX_CMP(x, y, predicate) Bool(_mm256_cmp_pd(x, y, predicate))
+
+FP_KERNEL_TARGET inline __m256d Add_vec(__m256d x, __m256d y) { return _mm256_add_pd(x, y); }
+FP_KERNEL_TARGET inline __m256d Sub_vec(__m256d x, __m256d y) { return _mm256_sub_pd(x, y); }
+FP_KERNEL_TARGET inline __m256d RSub_vec(__m256d x, __m256d y) { return _mm256_sub_pd(y, x); }
+FP_KERNEL_TARGET inline __m256d Mul_vec(__m256d x, __m256d y) { return _mm256_mul_pd(x, y); }
+FP_KERNEL_TARGET inline __m256d Div_vec(__m256d x, __m256d y) { return _mm256_div_pd(x, y); }
+FP_KERNEL_TARGET inline __m256d RDiv_vec(__m256d x, __m256d y) { return _mm256_div_pd(y, x); }
+FP_KERNEL_TARGET inline __m256d Min_vec(__m256d x, __m256d y) { return _mm256_min_pd(x, y); }
+FP_KERNEL_TARGET inline __m256d Max_vec(__m256d x, __m256d y) { return _mm256_max_pd(x, y); }
+FP_KERNEL_TARGET inline __m256d Neg_vec(__m256d x) { return _mm256_xor_pd(x, _mm256_set1_pd(-0.0)); }
+FP_KERNEL_TARGET inline __m256d Abs_vec(__m256d x) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), x); }
+FP_KERNEL_TARGET inline __m256d Sqr_vec(__m256d x) { return _mm256_mul_pd(x, x); }
+FP_KERNEL_TARGET inline __m256d Sqrt_vec(__m256d x) { return _mm256_sqrt_pd(x); }
+FP_KERNEL_TARGET inline __m256d Inv_vec(__m256d x) { return _mm256_div_pd(_mm256_set1_pd(1.0), x); }
+FP_KERNEL_TARGET inline __m256d RSqrt_vec(__m256d x) {
+    return _mm256_div_pd(_mm256_set1_pd(1.0), _mm256_sqrt_pd(x));
+}
+FP_KERNEL_TARGET inline __m256d Select_vec(__m256d x, __m256d y, __m256d z) {
+    return _mm256_blendv_pd(z, y, _mm256_cmp_pd(_mm256_add_pd(Abs_vec(x), _mm256_set1_pd(0.5)),
+                                                _mm256_set1_pd(1.0), _CMP_NLT_UQ));
+}
+#ifdef FP_EPSILON
+FP_KERNEL_TARGET inline __m256d Equal_vec(__m256d x, __m256d y) {
+    return FP_AVX_CMP(Abs_vec(_mm256_sub_pd(x, y)), _mm256_set1_pd(FP_EPSILON), _CMP_LE_OQ);
+}
+FP_KERNEL_TARGET inline __m256d NEqual_vec(__m256d x, __m256d y) {
+    return FP_AVX_CMP(Abs_vec(_mm256_sub_pd(x, y)), _mm256_set1_pd(FP_EPSILON), _CMP_GE_OQ);
+}
+FP_KERNEL_TARGET inline __m256d Less_vec(__m256d x, __m256d y) {
+    return FP_AVX_CMP(x, _mm256_sub_pd(y, _mm256_set1_pd(FP_EPSILON)), _CMP_LT_OQ);
+}
+FP_KERNEL_TARGET inline __m256d LessOrEq_vec(__m256d x, __m256d y) {
+    return FP_AVX_CMP(x, _mm256_add_pd(y, _mm256_set1_pd(FP_EPSILON)), _CMP_LE_OQ);
+}
+FP_KERNEL_TARGET inline __m256d Greater_vec(__m256d x, __m256d y) {
+    return FP_AVX_CMP(_mm256_sub_pd(x, _mm256_set1_pd(FP_EPSILON)), y, _CMP_GT_OQ);
+}
+FP_KERNEL_TARGET inline __m256d GreaterOrEq_vec(__m256d x, __m256d y) {
+    return FP_AVX_CMP(_mm256_add_pd(x, _mm256_set1_pd(FP_EPSILON)), y, _CMP_GE_OQ);
+}
+#else
+FP_KERNEL_TARGET inline __m256d Equal_vec(__m256d x, __m256d y) { return FP_AVX_CMP(x, y, _CMP_EQ_OQ); }
+FP_KERNEL_TARGET inline __m256d NEqual_vec(__m256d x, __m256d y) { return FP_AVX_CMP(x, y, _CMP_NEQ_UQ); }
+FP_KERNEL_TARGET inline __m256d Less_vec(__m256d x, __m256d y) { return FP_AVX_CMP(x, y, _CMP_LT_OQ); }
+FP_KERNEL_TARGET inline __m256d LessOrEq_vec(__m256d x, __m256d y) { return FP_AVX_CMP(x, y, _CMP_LE_OQ); }
+FP_KERNEL_TARGET inline __m256d Greater_vec(__m256d x, __m256d y) { return FP_AVX_CMP(x, y, _CMP_GT_OQ); }
+FP_KERNEL_TARGET inline __m256d GreaterOrEq_vec(__m256d x, __m256d y) { return FP_AVX_CMP(x, y, _CMP_GE_OQ); }
+#endif
+FP_KERNEL_TARGET inline bool IsZero_vec(__m256d x) {
+    return _mm256_movemask_pd(_mm256_cmp_pd(x, _mm256_setzero_pd(), _CMP_EQ_OQ)) != 0;
+}
+FP_KERNEL_TARGET inline bool IsNegative_vec(__m256d x) {
+    return _mm256_movemask_pd(_mm256_cmp_pd(x, _mm256_setzero_pd(), _CMP_LT_OQ)) != 0;
+}
+FP_KERNEL_TARGET inline bool IsNonPositive_vec(__m256d x) {
+    return _mm256_movemask_pd(_mm256_cmp_pd(x, _mm256_setzero_pd(), _CMP_LE_OQ)) != 0;
+}
+FP_KERNEL_TARGET inline bool IsOutsideUnit_vec(__m256d x) {
+    return _mm256_movemask_pd(_mm256_or_pd(_mm256_cmp_pd(x, _mm256_set1_pd(-1.0), _CMP_LT_OQ),
+                                           _mm256_cmp_pd(x, _mm256_set1_pd(1.0), _CMP_GT_OQ))) != 0;
+}
+#undef FP_AVX_CMP
+
+typedef __m256d VD;
+typedef __m256 VF;
+typedef __m256i VI;
+typedef unsigned long long VU __attribute__((vector_size(32)));
+FP_KERNEL_TARGET inline bool AnyLane(VI mask) { return _mm256_movemask_pd(_mm256_castsi256_pd(mask)) != 0; }
+FP_KERNEL_TARGET inline VD LowHalf(VF x) { return _mm256_cvtps_pd(_mm256_castps256_ps128(x)); }
+FP_KERNEL_TARGET inline VD HighHalf(VF x) { return _mm256_cvtps_pd(_mm256_extractf128_ps(x, 1)); }
+FP_KERNEL_TARGET inline VF ToFloats(VD low, VD high) {
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(low)), _mm256_cvtpd_ps(high), 1);
+}
+#include "fparser_vmath.hh"
+
+#define FP_KERNEL_VALUE double
+#define FP_VEC_WIDTH 4
+#define FP_VEC_TYPE __m256d
+#define FP_VEC_LOAD(p) _mm256_loadu_pd(p)
+#define FP_VEC_STORE(p, v) _mm256_storeu_pd(p, v)
+FP_DEFINE_KERNEL_SET("avx2", kernels)
+#undef FP_KERNEL_VALUE
+#undef FP_VEC_WIDTH
+#undef FP_VEC_TYPE
+#undef FP_VEC_LOAD
+#undef FP_VEC_STORE
+
+FP_KERNEL_TARGET inline __m256 Bool(__m256 mask) { return _mm256_and_ps(mask, _mm256_set1_ps(1.0f)); }
+#define FP_AVX_CMP(x, y, predicate) Bool(_mm256_cmp_ps(x, y, predicate))
+
+FP_KERNEL_TARGET inline __m256 Add_vec(__m256 x, __m256 y) { return _mm256_add_ps(x, y); }
+FP_KERNEL_TARGET inline __m256 Sub_vec(__m256 x, __m256 y) { return _mm256_sub_ps(x, y); }
+FP_KERNEL_TARGET inline __m256 RSub_vec(__m256 x, __m256 y) { return _mm256_sub_ps(y, x); }
+FP_KERNEL_TARGET inline __m256 Mul_vec(__m256 x, __m256 y) { return _mm256_mul_ps(x, y); }
+FP_KERNEL_TARGET inline __m256 Div_vec(__m256 x, __m256 y) { return _mm256_div_ps(x, y); }
+FP_KERNEL_TARGET inline __m256 RDiv_vec(__m256 x, __m256 y) { return _mm256_div_ps(y, x); }
+FP_KERNEL_TARGET inline __m256 Min_vec(__m256 x, __m256 y) { return _mm256_min_ps(x, y); }
+FP_KERNEL_TARGET inline __m256 Max_vec(__m256 x, __m256 y) { return _mm256_max_ps(x, y); }
+FP_KERNEL_TARGET inline __m256 Neg_vec(__m256 x) { return _mm256_xor_ps(x, _mm256_set1_ps(-0.0f)); }
+FP_KERNEL_TARGET inline __m256 Abs_vec(__m256 x) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), x); }
+FP_KERNEL_TARGET inline __m256 Sqr_vec(__m256 x) { return _mm256_mul_ps(x, x); }
+FP_KERNEL_TARGET inline __m256 Sqrt_vec(__m256 x) { return _mm256_sqrt_ps(x); }
+FP_KERNEL_TARGET inline __m256 Inv_vec(__m256 x) { return _mm256_div_ps(_mm256_set1_ps(1.0f), x); }
+FP_KERNEL_TARGET inline __m256 RSqrt_vec(__m256 x) {
+    return _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(x));
+}
+FP_KERNEL_TARGET inline __m256 Select_vec(__m256 x, __m256 y, __m256 z) {
+    return _mm256_blendv_ps(z, y, _mm256_cmp_ps(Abs_vec(x), _mm256_set1_ps(0.5f), _CMP_NLT_UQ));
+}
+#ifdef FP_EPSILON
+FP_KERNEL_TARGET inline __m256 Equal_vec(__m256 x, __m256 y) {
+    return FP_AVX_CMP(Abs_vec(_mm256_sub_ps(x, y)), _mm256_set1_ps(float(FP_EPSILON)), _CMP_LE_OQ);
+}
+FP_KERNEL_TARGET inline __m256 NEqual_vec(__m256 x, __m256 y) {
+    return FP_AVX_CMP(Abs_vec(_mm256_sub_ps(x, y)), _mm256_set1_ps(float(FP_EPSILON)), _CMP_GE_OQ);
+}
+FP_KERNEL_TARGET inline __m256 Less_vec(__m256 x, __m256 y) {
+    return FP_AVX_CMP(x, _mm256_sub_ps(y, _mm256_set1_ps(float(FP_EPSILON))), _CMP_LT_OQ);
+}
+FP_KERNEL_TARGET inline __m256 LessOrEq_vec(__m256 x, __m256 y) {
+    return FP_AVX_CMP(x, _mm256_add_ps(y, _mm256_set1_ps(float(FP_EPSILON))), _CMP_LE_OQ);
+}
+FP_KERNEL_TARGET inline __m256 Greater_vec(__m256 x, __m256 y) {
+    return FP_AVX_CMP(_mm256_sub_ps(x, _mm256_set1_ps(float(FP_EPSILON))), y, _CMP_GT_OQ);
+}
+FP_KERNEL_TARGET inline __m256 GreaterOrEq_vec(__m256 x, __m256 y) {
+    return FP_AVX_CMP(_mm256_add_ps(x, _mm256_set1_ps(float(FP_EPSILON))), y, _CMP_GE_OQ);
+}
+#else
+FP_KERNEL_TARGET inline __m256 Equal_vec(__m256 x, __m256 y) { return FP_AVX_CMP(x, y, _CMP_EQ_OQ); }
+FP_KERNEL_TARGET inline __m256 NEqual_vec(__m256 x, __m256 y) { return FP_AVX_CMP(x, y, _CMP_NEQ_UQ); }
+FP_KERNEL_TARGET inline __m256 Less_vec(__m256 x, __m256 y) { return FP_AVX_CMP(x, y, _CMP_LT_OQ); }
+FP_KERNEL_TARGET inline __m256 LessOrEq_vec(__m256 x, __m256 y) { return FP_AVX_CMP(x, y, _CMP_LE_OQ); }
+FP_KERNEL_TARGET inline __m256 Greater_vec(__m256 x, __m256 y) { return FP_AVX_CMP(x, y, _CMP_GT_OQ); }
+FP_KERNEL_TARGET inline __m256 GreaterOrEq_vec(__m256 x, __m256 y) { return FP_AVX_CMP(x, y, _CMP_GE_OQ); }
+#endif
+FP_KERNEL_TARGET inline bool IsZero_vec(__m256 x) {
+    return _mm256_movemask_ps(_mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_EQ_OQ)) != 0;
+}
+FP_KERNEL_TARGET inline bool IsNegative_vec(__m256 x) {
+    return _mm256_movemask_ps(_mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LT_OQ)) != 0;
+}
+FP_KERNEL_TARGET inline bool IsNonPositive_vec(__m256 x) {
+    return _mm256_movemask_ps(_mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LE_OQ)) != 0;
+}
+FP_KERNEL_TARGET inline bool IsOutsideUnit_vec(__m256 x) {
+    return _mm256_movemask_ps(_mm256_or_ps(_mm256_cmp_ps(x, _mm256_set1_ps(-1.0f), _CMP_LT_OQ),
+                                           _mm256_cmp_ps(x, _mm256_set1_ps(1.0f), _CMP_GT_OQ))) != 0;
+}
+#undef FP_AVX_CMP
+
+#define FP_KERNEL_VALUE float
+#define FP_VEC_WIDTH 8
+#define FP_VEC_TYPE __m256
+#define FP_VEC_LOAD(p) _mm256_loadu_ps(p)
+#define FP_VEC_STORE(p, v) _mm256_storeu_ps(p, v)
+FP_DEFINE_KERNEL_SET("avx2", floatKernels)
+#undef FP_KERNEL_VALUE
+#undef FP_VEC_WIDTH
+#undef FP_VEC_TYPE
+#undef FP_VEC_LOAD
+#undef FP_VEC_STORE
+} // namespace avx2_kernels
+} // namespace
+#undef FP_KERNEL_TARGET
+
+//=========================================================================
+// AVX-512 kernels
+//=========================================================================
+// Only AVX-512F is required, so the bitwise operations use the integer forms.
+// The unmasked forms of some intrinsics start from _mm512_undefined_pd(),
+// which gcc reports as possibly uninitialized; the zero-masked forms with all
+// lanes set compile to the same instructions without the warning.
+#define FP_KERNEL_TARGET __attribute__((target("avx512f")))
+namespace {
+namespace avx512_kernels {
+#define FP_AVX512_CMP(x, y, predicate) _mm512_maskz_mov_pd(_mm512_cmp_pd_mask(x, y, predicate), _mm512_set1_pd(1.0))
+
+FP_KERNEL_TARGET inline __m512d Add_vec(__m512d x, __m512d y) { return _mm512_add_pd(x, y); }
+FP_KERNEL_TARGET inline __m512d Sub_vec(__m512d x, __m512d y) { return _mm512_sub_pd(x, y); }
+FP_KERNEL_TARGET inline __m512d RSub_vec(__m512d x, __m512d y) { return _mm512_sub_pd(y, x); }
+FP_KERNEL_TARGET inline __m512d Mul_vec(__m512d x, __m512d y) { return _mm512_mul_pd(x, y); }
+FP_KERNEL_TARGET inline __m512d Div_vec(__m512d x, __m512d y) { return _mm512_div_pd(x, y); }
+FP_KERNEL_TARGET inline __m512d RDiv_vec(__m512d x, __m512d y) { return _mm512_div_pd(y, x); }
+FP_KERNEL_TARGET inline __m512d Min_vec(__m512d x, __m512d y) { return _mm512_maskz_min_pd(0xFF, x, y); }
+FP_KERNEL_TARGET inline __m512d Max_vec(__m512d x, __m512d y) { return _mm512_maskz_max_pd(0xFF, x, y); }
+FP_KERNEL_TARGET inline __m512d Neg_vec(__m512d x) {
+    return _mm512_castsi512_pd(_mm512_xor_epi64(_mm512_castpd_si512(x), _mm512_set1_epi64(0x8000000000000000LL)));
+}
+FP_KERNEL_TARGET inline __m512d Abs_vec(__m512d x) {
+    return _mm512_castsi512_pd(_mm512_and_epi64(_mm512_castpd_si512(x), _mm512_set1_epi64(0x7FFFFFFFFFFFFFFFLL)));
+}
+FP_KERNEL_TARGET inline __m512d Sqr_vec(__m512d x) { return _mm512_mul_pd(x, x); }
+FP_KERNEL_TARGET inline __m512d Sqrt_vec(__m512d x) { return _mm512_maskz_sqrt_pd(0xFF, x); }
+FP_KERNEL_TARGET inline __m512d Inv_vec(__m512d x) { return _mm512_div_pd(_mm512_set1_pd(1.0), x); }
+FP_KERNEL_TARGET inline __m512d RSqrt_vec(__m512d x) {
+    return _mm512_div_pd(_mm512_set1_pd(1.0), _mm512_maskz_sqrt_pd(0xFF, x));
+}
+FP_KERNEL_TARGET inline __m512d Select_vec(__m512d x, __m512d y, __m512d z) {
+    return _mm512_mask_blend_pd(_mm512_cmp_pd_mask(_mm512_add_pd(Abs_vec(x), _mm512_set1_pd(0.5)),
+                                                   _mm512_set1_pd(1.0), _CMP_NLT_UQ), z, y);
+}
+#ifdef FP_EPSILON
+FP_KERNEL_TARGET inline __m512d Equal_vec(__m512d x, __m512d y) {
+    return FP_AVX512_CMP(Abs_vec(_mm512_sub_pd(x, y)), _mm512_set1_pd(FP_EPSILON), _CMP_LE_OQ);
+}
+FP_KERNEL_TARGET inline __m512d NEqual_vec(__m512d x, __m512d y) {
+    return FP_AVX512_CMP(Abs_vec(_mm512_sub_pd(x, y)), _mm512_set1_pd(FP_EPSILON), _CMP_GE_OQ);
+}
+FP_KERNEL_TARGET inline __m512d Less_vec(__m512d x, __m512d y) {
+    return FP_AVX512_CMP(x, _mm512_sub_pd(y, _mm512_set1_pd(FP_EPSILON)), _CMP_LT_OQ);
+}
+FP_KERNEL_TARGET inline __m512d LessOrEq_vec(__m512d x, __m512d y) {
+    return FP_AVX512_CMP(x, _mm512_add_pd(y, _mm512_set1_pd(FP_EPSILON)), _CMP_LE_OQ);
+}
+FP_KERNEL_TARGET inline __m512d Greater_vec(__m512d x, __m512d y) {
+    return FP_AVX512_CMP(_mm512_sub_pd(x, _mm512_set1_pd(FP_EPSILON)), y, _CMP_GT_OQ);
+}
+FP_KERNEL_TARGET inline __m512d GreaterOrEq_vec(__m512d x, __m512d y) {
+    return FP_AVX512_CMP(_mm512_add_pd(x, _mm512_set1_pd(FP_EPSILON)), y, _CMP_GE_OQ);
+}
+#else
+FP_KERNEL_TARGET inline __m512d Equal_vec(__m512d x, __m512d y) { return FP_AVX512_CMP(x, y, _CMP_EQ_OQ); }
+FP_KERNEL_TARGET inline __m512d NEqual_vec(__m512d x, __m512d y) { return FP_AVX512_CMP(x, y, _CMP_NEQ_UQ); }
+FP_KERNEL_TARGET inline __m512d Less_vec(__m512d x, __m512d y) { return FP_AVX512_CMP(x, y, _CMP_LT_OQ); }
+FP_KERNEL_TARGET inline __m512d LessOrEq_vec(__m512d x, __m512d y) { return FP_AVX512_CMP(x, y, _CMP_LE_OQ); }
+FP_KERNEL_TARGET inline __m512d Greater_vec(__m512d x, __m512d y) { return FP_AVX512_CMP(x, y, _CMP_GT_OQ); }
+FP_KERNEL_TARGET inline __m512d GreaterOrEq_vec(__m512d x, __m512d y) { return FP_AVX512_CMP(x, y, _CMP_GE_OQ); }
+#endif
+FP_KERNEL_TARGET inline bool IsZero_vec(__m512d x) {
+    return _mm512_cmp_pd_mask(x, _mm512_setzero_pd(), _CMP_EQ_OQ) != 0;
+}
+FP_KERNEL_TARGET inline bool IsNegative_vec(__m512d x) {
+    return _mm512_cmp_pd_mask(x, _mm512_setzero_pd(), _CMP_LT_OQ) != 0;
+}
+FP_KERNEL_TARGET inline bool IsNonPositive_vec(__m512d x) {
+    return _mm512_cmp_pd_mask(x, _mm512_setzero_pd(), _CMP_LE_OQ) != 0;
+}
+FP_KERNEL_TARGET inline bool IsOutsideUnit_vec(__m512d x) {
+    return (_mm512_cmp_pd_mask(x, _mm512_set1_pd(-1.0), _CMP_LT_OQ) |
+            _mm512_cmp_pd_mask(x, _mm512_set1_pd(1.0), _CMP_GT_OQ)) != 0;
+}
+#undef FP_AVX512_CMP
+
+typedef __m512d VD;
+typedef __m512 VF;
+typedef __m512i VI;
+typedef unsigned long long VU __attribute__((vector_size(64)));
+FP_KERNEL_TARGET inline bool AnyLane(VI mask) { return _mm512_test_epi64_mask(mask, mask) != 0; }
+FP_KERNEL_TARGET inline VD LowHalf(VF x) {
+    return _mm512_maskz_cvtps_pd(0xFF, _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xF, _mm512_castps_pd(x), 0)));
+}
+FP_KERNEL_TARGET inline VD HighHalf(VF x) {
+    return _mm512_maskz_cvtps_pd(0xFF, _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xF, _mm512_castps_pd(x), 1)));
+}
+FP_KERNEL_TARGET inline VF ToFloats(VD low, VD high) {
+    const __m512d lowFloats = _mm512_castps_pd(_mm512_castps256_ps512(_mm512_maskz_cvtpd_ps(0xFF, low)));
+    return _mm512_castpd_ps(
+        _mm512_maskz_insertf64x4(0xFF, lowFloats, _mm256_castps_pd(_mm512_maskz_cvtpd_ps(0xFF, high)), 1));
+}
+#include "fparser_vmath.hh"
+
+#define FP_KERNEL_VALUE double
+#define FP_VEC_WIDTH 8
+#define FP_VEC_TYPE __m512d
+#define FP_VEC_LOAD(p) _mm512_loadu_pd(p)
+#define FP_VEC_STORE(p, v) _mm512_storeu_pd(p, v)
+FP_DEFINE_KERNEL_SET("avx512", kernels)
+#undef FP_KERNEL_VALUE
+#undef FP_VEC_WIDTH
+#undef FP_VEC_TYPE
+#undef FP_VEC_LOAD
+#undef FP_VEC_STORE
+
+#define FP_AVX512_CMP(x, y, predicate) _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(x, y, predicate), _mm512_set1_ps(1.0f))
+
+FP_KERNEL_TARGET inline __m512 Add_vec(__m512 x, __m512 y) { return _mm512_add_ps(x, y); }
+FP_KERNEL_TARGET inline __m512 Sub_vec(__m512 x, __m512 y) { return _mm512_sub_ps(x, y); }
+FP_KERNEL_TARGET inline __m512 RSub_vec(__m512 x, __m512 y) { return _mm512_sub_ps(y, x); }
+FP_KERNEL_TARGET inline __m512 Mul_vec(__m512 x, __m512 y) { return _mm512_mul_ps(x, y); }
+FP_KERNEL_TARGET inline __m512 Div_vec(__m512 x, __m512 y) { return _mm512_div_ps(x, y); }
+FP_KERNEL_TARGET inline __m512 RDiv_vec(__m512 x, __m512 y) { return _mm512_div_ps(y, x); }
+FP_KERNEL_TARGET inline __m512 Min_vec(__m512 x, __m512 y) { return _mm512_maskz_min_ps(0xFFFF, x, y); }
+FP_KERNEL_TARGET inline __m512 Max_vec(__m512 x, __m512 y) { return _mm512_maskz_max_ps(0xFFFF, x, y); }
+FP_KERNEL_TARGET inline __m512 Neg_vec(__m512 x) {
+    return _mm512_castsi512_ps(_mm512_xor_epi32(_mm512_castps_si512(x), _mm512_set1_epi32(int(0x80000000U))));
+}
+FP_KERNEL_TARGET inline __m512 Abs_vec(__m512 x) {
+    return _mm512_castsi512_ps(_mm512_and_epi32(_mm512_castps_si512(x), _mm512_set1_epi32(0x7FFFFFFF)));
+}
+FP_KERNEL_TARGET inline __m512 Sqr_vec(__m512 x) { return _mm512_mul_ps(x, x); }
+FP_KERNEL_TARGET inline __m512 Sqrt_vec(__m512 x) { return _mm512_maskz_sqrt_ps(0xFFFF, x); }
+FP_KERNEL_TARGET inline __m512 Inv_vec(__m512 x) { return _mm512_div_ps(_mm512_set1_ps(1.0f), x); }
+FP_KERNEL_TARGET inline __m512 RSqrt_vec(__m512 x) {
+    return _mm512_div_ps(_mm512_set1_ps(1.0f), _mm512_maskz_sqrt_ps(0xFFFF, x));
+}
+FP_KERNEL_TARGET inline __m512 Select_vec(__m512 x, __m512 y, __m512 z) {
+    return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(Abs_vec(x), _mm512_set1_ps(0.5f), _CMP_NLT_UQ), z, y);
+}
+#ifdef FP_EPSILON
+FP_KERNEL_TARGET inline __m512 Equal_vec(__m512 x, __m512 y) {
+    return FP_AVX512_CMP(Abs_vec(_mm512_sub_ps(x, y)), _mm512_set1_ps(float(FP_EPSILON)), _CMP_LE_OQ);
+}
+FP_KERNEL_TARGET inline __m512 NEqual_vec(__m512 x, __m512 y) {
+    return FP_AVX512_CMP(Abs_vec(_mm512_sub_ps(x, y)), _mm512_set1_ps(float(FP_EPSILON)), _CMP_GE_OQ);
+}
+FP_KERNEL_TARGET inline __m512 Less_vec(__m512 x, __m512 y) {
+    return FP_AVX512_CMP(x, _mm512_sub_ps(y, _mm512_set1_ps(float(FP_EPSILON))), _CMP_LT_OQ);
+}
+FP_KERNEL_TARGET inline __m512 LessOrEq_vec(__m512 x, __m512 y) {
+    return FP_AVX512_CMP(x, _mm512_add_ps(y, _mm512_set1_ps(float(FP_EPSILON))), _CMP_LE_OQ);
+}
+FP_KERNEL_TARGET inline __m512 Greater_vec(__m512 x, __m512 y) {
+    return FP_AVX512_CMP(_mm512_sub_ps(x, _mm512_set1_ps(float(FP_EPSILON))), y, _CMP_GT_OQ);
+}
+FP_KERNEL_TARGET inline __m512 GreaterOrEq_vec(__m512 x, __m512 y) {
+    return FP_AVX512_CMP(_mm512_add_ps(x, _mm512_set1_ps(float(FP_EPSILON))), y, _CMP_GE_OQ);
+}
+#else
+FP_KERNEL_TARGET inline __m512 Equal_vec(__m512 x, __m512 y) { return FP_AVX512_CMP(x, y, _CMP_EQ_OQ); }
+FP_KERNEL_TARGET inline __m512 NEqual_vec(__m512 x, __m512 y) { return FP_AVX512_CMP(x, y, _CMP_NEQ_UQ); }
+FP_KERNEL_TARGET inline __m512 Less_vec(__m512 x, __m512 y) { return FP_AVX512_CMP(x, y, _CMP_LT_OQ); }
+FP_KERNEL_TARGET inline __m512 LessOrEq_vec(__m512 x, __m512 y) { return FP_AVX512_CMP(x, y, _CMP_LE_OQ); }
+FP_KERNEL_TARGET inline __m512 Greater_vec(__m512 x, __m512 y) { return FP_AVX512_CMP(x, y, _CMP_GT_OQ); }
+FP_KERNEL_TARGET inline __m512 GreaterOrEq_vec(__m512 x, __m512 y) { return FP_AVX512_CMP(x, y, _CMP_GE_OQ); }
+#endif
+FP_KERNEL_TARGET inline bool IsZero_vec(__m512 x) {
+    return _mm512_cmp_ps_mask(x, _mm512_setzero_ps(), _CMP_EQ_OQ) != 0;
+}
+FP_KERNEL_TARGET inline bool IsNegative_vec(__m512 x) {
+    return _mm512_cmp_ps_mask(x, _mm512_setzero_ps(), _CMP_LT_OQ) != 0;
+}
+FP_KERNEL_TARGET inline bool IsNonPositive_vec(__m512 x) {
+    return _mm512_cmp_ps_mask(x, _mm512_setzero_ps(), _CMP_LE_OQ) != 0;
+}
+FP_KERNEL_TARGET inline bool IsOutsideUnit_vec(__m512 x) {
+    return (_mm512_cmp_ps_mask(x, _mm512_set1_ps(-1.0f), _CMP_LT_OQ) |
+            _mm512_cmp_ps_mask(x, _mm512_set1_ps(1.0f), _CMP_GT_OQ)) != 0;
+}
+#undef FP_AVX512_CMP
+
+#define FP_KERNEL_VALUE float
+#define FP_VEC_WIDTH 16
+#define FP_VEC_TYPE __m512
+#define FP_VEC_LOAD(p) _mm512_loadu_ps(p)
+#define FP_VEC_STORE(p, v) _mm512_storeu_ps(p, v)
+FP_DEFINE_KERNEL_SET("avx512", floatKernels)
+#undef FP_KERNEL_VALUE
+#undef FP_VEC_WIDTH
+#undef FP_VEC_TYPE
+#undef FP_VEC_LOAD
+#undef FP_VEC_STORE
+} // namespace avx512_kernels
+} // namespace
+#undef FP_KERNEL_TARGET
+
+//=========================================================================
+// Run-time selection
+//=========================================================================
+namespace {
+unsigned long long ReadXCR0() {
+    unsigned eax, edx;
+    __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<unsigned long long>(edx) << 32) | eax;
+}
+
+enum KernelLevel { SSE2_KERNELS, AVX2_KERNELS, AVX512_KERNELS };
+
+KernelLevel SelectKernelLevel() {
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return SSE2_KERNELS;
+
+    // The OS must have enabled the extended register state (XSAVE/XGETBV)
+    const unsigned cpuidOSXSAVE = 1U << 27, cpuidAVX = 1U << 28;
+    if ((ecx & cpuidOSXSAVE) == 0 || (ecx & cpuidAVX) == 0)
+        return SSE2_KERNELS;
+    const unsigned long long xcr0 = ReadXCR0();
+    if ((xcr0 & 0x06) != 0x06) // XMM and YMM state
+        return SSE2_KERNELS;
+    if (__get_cpuid_max(0, 0) < 7)
+        return SSE2_KERNELS;
+
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    const unsigned cpuidAVX2 = 1U << 5, cpuidAVX512F = 1U << 16;
+    if ((ebx & cpuidAVX512F) && (xcr0 & 0xE6) == 0xE6) // and opmask/ZMM state
+        return AVX512_KERNELS;
+    if (ebx & cpuidAVX2)
+        return AVX2_KERNELS;
+    return SSE2_KERNELS;
+}
+
+const BatchKernels<double>& SelectBatchKernels() {
+    switch (SelectKernelLevel()) {
+    case AVX512_KERNELS: return avx512_kernels::kernels;
+    case AVX2_KERNELS: return avx2_kernels::kernels;
+    default: return sse2_kernels::kernels;
+    }
+}
+
+const BatchKernels<float>& SelectFloatBatchKernels() {
+    switch (SelectKernelLevel()) {
+    case AVX512_KERNELS: return avx512_kernels::floatKernels;
+    case AVX2_KERNELS: return avx2_kernels::floatKernels;
+    default: return sse2_kernels::floatKernels;
+    }
+}
+} // namespace
+#endif // FP_SIMD_KERNELS_X86
+
+#undef FP_FOR_EACH_BINARY_KERNEL
+#undef FP_FOR_EACH_UNARY_KERNEL
+#undef FP_FOR_EACH_CHECK_KERNEL
+#undef FP_FOR_EACH_MATH_UNARY_KERNEL
+#undef FP_FOR_EACH_MATH_BINARY_KERNEL
+#undef FP_BINARY_KERNEL
+#undef FP_UNARY_KERNEL
+#undef FP_CHECK_KERNEL
+#undef FP_SELECT_KERNEL
+#undef FP_DIFFERENCES_KERNEL
+#undef FP_KERNEL_ENTRY
+#undef FP_DEFINE_KERNEL_SET
+
+template<>
+const BatchKernels<double>& FUNCTIONPARSERTYPES::GetBatchKernels<double>() {
+#ifdef FP_SIMD_KERNELS_X86
+    static const BatchKernels<double>& kernels = SelectBatchKernels();
+    return kernels;
+#else
+    return generic_kernels::kernels;
+#endif
+}
+
+template<>
+const BatchKernels<float>& FUNCTIONPARSERTYPES::GetBatchKernels<float>() {
+#ifdef FP_SIMD_KERNELS_X86
+    static const BatchKernels<float>& kernels = SelectFloatBatchKernels();
+    return kernels;
+#else
+    return generic_kernels::floatKernels;
+#endif
+}
@@ -0,0 +1,93 @@
+/***************************************************************************\
+|* Function Parser for C++ v3.3.2                                          *|
+|*-------------------------------------------------------------------------*|
+|* Copyright: Juha Nieminen                                                *|
+\***************************************************************************/
+
+// Column kernels used by FunctionParser::EvalMany()
+// -------------------------------------------------
+// NOTE: This file is for the internal use of the function parser only.
+
+#ifndef ONCE_FPARSER_SIMD_H_
+#define ONCE_FPARSER_SIMD_H_
+
+namespace FUNCTIONPARSERTYPES {
+/* Each kernel applies one opcode to n consecutive elements. Binary kernels
+   store their result in x, and select stores y where x is true (as the
+   condition of an if()) and z elsewhere. All the variants give bit-identical
+   results to the corresponding scalar code in FunctionParser::Eval() (except
+   for which one propagates when both operands are NaNs, which the compiler
+   does not define for the scalar code either).
+   The any* kernels return true if the check fails for at least one element.
+   There is a set for double and one for float (used by the single-precision
+   EvalMany()); the float kernels process twice as many elements at a time.
+   The math kernels (exp to atan2) are only used after UseVectorMath(): they
+   are not bit-identical to the standard library functions, but within the
+   error bounds documented there.
+   The differences kernel is used by EvalRange(). It steps the forward
+   differences of DifferenceLanes interleaved sequences n times: hi and lo
+   hold the high and low parts of difference k of lane l at index
+   k*DifferenceLanes + l, and each step writes the values of the lanes to
+   the next DifferenceLanes results. The rounding error of each addition is
+   kept in the low parts, which are renormalized at the end.
+*/
+enum { DifferenceLanes = 8 };
+
+template<typename Value_t>
+struct BatchKernels {
+    const char* name;
+
+    void (*add)(Value_t* x, const Value_t* y, unsigned n);
+    void (*sub)(Value_t* x, const Value_t* y, unsigned n);
+    void (*rsub)(Value_t* x, const Value_t* y, unsigned n);
+    void (*mul)(Value_t* x, const Value_t* y, unsigned n);
+    void (*div)(Value_t* x, const Value_t* y, unsigned n);
+    void (*rdiv)(Value_t* x, const Value_t* y, unsigned n);
+    void (*min)(Value_t* x, const Value_t* y, unsigned n);
+    void (*max)(Value_t* x, const Value_t* y, unsigned n);
+    void (*equal)(Value_t* x, const Value_t* y, unsigned n);
+    void (*nequal)(Value_t* x, const Value_t* y, unsigned n);
+    void (*less)(Value_t* x, const Value_t* y, unsigned n);
+    void (*lessOrEq)(Value_t* x, const Value_t* y, unsigned n);
+    void (*greater)(Value_t* x, const Value_t* y, unsigned n);
+    void (*greaterOrEq)(Value_t* x, const Value_t* y, unsigned n);
+    void (*select)(Value_t* x, const Value_t* y, const Value_t* z, unsigned n);
+
+    void (*neg)(Value_t* x, unsigned n);
+    void (*abs)(Value_t* x, unsigned n);
+    void (*sqr)(Value_t* x, unsigned n);
+    void (*sqrt)(Value_t* x, unsigned n);
+    void (*inv)(Value_t* x, unsigned n);
+    void (*rsqrt)(Value_t* x, unsigned n);
+
+    bool (*anyZero)(const Value_t* x, unsigned n);
+    bool (*anyNegative)(const Value_t* x, unsigned n);
+    bool (*anyNonPositive)(const Value_t* x, unsigned n);
+    bool (*anyOutsideUnit)(const Value_t* x, unsigned n);
+
+    void (*exp)(Value_t* x, unsigned n);
+    void (*exp2)(Value_t* x, unsigned n);
+    void (*log)(Value_t* x, unsigned n);
+    void (*log2)(Value_t* x, unsigned n);
+    void (*log10)(Value_t* x, unsigned n);
+    void (*sin)(Value_t* x, unsigned n);
+    void (*cos)(Value_t* x, unsigned n);
+    void (*tan)(Value_t* x, unsigned n);
+    void (*atan)(Value_t* x, unsigned n);
+    void (*pow)(Value_t* x, const Value_t* y, unsigned n);
+    void (*rpow)(Value_t* x, const Value_t* y, unsigned n);
+    void (*atan2)(Value_t* x, const Value_t* y, unsigned n);
+
+    void (*differences)(Value_t* hi, Value_t* lo, unsigned degree, unsigned n, Value_t* results);
+};
+
+// Returns the fastest kernel set supported by the running CPU.
+template<typename Value_t>
+const BatchKernels<Value_t>& GetBatchKernels();
+template<>
+const BatchKernels<double>& GetBatchKernels<double>();
+template<>
+const BatchKernels<float>& GetBatchKernels<float>();
+} // namespace FUNCTIONPARSERTYPES
+
+#endif
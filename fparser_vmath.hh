@@ -0,0 +1,456 @@
+/***************************************************************************\
+|* Function Parser for C++ v3.3.2                                          *|
+|*-------------------------------------------------------------------------*|
+|* Copyright: Juha Nieminen                                                *|
+\***************************************************************************/
+
+// Vector math functions of the EvalMany() kernels
+// -----------------------------------------------
+// NOTE: This file is for the internal use of the function parser only.
+//
+// There is no include guard: fparser_simd.cc includes this file in the
+// namespace of each instruction set, after defining FP_KERNEL_TARGET and
+//   VD, VF     the vectors of doubles and of floats (with twice as many
+//              elements)
+//   VI, VU     the vectors of signed and unsigned 64-bit integers
+//   bool AnyLane(VI mask)
+//   VD LowHalf(VF x), VD HighHalf(VF x), VF ToFloats(VD low, VD high)
+// It defines <Name>_vec(VD) and <Name>_vec(VF) for the math kernels of
+// FP_FOR_EACH_MATH_UNARY_KERNEL and FP_FOR_EACH_MATH_BINARY_KERNEL.
+//
+// The algorithms are those of fdlibm (the log(), log2(), log10(), sin(),
+// cos() and atan() polynomials and argument reductions) and a Taylor series
+// for exp(), written with the vector extensions of gcc and clang. pow() uses
+// a double-double logarithm. The arguments for which the reductions are not
+// exact (sin(), cos() and tan() of |x| > 2^20*pi/2, and the special cases of
+// pow() and atan2()) are passed to the standard library one element at a
+// time. The float versions compute in double precision and round the result.
+// The measured error bounds are documented with UseVectorMath().
+
+namespace vmath {
+const double RoundingShift = 6755399441055744.0; // 1.5*2^52
+const double Infinity = HUGE_VAL;
+const double Ln2 = 6.93147180559945286227e-01;
+const double Ln2Hi = 6.93147180559662956512e-01; // 41 bits: n*Ln2Hi is exact
+const double Ln2Lo = 2.82352905630315771226e-13;
+const double InvLn2 = 1.44269504088896338700e+00;
+const double InvLn2Hi = 1.44269504072144627571e+00;
+const double InvLn2Lo = 1.67517131648865118353e-10;
+const double InvLn10Hi = 4.34294481878168880939e-01;
+const double InvLn10Lo = 2.50829467116452752298e-11;
+const double Log10Of2Hi = 3.01029995663611771306e-01;
+const double Log10Of2Lo = 3.69423907715893078616e-13;
+const double TwoThirdsHi = 6.66666666666666629659e-01;
+const double TwoThirdsLo = 3.70074341541718826312e-17;
+
+const double TwoOverPi = 6.36619772367581382433e-01;
+const double PiOver2_1 = 1.57079632673412561417e+00; // 33 bits each
+const double PiOver2_2 = 6.07710050630396597660e-11;
+const double PiOver2_3 = 2.02226624871116645580e-21;
+const double PiOver2_3t = 8.47842766036889956997e-32;
+const double MaxReducedArgument = 1647099.0; // < 2^20*pi/2
+const double Pi = 3.14159265358979311600e+00;
+const double PiLo = 1.22464679914735317720e-16;
+
+FP_KERNEL_TARGET inline VD Fill(double value) { return VD() + value; }
+FP_KERNEL_TARGET inline VD Blend(VI mask, VD x, VD y) {
+    return (VD)((mask & (VI)x) | (~mask & (VI)y));
+}
+FP_KERNEL_TARGET inline VI SignBit(VD x) { return (VI)x & (-0x7FFFFFFFFFFFFFFFLL - 1); }
+FP_KERNEL_TARGET inline VD Abs(VD x) { return (VD)((VI)x & 0x7FFFFFFFFFFFFFFFLL); }
+FP_KERNEL_TARGET inline VD Clamp(VD x, double low, double high) {
+    x = Blend((VI)(x < low), Fill(low), x);
+    return Blend((VI)(x > high), Fill(high), x);
+}
+
+// Rounds to the nearest integer, for |x| < 2^51.
+FP_KERNEL_TARGET inline VD Round(VD x) { return (x + RoundingShift) - RoundingShift; }
+FP_KERNEL_TARGET inline VI ToInt(VD rounded) {
+    return (VI)(rounded + RoundingShift) - (VI)Fill(RoundingShift);
+}
+FP_KERNEL_TARGET inline VD ToDouble(VI n) { return (VD)(n + (VI)Fill(RoundingShift)) - RoundingShift; }
+
+// y*2^n for an integer |n| <= 2044, which is rounded only once if the
+// result is subnormal.
+FP_KERNEL_TARGET inline VD Scale(VD y, VD n) {
+    const VD half = Round(n * 0.5);
+    return y * (VD)((ToInt(half) + 1023) << 52) * (VD)((ToInt(n - half) + 1023) << 52);
+}
+
+// The error-free transformations of double-double arithmetic (Knuth's
+// TwoSum and Dekker's product, which does not need FMA instructions)
+FP_KERNEL_TARGET inline VD TwoSum(VD a, VD b, VD& error) {
+    const VD sum = a + b, bPart = sum - a;
+    error = (a - (sum - bPart)) + (b - bPart);
+    return sum;
+}
+FP_KERNEL_TARGET inline VD Split(VD a, VD& low) {
+    // a*(2^27+1), written so that the compiler cannot contract it and the
+    // subtraction below into an inexact FMA
+    const VD t = a * 134217728.0 + a;
+    const VD high = t - (t - a);
+    low = a - high;
+    return high;
+}
+FP_KERNEL_TARGET inline VD TwoProduct(VD a, VD b, VD& error) {
+    VD aLow, bLow;
+    const VD aHigh = Split(a, aLow), bHigh = Split(b, bLow);
+    const VD product = a * b;
+    error = ((aHigh * bHigh - product) + aHigh * bLow + aLow * bHigh) + aLow * bLow;
+    return product;
+}
+
+//-------------------------------------------------------------------------
+// exp(), exp2()
+//-------------------------------------------------------------------------
+// e^r for |r| <= log(2)/2 (the terms after r^13/13! are below 2^-60)
+FP_KERNEL_TARGET inline VD ExpSeries(VD r) {
+    VD p = Fill(1.0 / 6227020800.0);
+    p = p * r + 1.0 / 479001600.0;
+    p = p * r + 1.0 / 39916800.0;
+    p = p * r + 1.0 / 3628800.0;
+    p = p * r + 1.0 / 362880.0;
+    p = p * r + 1.0 / 40320.0;
+    p = p * r + 1.0 / 5040.0;
+    p = p * r + 1.0 / 720.0;
+    p = p * r + 1.0 / 120.0;
+    p = p * r + 1.0 / 24.0;
+    p = p * r + 1.0 / 6.0;
+    p = p * r + 0.5;
+    p = p * r + 1.0;
+    return p * r + 1.0;
+}
+
+// e^(x+dx), where dx is a correction of the order of the rounding error of x
+FP_KERNEL_TARGET inline VD Exp(VD x, VD dx) {
+    // Beyond these limits the result is 0 or infinity.
+    dx = (VD)((VI)(x >= -746.0) & (VI)(x <= 710.0) & (VI)dx);
+    x = Clamp(x, -746.0, 710.0);
+    const VD n = Round(x * InvLn2);
+    return Scale(ExpSeries(((x - n * Ln2Hi) - n * Ln2Lo) + dx), n);
+}
+
+FP_KERNEL_TARGET inline VD Exp2(VD x) {
+    x = Clamp(x, -1080.0, 1025.0);
+    const VD n = Round(x);
+    return Scale(ExpSeries((x - n) * Ln2), n);
+}
+
+//-------------------------------------------------------------------------
+// log(), log2(), log10()
+//-------------------------------------------------------------------------
+const double Lg1 = 6.666666666666735130e-01;
+const double Lg2 = 3.999999999940941908e-01;
+const double Lg3 = 2.857142874366239149e-01;
+const double Lg4 = 2.222219843214978396e-01;
+const double Lg5 = 1.818357216161805012e-01;
+const double Lg6 = 1.531383769920937332e-01;
+const double Lg7 = 1.479819860511658591e-01;
+
+// Splits a positive finite x into 2^k*(1+f) with sqrt(1/2) <= 1+f < sqrt(2),
+// and returns k.
+FP_KERNEL_TARGET inline VD LogReduce(VD x, VD& f) {
+    const VI subnormal = (VI)(x < 2.2250738585072014e-308);
+    x = Blend(subnormal, x * 18014398509481984.0, x); // 2^54
+    // Adding the difference between the bits of 1 and sqrt(1/2) carries
+    // into the exponent exactly when the mantissa is at least sqrt(2).
+    const VI bits = (VI)x + (0x3FF0000000000000LL - 0x3FE6A09E667F3BCDLL);
+    f = (VD)((bits & 0x000FFFFFFFFFFFFFLL) + 0x3FE6A09E667F3BCDLL) - 1.0;
+    return ToDouble((VI)((VU)bits >> 52) - 1023) - (VD)(subnormal & (VI)Fill(54.0));
+}
+
+// log(1+f) = f - hfsq + s*(hfsq+R(s^2)) with hfsq = f^2/2 and s = f/(2+f);
+// returns the last term.
+FP_KERNEL_TARGET inline VD LogTail(VD f, VD hfsq) {
+    const VD s = f / (2.0 + f);
+    const VD z = s * s, w = z * z;
+    const VD t1 = w * (Lg2 + w * (Lg4 + w * Lg6));
+    const VD t2 = z * (Lg1 + w * (Lg3 + w * (Lg5 + w * Lg7)));
+    return s * (hfsq + (t2 + t1));
+}
+
+// log(1+f) as hi+lo, where hi keeps only its upper 21 bits so that its
+// products with the high parts of the constants are exact.
+FP_KERNEL_TARGET inline VD LogSplit(VD f, VD& lo) {
+    const VD hfsq = 0.5 * f * f;
+    const VD hi = (VD)((VI)(f - hfsq) & ~0xFFFFFFFFLL);
+    lo = ((f - hi) - hfsq) + LogTail(f, hfsq);
+    return hi;
+}
+
+// The results for x <= 0, infinity and NaN
+FP_KERNEL_TARGET inline VD LogSpecial(VD x, VD result) {
+    result = Blend((VI)(x == Infinity), x, result);
+    result = Blend((VI)(x == 0.0), Fill(-Infinity), result);
+    result = Blend((VI)(x < 0.0), Fill(Infinity) - Infinity, result);
+    return Blend((VI)(x != x), x, result);
+}
+
+FP_KERNEL_TARGET inline VD Log(VD x) {
+    VD f;
+    const VD k = LogReduce(x, f);
+    const VD hfsq = 0.5 * f * f;
+    return LogSpecial(x, k * Ln2Hi - ((hfsq - (LogTail(f, hfsq) + k * Ln2Lo)) - f));
+}
+
+FP_KERNEL_TARGET inline VD Log2(VD x) {
+    VD f, lo;
+    const VD k = LogReduce(x, f);
+    const VD hi = LogSplit(f, lo);
+    const VD high = k + hi * InvLn2Hi;
+    const VD low = ((lo + hi) * InvLn2Lo + lo * InvLn2Hi) + ((k - high) + hi * InvLn2Hi);
+    return LogSpecial(x, low + high);
+}
+
+FP_KERNEL_TARGET inline VD Log10(VD x) {
+    VD f, lo;
+    const VD k = LogReduce(x, f);
+    const VD hi = LogSplit(f, lo);
+    const VD y = k * Log10Of2Hi, high = y + hi * InvLn10Hi;
+    const VD low = (k * Log10Of2Lo + (lo + hi) * InvLn10Lo + lo * InvLn10Hi) + ((y - high) + hi * InvLn10Hi);
+    return LogSpecial(x, low + high);
+}
+
+//-------------------------------------------------------------------------
+// pow()
+//-------------------------------------------------------------------------
+// log(x) as hi+lo for a positive finite x, with a relative error of about
+// 2^-64: log(1+f) = 2*atanh(s) = 2s + 2/3*s^3 + s^5*P(s^2) with s = f/(2+f).
+FP_KERNEL_TARGET inline VD LogExtended(VD x, VD& lo) {
+    VD f;
+    const VD k = LogReduce(x, f);
+
+    VD denominatorLow, productLow, squareLow, cubeLow, termLow;
+    const VD denominator = TwoSum(Fill(2.0), f, denominatorLow);
+    const VD s = f / denominator;
+    const VD product = TwoProduct(s, denominator, productLow);
+    const VD sLow = (((f - product) - productLow) - s * denominatorLow) / denominator;
+    const VD square = TwoProduct(s, s, squareLow);
+    squareLow += 2.0 * s * sLow;
+    const VD cube = TwoProduct(s, square, cubeLow);
+    cubeLow += s * squareLow + sLow * square;
+    const VD term = TwoProduct(Fill(TwoThirdsHi), cube, termLow);
+    termLow += TwoThirdsHi * cubeLow + TwoThirdsLo * cube;
+
+    VD p = Fill(2.0 / 25);
+    p = p * square + 2.0 / 23;
+    p = p * square + 2.0 / 21;
+    p = p * square + 2.0 / 19;
+    p = p * square + 2.0 / 17;
+    p = p * square + 2.0 / 15;
+    p = p * square + 2.0 / 13;
+    p = p * square + 2.0 / 11;
+    p = p * square + 2.0 / 9;
+    p = p * square + 2.0 / 7;
+    p = p * square + 2.0 / 5;
+
+    VD low;
+    VD high = TwoSum(2.0 * s, term, low);
+    low += 2.0 * sLow + termLow + cube * square * p;
+    high = TwoSum(high, low, low);
+    high = TwoSum(k * Ln2Hi, high, lo);
+    lo += low + k * Ln2Lo;
+    return TwoSum(high, lo, lo);
+}
+
+// x^y for x > 0 and |y| < 1e300 (which keeps y*log(x) from overflowing in
+// TwoProduct()); the other elements are computed by std::pow().
+FP_KERNEL_TARGET inline VD Pow(VD x, VD y) {
+    VD logLow, productLow;
+    const VD logHigh = LogExtended(x, logLow);
+    const VD product = TwoProduct(y, logHigh, productLow);
+    VD result = Exp(product, productLow + y * logLow);
+
+    const VI slow = ~((VI)(x > 0.0) & (VI)(x < Infinity) & (VI)(Abs(y) < 1e300));
+    if (AnyLane(slow))
+        for (unsigned i = 0; i < sizeof(VD) / sizeof(double); ++i)
+            if (slow[i])
+                result[i] = std::pow(x[i], y[i]);
+    return result;
+}
+
+//-------------------------------------------------------------------------
+// sin(), cos(), tan()
+//-------------------------------------------------------------------------
+const double S1 = -1.66666666666666324348e-01;
+const double S2 = 8.33333333332248946124e-03;
+const double S3 = -1.98412698298579493134e-04;
+const double S4 = 2.75573137070700676789e-06;
+const double S5 = -2.50507602534068634195e-08;
+const double S6 = 1.58969099521155010221e-10;
+const double C1 = 4.16666666666666019037e-02;
+const double C2 = -1.38888888888741095749e-03;
+const double C3 = 2.48015872894767294178e-05;
+const double C4 = -2.75573143513906633035e-07;
+const double C5 = 2.08757232129817482790e-09;
+const double C6 = -1.13596475577881948265e-11;
+
+// Reduces x to r+dr = x - q*pi/2 with |r| <= pi/4 and returns q. The
+// products with the 33-bit parts of pi/2 are exact for |q| < 2^20.
+FP_KERNEL_TARGET inline VI ReduceHalfPi(VD x, VD& r, VD& dr) {
+    const VD q = Round(x * TwoOverPi);
+    VD error;
+    r = TwoSum(x - q * PiOver2_1, -(q * PiOver2_2), error);
+    r = TwoSum(r, (error - q * PiOver2_3) - q * PiOver2_3t, dr);
+    return ToInt(q);
+}
+
+// sin(x+y) and cos(x+y) for |x| <= pi/4 and |y| <= ulp(x)/2
+FP_KERNEL_TARGET inline VD SinKernel(VD x, VD y) {
+    const VD z = x * x, v = z * x;
+    const VD r = S2 + z * (S3 + z * (S4 + z * (S5 + z * S6)));
+    return x - ((z * (0.5 * y - v * r) - y) - v * S1);
+}
+FP_KERNEL_TARGET inline VD CosKernel(VD x, VD y) {
+    const VD z = x * x;
+    const VD r = z * (C1 + z * (C2 + z * (C3 + z * (C4 + z * (C5 + z * C6)))));
+    const VD hz = 0.5 * z, w = 1.0 - hz;
+    return w + (((1.0 - w) - hz) + (z * r - x * y));
+}
+
+// The elements which cannot be reduced (including infinities and NaNs)
+FP_KERNEL_TARGET inline VI NotReducible(VD x) { return ~(VI)(Abs(x) <= MaxReducedArgument); }
+
+// sin(x + quadrant*pi/2)
+FP_KERNEL_TARGET inline VD Sin(VD x, int quadrant) {
+    VD r, dr;
+    const VI q = ReduceHalfPi(x, r, dr) + quadrant;
+    const VD result = (VD)((VI)Blend(-(q & 1), CosKernel(r, dr), SinKernel(r, dr)) ^ ((q & 2) << 62));
+    return quadrant ? result : Blend((VI)(x == 0.0), x, result); // keeps the sign of a zero
+}
+
+FP_KERNEL_TARGET inline VD Tan(VD x) {
+    VD r, dr;
+    const VI q = ReduceHalfPi(x, r, dr);
+    const VI odd = -(q & 1);
+    const VD s = SinKernel(r, dr), c = CosKernel(r, dr);
+    const VD result = (VD)((VI)(Blend(odd, c, s) / Blend(odd, s, c)) ^ (odd & SignBit(Fill(-1.0))));
+    return Blend((VI)(x == 0.0), x, result); // keeps the sign of a zero
+}
+
+//-------------------------------------------------------------------------
+// atan(), atan2()
+//-------------------------------------------------------------------------
+const double AtanHi0 = 4.63647609000806093515e-01; // atan(0.5)
+const double AtanLo0 = 2.26987774529616870924e-17;
+const double AtanHi1 = 7.85398163397448278999e-01; // atan(1)
+const double AtanLo1 = 3.06161699786838301793e-17;
+const double AtanHi2 = 9.82793723247329054082e-01; // atan(1.5)
+const double AtanLo2 = 1.39033110312309984516e-17;
+const double AtanHi3 = 1.57079632679489655800e+00; // atan(inf)
+const double AtanLo3 = 6.12323399573676603587e-17;
+const double AT0 = 3.33333333333329318027e-01;
+const double AT1 = -1.99999999998764832476e-01;
+const double AT2 = 1.42857142725034663711e-01;
+const double AT3 = -1.11111104054623557880e-01;
+const double AT4 = 9.09088713343650656196e-02;
+const double AT5 = -7.69187620504482999495e-02;
+const double AT6 = 6.66107313738753120669e-02;
+const double AT7 = -5.83357013379057348645e-02;
+const double AT8 = 4.97687799461593236017e-02;
+const double AT9 = -3.65315727442169155270e-02;
+const double AT10 = 1.62858201153657823623e-02;
+
+// atan(|x|): the argument is reduced to |t| <= 7/16 by one of the identities
+// atan(x) = atan(c) + atan((x-c)/(1+c*x)) for c = 0, 0.5, 1, 1.5 and infinity.
+FP_KERNEL_TARGET inline VD AtanAbs(VD x) {
+    const VD a = Abs(x);
+    const VI above0 = (VI)(a >= 0.4375) | (VI)(a != a), above1 = (VI)(a >= 0.6875) | (VI)(a != a);
+    const VI above2 = (VI)(a >= 1.1875) | (VI)(a != a), above3 = (VI)(a >= 2.4375) | (VI)(a != a);
+    VD numerator = a, denominator = Fill(1.0), hi = VD(), lo = VD();
+    numerator = Blend(above0, 2.0 * a - 1.0, numerator);
+    denominator = Blend(above0, 2.0 + a, denominator);
+    hi = Blend(above0, Fill(AtanHi0), hi);
+    lo = Blend(above0, Fill(AtanLo0), lo);
+    numerator = Blend(above1, a - 1.0, numerator);
+    denominator = Blend(above1, a + 1.0, denominator);
+    hi = Blend(above1, Fill(AtanHi1), hi);
+    lo = Blend(above1, Fill(AtanLo1), lo);
+    numerator = Blend(above2, a - 1.5, numerator);
+    denominator = Blend(above2, 1.0 + 1.5 * a, denominator);
+    hi = Blend(above2, Fill(AtanHi2), hi);
+    lo = Blend(above2, Fill(AtanLo2), lo);
+    numerator = Blend(above3, Fill(-1.0), numerator);
+    denominator = Blend(above3, a, denominator);
+    hi = Blend(above3, Fill(AtanHi3), hi);
+    lo = Blend(above3, Fill(AtanLo3), lo);
+
+    const VD t = numerator / denominator;
+    const VD z = t * t, w = z * z;
+    const VD s1 = z * (AT0 + w * (AT2 + w * (AT4 + w * (AT6 + w * (AT8 + w * AT10)))));
+    const VD s2 = w * (AT1 + w * (AT3 + w * (AT5 + w * (AT7 + w * AT9))));
+    return hi - ((t * (s1 + s2) - lo) - t);
+}
+
+FP_KERNEL_TARGET inline VD Atan(VD x) { return (VD)((VI)AtanAbs(x) ^ SignBit(x)); }
+
+// atan2(y, x) from atan(|y/x|); the elements where x or y is zero or not
+// finite, or |y/x| is not a normal number, are computed by std::atan2().
+FP_KERNEL_TARGET inline VD Atan2(VD y, VD x) {
+    const VD ratio = Abs(y / x);
+    const VD z = AtanAbs(ratio);
+    VD result = Blend((VI)(x < 0.0), Pi - (z - PiLo), z);
+    result = (VD)((VI)result ^ SignBit(y));
+
+    const VI slow = ~((VI)(ratio >= 1e-300) & (VI)(ratio <= 1e300) &
+                      (VI)(Abs(x) < Infinity) & (VI)(Abs(y) < Infinity));
+    if (AnyLane(slow))
+        for (unsigned i = 0; i < sizeof(VD) / sizeof(double); ++i)
+            if (slow[i])
+                result[i] = std::atan2(y[i], x[i]);
+    return result;
+}
+} // namespace vmath
+
+//-------------------------------------------------------------------------
+// Kernel entry points
+//-------------------------------------------------------------------------
+FP_KERNEL_TARGET inline VD Exp_vec(VD x) { return vmath::Exp(x, VD()); }
+FP_KERNEL_TARGET inline VD Exp2_vec(VD x) { return vmath::Exp2(x); }
+FP_KERNEL_TARGET inline VD Log_vec(VD x) { return vmath::Log(x); }
+FP_KERNEL_TARGET inline VD Log2_vec(VD x) { return vmath::Log2(x); }
+FP_KERNEL_TARGET inline VD Log10_vec(VD x) { return vmath::Log10(x); }
+FP_KERNEL_TARGET inline VD Atan_vec(VD x) { return vmath::Atan(x); }
+FP_KERNEL_TARGET inline VD Pow_vec(VD x, VD y) { return vmath::Pow(x, y); }
+FP_KERNEL_TARGET inline VD RPow_vec(VD x, VD y) { return vmath::Pow(y, x); }
+FP_KERNEL_TARGET inline VD Atan2_vec(VD x, VD y) { return vmath::Atan2(x, y); }
+
+// The trigonometric functions fall back to the standard library for the
+// whole vector when an element cannot be reduced.
+FP_KERNEL_TARGET inline VD Sin_vec(VD x) {
+    if (AnyLane(vmath::NotReducible(x))) {
+        for (unsigned i = 0; i < sizeof(VD) / sizeof(double); ++i)
+            x[i] = std::sin(x[i]);
+        return x;
+    }
+    return vmath::Sin(x, 0);
+}
+FP_KERNEL_TARGET inline VD Cos_vec(VD x) {
+    if (AnyLane(vmath::NotReducible(x))) {
+        for (unsigned i = 0; i < sizeof(VD) / sizeof(double); ++i)
+            x[i] = std::cos(x[i]);
+        return x;
+    }
+    return vmath::Sin(x, 1);
+}
+FP_KERNEL_TARGET inline VD Tan_vec(VD x) {
+    if (AnyLane(vmath::NotReducible(x))) {
+        for (unsigned i = 0; i < sizeof(VD) / sizeof(double); ++i)
+            x[i] = std::tan(x[i]);
+        return x;
+    }
+    return vmath::Tan(x);
+}
+
+#define FP_VMATH_FLOAT_UNARY(name, op) \
+    FP_KERNEL_TARGET inline VF op##_vec(VF x) { \
+        return ToFloats(op##_vec(LowHalf(x)), op##_vec(HighHalf(x))); \
+    }
+#define FP_VMATH_FLOAT_BINARY(name, op) \
+    FP_KERNEL_TARGET inline VF op##_vec(VF x, VF y) { \
+        return ToFloats(op##_vec(LowHalf(x), LowHalf(y)), op##_vec(HighHalf(x), HighHalf(y))); \
+    }
+FP_FOR_EACH_MATH_UNARY_KERNEL(FP_VMATH_FLOAT_UNARY)
+FP_FOR_EACH_MATH_BINARY_KERNEL(FP_VMATH_FLOAT_BINARY)
+#undef FP_VMATH_FLOAT_UNARY
+#undef FP_VMATH_FLOAT_BINARY
@@ -0,0 +1,83 @@
+/***************************************************************************\
+|* Function Parser for C++ v3.3.2                                          *|
+|*-------------------------------------------------------------------------*|
+|* Copyright: Juha Nieminen                                                *|
+\***************************************************************************/
+
+// Auxiliary functions
+// -------------------
+// NOTE: This file is for the internal use of the function parser only.
+// The evaluation engines share these so that they all give the same results.
+
+#ifndef ONCE_FPARSER_AUX_H_
+#define ONCE_FPARSER_AUX_H_
+
+#include <cmath>
+
+#ifndef M_PI
+#define M_PI 3.1415926535897932384626433832795
+#endif
+
+namespace FUNCTIONPARSERTYPES {
+template<typename Value_t>
+inline int doubleToInt(Value_t d) {
+    return d < 0 ? -int((-d) + .5) : int(d + .5);
+}
+
+template<typename Value_t>
+inline Value_t Min(Value_t d1, Value_t d2) {
+    return d1 < d2 ? d1 : d2;
+}
+template<typename Value_t>
+inline Value_t Max(Value_t d1, Value_t d2) {
+    return d1 > d2 ? d1 : d2;
+}
+
+// The constants are rounded to the precision of the value type (the double
+// and float versions below keep the results of the JIT and SIMD code):
+template<typename Value_t>
+inline Value_t DegreesToRadians(Value_t degrees) {
+    return degrees * Value_t(0.017453292519943295769236907684886127L);
+}
+template<typename Value_t>
+inline Value_t RadiansToDegrees(Value_t radians) {
+    return radians * Value_t(57.295779513082320876798154814105170L);
+}
+
+#ifdef FP_SUPPORT_LOG2
+template<typename Value_t>
+inline Value_t fp_log2(Value_t x) { return std::log2(x); }
+#else
+template<typename Value_t>
+inline Value_t fp_log2(Value_t x) { return std::log(x) * Value_t(1.4426950408889634073599246810018921L); }
+#endif
+
+inline double DegreesToRadians(double degrees) {
+    return degrees * (M_PI / 180.0);
+}
+inline double RadiansToDegrees(double radians) {
+    return radians * (180.0 / M_PI);
+}
+
+#ifdef FP_SUPPORT_LOG2
+inline double fp_log2(double x) { return log2(x); }
+#else
+inline double fp_log2(double x) { return log(x) * 1.4426950408889634074; }
+#endif
+
+// Single-precision versions for EvalMany(const float*, ...):
+inline float DegreesToRadians(float degrees) {
+    return degrees * float(M_PI / 180.0);
+}
+inline float RadiansToDegrees(float radians) {
+    return radians * float(180.0 / M_PI);
+}
+
+#ifdef FP_SUPPORT_LOG2
+inline float fp_log2(float x) { return log2f(x); }
+#else
+inline float fp_log2(float x) { return std::log(x) * 1.44269504f; }
+#endif
+} // namespace FUNCTIONPARSERTYPES
+
+#endif
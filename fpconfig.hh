@@ -80,3 +80,40 @@
  (Consult the documentation for details.)
  */
 //#define FP_NO_EVALUATION_CHECKS
+
+/*
+ Uncomment (or define in your compiler options) to make EvalMany() use
+ portable C++ loops instead of the SSE2/AVX2/AVX-512 kernels which are
+ otherwise selected at run time on x86 processors.
+ */
+//#define FP_NO_SIMD_KERNELS
+
+/*
+ Uncomment (or define in your compiler options) to make EvalManyParallel()
+ evaluate all the rows in the calling thread. Otherwise it uses POSIX threads
+ where they are available (which may require linking with -pthread).
+ */
+//#define FP_NO_THREADS
+
+#if !defined(FP_NO_THREADS) && (defined(__unix__) || defined(__APPLE__))
+#define FP_USE_POSIX_THREADS
+#endif
+
+/*
+ Uncomment (or define in your compiler options) to make Eval() dispatch the
+ opcodes with a plain switch statement. Otherwise, when compiling with gcc
+ or clang, Eval() jumps directly from the handler of each opcode to the
+ next one using the "labels as values" extension, which is faster.
+ */
+//#define FP_NO_THREADED_DISPATCH
+
+#if !defined(FP_NO_THREADED_DISPATCH) && (defined(__GNUC__) || defined(__clang__))
+#define FP_USE_THREADED_DISPATCH
+#endif
+
+/*
+ Uncomment (or define in your compiler options) to make Eval() interpret
+ the stack bytecode directly instead of first translating it into
+ three-address register code, which is faster.
+ */
+//#define FP_NO_REGISTER_CODE
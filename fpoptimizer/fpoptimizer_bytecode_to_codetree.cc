@@ -122,12 +122,13 @@ double ParseMuliSequence(const std::vector<unsigned>& ByteCode, size_t& IP, size
 } // namespace
 
 namespace FPoptimizer_CodeTree {
+template<typename Value_t>
 class CodeTreeParserData {
 public:
     CodeTreeParserData() : stack() {}
 
     void Eat(size_t nparams, OPCODE opcode) {
-        CodeTree newnode;
+        CodeTree<Value_t> newnode;
         newnode.SetOpcode(opcode);
         size_t stackhead = stack.size() - nparams;
         for (size_t a = 0; a < nparams; ++a)
@@ -155,17 +156,17 @@ public:
         //        tanh: sinh/cosh = (exp(2*x)-1) / (exp(2*x)+1)
         //cTanh [x] -> (cMul (cAdd {(cPow [CONSTANT_2E x]) -1}) (cPow [(cAdd {(cPow [CONSTANT_2E x]) 1}) -1]))
         case cTanh: {
-            CodeTree sinh, cosh;
+            CodeTree<Value_t> sinh, cosh;
             sinh.SetOpcode(cSinh);
             sinh.AddParam(newnode.GetParam(0));
             sinh.Rehash();
             cosh.SetOpcode(cCosh);
             cosh.AddParamMove(newnode.GetParam(0));
             cosh.Rehash();
-            CodeTree pow;
+            CodeTree<Value_t> pow;
             pow.SetOpcode(cPow);
             pow.AddParamMove(cosh);
-            pow.AddParam(CodeTree(-1.0));
+            pow.AddParam(CodeTree<Value_t>(-1.0));
             pow.Rehash();
             newnode.SetOpcode(cMul);
             newnode.SetParamMove(0, sinh);
@@ -176,17 +177,17 @@ public:
         //        tan: sin/cos
         //cTan [x] -> (cMul (cSin [x]) (cPow [(cCos [x]) -1]))
         case cTan: {
-            CodeTree sin, cos;
+            CodeTree<Value_t> sin, cos;
             sin.SetOpcode(cSin);
             sin.AddParam(newnode.GetParam(0));
             sin.Rehash();
             cos.SetOpcode(cCos);
             cos.AddParamMove(newnode.GetParam(0));
             cos.Rehash();
-            CodeTree pow;
+            CodeTree<Value_t> pow;
             pow.SetOpcode(cPow);
             pow.AddParamMove(cos);
-            pow.AddParam(CodeTree(-1.0));
+            pow.AddParam(CodeTree<Value_t>(-1.0));
             pow.Rehash();
             newnode.SetOpcode(cMul);
             newnode.SetParamMove(0, sin);
@@ -195,17 +196,17 @@ public:
         }
 
         case cPow: {
-            const CodeTree& p0 = newnode.GetParam(0);
-            const CodeTree& p1 = newnode.GetParam(1);
+            const CodeTree<Value_t>& p0 = newnode.GetParam(0);
+            const CodeTree<Value_t>& p1 = newnode.GetParam(1);
             if (p1.GetOpcode() == cAdd) {
                 // convert x^(a + b) into x^a * x^b just so that
                 // some optimizations can be run on it.
                 // For instance, exp(log(x)*-61.1 + log(z)*-59.1)
                 // won't be changed into exp(log(x*z)*-61.1)*z^2
                 // unless we do this.
-                std::vector<CodeTree> mulgroup(p1.GetParamCount());
+                std::vector<CodeTree<Value_t> > mulgroup(p1.GetParamCount());
                 for (size_t a = 0; a < p1.GetParamCount(); ++a) {
-                    CodeTree pow;
+                    CodeTree<Value_t> pow;
                     pow.SetOpcode(cPow);
                     pow.AddParam(p0);
                     pow.AddParam(p1.GetParam(a));
@@ -248,7 +249,7 @@ public:
     }
 
     void EatFunc(size_t nparams, OPCODE opcode, unsigned funcno) {
-        CodeTree newnode;
+        CodeTree<Value_t> newnode;
         newnode.SetFuncOpcode(opcode, funcno);
         size_t stackhead = stack.size() - nparams;
         for (size_t a = 0; a < nparams; ++a)
@@ -264,14 +265,14 @@ public:
         stack.back().swap(newnode);
     }
 
-    void AddConst(double value) {
-        CodeTree newnode(value);
+    void AddConst(Value_t value) {
+        CodeTree<Value_t> newnode(value);
         FindClone(newnode);
         Push(newnode);
     }
 
     void AddVar(unsigned varno) {
-        CodeTree newnode(varno, CodeTree::VarTag());
+        CodeTree<Value_t> newnode(varno, typename CodeTree<Value_t>::VarTag());
         FindClone(newnode);
         Push(newnode);
     }
@@ -303,9 +304,9 @@ public:
         stack.resize(target + 1);
     }
 
-    CodeTree PullResult() {
+    CodeTree<Value_t> PullResult() {
         clones.clear();
-        CodeTree result(stack.back());
+        CodeTree<Value_t> result(stack.back());
         stack.resize(stack.size() - 1);
         return result;
     }
@@ -313,8 +314,8 @@ public:
     size_t GetStackTop() const { return stack.size(); }
 
 private:
-    void FindClone(CodeTree& tree, bool recurse = true) {
-        std::multimap<fphash_t, CodeTree>::const_iterator
+    void FindClone(CodeTree<Value_t>& tree, bool recurse = true) {
+        typename std::multimap<fphash_t, CodeTree<Value_t> >::const_iterator
             i = clones.lower_bound(tree.GetHash());
         for (; i != clones.end() && i->first == tree.GetHash(); ++i) {
             if (i->second.IsIdenticalTo(tree))
@@ -327,26 +328,28 @@ private:
     }
 
 private:
-    std::vector<CodeTree> stack;
-    std::multimap<fphash_t, CodeTree> clones;
+    std::vector<CodeTree<Value_t> > stack;
+    std::multimap<fphash_t, CodeTree<Value_t> > clones;
 
 private:
     CodeTreeParserData(const CodeTreeParserData&);
     CodeTreeParserData& operator=(const CodeTreeParserData&);
 };
 
+template<typename Value_t>
 struct IfInfo {
-    CodeTree condition;
-    CodeTree thenbranch;
+    CodeTree<Value_t> condition;
+    CodeTree<Value_t> thenbranch;
     size_t endif_location;
 };
 
-void CodeTree::GenerateFrom(
+template<typename Value_t>
+void CodeTree<Value_t>::GenerateFrom(
     const std::vector<unsigned>& ByteCode,
-    const std::vector<double>& Immed,
-    const FunctionParser::Data& fpdata) {
-    CodeTreeParserData sim;
-    std::vector<IfInfo> if_stack;
+    const std::vector<Value_t>& Immed,
+    const typename FunctionParserBase<Value_t>::Data& fpdata) {
+    CodeTreeParserData<Value_t> sim;
+    std::vector<IfInfo<Value_t> > if_stack;
 
     for (size_t IP = 0, DP = 0;; ++IP) {
     after_powi:
@@ -554,6 +557,9 @@ void CodeTree::GenerateFrom(
                 sim.PopNMov(stackOffs_target, stackOffs_source);
                 break;
             }
+            case cSelect: // a branchless if
+                sim.Eat(3, cIf);
+                break;
             // Note: cVar should never be encountered in bytecode.
             // Other functions
 #ifndef FP_DISABLE_EVAL
@@ -580,4 +586,14 @@ void CodeTree::GenerateFrom(
 }
 } // namespace FPoptimizer_CodeTree
 
+namespace FPoptimizer_CodeTree {
+#define FP_INSTANTIATE(type)                                         \
+    template void CodeTree<type>::GenerateFrom(                      \
+        const std::vector<unsigned>& ByteCode,                       \
+        const std::vector<type>& Immed,                              \
+        const FunctionParserBase<type>::Data& fpdata);
+FP_INSTANTIATE_OPTIMIZER_TYPES(FP_INSTANTIATE)
+#undef FP_INSTANTIATE
+} // namespace FPoptimizer_CodeTree
+
 #endif
@@ -143,12 +143,14 @@ public:
     }
 };
 
+template<typename Value_t>
 size_t AssembleSequence_Subdivide(
     long count,
     PowiCache& cache,
     const SequenceOpCode& sequencing,
-    ByteCodeSynth& synth);
+    ByteCodeSynth<Value_t>& synth);
 
+template<typename Value_t>
 void Subdivide_Combine(
     size_t apos, long aval,
     size_t bpos, long bval,
@@ -157,7 +159,7 @@ void Subdivide_Combine(
     unsigned cumulation_opcode,
     unsigned cimulation_opcode_flip,
 
-    ByteCodeSynth& synth);
+    ByteCodeSynth<Value_t>& synth);
 
 void PlanNtimesCache(long value,
                      PowiCache& cache,
@@ -197,11 +199,12 @@ void PlanNtimesCache(long value,
     cache.Plan_Has(value);
 }
 
+template<typename Value_t>
 size_t AssembleSequence_Subdivide(
     long value,
     PowiCache& cache,
     const SequenceOpCode& sequencing,
-    ByteCodeSynth& synth) {
+    ByteCodeSynth<Value_t>& synth) {
     int cachepos = cache.Find(value);
     if (cachepos >= 0) {
         // found from the cache
@@ -245,13 +248,14 @@ size_t AssembleSequence_Subdivide(
     return stackpos;
 }
 
+template<typename Value_t>
 void Subdivide_Combine(
     size_t apos, long aval,
     size_t bpos, long bval,
     PowiCache& cache,
     unsigned cumulation_opcode,
     unsigned cumulation_opcode_flip,
-    ByteCodeSynth& synth) {
+    ByteCodeSynth<Value_t>& synth) {
     /*FPO(fprintf(stderr, "== making result for (sp=%u, val=%d, needs=%d) and (sp=%u, val=%d, needs=%d), stacktop=%u\n",
             (unsigned)apos, aval, aval>=0 ? cache_needed[aval] : -1,
             (unsigned)bpos, bval, bval>=0 ? cache_needed[bval] : -1,
@@ -381,10 +385,11 @@ void Subdivide_Combine(
 } // namespace
 
 namespace FPoptimizer_ByteCode {
+template<typename Value_t>
 void AssembleSequence(
     long count,
     const SequenceOpCode& sequencing,
-    ByteCodeSynth& synth) {
+    ByteCodeSynth<Value_t>& synth) {
     if (count == 0)
         synth.PushImmed(sequencing.basevalue);
     else {
@@ -418,4 +423,14 @@ void AssembleSequence(
 }
 } // namespace FPoptimizer_ByteCode
 
+namespace FPoptimizer_ByteCode {
+#define FP_INSTANTIATE(type)                 \
+    template void AssembleSequence<type>(    \
+        long count,                          \
+        const SequenceOpCode& sequencing,    \
+        ByteCodeSynth<type>& synth);
+FP_INSTANTIATE_OPTIMIZER_TYPES(FP_INSTANTIATE)
+#undef FP_INSTANTIATE
+} // namespace FPoptimizer_ByteCode
+
 #endif
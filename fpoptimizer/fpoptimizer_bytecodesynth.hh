@@ -19,10 +19,11 @@
 // line removed
 
 namespace FPoptimizer_ByteCode {
+template<typename Value_t>
 class ByteCodeSynth {
 public:
     ByteCodeSynth()
-        : ByteCode(), Immed(), StackTop(0), StackMax(0) {
+        : ByteCode(), Immed(), StackTop(0), StackMax(0), SelectAllowed(false) {
         /* estimate the initial requirements as such */
         ByteCode.reserve(64);
         Immed.reserve(8);
@@ -30,7 +31,7 @@ public:
     }
 
     void Pull(std::vector<unsigned>& bc,
-              std::vector<double>& imm,
+              std::vector<Value_t>& imm,
               size_t& StackTop_max) {
         ByteCode.swap(bc);
         Immed.swap(imm);
@@ -40,19 +41,23 @@ public:
     size_t GetByteCodeSize() const { return ByteCode.size(); }
     size_t GetStackTop() const { return StackTop; }
 
+    /* Whether cheap if()s may be synthesized as cSelect */
+    void SetSelectAllowed(bool allowed) { SelectAllowed = allowed; }
+    bool IsSelectAllowed() const { return SelectAllowed; }
+
     void PushVar(unsigned varno) {
         ByteCode.push_back(varno);
         SetStackTop(StackTop + 1);
     }
 
-    void PushImmed(double immed) {
+    void PushImmed(Value_t immed) {
         using namespace FUNCTIONPARSERTYPES;
         ByteCode.push_back(cImmed);
         Immed.push_back(immed);
         SetStackTop(StackTop + 1);
     }
 
-    void StackTopIs(const FPoptimizer_CodeTree::CodeTree& hash) {
+    void StackTopIs(const FPoptimizer_CodeTree::CodeTree<Value_t>& hash) {
         if (StackTop > 0) {
             StackHash[StackTop - 1].first = true;
             StackHash[StackTop - 1].second = hash;
@@ -93,7 +98,7 @@ public:
         StackHash[StackTop - 1] = StackHash[src_pos];
     }
 
-    bool FindAndDup(const FPoptimizer_CodeTree::CodeTree& hash) {
+    bool FindAndDup(const FPoptimizer_CodeTree::CodeTree<Value_t>& hash) {
         for (size_t a = StackTop; a-- > 0;) {
             if (StackHash[a].first && StackHash[a].second.IsIdenticalTo(hash)) {
                 DoDup(a);
@@ -144,13 +149,14 @@ private:
 
 private:
     std::vector<unsigned> ByteCode;
-    std::vector<double> Immed;
+    std::vector<Value_t> Immed;
 
     std::vector<
-        std::pair<bool /*known*/, FPoptimizer_CodeTree::CodeTree /*hash*/> >
+        std::pair<bool /*known*/, FPoptimizer_CodeTree::CodeTree<Value_t> /*hash*/> >
         StackHash;
     size_t StackTop;
     size_t StackMax;
+    bool SelectAllowed;
 };
 
 struct SequenceOpCode;
@@ -161,10 +167,11 @@ extern const SequenceOpCode MulSequence; /* Exponentiation implemented with muls
      * last operand in the stack by the given constant integer
      * amount (positive or negative).
      */
+template<typename Value_t>
 void AssembleSequence(
     long count,
     const SequenceOpCode& sequencing,
-    ByteCodeSynth& synth);
+    ByteCodeSynth<Value_t>& synth);
 } // namespace FPoptimizer_ByteCode
 
 #endif
@@ -21,7 +21,8 @@ using namespace FUNCTIONPARSERTYPES;
 //using namespace FPoptimizer_Grammar;
 
 namespace {
-bool MarkIncompletes(FPoptimizer_CodeTree::CodeTree& tree) {
+template<typename Value_t>
+bool MarkIncompletes(FPoptimizer_CodeTree::CodeTree<Value_t>& tree) {
     if (tree.Is_Incompletely_Hashed())
         return true;
 
@@ -33,7 +34,8 @@ bool MarkIncompletes(FPoptimizer_CodeTree::CodeTree& tree) {
     return needs_rehash;
 }
 
-void FixIncompletes(FPoptimizer_CodeTree::CodeTree& tree) {
+template<typename Value_t>
+void FixIncompletes(FPoptimizer_CodeTree::CodeTree<Value_t>& tree) {
     if (tree.Is_Incompletely_Hashed()) {
         for (size_t a = 0; a < tree.GetParamCount(); ++a)
             FixIncompletes(tree.GetParam(a));
@@ -43,38 +45,45 @@ void FixIncompletes(FPoptimizer_CodeTree::CodeTree& tree) {
 } // namespace
 
 namespace FPoptimizer_CodeTree {
-CodeTree::CodeTree()
-    : data(new CodeTreeData) {
+template<typename Value_t>
+CodeTree<Value_t>::CodeTree()
+    : data(new CodeTreeData<Value_t>) {
 }
 
-CodeTree::CodeTree(double i)
-    : data(new CodeTreeData(i)) {
+template<typename Value_t>
+CodeTree<Value_t>::CodeTree(Value_t i)
+    : data(new CodeTreeData<Value_t>(i)) {
     data->Recalculate_Hash_NoRecursion();
 }
 
-CodeTree::CodeTree(unsigned v, CodeTree::VarTag)
-    : data(new CodeTreeData) {
+template<typename Value_t>
+CodeTree<Value_t>::CodeTree(unsigned v, CodeTree::VarTag)
+    : data(new CodeTreeData<Value_t>) {
     data->Opcode = cVar;
     data->Var = v;
     data->Recalculate_Hash_NoRecursion();
 }
 
-CodeTree::CodeTree(const CodeTree& b, CodeTree::CloneTag)
-    : data(new CodeTreeData(*b.data)) {
+template<typename Value_t>
+CodeTree<Value_t>::CodeTree(const CodeTree& b, CodeTree::CloneTag)
+    : data(new CodeTreeData<Value_t>(*b.data)) {
 }
 
-CodeTree::~CodeTree() {
+template<typename Value_t>
+CodeTree<Value_t>::~CodeTree() {
 }
 
+template<typename Value_t>
 struct ParamComparer {
-    bool operator()(const CodeTree& a, const CodeTree& b) const {
+    bool operator()(const CodeTree<Value_t>& a, const CodeTree<Value_t>& b) const {
         if (a.GetDepth() != b.GetDepth())
             return a.GetDepth() > b.GetDepth();
         return a.GetHash() < b.GetHash();
     }
 };
 
-void CodeTreeData::Sort() {
+template<typename Value_t>
+void CodeTreeData<Value_t>::Sort() {
     /* If the tree is commutative, order the parameters
          * in a set order in order to make equality tests
          * efficient in the optimizer
@@ -88,28 +97,28 @@ void CodeTreeData::Sort() {
     case cOr:
     case cEqual:
     case cNEqual:
-        std::sort(Params.begin(), Params.end(), ParamComparer());
+        std::sort(Params.begin(), Params.end(), ParamComparer<Value_t>());
         break;
     case cLess:
-        if (ParamComparer()(Params[1], Params[0])) {
+        if (ParamComparer<Value_t>()(Params[1], Params[0])) {
             std::swap(Params[0], Params[1]);
             Opcode = cGreater;
         }
         break;
     case cLessOrEq:
-        if (ParamComparer()(Params[1], Params[0])) {
+        if (ParamComparer<Value_t>()(Params[1], Params[0])) {
             std::swap(Params[0], Params[1]);
             Opcode = cGreaterOrEq;
         }
         break;
     case cGreater:
-        if (ParamComparer()(Params[1], Params[0])) {
+        if (ParamComparer<Value_t>()(Params[1], Params[0])) {
             std::swap(Params[0], Params[1]);
             Opcode = cLess;
         }
         break;
     case cGreaterOrEq:
-        if (ParamComparer()(Params[1], Params[0])) {
+        if (ParamComparer<Value_t>()(Params[1], Params[0])) {
             std::swap(Params[0], Params[1]);
             Opcode = cLessOrEq;
         }
@@ -119,21 +128,25 @@ void CodeTreeData::Sort() {
     }
 }
 
-void CodeTree::Rehash(bool constantfolding) {
+template<typename Value_t>
+void CodeTree<Value_t>::Rehash(bool constantfolding) {
     if (constantfolding)
         ConstantFolding();
     data->Sort();
     data->Recalculate_Hash_NoRecursion();
 }
 
-void CodeTreeData::Recalculate_Hash_NoRecursion() {
+template<typename Value_t>
+void CodeTreeData<Value_t>::Recalculate_Hash_NoRecursion() {
     fphash_t NewHash = {Opcode * FPHASH_CONST(0x3A83A83A83A83A0),
                         Opcode * FPHASH_CONST(0x1131462E270012B)};
     Depth = 1;
     switch (Opcode) {
     case cImmed:
-        if (Value != 0.0) {
-            crc32_t crc = crc32::calc((const unsigned char*)&Value, sizeof(Value));
+        if (Value != Value_t(0)) {
+            /* Hash a double, because long double has unspecified padding */
+            double hashvalue = double(Value);
+            crc32_t crc = crc32::calc((const unsigned char*)&hashvalue, sizeof(hashvalue));
             NewHash.hash1 ^= crc | (fphash_value_t(crc) << FPHASH_CONST(32));
             NewHash.hash2 += ((~fphash_value_t(crc)) * 3) ^ 1234567;
         }
@@ -173,33 +186,40 @@ void CodeTreeData::Recalculate_Hash_NoRecursion() {
     }
 }
 
-void CodeTree::AddParam(const CodeTree& param) {
+template<typename Value_t>
+void CodeTree<Value_t>::AddParam(const CodeTree& param) {
     //std::cout << "AddParam called\n";
     data->Params.push_back(param);
 }
-void CodeTree::AddParamMove(CodeTree& param) {
+template<typename Value_t>
+void CodeTree<Value_t>::AddParamMove(CodeTree& param) {
     data->Params.push_back(CodeTree());
     data->Params.back().swap(param);
 }
-void CodeTree::SetParam(size_t which, const CodeTree& b) {
+template<typename Value_t>
+void CodeTree<Value_t>::SetParam(size_t which, const CodeTree& b) {
     DataP slot_holder(data->Params[which].data);
     data->Params[which] = b;
 }
-void CodeTree::SetParamMove(size_t which, CodeTree& b) {
+template<typename Value_t>
+void CodeTree<Value_t>::SetParamMove(size_t which, CodeTree& b) {
     DataP slot_holder(data->Params[which].data);
     data->Params[which].swap(b);
 }
 
-void CodeTree::AddParams(const std::vector<CodeTree>& RefParams) {
+template<typename Value_t>
+void CodeTree<Value_t>::AddParams(const std::vector<CodeTree>& RefParams) {
     data->Params.insert(data->Params.end(), RefParams.begin(), RefParams.end());
 }
-void CodeTree::AddParamsMove(std::vector<CodeTree>& RefParams) {
+template<typename Value_t>
+void CodeTree<Value_t>::AddParamsMove(std::vector<CodeTree>& RefParams) {
     size_t endpos = data->Params.size(), added = RefParams.size();
     data->Params.resize(endpos + added, CodeTree());
     for (size_t p = 0; p < added; ++p)
         data->Params[endpos + p].swap(RefParams[p]);
 }
-void CodeTree::AddParamsMove(std::vector<CodeTree>& RefParams, size_t replacing_slot) {
+template<typename Value_t>
+void CodeTree<Value_t>::AddParamsMove(std::vector<CodeTree>& RefParams, size_t replacing_slot) {
     DataP slot_holder(data->Params[replacing_slot].data);
     DelParam(replacing_slot);
     AddParamsMove(RefParams);
@@ -235,25 +255,29 @@ void CodeTree::AddParamsMove(std::vector<CodeTree>& RefParams, size_t replacing_
     */
 }
 
-void CodeTree::SetParams(const std::vector<CodeTree>& RefParams) {
+template<typename Value_t>
+void CodeTree<Value_t>::SetParams(const std::vector<CodeTree>& RefParams) {
     //std::cout << "SetParams called" << (do_clone ? ", clone" : ", no clone") << "\n";
     std::vector<CodeTree> tmp(RefParams);
     data->Params.swap(tmp);
 }
 
-void CodeTree::SetParamsMove(std::vector<CodeTree>& RefParams) {
+template<typename Value_t>
+void CodeTree<Value_t>::SetParamsMove(std::vector<CodeTree>& RefParams) {
     data->Params.swap(RefParams);
     RefParams.clear();
 }
 
 #ifdef __GXX_EXPERIMENTAL_CXX0X__
-void CodeTree::SetParams(std::vector<CodeTree>&& RefParams) {
+template<typename Value_t>
+void CodeTree<Value_t>::SetParams(std::vector<CodeTree>&& RefParams) {
     //std::cout << "SetParams&& called\n";
     SetParamsMove(RefParams);
 }
 #endif
 
-void CodeTree::DelParam(size_t index) {
+template<typename Value_t>
+void CodeTree<Value_t>::DelParam(size_t index) {
     std::vector<CodeTree>& Params = data->Params;
     //std::cout << "DelParam(" << index << ") called\n";
 #ifdef __GXX_EXPERIMENTAL_CXX0X__
@@ -269,12 +293,14 @@ void CodeTree::DelParam(size_t index) {
 #endif
 }
 
-void CodeTree::DelParams() {
+template<typename Value_t>
+void CodeTree<Value_t>::DelParams() {
     data->Params.clear();
 }
 
 /* Is the value of this tree definitely odd(true) or even(false)? */
-CodeTree::TriTruthValue CodeTree::GetEvennessInfo() const {
+template<typename Value_t>
+typename CodeTree<Value_t>::TriTruthValue CodeTree<Value_t>::GetEvennessInfo() const {
     if (!IsImmed())
         return Unknown;
     if (!IsLongIntegerImmed())
@@ -282,10 +308,11 @@ CodeTree::TriTruthValue CodeTree::GetEvennessInfo() const {
     return (GetLongIntegerImmed() & 1) ? IsNever : IsAlways;
 }
 
-bool CodeTree::IsLogicalValue() const {
+template<typename Value_t>
+bool CodeTree<Value_t>::IsLogicalValue() const {
     switch (data->Opcode) {
     case cImmed:
-        return FloatEqual(data->Value, 0.0) || FloatEqual(data->Value, 1.0);
+        return FloatEqual(data->Value, Value_t(0)) || FloatEqual(data->Value, Value_t(1));
     case cAnd:
     case cOr:
     case cNot:
@@ -315,7 +342,8 @@ bool CodeTree::IsLogicalValue() const {
     return false; // Not a logical value.
 }
 
-bool CodeTree::IsAlwaysInteger() const {
+template<typename Value_t>
+bool CodeTree<Value_t>::IsAlwaysInteger() const {
     switch (data->Opcode) {
     case cImmed:
         return IsLongIntegerImmed();
@@ -344,8 +372,9 @@ bool CodeTree::IsAlwaysInteger() const {
     return false; /* Don't know whether it's integer. */
 }
 
-bool CodeTree::IsAlwaysSigned(bool positive) const {
-    MinMaxTree tmp = CalculateResultBoundaries();
+template<typename Value_t>
+bool CodeTree<Value_t>::IsAlwaysSigned(bool positive) const {
+    MinMaxTree<Value_t> tmp = CalculateResultBoundaries();
 
     if (positive)
         return tmp._has_min && tmp._min >= 0.0 && (!tmp._has_max || tmp._max >= 0.0);
@@ -353,7 +382,8 @@ bool CodeTree::IsAlwaysSigned(bool positive) const {
         return tmp._has_max && tmp._max < 0.0 && (!tmp._has_min || tmp._min < 0.0);
 }
 
-bool CodeTree::IsIdenticalTo(const CodeTree& b) const {
+template<typename Value_t>
+bool CodeTree<Value_t>::IsIdenticalTo(const CodeTree& b) const {
     if ((!&*data) != (!&*b.data))
         return false;
     if (&*data == &*b.data)
@@ -361,7 +391,8 @@ bool CodeTree::IsIdenticalTo(const CodeTree& b) const {
     return data->IsIdenticalTo(*b.data);
 }
 
-bool CodeTreeData::IsIdenticalTo(const CodeTreeData& b) const {
+template<typename Value_t>
+bool CodeTreeData<Value_t>::IsIdenticalTo(const CodeTreeData& b) const {
     if (Hash != b.Hash)
         return false; // a quick catch-all
     if (Opcode != b.Opcode)
@@ -388,7 +419,8 @@ bool CodeTreeData::IsIdenticalTo(const CodeTreeData& b) const {
     return true;
 }
 
-void CodeTree::Become(const CodeTree& b) {
+template<typename Value_t>
+void CodeTree<Value_t>::Become(const CodeTree& b) {
     if (&b != this && &*data != &*b.data) {
         DataP tmp = b.data;
         CopyOnWrite();
@@ -396,18 +428,21 @@ void CodeTree::Become(const CodeTree& b) {
     }
 }
 
-void CodeTree::CopyOnWrite() {
+template<typename Value_t>
+void CodeTree<Value_t>::CopyOnWrite() {
     if (data->RefCount > 1)
-        data = new CodeTreeData(*data);
+        data = new CodeTreeData<Value_t>(*data);
 }
 
-CodeTree CodeTree::GetUniqueRef() {
+template<typename Value_t>
+CodeTree<Value_t> CodeTree<Value_t>::GetUniqueRef() {
     if (data->RefCount > 1)
         return CodeTree(*this, CloneTag());
     return *this;
 }
 
-CodeTreeData::CodeTreeData()
+template<typename Value_t>
+CodeTreeData<Value_t>::CodeTreeData()
     : RefCount(0),
       Opcode(),
       Params(),
@@ -416,7 +451,8 @@ CodeTreeData::CodeTreeData()
       OptimizedUsing(0) {
 }
 
-CodeTreeData::CodeTreeData(const CodeTreeData& b)
+template<typename Value_t>
+CodeTreeData<Value_t>::CodeTreeData(const CodeTreeData& b)
     : RefCount(0),
       Opcode(b.Opcode),
       Params(b.Params),
@@ -439,7 +475,8 @@ CodeTreeData::CodeTreeData(const CodeTreeData& b)
 }
 
 #ifdef __GXX_EXPERIMENTAL_CXX0X__
-CodeTreeData::CodeTreeData(CodeTreeData&& b)
+template<typename Value_t>
+CodeTreeData<Value_t>::CodeTreeData(CodeTreeData&& b)
     : RefCount(0),
       Opcode(b.Opcode),
       Params(b.Params),
@@ -456,7 +493,8 @@ CodeTreeData::CodeTreeData(CodeTreeData&& b)
 }
 #endif
 
-CodeTreeData::CodeTreeData(double i)
+template<typename Value_t>
+CodeTreeData<Value_t>::CodeTreeData(Value_t i)
     : RefCount(0),
       Opcode(cImmed),
       Params(),
@@ -466,10 +504,20 @@ CodeTreeData::CodeTreeData(double i)
     Value = i;
 }
 
-void FixIncompleteHashes(CodeTree& tree) {
+template<typename Value_t>
+void FixIncompleteHashes(CodeTree<Value_t>& tree) {
     MarkIncompletes(tree);
     FixIncompletes(tree);
 }
 } // namespace FPoptimizer_CodeTree
 
+namespace FPoptimizer_CodeTree {
+#define FP_INSTANTIATE(type)                                    \
+    template class CodeTree<type>;                              \
+    template struct CodeTreeData<type>;                         \
+    template void FixIncompleteHashes(CodeTree<type>& tree);
+FP_INSTANTIATE_OPTIMIZER_TYPES(FP_INSTANTIATE)
+#undef FP_INSTANTIATE
+} // namespace FPoptimizer_CodeTree
+
 #endif
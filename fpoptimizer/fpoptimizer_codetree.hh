@@ -32,24 +32,34 @@ struct Grammar;
 }
 
 namespace FPoptimizer_ByteCode {
+template<typename Value_t>
 class ByteCodeSynth;
 }
 
+/* The optimizer is instantiated for each value type of FunctionParserBase */
+#define FP_INSTANTIATE_OPTIMIZER_TYPES(f) \
+    f(double) f(float) f(long double)
+
 namespace FPoptimizer_CodeTree {
+template<typename Value_t>
 class CodeTree;
 
+template<typename Value_t>
 struct MinMaxTree {
-    double _min, _max;
+    Value_t _min, _max;
     bool _has_min, _has_max;
     MinMaxTree() : _min(), _max(), _has_min(false), _has_max(false) {}
-    MinMaxTree(double mi, double ma) : _min(mi), _max(ma), _has_min(true), _has_max(true) {}
-    MinMaxTree(bool, double ma) : _min(), _max(ma), _has_min(false), _has_max(true) {}
-    MinMaxTree(double mi, bool) : _min(mi), _max(), _has_min(true), _has_max(false) {}
+    MinMaxTree(Value_t mi, Value_t ma) : _min(mi), _max(ma), _has_min(true), _has_max(true) {}
+    MinMaxTree(bool, Value_t ma) : _min(), _max(ma), _has_min(false), _has_max(true) {}
+    MinMaxTree(Value_t mi, bool) : _min(mi), _max(), _has_min(true), _has_max(false) {}
 };
 
+template<typename Value_t>
 struct CodeTreeData;
+
+template<typename Value_t>
 class CodeTree {
-    typedef FPOPT_autoptr<CodeTreeData> DataP;
+    typedef FPOPT_autoptr<CodeTreeData<Value_t> > DataP;
     DataP data;
 
 public:
@@ -57,7 +67,7 @@ public:
     CodeTree();
     ~CodeTree();
 
-    explicit CodeTree(double v); // produce an immed
+    explicit CodeTree(Value_t v); // produce an immed
     struct VarTag {};
     explicit CodeTree(unsigned varno, VarTag); // produce a var reference
     struct CloneTag {};
@@ -66,14 +76,25 @@ public:
     /* Generates a CodeTree from the given bytecode */
     void GenerateFrom(
         const std::vector<unsigned>& byteCode,
-        const std::vector<double>& immed,
-        const FunctionParser::Data& data);
+        const std::vector<Value_t>& immed,
+        const typename FunctionParserBase<Value_t>::Data& data);
 
     void SynthesizeByteCode(
         std::vector<unsigned>& byteCode,
-        std::vector<double>& immed,
-        size_t& stacktop_max);
-    void SynthesizeByteCode(FPoptimizer_ByteCode::ByteCodeSynth& synth) const;
+        std::vector<Value_t>& immed,
+        size_t& stacktop_max,
+        bool branchlessIfs = false);
+    void SynthesizeByteCode(FPoptimizer_ByteCode::ByteCodeSynth<Value_t>& synth) const;
+
+    /* Synthesizes several trees into one bytecode, which leaves the value
+     * of trees[i] in the stack at outputs[i]. The subtrees common to the
+     * trees are synthesized only once. */
+    static void SynthesizeByteCode(
+        std::vector<CodeTree>& trees,
+        std::vector<unsigned>& byteCode,
+        std::vector<Value_t>& immed,
+        size_t& stacktop_max,
+        std::vector<unsigned>& outputs);
 
     void SetParams(const std::vector<CodeTree>& RefParams);
     void SetParamsMove(std::vector<CodeTree>& RefParams);
@@ -102,20 +123,20 @@ public:
     inline void SetOpcode(FUNCTIONPARSERTYPES::OPCODE o);
     inline void SetFuncOpcode(FUNCTIONPARSERTYPES::OPCODE o, unsigned f);
     inline void SetVar(unsigned v);
-    inline void SetImmed(double v);
+    inline void SetImmed(Value_t v);
     inline FUNCTIONPARSERTYPES::OPCODE GetOpcode() const;
     inline FUNCTIONPARSERTYPES::fphash_t GetHash() const;
     inline const std::vector<CodeTree>& GetParams() const;
     inline std::vector<CodeTree>& GetParams();
     inline size_t GetDepth() const;
-    inline double GetImmed() const;
+    inline Value_t GetImmed() const;
     inline unsigned GetVar() const;
     inline unsigned GetFuncNo() const;
     inline bool IsDefined() const { return (&*data) != 0; }
 
     inline bool IsImmed() const { return GetOpcode() == FUNCTIONPARSERTYPES::cImmed; }
     inline bool IsVar() const { return GetOpcode() == FUNCTIONPARSERTYPES::cVar; }
-    bool IsLongIntegerImmed() const { return IsImmed() && GetImmed() == (double)GetLongIntegerImmed(); }
+    bool IsLongIntegerImmed() const { return IsImmed() && GetImmed() == (Value_t)GetLongIntegerImmed(); }
     long GetLongIntegerImmed() const { return (long)GetImmed(); }
     bool IsLogicalValue() const;
     inline unsigned GetRefCount() const;
@@ -123,8 +144,8 @@ public:
          * of the tree's result. If an estimate cannot be made,
          * has_min/has_max are indicated as false.
          */
-    MinMaxTree CalculateResultBoundaries_do() const;
-    MinMaxTree CalculateResultBoundaries() const;
+    MinMaxTree<Value_t> CalculateResultBoundaries_do() const;
+    MinMaxTree<Value_t> CalculateResultBoundaries() const;
 
     enum TriTruthValue { IsAlways,
                          IsNever,
@@ -156,13 +177,14 @@ public:
     void CopyOnWrite();
 };
 
+template<typename Value_t>
 struct CodeTreeData {
     int RefCount;
 
     /* Describing the codetree node */
     FUNCTIONPARSERTYPES::OPCODE Opcode;
     union {
-        double Value; // In case of cImmed: value of the immed
+        Value_t Value; // In case of cImmed: value of the immed
         unsigned Var; // In case of cVar:   variable number
         unsigned Funcno; // In case of cFCall or cPCall
     };
@@ -184,7 +206,7 @@ struct CodeTreeData {
     //   For cVar,   not used
     //   For cIf:  operand 1 = condition, operand 2 = yes-branch, operand 3 = no-branch
     //   For anything else: the parameters required by the operation/function
-    std::vector<CodeTree> Params;
+    std::vector<CodeTree<Value_t> > Params;
 
     /* Internal operation */
     FUNCTIONPARSERTYPES::fphash_t Hash;
@@ -193,7 +215,7 @@ struct CodeTreeData {
 
     CodeTreeData();
     CodeTreeData(const CodeTreeData& b);
-    explicit CodeTreeData(double i);
+    explicit CodeTreeData(Value_t i);
 #ifdef __GXX_EXPERIMENTAL_CXX0X__
     CodeTreeData(CodeTreeData&& b);
 #endif
@@ -203,36 +225,54 @@ struct CodeTreeData {
     void Recalculate_Hash_NoRecursion();
 };
 
-inline void CodeTree::SetOpcode(FUNCTIONPARSERTYPES::OPCODE o) { data->Opcode = o; }
-inline void CodeTree::SetFuncOpcode(FUNCTIONPARSERTYPES::OPCODE o, unsigned f) {
+template<typename Value_t>
+inline void CodeTree<Value_t>::SetOpcode(FUNCTIONPARSERTYPES::OPCODE o) { data->Opcode = o; }
+template<typename Value_t>
+inline void CodeTree<Value_t>::SetFuncOpcode(FUNCTIONPARSERTYPES::OPCODE o, unsigned f) {
     SetOpcode(o);
     data->Funcno = f;
 }
-inline void CodeTree::SetVar(unsigned v) {
+template<typename Value_t>
+inline void CodeTree<Value_t>::SetVar(unsigned v) {
     SetOpcode(FUNCTIONPARSERTYPES::cVar);
     data->Var = v;
 }
-inline void CodeTree::SetImmed(double v) {
+template<typename Value_t>
+inline void CodeTree<Value_t>::SetImmed(Value_t v) {
     SetOpcode(FUNCTIONPARSERTYPES::cImmed);
     data->Value = v;
 }
-inline FUNCTIONPARSERTYPES::OPCODE CodeTree::GetOpcode() const { return data->Opcode; }
-inline FUNCTIONPARSERTYPES::fphash_t CodeTree::GetHash() const { return data->Hash; }
-inline const std::vector<CodeTree>& CodeTree::GetParams() const { return data->Params; }
-inline std::vector<CodeTree>& CodeTree::GetParams() { return data->Params; }
-inline size_t CodeTree::GetDepth() const { return data->Depth; }
-inline double CodeTree::GetImmed() const { return data->Value; }
-inline unsigned CodeTree::GetVar() const { return data->Var; }
-inline unsigned CodeTree::GetFuncNo() const { return data->Funcno; }
-
-inline const FPoptimizer_Grammar::Grammar* CodeTree::GetOptimizedUsing() const { return data->OptimizedUsing; }
-inline void CodeTree::SetOptimizedUsing(const FPoptimizer_Grammar::Grammar* g) { data->OptimizedUsing = g; }
-inline unsigned CodeTree::GetRefCount() const { return data->RefCount; }
-
-inline void CodeTree::Mark_Incompletely_Hashed() { data->Depth = 0; }
-inline bool CodeTree::Is_Incompletely_Hashed() const { return data->Depth == 0; }
-
-void FixIncompleteHashes(CodeTree& tree);
+template<typename Value_t>
+inline FUNCTIONPARSERTYPES::OPCODE CodeTree<Value_t>::GetOpcode() const { return data->Opcode; }
+template<typename Value_t>
+inline FUNCTIONPARSERTYPES::fphash_t CodeTree<Value_t>::GetHash() const { return data->Hash; }
+template<typename Value_t>
+inline const std::vector<CodeTree<Value_t> >& CodeTree<Value_t>::GetParams() const { return data->Params; }
+template<typename Value_t>
+inline std::vector<CodeTree<Value_t> >& CodeTree<Value_t>::GetParams() { return data->Params; }
+template<typename Value_t>
+inline size_t CodeTree<Value_t>::GetDepth() const { return data->Depth; }
+template<typename Value_t>
+inline Value_t CodeTree<Value_t>::GetImmed() const { return data->Value; }
+template<typename Value_t>
+inline unsigned CodeTree<Value_t>::GetVar() const { return data->Var; }
+template<typename Value_t>
+inline unsigned CodeTree<Value_t>::GetFuncNo() const { return data->Funcno; }
+
+template<typename Value_t>
+inline const FPoptimizer_Grammar::Grammar* CodeTree<Value_t>::GetOptimizedUsing() const { return data->OptimizedUsing; }
+template<typename Value_t>
+inline void CodeTree<Value_t>::SetOptimizedUsing(const FPoptimizer_Grammar::Grammar* g) { data->OptimizedUsing = g; }
+template<typename Value_t>
+inline unsigned CodeTree<Value_t>::GetRefCount() const { return data->RefCount; }
+
+template<typename Value_t>
+inline void CodeTree<Value_t>::Mark_Incompletely_Hashed() { data->Depth = 0; }
+template<typename Value_t>
+inline bool CodeTree<Value_t>::Is_Incompletely_Hashed() const { return data->Depth == 0; }
+
+template<typename Value_t>
+void FixIncompleteHashes(CodeTree<Value_t>& tree);
 } // namespace FPoptimizer_CodeTree
 
 #endif
@@ -30,25 +30,32 @@ static const unsigned MAX_POWI_BYTECODE_LENGTH = 15;
 static const unsigned MAX_POWI_BYTECODE_LENGTH = 999;
 #endif
 static const unsigned MAX_MULI_BYTECODE_LENGTH = 3;
+static const unsigned MAX_SELECT_BRANCH_COST = 12;
 
 namespace {
 using namespace FPoptimizer_CodeTree;
 
+template<typename Value_t>
 bool AssembleSequence(
-    const CodeTree& tree, long count,
+    const CodeTree<Value_t>& tree, long count,
     const FPoptimizer_ByteCode::SequenceOpCode& sequencing,
-    FPoptimizer_ByteCode::ByteCodeSynth& synth,
+    FPoptimizer_ByteCode::ByteCodeSynth<Value_t>& synth,
     size_t max_bytecode_grow_length);
 } // namespace
 
 namespace {
-typedef std::multimap<fphash_t, std::pair<size_t, CodeTree> >
-    TreeCountType;
-typedef std::multimap<fphash_t, CodeTree>
-    DoneTreesType;
-
-void FindTreeCounts(TreeCountType& TreeCounts, const CodeTree& tree) {
-    TreeCountType::iterator i = TreeCounts.lower_bound(tree.GetHash());
+template<typename Value_t>
+class TreeCountType
+    : public std::multimap<fphash_t, std::pair<size_t, CodeTree<Value_t> > > {
+};
+template<typename Value_t>
+class DoneTreesType
+    : public std::multimap<fphash_t, CodeTree<Value_t> > {
+};
+
+template<typename Value_t>
+void FindTreeCounts(TreeCountType<Value_t>& TreeCounts, const CodeTree<Value_t>& tree) {
+    typename TreeCountType<Value_t>::iterator i = TreeCounts.lower_bound(tree.GetHash());
     for (; i != TreeCounts.end() && i->first == tree.GetHash(); ++i) {
         if (tree.IsIdenticalTo(i->second.second)) {
             i->second.first += 1;
@@ -61,30 +68,78 @@ found:
         FindTreeCounts(TreeCounts, tree.GetParam(a));
 }
 
-void RememberRecursivelyHashList(DoneTreesType& hashlist,
-                                 const CodeTree& tree) {
+template<typename Value_t>
+void RememberRecursivelyHashList(DoneTreesType<Value_t>& hashlist,
+                                 const CodeTree<Value_t>& tree) {
     hashlist.insert(std::make_pair(tree.GetHash(), tree));
     for (size_t a = 0; a < tree.GetParamCount(); ++a)
         RememberRecursivelyHashList(hashlist, tree.GetParam(a));
 }
 
-#ifdef DEBUG_SUBSTITUTIONS
-CodeTree* root;
-#endif
+/* The cost of evaluating the tree when its value is not needed, counting
+ * one for each operation. It is above MAX_SELECT_BRANCH_COST if the tree
+ * contains an operation that is expensive or checked for evaluation
+ * errors, which would then be reported for the branch that if() skips.
+ */
+template<typename Value_t>
+unsigned SelectBranchCost(const CodeTree<Value_t>& tree) {
+    switch (tree.GetOpcode()) {
+    case cVar:
+    case cImmed:
+        return 0;
+    case cPow:
+        // Only the integer powers, which are synthesized as multiplications
+        if (!tree.GetParam(1).IsLongIntegerImmed() || tree.GetParam(1).GetLongIntegerImmed() < 0)
+            return MAX_SELECT_BRANCH_COST + 1;
+        break;
+    case cAdd:
+    case cSub:
+    case cRSub:
+    case cMul:
+    case cNeg:
+    case cSqr:
+    case cMin:
+    case cMax:
+    case cAbs:
+    case cFloor:
+    case cCeil:
+    case cInt:
+    case cEqual:
+    case cNEqual:
+    case cLess:
+    case cLessOrEq:
+    case cGreater:
+    case cGreaterOrEq:
+    case cNot:
+    case cNotNot:
+    case cAnd:
+    case cOr:
+    case cIf:
+        break;
+    default:
+        return MAX_SELECT_BRANCH_COST + 1;
+    }
+    unsigned cost = 1;
+    for (size_t a = 0; a < tree.GetParamCount() && cost <= MAX_SELECT_BRANCH_COST; ++a)
+        cost += SelectBranchCost(tree.GetParam(a));
+    return cost;
+}
 
+template<typename Value_t>
 bool IsOptimizableUsingPowi(long immed, long penalty = 0) {
-    FPoptimizer_ByteCode::ByteCodeSynth synth;
-    return AssembleSequence(CodeTree(0, CodeTree::VarTag()),
+    FPoptimizer_ByteCode::ByteCodeSynth<Value_t> synth;
+    return AssembleSequence(CodeTree<Value_t>(0, typename CodeTree<Value_t>::VarTag()),
                             immed,
                             FPoptimizer_ByteCode::MulSequence,
                             synth,
                             MAX_POWI_BYTECODE_LENGTH - penalty);
 }
 
-void ChangeIntoSqrtChain(CodeTree& tree, long sqrt_chain) {
+template<typename Value_t>
+void ChangeIntoSqrtChain(CodeTree<Value_t>& tree, long sqrt_chain) {
     long abs_sqrt_chain = sqrt_chain < 0 ? -sqrt_chain : sqrt_chain;
     while (abs_sqrt_chain > 2) {
-        CodeTree tmp;
+        CodeTree<Value_t> tmp;
         tmp.SetOpcode(cSqrt);
         tmp.AddParamMove(tree.GetParam(0));
         tmp.Rehash();
@@ -95,7 +150,8 @@ void ChangeIntoSqrtChain(CodeTree& tree, long sqrt_chain) {
     tree.SetOpcode(sqrt_chain < 0 ? cRSqrt : cSqrt);
 }
 
-bool RecreateInversionsAndNegations(CodeTree& tree) {
+template<typename Value_t>
+bool RecreateInversionsAndNegations(CodeTree<Value_t>& tree) {
     bool changed = false;
 
     for (size_t a = 0; a < tree.GetParamCount(); ++a)
@@ -111,22 +167,22 @@ bool RecreateInversionsAndNegations(CodeTree& tree) {
     switch (tree.GetOpcode()) // Recreate inversions and negations
     {
     case cMul: {
-        std::vector<CodeTree> div_params;
+        std::vector<CodeTree<Value_t> > div_params;
 
         for (size_t a = tree.GetParamCount(); a-- > 0;) {
-            const CodeTree& powgroup = tree.GetParam(a);
+            const CodeTree<Value_t>& powgroup = tree.GetParam(a);
             if (powgroup.GetOpcode() == cPow && powgroup.GetParam(1).IsImmed()) {
-                const CodeTree& exp_param = powgroup.GetParam(1);
-                double exponent = exp_param.GetImmed();
-                if (FloatEqual(exponent, -1.0)) {
+                const CodeTree<Value_t>& exp_param = powgroup.GetParam(1);
+                Value_t exponent = exp_param.GetImmed();
+                if (FloatEqual(exponent, Value_t(-1))) {
                     tree.CopyOnWrite();
                     div_params.push_back(tree.GetParam(a).GetParam(0));
                     tree.DelParam(a); // delete the pow group
                 } else if (exponent < 0 && IsIntegerConst(exponent)) {
-                    CodeTree edited_powgroup;
+                    CodeTree<Value_t> edited_powgroup;
                     edited_powgroup.SetOpcode(cPow);
                     edited_powgroup.AddParam(powgroup.GetParam(0));
-                    edited_powgroup.AddParam(CodeTree(-exponent));
+                    edited_powgroup.AddParam(CodeTree<Value_t>(-exponent));
                     edited_powgroup.Rehash();
                     div_params.push_back(edited_powgroup);
                     tree.CopyOnWrite();
@@ -137,15 +193,15 @@ bool RecreateInversionsAndNegations(CodeTree& tree) {
         if (!div_params.empty()) {
             changed = true;
 
-            CodeTree divgroup;
+            CodeTree<Value_t> divgroup;
             divgroup.SetOpcode(cMul);
             divgroup.SetParamsMove(div_params);
             divgroup.Rehash(); // will reduce to div_params[0] if only one item
-            CodeTree mulgroup;
+            CodeTree<Value_t> mulgroup;
             mulgroup.SetOpcode(cMul);
             mulgroup.SetParamsMove(tree.GetParams());
             mulgroup.Rehash(); // will reduce to 1.0 if none remained in this cMul
-            if (mulgroup.IsImmed() && FloatEqual(mulgroup.GetImmed(), 1.0)) {
+            if (mulgroup.IsImmed() && FloatEqual(mulgroup.GetImmed(), Value_t(1))) {
                 tree.SetOpcode(cInv);
                 tree.AddParamMove(divgroup);
             } else {
@@ -163,16 +219,16 @@ bool RecreateInversionsAndNegations(CodeTree& tree) {
         break;
     }
     case cAdd: {
-        std::vector<CodeTree> sub_params;
+        std::vector<CodeTree<Value_t> > sub_params;
 
         for (size_t a = tree.GetParamCount(); a-- > 0;)
             if (tree.GetParam(a).GetOpcode() == cMul) {
                 bool is_signed = false; // if the mul group has a -1 constant...
 
-                CodeTree mulgroup = tree.GetParam(a);
+                CodeTree<Value_t> mulgroup = tree.GetParam(a);
 
                 for (size_t b = mulgroup.GetParamCount(); b-- > 0;)
-                    if (mulgroup.GetParam(b).IsImmed() && FloatEqual(mulgroup.GetParam(b).GetImmed(), -1.0)) {
+                    if (mulgroup.GetParam(b).IsImmed() && FloatEqual(mulgroup.GetParam(b).GetImmed(), Value_t(-1))) {
                         mulgroup.CopyOnWrite();
                         mulgroup.DelParam(b);
                         is_signed = !is_signed;
@@ -185,15 +241,15 @@ bool RecreateInversionsAndNegations(CodeTree& tree) {
                 }
             }
         if (!sub_params.empty()) {
-            CodeTree subgroup;
+            CodeTree<Value_t> subgroup;
             subgroup.SetOpcode(cAdd);
             subgroup.SetParamsMove(sub_params);
             subgroup.Rehash(); // will reduce to sub_params[0] if only one item
-            CodeTree addgroup;
+            CodeTree<Value_t> addgroup;
             addgroup.SetOpcode(cAdd);
             addgroup.SetParamsMove(tree.GetParams());
             addgroup.Rehash(); // will reduce to 0.0 if none remained in this cAdd
-            if (addgroup.IsImmed() && FloatEqual(addgroup.GetImmed(), 0.0)) {
+            if (addgroup.IsImmed() && FloatEqual(addgroup.GetImmed(), Value_t(0))) {
                 tree.SetOpcode(cNeg);
                 tree.AddParamMove(subgroup);
             } else {
@@ -216,7 +272,7 @@ bool RecreateInversionsAndNegations(CodeTree& tree) {
                     tree.AddParamMove(addgroup);
                     tree.AddParamMove(subgroup.GetParam(0));
                     for (size_t a = 1; a < subgroup.GetParamCount(); ++a) {
-                        CodeTree innersub;
+                        CodeTree<Value_t> innersub;
                         innersub.SetOpcode(cSub);
                         innersub.SetParamsMove(tree.GetParams());
                         innersub.Rehash(false);
@@ -234,11 +290,11 @@ bool RecreateInversionsAndNegations(CodeTree& tree) {
         break;
     }
     case cPow: {
-        const CodeTree& p0 = tree.GetParam(0);
-        const CodeTree& p1 = tree.GetParam(1);
+        const CodeTree<Value_t>& p0 = tree.GetParam(0);
+        const CodeTree<Value_t>& p1 = tree.GetParam(1);
         if (p1.IsImmed()) {
             if (p1.GetImmed() != 0.0 && !p1.IsLongIntegerImmed()) {
-                double inverse_exponent = 1.0 / p1.GetImmed();
+                Value_t inverse_exponent = 1.0 / p1.GetImmed();
                 if (inverse_exponent >= -16.0 && inverse_exponent <= 16.0 && IsIntegerConst(inverse_exponent)) {
                     long sqrt_chain = (long)inverse_exponent;
                     long abs_sqrt_chain = sqrt_chain < 0 ? -sqrt_chain : sqrt_chain;
@@ -253,22 +309,22 @@ bool RecreateInversionsAndNegations(CodeTree& tree) {
             if (!p1.IsLongIntegerImmed()) {
                 // x^1.5 is sqrt(x^3)
                 for (int sqrt_count = 1; sqrt_count <= 4; ++sqrt_count) {
-                    double with_sqrt_exponent = p1.GetImmed() * (1 << sqrt_count);
+                    Value_t with_sqrt_exponent = p1.GetImmed() * (1 << sqrt_count);
                     if (IsIntegerConst(with_sqrt_exponent)) {
                         long int_sqrt_exponent = (long)with_sqrt_exponent;
                         if (int_sqrt_exponent < 0)
                             int_sqrt_exponent = -int_sqrt_exponent;
-                        if (IsOptimizableUsingPowi(int_sqrt_exponent, sqrt_count)) {
+                        if (IsOptimizableUsingPowi<Value_t>(int_sqrt_exponent, sqrt_count)) {
                             long sqrt_chain = 1 << sqrt_count;
                             if (with_sqrt_exponent < 0) sqrt_chain = -sqrt_chain;
 
-                            CodeTree tmp;
+                            CodeTree<Value_t> tmp;
                             tmp.AddParamMove(tree.GetParam(0));
-                            tmp.AddParam(CodeTree());
+                            tmp.AddParam(CodeTree<Value_t>());
                             ChangeIntoSqrtChain(tmp, sqrt_chain);
                             tmp.Rehash();
                             tree.SetParamMove(0, tmp);
-                            tree.SetParam(1, CodeTree(p1.GetImmed() * (double)sqrt_chain));
+                            tree.SetParam(1, CodeTree<Value_t>(p1.GetImmed() * (Value_t)sqrt_chain));
                             changed = true;
                         }
                         break;
@@ -276,20 +332,20 @@ bool RecreateInversionsAndNegations(CodeTree& tree) {
                 }
             }
         }
-        if (!p1.IsLongIntegerImmed() || !IsOptimizableUsingPowi(p1.GetLongIntegerImmed())) {
+        if (!p1.IsLongIntegerImmed() || !IsOptimizableUsingPowi<Value_t>(p1.GetLongIntegerImmed())) {
             if (p0.IsImmed() && p0.GetImmed() > 0.0) {
                 // Convert into cExp or Exp2.
                 //    x^y = exp(log(x) * y) =
                 //    Can only be done when x is positive, though.
-                double mulvalue = std::log(p0.GetImmed());
+                Value_t mulvalue = std::log(p0.GetImmed());
                 if (mulvalue == 1.0) {
                     // exp(1)^x becomes exp(x)
                     tree.DelParam(0);
                 } else {
                     // exp(4)^x becomes exp(4*x)
-                    CodeTree exponent;
+                    CodeTree<Value_t> exponent;
                     exponent.SetOpcode(cMul);
-                    exponent.AddParam(CodeTree(mulvalue));
+                    exponent.AddParam(CodeTree<Value_t>(mulvalue));
                     exponent.AddParam(p1);
                     exponent.Rehash();
                     tree.SetParamMove(0, exponent);
@@ -301,11 +357,11 @@ bool RecreateInversionsAndNegations(CodeTree& tree) {
                 // x^y can be safely converted into exp(y * log(x))
                 // when y is _not_ integer, because we know that x >= 0.
                 // Otherwise either expression will give a NaN or inf.
-                CodeTree log;
+                CodeTree<Value_t> log;
                 log.SetOpcode(cLog);
                 log.AddParam(p0);
                 log.Rehash();
-                CodeTree exponent;
+                CodeTree<Value_t> exponent;
                 exponent.SetOpcode(cMul);
                 exponent.AddParam(p1);
                 exponent.AddParamMove(log);
@@ -329,82 +385,98 @@ bool RecreateInversionsAndNegations(CodeTree& tree) {
 }
 } // namespace
 
-namespace FPoptimizer_CodeTree {
-void CodeTree::SynthesizeByteCode(
-    std::vector<unsigned>& ByteCode,
-    std::vector<double>& Immed,
-    size_t& stacktop_max) {
+namespace {
+template<typename Value_t>
+void RecreateInversionsAndNegationsFully(CodeTree<Value_t>& tree) {
 #ifdef DEBUG_SUBSTITUTIONS
     std::cout << "Making bytecode for:\n";
-    FPoptimizer_Grammar::DumpTreeWithIndent(*this);
-    root = this;
+    FPoptimizer_Grammar::DumpTreeWithIndent(tree);
 #endif
-    while (RecreateInversionsAndNegations(*this)) {
+    while (RecreateInversionsAndNegations(tree)) {
 #ifdef DEBUG_SUBSTITUTIONS
         std::cout << "One change issued, produced:\n";
-        FPoptimizer_Grammar::DumpTreeWithIndent(*root);
+        FPoptimizer_Grammar::DumpTreeWithIndent(tree);
 #endif
-        FixIncompleteHashes(*this);
+        FixIncompleteHashes(tree);
     }
 #ifdef DEBUG_SUBSTITUTIONS
     std::cout << "After recreating inv/neg:  ";
-    FPoptimizer_Grammar::DumpTree(*this);
+    FPoptimizer_Grammar::DumpTree(tree);
     std::cout << "\n";
 #endif
+}
 
-    FPoptimizer_ByteCode::ByteCodeSynth synth;
-
-    { // begin scope for TreeCounts, AlreadyDoneTrees
-        /* Find common subtrees */
-        TreeCountType TreeCounts;
-        FindTreeCounts(TreeCounts, *this);
-
-        /* Synthesize some of the most common ones */
-        DoneTreesType AlreadyDoneTrees;
-    FindMore:;
-        size_t best_score = 0;
-        TreeCountType::const_iterator synth_it;
-        for (TreeCountType::const_iterator
-                 i = TreeCounts.begin();
-             i != TreeCounts.end();
-             ++i) {
-            const fphash_t& hash = i->first;
-            size_t score = i->second.first;
-            const CodeTree& tree = i->second.second;
-            // It must always occur at least twice
-            if (score < 2) continue;
-            // And it must not be a simple expression
-            if (tree.GetDepth() < 2)
-            CandSkip:
-                continue;
-            // And it must not yet have been synthesized
-            DoneTreesType::const_iterator j = AlreadyDoneTrees.lower_bound(hash);
-            for (; j != AlreadyDoneTrees.end() && j->first == hash; ++j) {
-                if (j->second.IsIdenticalTo(tree))
-                    goto CandSkip;
-            }
-            // Is a candidate.
-            score *= tree.GetDepth();
-            if (score > best_score) {
-                best_score = score;
-                synth_it = i;
-            }
+/* Synthesizes the subtrees which occur more than once in the given trees,
+ * leaving them in the stack for FindAndDup() to find.
+ */
+template<typename Value_t>
+void SynthesizeCommonSubtrees(const CodeTree<Value_t>* trees, size_t count,
+                              FPoptimizer_ByteCode::ByteCodeSynth<Value_t>& synth) {
+    /* Find common subtrees */
+    TreeCountType<Value_t> TreeCounts;
+    for (size_t t = 0; t < count; ++t)
+        FindTreeCounts(TreeCounts, trees[t]);
+
+    /* Synthesize some of the most common ones */
+    DoneTreesType<Value_t> AlreadyDoneTrees;
+FindMore:;
+    size_t best_score = 0;
+    typename TreeCountType<Value_t>::const_iterator synth_it;
+    for (typename TreeCountType<Value_t>::const_iterator
+             i = TreeCounts.begin();
+         i != TreeCounts.end();
+         ++i) {
+        const fphash_t& hash = i->first;
+        size_t score = i->second.first;
+        const CodeTree<Value_t>& tree = i->second.second;
+        // It must always occur at least twice
+        if (score < 2) continue;
+        // And it must not be a simple expression
+        if (tree.GetDepth() < 2)
+        CandSkip:
+            continue;
+        // And it must not yet have been synthesized
+        typename DoneTreesType<Value_t>::const_iterator j = AlreadyDoneTrees.lower_bound(hash);
+        for (; j != AlreadyDoneTrees.end() && j->first == hash; ++j) {
+            if (j->second.IsIdenticalTo(tree))
+                goto CandSkip;
         }
-        if (best_score > 0) {
+        // Is a candidate.
+        score *= tree.GetDepth();
+        if (score > best_score) {
+            best_score = score;
+            synth_it = i;
+        }
+    }
+    if (best_score > 0) {
 #ifdef DEBUG_SUBSTITUTIONS
-            std::cout << "Found Common Subexpression:";
-            FPoptimizer_Grammar::DumpTree(synth_it->second.second);
-            std::cout << "\n";
+        std::cout << "Found Common Subexpression:";
+        FPoptimizer_Grammar::DumpTree(synth_it->second.second);
+        std::cout << "\n";
 #endif
-            /* Synthesize the selected tree */
-            synth_it->second.second.SynthesizeByteCode(synth);
-            /* Add the tree and all its children to the AlreadyDoneTrees list,
-             * to prevent it from being re-synthesized
-             */
-            RememberRecursivelyHashList(AlreadyDoneTrees, synth_it->second.second);
-            goto FindMore;
-        }
-    } // end scope for TreeCounts, AlreadyDoneTrees
+        /* Synthesize the selected tree */
+        synth_it->second.second.SynthesizeByteCode(synth);
+        /* Add the tree and all its children to the AlreadyDoneTrees list,
+         * to prevent it from being re-synthesized
+         */
+        RememberRecursivelyHashList(AlreadyDoneTrees, synth_it->second.second);
+        goto FindMore;
+    }
+}
+} // namespace
+
+namespace FPoptimizer_CodeTree {
+template<typename Value_t>
+void CodeTree<Value_t>::SynthesizeByteCode(
+    std::vector<unsigned>& ByteCode,
+    std::vector<Value_t>& Immed,
+    size_t& stacktop_max,
+    bool branchlessIfs) {
+    RecreateInversionsAndNegationsFully(*this);
+
+    FPoptimizer_ByteCode::ByteCodeSynth<Value_t> synth;
+    synth.SetSelectAllowed(branchlessIfs);
+    SynthesizeCommonSubtrees(this, 1, synth);
 
 #ifdef DEBUG_SUBSTITUTIONS
     std::cout << "Actually synthesizing:\n";
@@ -424,7 +496,33 @@ void CodeTree::SynthesizeByteCode(
     synth.Pull(ByteCode, Immed, stacktop_max);
 }
 
-void CodeTree::SynthesizeByteCode(FPoptimizer_ByteCode::ByteCodeSynth& synth) const {
+template<typename Value_t>
+void CodeTree<Value_t>::SynthesizeByteCode(
+    std::vector<CodeTree>& trees,
+    std::vector<unsigned>& ByteCode,
+    std::vector<Value_t>& Immed,
+    size_t& stacktop_max,
+    std::vector<unsigned>& outputs) {
+    for (size_t t = 0; t < trees.size(); ++t)
+        RecreateInversionsAndNegationsFully(trees[t]);
+
+    FPoptimizer_ByteCode::ByteCodeSynth<Value_t> synth;
+    if (!trees.empty())
+        SynthesizeCommonSubtrees(&trees[0], trees.size(), synth);
+
+    /* Each result stays in the stack while the following ones are
+     * synthesized (which may also dup it or its parts).
+     */
+    outputs.resize(trees.size());
+    for (size_t t = 0; t < trees.size(); ++t) {
+        trees[t].SynthesizeByteCode(synth);
+        outputs[t] = unsigned(synth.GetStackTop() - 1);
+    }
+    synth.Pull(ByteCode, Immed, stacktop_max);
+}
+
+template<typename Value_t>
+void CodeTree<Value_t>::SynthesizeByteCode(FPoptimizer_ByteCode::ByteCodeSynth<Value_t>& synth) const {
     // If the synth can already locate our operand in the stack,
     // never mind synthesizing it again, just dup it.
     if (synth.FindAndDup(*this)) {
@@ -523,6 +621,16 @@ void CodeTree::SynthesizeByteCode(FPoptimizer_ByteCode::ByteCodeSynth& synth) co
         break;
     }
     case cIf: {
+        // If both branches are cheap, evaluating both and selecting
+        // the result is faster than a mispredicted jump.
+        if (synth.IsSelectAllowed() &&
+            SelectBranchCost(GetParam(1)) + SelectBranchCost(GetParam(2)) <= MAX_SELECT_BRANCH_COST) {
+            GetParam(0).SynthesizeByteCode(synth); // expression
+            GetParam(1).SynthesizeByteCode(synth); // true branch
+            GetParam(2).SynthesizeByteCode(synth); // false branch
+            synth.AddOperation(cSelect, 3);
+            break;
+        }
         size_t ofs;
         // If the parameter amount is != 3, we're screwed.
         GetParam(0).SynthesizeByteCode(synth); // expression
@@ -555,13 +663,14 @@ void CodeTree::SynthesizeByteCode(FPoptimizer_ByteCode::ByteCodeSynth& synth) co
 } // namespace FPoptimizer_CodeTree
 
 namespace {
+template<typename Value_t>
 bool AssembleSequence(
-    const CodeTree& tree, long count,
+    const CodeTree<Value_t>& tree, long count,
     const FPoptimizer_ByteCode::SequenceOpCode& sequencing,
-    FPoptimizer_ByteCode::ByteCodeSynth& synth,
+    FPoptimizer_ByteCode::ByteCodeSynth<Value_t>& synth,
     size_t max_bytecode_grow_length) {
     if (count != 0) {
-        FPoptimizer_ByteCode::ByteCodeSynth backup = synth;
+        FPoptimizer_ByteCode::ByteCodeSynth<Value_t> backup = synth;
 
         tree.SynthesizeByteCode(synth);
 
@@ -583,4 +692,23 @@ bool AssembleSequence(
 }
 } // namespace
 
+namespace FPoptimizer_CodeTree {
+#define FP_INSTANTIATE(type)                                                   \
+    template void CodeTree<type>::SynthesizeByteCode(                          \
+        std::vector<unsigned>& ByteCode,                                       \
+        std::vector<type>& Immed,                                              \
+        size_t& stacktop_max,                                                  \
+        bool branchlessIfs);                                                   \
+    template void CodeTree<type>::SynthesizeByteCode(                          \
+        std::vector<CodeTree<type> >& trees,                                   \
+        std::vector<unsigned>& ByteCode,                                       \
+        std::vector<type>& Immed,                                              \
+        size_t& stacktop_max,                                                  \
+        std::vector<unsigned>& outputs);                                       \
+    template void CodeTree<type>::SynthesizeByteCode(                          \
+        FPoptimizer_ByteCode::ByteCodeSynth<type>& synth) const;
+FP_INSTANTIATE_OPTIMIZER_TYPES(FP_INSTANTIATE)
+#undef FP_INSTANTIATE
+} // namespace FPoptimizer_CodeTree
+
 #endif
@@ -30,6 +30,7 @@ using namespace FPoptimizer_CodeTree;
 
 namespace {
 /* For optimizing And, Or */
+template<typename Value_t>
 struct ComparisonSet {
     static const int Lt_Mask = 0x1; // 1=less
     static const int Eq_Mask = 0x2; // 2=equal
@@ -39,13 +40,13 @@ struct ComparisonSet {
     static const int Ge_Mask = 0x6; // 4+2 = Greater or Equal
     static int Swap_Mask(int m) { return (m & Eq_Mask) | ((m & Lt_Mask) ? Gt_Mask : 0) | ((m & Gt_Mask) ? Lt_Mask : 0); }
     struct Comparison {
-        CodeTree a;
-        CodeTree b;
+        CodeTree<Value_t> a;
+        CodeTree<Value_t> b;
         int relationship;
     };
     std::vector<Comparison> relationships;
     struct Item {
-        CodeTree value;
+        CodeTree<Value_t> value;
         bool negated;
     };
     std::vector<Item> plain_set;
@@ -57,7 +58,7 @@ struct ComparisonSet {
         Suboptimal
     };
 
-    RelationshipResult AddItem(const CodeTree& a, bool negated, bool is_or) {
+    RelationshipResult AddItem(const CodeTree<Value_t>& a, bool negated, bool is_or) {
         for (size_t c = 0; c < plain_set.size(); ++c)
             if (plain_set[c].value.IsIdenticalTo(a)) {
                 if (negated != plain_set[c].negated)
@@ -71,7 +72,7 @@ struct ComparisonSet {
         return Ok;
     }
 
-    RelationshipResult AddRelationship(CodeTree a, CodeTree b, int reltype, bool is_or) {
+    RelationshipResult AddRelationship(CodeTree<Value_t> a, CodeTree<Value_t> b, int reltype, bool is_or) {
         if (is_or) {
             if (reltype == 7)
                 return BecomeOne;
@@ -109,27 +110,28 @@ struct ComparisonSet {
         return Ok;
     }
 
-    RelationshipResult AddAndRelationship(CodeTree a, CodeTree b, int reltype) {
+    RelationshipResult AddAndRelationship(CodeTree<Value_t> a, CodeTree<Value_t> b, int reltype) {
         return AddRelationship(a, b, reltype, false);
     }
 
-    RelationshipResult AddOrRelationship(CodeTree a, CodeTree b, int reltype) {
+    RelationshipResult AddOrRelationship(CodeTree<Value_t> a, CodeTree<Value_t> b, int reltype) {
         return AddRelationship(a, b, reltype, true);
     }
 };
 
 /* For optimizing Add,  Mul */
+template<typename Value_t>
 struct CollectionSet {
     struct Collection {
-        CodeTree value;
-        CodeTree factor;
+        CodeTree<Value_t> value;
+        CodeTree<Value_t> factor;
         bool factor_needs_rehashing;
 
         Collection()
             : value(),
               factor(),
               factor_needs_rehashing(false) {}
-        Collection(const CodeTree& v, const CodeTree& f)
+        Collection(const CodeTree<Value_t>& v, const CodeTree<Value_t>& f)
             : value(v),
               factor(f),
               factor_needs_rehashing(false) {}
@@ -141,9 +143,9 @@ struct CollectionSet {
         Suboptimal
     };
 
-    typedef std::multimap<fphash_t, Collection>::iterator PositionType;
+    typedef typename std::multimap<fphash_t, Collection>::iterator PositionType;
 
-    PositionType FindIdenticalValueTo(const CodeTree& value) {
+    PositionType FindIdenticalValueTo(const CodeTree<Value_t>& value) {
         fphash_t hash = value.GetHash();
         for (PositionType i = collections.lower_bound(hash); i != collections.end() && i->first == hash; ++i) {
             if (value.IsIdenticalTo(i->second.value))
@@ -153,12 +155,12 @@ struct CollectionSet {
     }
     bool Found(const PositionType& b) { return b != collections.end(); }
 
-    CollectionResult AddCollectionTo(const CodeTree& factor, const PositionType& into_which) {
+    CollectionResult AddCollectionTo(const CodeTree<Value_t>& factor, const PositionType& into_which) {
         Collection& c = into_which->second;
         if (c.factor_needs_rehashing)
             c.factor.AddParam(factor);
         else {
-            CodeTree add;
+            CodeTree<Value_t> add;
             add.SetOpcode(cAdd);
             add.AddParamMove(c.factor);
             add.AddParam(factor);
@@ -168,7 +170,7 @@ struct CollectionSet {
         return Suboptimal;
     }
 
-    CollectionResult AddCollection(const CodeTree& value, const CodeTree& factor) {
+    CollectionResult AddCollection(const CodeTree<Value_t>& value, const CodeTree<Value_t>& factor) {
         const fphash_t hash = value.GetHash();
         PositionType i = collections.lower_bound(hash);
         for (; i != collections.end() && i->first == hash; ++i) {
@@ -181,8 +183,8 @@ struct CollectionSet {
         return Ok;
     }
 
-    CollectionResult AddCollection(const CodeTree& a) {
-        return AddCollection(a, CodeTree(1.0));
+    CollectionResult AddCollection(const CodeTree<Value_t>& a) {
+        return AddCollection(a, CodeTree<Value_t>(1.0));
     }
 };
 
@@ -209,25 +211,27 @@ struct Select1st {
     }
 };
 
-bool IsEvenIntegerConst(double v) {
+template<typename Value_t>
+bool IsEvenIntegerConst(Value_t v) {
     return IsIntegerConst(v) && ((long)v % 2) == 0;
 }
 
+template<typename Value_t>
 struct ConstantExponentCollection {
-    typedef std::pair<double, std::vector<CodeTree> > ExponentInfo;
+    typedef std::pair<Value_t, std::vector<CodeTree<Value_t> > > ExponentInfo;
     std::vector<ExponentInfo> data;
 
-    void MoveToSet_Unique(double exponent, std::vector<CodeTree>& source_set) {
-        data.push_back(std::pair<double, std::vector<CodeTree> >(exponent, std::vector<CodeTree>()));
+    void MoveToSet_Unique(Value_t exponent, std::vector<CodeTree<Value_t> >& source_set) {
+        data.push_back(std::pair<Value_t, std::vector<CodeTree<Value_t> > >(exponent, std::vector<CodeTree<Value_t> >()));
         data.back().second.swap(source_set);
     }
-    void MoveToSet_NonUnique(double exponent, std::vector<CodeTree>& source_set) {
-        std::vector<ExponentInfo>::iterator i = std::lower_bound(data.begin(), data.end(), exponent, Select1st());
+    void MoveToSet_NonUnique(Value_t exponent, std::vector<CodeTree<Value_t> >& source_set) {
+        typename std::vector<ExponentInfo>::iterator i = std::lower_bound(data.begin(), data.end(), exponent, Select1st());
         if (i != data.end() && i->first == exponent) {
             i->second.insert(i->second.end(), source_set.begin(), source_set.end());
         } else {
             //MoveToSet_Unique(exponent, source_set);
-            data.insert(i, std::pair<double, std::vector<CodeTree> >(exponent, source_set));
+            data.insert(i, std::pair<Value_t, std::vector<CodeTree<Value_t> > >(exponent, source_set));
         }
     }
 
@@ -268,15 +272,15 @@ struct ConstantExponentCollection {
              *       but this is wrong, for it falsely includes x^evenint.. twice.
              */
         for (size_t a = 0; a < data.size(); ++a) {
-            double exp_a = data[a].first;
-            if (FloatEqual(exp_a, 1.0))
+            Value_t exp_a = data[a].first;
+            if (FloatEqual(exp_a, Value_t(1)))
                 continue;
             for (size_t b = a + 1; b < data.size(); ++b) {
-                double exp_b = data[b].first;
-                double exp_diff = exp_b - exp_a;
-                if (exp_diff >= fabs(exp_a))
+                Value_t exp_b = data[b].first;
+                Value_t exp_diff = exp_b - exp_a;
+                if (exp_diff >= std::fabs(exp_a))
                     break;
-                double exp_diff_still_probable_integer = exp_diff * 16.0;
+                Value_t exp_diff_still_probable_integer = exp_diff * 16.0;
                 if (IsIntegerConst(exp_diff_still_probable_integer) && !(IsIntegerConst(exp_b) && !IsIntegerConst(exp_diff))) {
                     /* When input is x^3 * z^2,
                          * exp_a = 2
@@ -285,8 +289,8 @@ struct ConstantExponentCollection {
                          * b_set = x
                          * exp_diff = 3-2 = 1
                          */
-                    std::vector<CodeTree>& a_set = data[a].second;
-                    std::vector<CodeTree>& b_set = data[b].second;
+                    std::vector<CodeTree<Value_t> >& a_set = data[a].second;
+                    std::vector<CodeTree<Value_t> >& b_set = data[b].second;
 #ifdef DEBUG_SUBSTITUTIONS
                     std::cout << "Before ConstantExponentCollection iteration:\n";
                     Dump(std::cout);
@@ -294,11 +298,11 @@ struct ConstantExponentCollection {
                     if (IsIntegerConst(exp_b) && IsEvenIntegerConst(exp_b)
                         //&& !IsEvenIntegerConst(exp_diff)
                         && !IsEvenIntegerConst(exp_diff + exp_a)) {
-                        CodeTree tmp2;
+                        CodeTree<Value_t> tmp2;
                         tmp2.SetOpcode(cMul);
                         tmp2.SetParamsMove(b_set);
                         tmp2.Rehash();
-                        CodeTree tmp;
+                        CodeTree<Value_t> tmp;
                         tmp.SetOpcode(cAbs);
                         tmp.AddParamMove(tmp2);
                         tmp.Rehash();
@@ -308,7 +312,7 @@ struct ConstantExponentCollection {
 
                     a_set.insert(a_set.end(), b_set.begin(), b_set.end());
 
-                    std::vector<CodeTree> b_copy = b_set;
+                    std::vector<CodeTree<Value_t> > b_copy = b_set;
                     data.erase(data.begin() + b);
                     MoveToSet_NonUnique(exp_diff, b_copy);
                     changed = true;
@@ -341,7 +345,8 @@ struct ConstantExponentCollection {
 } // namespace
 
 namespace FPoptimizer_CodeTree {
-void CodeTree::ConstantFolding_FromLogicalParent() {
+template<typename Value_t>
+void CodeTree<Value_t>::ConstantFolding_FromLogicalParent() {
 redo:;
     switch (GetOpcode()) {
     case cNotNot:
@@ -364,30 +369,31 @@ redo:;
     }
 }
 
-bool CodeTree::ConstantFolding_LogicCommon(bool is_or) {
+template<typename Value_t>
+bool CodeTree<Value_t>::ConstantFolding_LogicCommon(bool is_or) {
     bool should_regenerate = false;
-    ComparisonSet comp;
+    ComparisonSet<Value_t> comp;
     for (size_t a = 0; a < GetParamCount(); ++a) {
-        ComparisonSet::RelationshipResult change = ComparisonSet::Ok;
+        typename ComparisonSet<Value_t>::RelationshipResult change = ComparisonSet<Value_t>::Ok;
         const CodeTree& atree = GetParam(a);
         switch (atree.GetOpcode()) {
         case cEqual:
-            change = comp.AddRelationship(atree.GetParam(0), atree.GetParam(1), ComparisonSet::Eq_Mask, is_or);
+            change = comp.AddRelationship(atree.GetParam(0), atree.GetParam(1), ComparisonSet<Value_t>::Eq_Mask, is_or);
             break;
         case cNEqual:
-            change = comp.AddRelationship(atree.GetParam(0), atree.GetParam(1), ComparisonSet::Ne_Mask, is_or);
+            change = comp.AddRelationship(atree.GetParam(0), atree.GetParam(1), ComparisonSet<Value_t>::Ne_Mask, is_or);
             break;
         case cLess:
-            change = comp.AddRelationship(atree.GetParam(0), atree.GetParam(1), ComparisonSet::Lt_Mask, is_or);
+            change = comp.AddRelationship(atree.GetParam(0), atree.GetParam(1), ComparisonSet<Value_t>::Lt_Mask, is_or);
             break;
         case cLessOrEq:
-            change = comp.AddRelationship(atree.GetParam(0), atree.GetParam(1), ComparisonSet::Le_Mask, is_or);
+            change = comp.AddRelationship(atree.GetParam(0), atree.GetParam(1), ComparisonSet<Value_t>::Le_Mask, is_or);
             break;
         case cGreater:
-            change = comp.AddRelationship(atree.GetParam(0), atree.GetParam(1), ComparisonSet::Gt_Mask, is_or);
+            change = comp.AddRelationship(atree.GetParam(0), atree.GetParam(1), ComparisonSet<Value_t>::Gt_Mask, is_or);
             break;
         case cGreaterOrEq:
-            change = comp.AddRelationship(atree.GetParam(0), atree.GetParam(1), ComparisonSet::Ge_Mask, is_or);
+            change = comp.AddRelationship(atree.GetParam(0), atree.GetParam(1), ComparisonSet<Value_t>::Ge_Mask, is_or);
             break;
         case cNot:
             change = comp.AddItem(atree.GetParam(0), true, is_or);
@@ -397,18 +403,18 @@ bool CodeTree::ConstantFolding_LogicCommon(bool is_or) {
         }
         switch (change) {
         ReplaceTreeWithZero:
-            data = new CodeTreeData(0.0);
+            data = new CodeTreeData<Value_t>(0.0);
             return true;
         ReplaceTreeWithOne:
-            data = new CodeTreeData(1.0);
+            data = new CodeTreeData<Value_t>(1.0);
             return true;
-        case ComparisonSet::Ok: // ok
+        case ComparisonSet<Value_t>::Ok: // ok
             break;
-        case ComparisonSet::BecomeZero: // whole set was invalidated
+        case ComparisonSet<Value_t>::BecomeZero: // whole set was invalidated
             goto ReplaceTreeWithZero;
-        case ComparisonSet::BecomeOne: // whole set was validated
+        case ComparisonSet<Value_t>::BecomeOne: // whole set was validated
             goto ReplaceTreeWithOne;
-        case ComparisonSet::Suboptimal: // something was changed
+        case ComparisonSet<Value_t>::Suboptimal: // something was changed
             should_regenerate = true;
             break;
         }
@@ -434,22 +440,22 @@ bool CodeTree::ConstantFolding_LogicCommon(bool is_or) {
             CodeTree r;
             r.SetOpcode(cAtan2);
             switch (comp.relationships[a].relationship) {
-            case ComparisonSet::Lt_Mask:
+            case ComparisonSet<Value_t>::Lt_Mask:
                 r.SetOpcode(cLess);
                 break;
-            case ComparisonSet::Eq_Mask:
+            case ComparisonSet<Value_t>::Eq_Mask:
                 r.SetOpcode(cEqual);
                 break;
-            case ComparisonSet::Gt_Mask:
+            case ComparisonSet<Value_t>::Gt_Mask:
                 r.SetOpcode(cGreater);
                 break;
-            case ComparisonSet::Le_Mask:
+            case ComparisonSet<Value_t>::Le_Mask:
                 r.SetOpcode(cLessOrEq);
                 break;
-            case ComparisonSet::Ne_Mask:
+            case ComparisonSet<Value_t>::Ne_Mask:
                 r.SetOpcode(cNEqual);
                 break;
-            case ComparisonSet::Ge_Mask:
+            case ComparisonSet<Value_t>::Ge_Mask:
                 r.SetOpcode(cGreaterOrEq);
                 break;
             }
@@ -473,50 +479,54 @@ bool CodeTree::ConstantFolding_LogicCommon(bool is_or) {
     return false;
 }
 
-bool CodeTree::ConstantFolding_AndLogic() {
+template<typename Value_t>
+bool CodeTree<Value_t>::ConstantFolding_AndLogic() {
     return ConstantFolding_LogicCommon(false);
 }
-bool CodeTree::ConstantFolding_OrLogic() {
+template<typename Value_t>
+bool CodeTree<Value_t>::ConstantFolding_OrLogic() {
     return ConstantFolding_LogicCommon(true);
 }
 
-static CodeTree CollectMulGroup_Item(
-    CodeTree& value,
+template<typename Value_t>
+static CodeTree<Value_t> CollectMulGroup_Item(
+    CodeTree<Value_t>& value,
     bool& has_highlevel_opcodes) {
     switch (value.GetOpcode()) {
     case cPow: {
-        CodeTree exponent = value.GetParam(1);
+        CodeTree<Value_t> exponent = value.GetParam(1);
         value.Become(value.GetParam(0));
         return exponent;
     }
     case cSqrt:
         value.Become(value.GetParam(0));
         has_highlevel_opcodes = true;
-        return CodeTree(0.5);
+        return CodeTree<Value_t>(0.5);
     case cRSqrt:
         value.Become(value.GetParam(0));
         has_highlevel_opcodes = true;
-        return CodeTree(-0.5);
+        return CodeTree<Value_t>(-0.5);
     case cInv:
         value.Become(value.GetParam(0));
         has_highlevel_opcodes = true;
-        return CodeTree(-1.0);
+        return CodeTree<Value_t>(-1.0);
     default: break;
     }
-    return CodeTree(1.0);
+    return CodeTree<Value_t>(1.0);
 }
 
+template<typename Value_t>
 static void CollectMulGroup(
-    CollectionSet& mul, const CodeTree& tree, const CodeTree& factor,
+    CollectionSet<Value_t>& mul, const CodeTree<Value_t>& tree, const CodeTree<Value_t>& factor,
     bool& should_regenerate,
     bool& has_highlevel_opcodes) {
     for (size_t a = 0; a < tree.GetParamCount(); ++a) {
-        CodeTree value(tree.GetParam(a));
+        CodeTree<Value_t> value(tree.GetParam(a));
 
-        CodeTree exponent(CollectMulGroup_Item(value, has_highlevel_opcodes));
+        CodeTree<Value_t> exponent(CollectMulGroup_Item(value, has_highlevel_opcodes));
 
         if (!factor.IsImmed() || factor.GetImmed() != 1.0) {
-            CodeTree new_exp;
+            CodeTree<Value_t> new_exp;
             new_exp.SetOpcode(cMul);
             new_exp.AddParam(exponent);
             new_exp.AddParam(factor);
@@ -537,12 +547,12 @@ static void CollectMulGroup(
                     for(size_t b=0; b<value.GetParamCount(); ++b)
                     {
                         bool tmp=false;
-                        CodeTree val(value.GetParam(b));
-                        CodeTree exp(CollectMulGroup_Item(val, tmp));
+                        CodeTree<Value_t> val(value.GetParam(b));
+                        CodeTree<Value_t> exp(CollectMulGroup_Item(val, tmp));
                         if(exponent_is_even
                         || (exp.IsImmed() && IsEvenIntegerConst(exp.GetImmed())))
                         {
-                            CodeTree new_exp;
+                            CodeTree<Value_t> new_exp;
                             new_exp.SetOpcode(cMul);
                             new_exp.AddParam(exponent);
                             new_exp.AddParamMove(exp);
@@ -561,16 +571,17 @@ static void CollectMulGroup(
             else cannot_adopt_mul:
 #endif
         {
-            if (mul.AddCollection(value, exponent) == CollectionSet::Suboptimal)
+            if (mul.AddCollection(value, exponent) == CollectionSet<Value_t>::Suboptimal)
                 should_regenerate = true;
         }
     }
 }
 
-bool CodeTree::ConstantFolding_MulGrouping() {
+template<typename Value_t>
+bool CodeTree<Value_t>::ConstantFolding_MulGrouping() {
     bool has_highlevel_opcodes = false;
     bool should_regenerate = false;
-    CollectionSet mul;
+    CollectionSet<Value_t> mul;
 
     CollectMulGroup(mul, *this, CodeTree(1.0),
                     should_regenerate,
@@ -585,16 +596,16 @@ bool CodeTree::ConstantFolding_MulGrouping() {
         exponent_map;
     exponent_map by_exponent;
 
-    for (CollectionSet::PositionType j = mul.collections.begin(); j != mul.collections.end(); ++j) {
+    for (typename CollectionSet<Value_t>::PositionType j = mul.collections.begin(); j != mul.collections.end(); ++j) {
         CodeTree& value = j->second.value;
         CodeTree& exponent = j->second.factor;
         if (j->second.factor_needs_rehashing) exponent.Rehash();
         const fphash_t exponent_hash = exponent.GetHash();
 
-        exponent_map::iterator i = by_exponent.lower_bound(exponent_hash);
+        typename exponent_map::iterator i = by_exponent.lower_bound(exponent_hash);
         for (; i != by_exponent.end() && i->first == exponent_hash; ++i)
             if (i->second.first.IsIdenticalTo(exponent)) {
-                if (!exponent.IsImmed() || !FloatEqual(exponent.GetImmed(), 1.0))
+                if (!exponent.IsImmed() || !FloatEqual(exponent.GetImmed(), Value_t(1)))
                     should_regenerate = true;
                 i->second.second.push_back(value);
                 goto skip_b;
@@ -606,13 +617,13 @@ bool CodeTree::ConstantFolding_MulGrouping() {
     }
 
 #ifdef FP_MUL_COMBINE_EXPONENTS
-    ConstantExponentCollection by_float_exponent;
-    for (exponent_map::iterator j, i = by_exponent.begin(); i != by_exponent.end(); i = j) {
+    ConstantExponentCollection<Value_t> by_float_exponent;
+    for (typename exponent_map::iterator j, i = by_exponent.begin(); i != by_exponent.end(); i = j) {
         j = i;
         ++j;
         exponent_list& list = i->second;
         if (list.first.IsImmed()) {
-            double exponent = list.first.GetImmed();
+            Value_t exponent = list.first.GetImmed();
             if (!(exponent == 0.0))
                 by_float_exponent.MoveToSet_Unique(exponent, list.second);
             by_exponent.erase(i);
@@ -635,16 +646,16 @@ bool CodeTree::ConstantFolding_MulGrouping() {
 
         /* Group by exponents */
         /* First handle non-constant exponents */
-        for (exponent_map::iterator
+        for (typename exponent_map::iterator
                  i = by_exponent.begin();
              i != by_exponent.end();
              ++i) {
             exponent_list& list = i->second;
 #ifndef FP_MUL_COMBINE_EXPONENTS
             if (list.first.IsImmed()) {
-                double exponent = list.first.GetImmed();
+                Value_t exponent = list.first.GetImmed();
                 if (exponent == 0.0) continue;
-                if (FloatEqual(exponent, 1.0)) {
+                if (FloatEqual(exponent, Value_t(1))) {
                     AddParamsMove(list.second);
                     continue;
                 }
@@ -692,8 +703,8 @@ bool CodeTree::ConstantFolding_MulGrouping() {
         by_exponent.clear();
         /* Then handle constant exponents */
         for (size_t a = 0; a < by_float_exponent.data.size(); ++a) {
-            double exponent = by_float_exponent.data[a].first;
-            if (FloatEqual(exponent, 1.0)) {
+            Value_t exponent = by_float_exponent.data[a].first;
+            if (FloatEqual(exponent, Value_t(1))) {
                 AddParamsMove(by_float_exponent.data[a].second);
                 continue;
             }
@@ -720,13 +731,14 @@ bool CodeTree::ConstantFolding_MulGrouping() {
     return false;
 }
 
-bool CodeTree::ConstantFolding_AddGrouping() {
+template<typename Value_t>
+bool CodeTree<Value_t>::ConstantFolding_AddGrouping() {
     bool should_regenerate = false;
-    CollectionSet add;
+    CollectionSet<Value_t> add;
     for (size_t a = 0; a < GetParamCount(); ++a) {
         if (GetParam(a).GetOpcode() == cMul)
             continue;
-        if (add.AddCollection(GetParam(a)) == CollectionSet::Suboptimal)
+        if (add.AddCollection(GetParam(a)) == CollectionSet<Value_t>::Suboptimal)
             should_regenerate = true;
         // This catches x + x and x - x
     }
@@ -745,7 +757,7 @@ bool CodeTree::ConstantFolding_AddGrouping() {
             for (size_t b = 0; b < mulgroup.GetParamCount(); ++b) {
                 if (mulgroup.GetParam(b).IsImmed())
                     continue;
-                CollectionSet::PositionType c = add.FindIdenticalValueTo(mulgroup.GetParam(b));
+                typename CollectionSet<Value_t>::PositionType c = add.FindIdenticalValueTo(mulgroup.GetParam(b));
                 if (add.Found(c)) {
                     CodeTree tmp(mulgroup, CodeTree::CloneTag());
                     tmp.DelParam(b);
@@ -837,7 +849,7 @@ bool CodeTree::ConstantFolding_AddGrouping() {
         // all remaining mul-groups.
         for (size_t a = 0; a < GetParamCount(); ++a)
             if (remaining[a]) {
-                if (add.AddCollection(GetParam(a)) == CollectionSet::Suboptimal)
+                if (add.AddCollection(GetParam(a)) == CollectionSet<Value_t>::Suboptimal)
                     should_regenerate = true;
             }
     }
@@ -850,7 +862,7 @@ bool CodeTree::ConstantFolding_AddGrouping() {
 #endif
         DelParams();
 
-        for (CollectionSet::PositionType j = add.collections.begin(); j != add.collections.end(); ++j) {
+        for (typename CollectionSet<Value_t>::PositionType j = add.collections.begin(); j != add.collections.end(); ++j) {
             CodeTree& value = j->second.value;
             CodeTree& coeff = j->second.factor;
             if (j->second.factor_needs_rehashing)
@@ -859,7 +871,7 @@ bool CodeTree::ConstantFolding_AddGrouping() {
             if (coeff.IsImmed()) {
                 if (coeff.GetImmed() == 0.0)
                     continue;
-                if (FloatEqual(coeff.GetImmed(), 1.0)) {
+                if (FloatEqual(coeff.GetImmed(), Value_t(1))) {
                     AddParamMove(value);
                     continue;
                 }
@@ -881,7 +893,8 @@ bool CodeTree::ConstantFolding_AddGrouping() {
     return false;
 }
 
-bool CodeTree::ConstantFolding_Assimilate() {
+template<typename Value_t>
+bool CodeTree<Value_t>::ConstantFolding_Assimilate() {
     /* If the list contains another list of the same kind, assimilate it */
     bool assimilated = false;
     for (size_t a = GetParamCount(); a-- > 0;)
@@ -907,7 +920,8 @@ bool CodeTree::ConstantFolding_Assimilate() {
     return assimilated;
 }
 
-void CodeTree::ConstantFolding() {
+template<typename Value_t>
+void CodeTree<Value_t>::ConstantFolding() {
 #ifdef DEBUG_SUBSTITUTIONS
     std::cout << "Runs ConstantFolding for: ";
     FPoptimizer_Grammar::DumpTree(*this);
@@ -920,11 +934,11 @@ redo:;
     // that you want to be done whenever a new subtree is generated.
     /* Not recursive. */
 
-    double const_value = 1.0;
+    Value_t const_value = 1.0;
     size_t which_param = 0;
 
     if (GetOpcode() != cImmed) {
-        MinMaxTree p = CalculateResultBoundaries();
+        MinMaxTree<Value_t> p = CalculateResultBoundaries();
         if (p._has_min && p._has_max && p._min == p._max) {
             // Replace us with this immed
             const_value = p._min;
@@ -950,7 +964,7 @@ redo:;
         FPoptimizer_Grammar::DumpTree(*this);
         std::cout << " with const value " << const_value << "\n";
 #endif
-        data = new CodeTreeData(const_value);
+        data = new CodeTreeData<Value_t>(const_value);
         break;
     ReplaceTreeWithParam0:
         which_param = 0;
@@ -978,7 +992,7 @@ redo:;
         // the whole list evaluates to one.
         bool all_values_are_nonzero = true;
         for (size_t a = 0; a < GetParamCount(); ++a) {
-            MinMaxTree p = GetParam(a).CalculateResultBoundaries();
+            MinMaxTree<Value_t> p = GetParam(a).CalculateResultBoundaries();
             if (p._has_min && p._has_max && p._min > -0.5 && p._max < 0.5) // -0.5 < x < 0.5 = zero
             {
                 goto ReplaceTreeWithZero;
@@ -1010,7 +1024,7 @@ redo:;
         // the whole list evaluates to zero.
         bool all_values_are_zero = true;
         for (size_t a = 0; a < GetParamCount(); ++a) {
-            MinMaxTree p = GetParam(a).CalculateResultBoundaries();
+            MinMaxTree<Value_t> p = GetParam(a).CalculateResultBoundaries();
             if (p._has_min && p._has_max && p._min > -0.5 && p._max < 0.5) // -0.5 < x < 0.5 = zero
             {
             } else if ((p._has_max && p._max <= -0.5) || (p._has_min && p._min >= 0.5)) // |x| >= 0.5  = nonzero
@@ -1069,7 +1083,7 @@ redo:;
 
         // If the sub-expression evaluates to approx. zero, yield one.
         // If the sub-expression evaluates to approx. nonzero, yield zero.
-        MinMaxTree p = GetParam(0).CalculateResultBoundaries();
+        MinMaxTree<Value_t> p = GetParam(0).CalculateResultBoundaries();
         if (p._has_min && p._has_max && p._min > -0.5 && p._max < 0.5) // -0.5 < x < 0.5 = zero
         {
             goto ReplaceTreeWithOne;
@@ -1086,7 +1100,7 @@ redo:;
 
         // If the sub-expression evaluates to approx. zero, yield zero.
         // If the sub-expression evaluates to approx. nonzero, yield one.
-        MinMaxTree p = GetParam(0).CalculateResultBoundaries();
+        MinMaxTree<Value_t> p = GetParam(0).CalculateResultBoundaries();
         if (p._has_min && p._has_max && p._min > -0.5 && p._max < 0.5) // -0.5 < x < 0.5 = zero
         {
             goto ReplaceTreeWithZero;
@@ -1104,7 +1118,7 @@ redo:;
 
         // If the sub-expression evaluates to approx. zero, yield param3.
         // If the sub-expression evaluates to approx. nonzero, yield param2.
-        MinMaxTree p = GetParam(0).CalculateResultBoundaries();
+        MinMaxTree<Value_t> p = GetParam(0).CalculateResultBoundaries();
         if (p._has_min && p._has_max && p._min > -0.5 && p._max < 0.5) // -0.5 < x < 0.5 = zero
         {
             which_param = 2;
@@ -1120,21 +1134,21 @@ redo:;
     NowWeAreMulGroup:;
         ConstantFolding_Assimilate();
         // If one sub-expression evalutes to exact zero, yield zero.
-        double immed_product = 1.0;
+        Value_t immed_product = 1.0;
         size_t n_immeds = 0;
         bool needs_resynth = false;
         for (size_t a = 0; a < GetParamCount(); ++a) {
             if (!GetParam(a).IsImmed())
                 continue;
             // ^ Only check constant values
-            double immed = GetParam(a).GetImmed();
+            Value_t immed = GetParam(a).GetImmed();
             if (immed == 0.0)
                 goto ReplaceTreeWithZero;
             immed_product *= immed;
             ++n_immeds;
         }
         // Merge immeds.
-        if (n_immeds > 1 || (n_immeds == 1 && FloatEqual(immed_product, 1.0)))
+        if (n_immeds > 1 || (n_immeds == 1 && FloatEqual(immed_product, Value_t(1))))
             needs_resynth = true;
         if (needs_resynth) {
             // delete immeds and add new ones
@@ -1149,7 +1163,7 @@ redo:;
 #endif
                     DelParam(a);
                 }
-            if (!FloatEqual(immed_product, 1.0))
+            if (!FloatEqual(immed_product, Value_t(1)))
                 AddParam(CodeTree(immed_product));
         }
         switch (GetParamCount()) {
@@ -1165,14 +1179,14 @@ redo:;
     }
     case cAdd: {
         ConstantFolding_Assimilate();
-        double immed_sum = 0.0;
+        Value_t immed_sum = 0.0;
         size_t n_immeds = 0;
         bool needs_resynth = false;
         for (size_t a = 0; a < GetParamCount(); ++a) {
             if (!GetParam(a).IsImmed())
                 continue;
             // ^ Only check constant values
-            double immed = GetParam(a).GetImmed();
+            Value_t immed = GetParam(a).GetImmed();
             immed_sum += immed;
             ++n_immeds;
         }
@@ -1221,9 +1235,9 @@ redo:;
                  *            2. eliminate all operands where their minimum is
                  *               larger than the selected maximum.
                  */
-        MinMaxTree smallest_maximum;
+        MinMaxTree<Value_t> smallest_maximum;
         for (size_t a = 0; a < GetParamCount(); ++a) {
-            MinMaxTree p = GetParam(a).CalculateResultBoundaries();
+            MinMaxTree<Value_t> p = GetParam(a).CalculateResultBoundaries();
             if (p._has_max && (!smallest_maximum._has_max || p._max < smallest_maximum._max)) {
                 smallest_maximum._max = p._max;
                 smallest_maximum._has_max = true;
@@ -1231,7 +1245,7 @@ redo:;
         }
         if (smallest_maximum._has_max)
             for (size_t a = GetParamCount(); a-- > 0;) {
-                MinMaxTree p = GetParam(a).CalculateResultBoundaries();
+                MinMaxTree<Value_t> p = GetParam(a).CalculateResultBoundaries();
                 if (p._has_min && p._min > smallest_maximum._max)
                     DelParam(a);
             }
@@ -1254,9 +1268,9 @@ redo:;
                  *            2. eliminate all operands where their maximum is
                  *               smaller than the selected minimum.
                  */
-        MinMaxTree biggest_minimum;
+        MinMaxTree<Value_t> biggest_minimum;
         for (size_t a = 0; a < GetParamCount(); ++a) {
-            MinMaxTree p = GetParam(a).CalculateResultBoundaries();
+            MinMaxTree<Value_t> p = GetParam(a).CalculateResultBoundaries();
             if (p._has_min && (!biggest_minimum._has_min || p._min > biggest_minimum._min)) {
                 biggest_minimum._min = p._min;
                 biggest_minimum._has_min = true;
@@ -1265,7 +1279,7 @@ redo:;
         if (biggest_minimum._has_min) {
             //fprintf(stderr, "Removing all where max < %g\n", biggest_minimum._min);
             for (size_t a = GetParamCount(); a-- > 0;) {
-                MinMaxTree p = GetParam(a).CalculateResultBoundaries();
+                MinMaxTree<Value_t> p = GetParam(a).CalculateResultBoundaries();
                 if (p._has_max && p._max < biggest_minimum._min) {
                     //fprintf(stderr, "Removing %g\n", p._max);
                     DelParam(a);
@@ -1286,8 +1300,8 @@ redo:;
         /* If we know the two operands' ranges don't overlap, we get zero.
                  * The opposite is more complex and is done in .dat code.
                  */
-        MinMaxTree p0 = GetParam(0).CalculateResultBoundaries();
-        MinMaxTree p1 = GetParam(1).CalculateResultBoundaries();
+        MinMaxTree<Value_t> p0 = GetParam(0).CalculateResultBoundaries();
+        MinMaxTree<Value_t> p1 = GetParam(1).CalculateResultBoundaries();
         if ((p0._has_max && p1._has_min && p1._min > p0._max) || (p1._has_max && p0._has_min && p0._min > p1._max))
             goto ReplaceTreeWithZero;
         break;
@@ -1298,8 +1312,8 @@ redo:;
         /* If we know the two operands' ranges don't overlap, we get one.
                  * The opposite is more complex and is done in .dat code.
                  */
-        MinMaxTree p0 = GetParam(0).CalculateResultBoundaries();
-        MinMaxTree p1 = GetParam(1).CalculateResultBoundaries();
+        MinMaxTree<Value_t> p0 = GetParam(0).CalculateResultBoundaries();
+        MinMaxTree<Value_t> p1 = GetParam(1).CalculateResultBoundaries();
         if ((p0._has_max && p1._has_min && p1._min > p0._max) || (p1._has_max && p0._has_min && p0._min > p1._max))
             goto ReplaceTreeWithOne;
         break;
@@ -1308,8 +1322,8 @@ redo:;
     case cLess: {
         if (GetParam(0).IsIdenticalTo(GetParam(1)))
             goto ReplaceTreeWithZero;
-        MinMaxTree p0 = GetParam(0).CalculateResultBoundaries();
-        MinMaxTree p1 = GetParam(1).CalculateResultBoundaries();
+        MinMaxTree<Value_t> p0 = GetParam(0).CalculateResultBoundaries();
+        MinMaxTree<Value_t> p1 = GetParam(1).CalculateResultBoundaries();
         if (p0._has_max && p1._has_min && p0._max < p1._min)
             goto ReplaceTreeWithOne; // We know p0 < p1
         if (p1._has_max && p0._has_min && p1._max <= p0._min)
@@ -1320,8 +1334,8 @@ redo:;
     case cLessOrEq: {
         if (GetParam(0).IsIdenticalTo(GetParam(1)))
             goto ReplaceTreeWithOne;
-        MinMaxTree p0 = GetParam(0).CalculateResultBoundaries();
-        MinMaxTree p1 = GetParam(1).CalculateResultBoundaries();
+        MinMaxTree<Value_t> p0 = GetParam(0).CalculateResultBoundaries();
+        MinMaxTree<Value_t> p1 = GetParam(1).CalculateResultBoundaries();
         if (p0._has_max && p1._has_min && p0._max <= p1._min)
             goto ReplaceTreeWithOne; // We know p0 <= p1
         if (p1._has_max && p0._has_min && p1._max < p0._min)
@@ -1333,8 +1347,8 @@ redo:;
         if (GetParam(0).IsIdenticalTo(GetParam(1)))
             goto ReplaceTreeWithZero;
         // Note: Eq case not handled
-        MinMaxTree p0 = GetParam(0).CalculateResultBoundaries();
-        MinMaxTree p1 = GetParam(1).CalculateResultBoundaries();
+        MinMaxTree<Value_t> p0 = GetParam(0).CalculateResultBoundaries();
+        MinMaxTree<Value_t> p1 = GetParam(1).CalculateResultBoundaries();
         if (p0._has_max && p1._has_min && p0._max <= p1._min)
             goto ReplaceTreeWithZero; // We know p0 <= p1
         if (p1._has_max && p0._has_min && p1._max < p0._min)
@@ -1346,8 +1360,8 @@ redo:;
         if (GetParam(0).IsIdenticalTo(GetParam(1)))
             goto ReplaceTreeWithOne;
         // Note: Eq case not handled
-        MinMaxTree p0 = GetParam(0).CalculateResultBoundaries();
-        MinMaxTree p1 = GetParam(1).CalculateResultBoundaries();
+        MinMaxTree<Value_t> p0 = GetParam(0).CalculateResultBoundaries();
+        MinMaxTree<Value_t> p1 = GetParam(1).CalculateResultBoundaries();
         if (p0._has_max && p1._has_min && p0._max < p1._min)
             goto ReplaceTreeWithZero; // We know p0 < p1
         if (p1._has_max && p0._has_min && p1._max <= p0._min)
@@ -1359,7 +1373,7 @@ redo:;
         /* If we know the operand is always positive, cAbs is redundant.
                  * If we know the operand is always negative, use actual negation.
                  */
-        MinMaxTree p0 = GetParam(0).CalculateResultBoundaries();
+        MinMaxTree<Value_t> p0 = GetParam(0).CalculateResultBoundaries();
         if (p0._has_min && p0._min >= 0.0)
             goto ReplaceTreeWithParam0;
         if (p0._has_max && p0._max <= NEGATIVE_MAXIMUM) {
@@ -1506,19 +1520,19 @@ redo:;
         break; // convered into cPow CONSTANT_E x
     case cInt:
         if (GetParam(0).IsImmed()) {
-            const_value = floor(GetParam(0).GetImmed() + 0.5);
+            const_value = std::floor(GetParam(0).GetImmed() + 0.5);
             goto ReplaceTreeWithConstValue;
         }
         break;
     case cLog2:
         if (GetParam(0).IsImmed()) {
-            const_value = log(GetParam(0).GetImmed()) * CONSTANT_L2I;
+            const_value = std::log(GetParam(0).GetImmed()) * Value_t(CONSTANT_L2I);
             goto ReplaceTreeWithConstValue;
         }
         break;
     case cLog10:
         if (GetParam(0).IsImmed()) {
-            const_value = log(GetParam(0).GetImmed()) * CONSTANT_L10I;
+            const_value = std::log(GetParam(0).GetImmed()) * Value_t(CONSTANT_L10I);
             goto ReplaceTreeWithConstValue;
         }
         break;
@@ -1537,8 +1551,8 @@ redo:;
                  *         It allows e.g. atan2(6*x, 3*y) -> atan(2*x/y)
                  *         when we know y != 0
                  */
-        MinMaxTree p0 = GetParam(0).CalculateResultBoundaries();
-        MinMaxTree p1 = GetParam(1).CalculateResultBoundaries();
+        MinMaxTree<Value_t> p0 = GetParam(0).CalculateResultBoundaries();
+        MinMaxTree<Value_t> p1 = GetParam(1).CalculateResultBoundaries();
         if (p0._has_min && p0._has_max && p0._min == 0.0) {
             if (p1._has_max && p1._max < 0) {
                 const_value = CONSTANT_PI;
@@ -1560,7 +1574,7 @@ redo:;
             }
         }
         if (GetParam(0).IsImmed() && GetParam(1).IsImmed()) {
-            const_value = atan2(GetParam(0).GetImmed(),
+            const_value = std::atan2(GetParam(0).GetImmed(),
                                 GetParam(1).GetImmed());
             goto ReplaceTreeWithConstValue;
         }
@@ -1584,7 +1598,7 @@ redo:;
 
     case cPow: {
         if (GetParam(0).IsImmed() && GetParam(1).IsImmed()) {
-            const_value = pow(GetParam(0).GetImmed(),
+            const_value = std::pow(GetParam(0).GetImmed(),
                               GetParam(1).GetImmed());
             goto ReplaceTreeWithConstValue;
         }
@@ -1600,14 +1614,14 @@ redo:;
         // 5^(20*x) = (5^20)^x
         if (GetParam(0).IsImmed() && GetParam(1).GetOpcode() == cMul) {
             bool changes = false;
-            double base_immed = GetParam(0).GetImmed();
+            Value_t base_immed = GetParam(0).GetImmed();
             CodeTree& mulgroup = GetParam(1);
             for (size_t a = mulgroup.GetParamCount(); a-- > 0;)
                 if (mulgroup.GetParam(a).IsImmed()) {
-                    double imm = mulgroup.GetParam(a).GetImmed();
+                    Value_t imm = mulgroup.GetParam(a).GetImmed();
                     //if(imm >= 0.0)
                     {
-                        double new_base_immed = std::pow(base_immed, imm);
+                        Value_t new_base_immed = std::pow(base_immed, imm);
                         if (isinf(new_base_immed) || new_base_immed == 0.0) {
                             // It produced an infinity. Do not change.
                             break;
@@ -1630,9 +1644,9 @@ redo:;
         // (x^3)^2 = x^6
         // NOTE: If 3 is even and 3*2 is not, x must be changed to abs(x).
         if (GetParam(0).GetOpcode() == cPow && GetParam(1).IsImmed() && GetParam(0).GetParam(1).IsImmed()) {
-            double a = GetParam(0).GetParam(1).GetImmed();
-            double b = GetParam(1).GetImmed();
-            double c = a * b; // new exponent
+            Value_t a = GetParam(0).GetParam(1).GetImmed();
+            Value_t b = GetParam(1).GetImmed();
+            Value_t c = a * b; // new exponent
             if (IsEvenIntegerConst(a) // a is an even int?
                 && !IsEvenIntegerConst(c)) // c is not?
             {
@@ -1651,7 +1665,7 @@ redo:;
     case cMod: {
         /* Can more be done than this? */
         if (GetParam(0).IsImmed() && GetParam(1).IsImmed()) {
-            const_value = fmod(GetParam(0).GetImmed(),
+            const_value = std::fmod(GetParam(0).GetImmed(),
                                GetParam(1).GetImmed());
             goto ReplaceTreeWithConstValue;
         }
@@ -1704,6 +1718,7 @@ redo:;
     case cDup:
     case cFetch:
     case cPopNMov:
+    case cSelect:
     case cNop:
     case cJump:
     case VarBegin:
@@ -1716,10 +1731,11 @@ redo:;
     }
 }
 
-MinMaxTree CodeTree::CalculateResultBoundaries() const
+template<typename Value_t>
+MinMaxTree<Value_t> CodeTree<Value_t>::CalculateResultBoundaries() const
 #ifdef DEBUG_SUBSTITUTIONS_extra_verbose
 {
-    MinMaxTree tmp = CalculateResultBoundaries_do();
+    MinMaxTree<Value_t> tmp = CalculateResultBoundaries_do();
     std::cout << "Estimated boundaries: ";
     if (tmp._has_min)
         std::cout << tmp._min;
@@ -1735,13 +1751,14 @@ MinMaxTree CodeTree::CalculateResultBoundaries() const
     std::cout << std::endl;
     return tmp;
 }
-MinMaxTree CodeTree::CalculateResultBoundaries_do() const
+template<typename Value_t>
+MinMaxTree<Value_t> CodeTree<Value_t>::CalculateResultBoundaries_do() const
 #endif
 {
     using namespace std;
     switch (GetOpcode()) {
     case cImmed:
-        return MinMaxTree(GetImmed(), GetImmed()); // a definite value.
+        return MinMaxTree<Value_t>(GetImmed(), GetImmed()); // a definite value.
     case cAnd:
     case cOr:
     case cNot:
@@ -1754,32 +1771,32 @@ MinMaxTree CodeTree::CalculateResultBoundaries_do() const
     case cGreaterOrEq: {
         /* These operations always produce truth values (0 or 1) */
         /* Narrowing them down is a matter of performing Constant optimization */
-        return MinMaxTree(0.0, 1.0);
+        return MinMaxTree<Value_t>(Value_t(0), Value_t(1));
     }
     case cAbs: {
         /* cAbs always produces a positive value */
-        MinMaxTree m = GetParam(0).CalculateResultBoundaries();
+        MinMaxTree<Value_t> m = GetParam(0).CalculateResultBoundaries();
         if (m._has_min && m._has_max) {
             if (m._min < 0.0 && m._max >= 0.0) { // ex. -10..+6 or -6..+10
                 /* -x..+y: spans across zero. min=0, max=greater of |x| and |y|. */
-                double tmp = -m._min;
+                Value_t tmp = -m._min;
                 if (tmp > m._max) m._max = tmp;
                 m._min = 0.0;
                 m._has_min = true;
             } else if (m._min < 0.0) // ex. -10..-4
             {
-                double tmp = m._max;
+                Value_t tmp = m._max;
                 m._max = -m._min;
                 m._min = -tmp;
             }
         } else if (!m._has_min && m._has_max && m._max < 0.0) // ex. -inf..-10
         {
-            m._min = fabs(m._max);
+            m._min = std::fabs(m._max);
             m._has_min = true;
             m._has_max = false;
         } else if (!m._has_max && m._has_min && m._min > 0.0) // ex. +10..+inf
         {
-            m._min = fabs(m._min);
+            m._min = std::fabs(m._min);
             m._has_min = true;
             m._has_max = false;
         } else // ex. -inf..+inf, -inf..+10, -10..+inf
@@ -1793,42 +1810,42 @@ MinMaxTree CodeTree::CalculateResultBoundaries_do() const
     }
 
     case cLog: { /* Defined for 0.0 < x <= inf */
-        MinMaxTree m = GetParam(0).CalculateResultBoundaries();
+        MinMaxTree<Value_t> m = GetParam(0).CalculateResultBoundaries();
         if (m._has_min) {
             if (m._min < 0.0)
                 m._has_min = false;
             else
-                m._min = log(m._min);
+                m._min = std::log(m._min);
         } // No boundaries
         if (m._has_max) {
             if (m._max < 0.0)
                 m._has_max = false;
             else
-                m._max = log(m._max);
+                m._max = std::log(m._max);
         }
         return m;
     }
 
     case cLog2: { /* Defined for 0.0 < x <= inf */
-        MinMaxTree m = GetParam(0).CalculateResultBoundaries();
+        MinMaxTree<Value_t> m = GetParam(0).CalculateResultBoundaries();
         if (m._has_min) {
             if (m._min < 0.0)
                 m._has_min = false;
             else
-                m._min = log(m._min) * CONSTANT_L2I;
+                m._min = std::log(m._min) * Value_t(CONSTANT_L2I);
         } // No boundaries
         if (m._has_max) {
             if (m._max < 0.0)
                 m._has_max = false;
             else
-                m._max = log(m._max) * CONSTANT_L2I;
+                m._max = std::log(m._max) * Value_t(CONSTANT_L2I);
         }
         return m;
     }
 
     case cAcosh: /* defined for             1.0 <  x <= inf */
     {
-        MinMaxTree m = GetParam(0).CalculateResultBoundaries();
+        MinMaxTree<Value_t> m = GetParam(0).CalculateResultBoundaries();
         if (m._has_min) {
             if (m._min <= 1.0)
                 m._has_min = false;
@@ -1845,14 +1862,14 @@ MinMaxTree CodeTree::CalculateResultBoundaries_do() const
     }
     case cAsinh: /* defined for all values -inf <= x <= inf */
     {
-        MinMaxTree m = GetParam(0).CalculateResultBoundaries();
+        MinMaxTree<Value_t> m = GetParam(0).CalculateResultBoundaries();
         if (m._has_min) m._min = fp_asinh(m._min); // No boundaries
         if (m._has_max) m._max = fp_asinh(m._max);
         return m;
     }
     case cAtanh: /* defined for all values -inf <= x <= inf */
     {
-        MinMaxTree m = GetParam(0).CalculateResultBoundaries();
+        MinMaxTree<Value_t> m = GetParam(0).CalculateResultBoundaries();
         if (m._has_min) m._min = fp_atanh(m._min); // No boundaries
         if (m._has_max) m._max = fp_atanh(m._max);
         return m;
@@ -1860,23 +1877,23 @@ MinMaxTree CodeTree::CalculateResultBoundaries_do() const
     case cAcos: { /* defined for -1.0 <= x < 1, results within CONSTANT_PI..0 */
         /* Somewhat complicated to narrow down from this */
         /* TODO: A resourceful programmer may add it later. */
-        return MinMaxTree(0.0, CONSTANT_PI);
+        return MinMaxTree<Value_t>(Value_t(0), Value_t(CONSTANT_PI));
     }
     case cAsin: { /* defined for -1.0 <= x < 1, results within -CONSTANT_PIHALF..CONSTANT_PIHALF */
         /* Somewhat complicated to narrow down from this */
         /* TODO: A resourceful programmer may add it later. */
-        return MinMaxTree(-CONSTANT_PIHALF, CONSTANT_PIHALF);
+        return MinMaxTree<Value_t>(-Value_t(CONSTANT_PIHALF), Value_t(CONSTANT_PIHALF));
     }
     case cAtan: { /* defined for all values -inf <= x <= inf */
-        MinMaxTree m = GetParam(0).CalculateResultBoundaries();
+        MinMaxTree<Value_t> m = GetParam(0).CalculateResultBoundaries();
         if (m._has_min)
-            m._min = atan(m._min);
+            m._min = std::atan(m._min);
         else {
             m._min = -CONSTANT_PIHALF;
             m._has_min = true;
         }
         if (m._has_max)
-            m._max = atan(m._max);
+            m._max = std::atan(m._max);
         else {
             m._max = CONSTANT_PIHALF;
             m._has_max = true;
@@ -1886,7 +1903,7 @@ MinMaxTree CodeTree::CalculateResultBoundaries_do() const
     case cAtan2: { /* too complicated to estimate */
         /* Somewhat complicated to narrow down from this */
         /* TODO: A resourceful programmer may add it later. */
-        return MinMaxTree(-CONSTANT_PI, CONSTANT_PI);
+        return MinMaxTree<Value_t>(-Value_t(CONSTANT_PI), Value_t(CONSTANT_PI));
     }
 
     case cSin:
@@ -1895,66 +1912,66 @@ MinMaxTree CodeTree::CalculateResultBoundaries_do() const
                  * but it's too complicated due to
                  * the cyclic nature of the function. */
         /* TODO: A resourceful programmer may add it later. */
-        return MinMaxTree(-1.0, 1.0);
+        return MinMaxTree<Value_t>(Value_t(-1), Value_t(1));
     }
     case cTan: {
         /* Could be narrowed down from here,
                  * but it's too complicated due to
                  * the cyclic nature of the function */
         /* TODO: A resourceful programmer may add it later. */
-        return MinMaxTree(); // (CONSTANT_NEG_INF, CONSTANT_POS_INF);
+        return MinMaxTree<Value_t>(); // (CONSTANT_NEG_INF, CONSTANT_POS_INF);
     }
 
     case cCeil: {
-        MinMaxTree m = GetParam(0).CalculateResultBoundaries();
+        MinMaxTree<Value_t> m = GetParam(0).CalculateResultBoundaries();
         m._max = std::ceil(m._max); // ceil() may increase the value, may not decrease
         return m;
     }
     case cFloor: {
-        MinMaxTree m = GetParam(0).CalculateResultBoundaries();
+        MinMaxTree<Value_t> m = GetParam(0).CalculateResultBoundaries();
         m._min = std::floor(m._min); // floor() may decrease the value, may not increase
         return m;
     }
     case cInt: {
-        MinMaxTree m = GetParam(0).CalculateResultBoundaries();
+        MinMaxTree<Value_t> m = GetParam(0).CalculateResultBoundaries();
         m._min = std::floor(m._min); // int() may either increase or decrease the value
         m._max = std::ceil(m._max); // for safety, we assume both
         return m;
     }
     case cSinh: { /* defined for all values -inf <= x <= inf */
-        MinMaxTree m = GetParam(0).CalculateResultBoundaries();
-        if (m._has_min) m._min = sinh(m._min); // No boundaries
-        if (m._has_max) m._max = sinh(m._max);
+        MinMaxTree<Value_t> m = GetParam(0).CalculateResultBoundaries();
+        if (m._has_min) m._min = std::sinh(m._min); // No boundaries
+        if (m._has_max) m._max = std::sinh(m._max);
         return m;
     }
     case cTanh: { /* defined for all values -inf <= x <= inf */
-        MinMaxTree m = GetParam(0).CalculateResultBoundaries();
-        if (m._has_min) m._min = tanh(m._min); // No boundaries
-        if (m._has_max) m._max = tanh(m._max);
+        MinMaxTree<Value_t> m = GetParam(0).CalculateResultBoundaries();
+        if (m._has_min) m._min = std::tanh(m._min); // No boundaries
+        if (m._has_max) m._max = std::tanh(m._max);
         return m;
     }
     case cCosh: { /* defined for all values -inf <= x <= inf, results within 1..inf */
-        MinMaxTree m = GetParam(0).CalculateResultBoundaries();
+        MinMaxTree<Value_t> m = GetParam(0).CalculateResultBoundaries();
         if (m._has_min) {
             if (m._has_max) { // max, min
                 if (m._min >= 0.0 && m._max >= 0.0) { // +x .. +y
-                    m._min = cosh(m._min);
-                    m._max = cosh(m._max);
+                    m._min = std::cosh(m._min);
+                    m._max = std::cosh(m._max);
                 } else if (m._min < 0.0 && m._max >= 0.0) { // -x .. +y
-                    double tmp = cosh(m._min);
-                    m._max = cosh(m._max);
+                    Value_t tmp = std::cosh(m._min);
+                    m._max = std::cosh(m._max);
                     if (tmp > m._max)
                         m._max = tmp;
                     m._min = 1.0;
                 } else { // -x .. -y
-                    m._min = cosh(m._min);
-                    m._max = cosh(m._max);
+                    m._min = std::cosh(m._min);
+                    m._max = std::cosh(m._max);
                     std::swap(m._min, m._max);
                 }
             } else { // min, no max
                 if (m._min >= 0.0) { // 0..inf -> 1..inf
                     m._has_max = true;
-                    m._max = cosh(m._min);
+                    m._max = std::cosh(m._min);
                     m._min = 1.0;
                 } else {
                     m._has_max = false;
@@ -1965,7 +1982,7 @@ MinMaxTree CodeTree::CalculateResultBoundaries_do() const
             m._has_min = true;
             m._min = 1.0; // always a lower boundary
             if (m._has_max) { // max, no min
-                m._min = cosh(m._max); // n..inf
+                m._min = std::cosh(m._max); // n..inf
                 m._has_max = false; // No upper boundary
             } else { // no max, no min
                 m._has_max = false; // No upper boundary
@@ -1976,8 +1993,8 @@ MinMaxTree CodeTree::CalculateResultBoundaries_do() const
 
     case cIf: {
         // No guess which branch is chosen. Produce a spanning min & max.
-        MinMaxTree res1 = GetParam(1).CalculateResultBoundaries();
-        MinMaxTree res2 = GetParam(2).CalculateResultBoundaries();
+        MinMaxTree<Value_t> res1 = GetParam(1).CalculateResultBoundaries();
+        MinMaxTree<Value_t> res2 = GetParam(2).CalculateResultBoundaries();
         if (!res2._has_min)
             res1._has_min = false;
         else if (res2._min < res1._min)
@@ -1993,9 +2010,9 @@ MinMaxTree CodeTree::CalculateResultBoundaries_do() const
         bool has_unknown_min = false;
         bool has_unknown_max = false;
 
-        MinMaxTree result;
+        MinMaxTree<Value_t> result;
         for (size_t a = 0; a < GetParamCount(); ++a) {
-            MinMaxTree m = GetParam(a).CalculateResultBoundaries();
+            MinMaxTree<Value_t> m = GetParam(a).CalculateResultBoundaries();
             if (!m._has_min)
                 has_unknown_min = true;
             else if (!result._has_min || m._min < result._min)
@@ -2014,9 +2031,9 @@ MinMaxTree CodeTree::CalculateResultBoundaries_do() const
         bool has_unknown_min = false;
         bool has_unknown_max = false;
 
-        MinMaxTree result;
+        MinMaxTree<Value_t> result;
         for (size_t a = 0; a < GetParamCount(); ++a) {
-            MinMaxTree m = GetParam(a).CalculateResultBoundaries();
+            MinMaxTree<Value_t> m = GetParam(a).CalculateResultBoundaries();
             if (!m._has_min)
                 has_unknown_min = true;
             else if (!result._has_min || m._min > result._min)
@@ -2036,9 +2053,9 @@ MinMaxTree CodeTree::CalculateResultBoundaries_do() const
         /* Note: This also deals with the following opcodes:
                  *       cNeg, cSub, cRSub
                  */
-        MinMaxTree result(0.0, 0.0);
+        MinMaxTree<Value_t> result(Value_t(0), Value_t(0));
         for (size_t a = 0; a < GetParamCount(); ++a) {
-            MinMaxTree item = GetParam(a).CalculateResultBoundaries();
+            MinMaxTree<Value_t> item = GetParam(a).CalculateResultBoundaries();
 
             if (item._has_min)
                 result._min += item._min;
@@ -2066,10 +2083,10 @@ MinMaxTree CodeTree::CalculateResultBoundaries_do() const
                              MinusInf,
                              PlusInf };
             ValueType valueType;
-            double value;
+            Value_t value;
 
             Value(ValueType t) : valueType(t), value(0) {}
-            Value(double v) : valueType(Finite), value(v) {}
+            Value(Value_t v) : valueType(Finite), value(v) {}
 
             bool isNegative() const {
                 return valueType == MinusInf ||
@@ -2107,10 +2124,10 @@ MinMaxTree CodeTree::CalculateResultBoundaries_do() const
             }
         };
 
-        MinMaxTree result(1.0, 1.0);
+        MinMaxTree<Value_t> result(Value_t(1), Value_t(1));
         for (size_t a = 0; a < GetParamCount(); ++a) {
-            MinMaxTree item = GetParam(a).CalculateResultBoundaries();
-            if (!item._has_min && !item._has_max) return MinMaxTree(); // hopeless
+            MinMaxTree<Value_t> item = GetParam(a).CalculateResultBoundaries();
+            if (!item._has_min && !item._has_max) return MinMaxTree<Value_t>(); // hopeless
 
             Value minValue0 = result._has_min ? Value(result._min) : Value(Value::MinusInf);
             Value maxValue0 = result._has_max ? Value(result._max) : Value(Value::PlusInf);
@@ -2142,39 +2159,39 @@ MinMaxTree CodeTree::CalculateResultBoundaries_do() const
     case cMod: {
         /* TODO: The boundaries of modulo operator could be estimated better. */
 
-        MinMaxTree x = GetParam(0).CalculateResultBoundaries();
-        MinMaxTree y = GetParam(1).CalculateResultBoundaries();
+        MinMaxTree<Value_t> x = GetParam(0).CalculateResultBoundaries();
+        MinMaxTree<Value_t> y = GetParam(1).CalculateResultBoundaries();
 
         if (y._has_max) {
             if (y._max >= 0.0) {
                 if (!x._has_min || x._min < 0)
-                    return MinMaxTree(-y._max, y._max);
+                    return MinMaxTree<Value_t>(-y._max, y._max);
                 else
-                    return MinMaxTree(0.0, y._max);
+                    return MinMaxTree<Value_t>(Value_t(0), y._max);
             } else {
                 if (!x._has_max || x._max >= 0)
-                    return MinMaxTree(y._max, -y._max);
+                    return MinMaxTree<Value_t>(y._max, -y._max);
                 else
-                    return MinMaxTree(y._max, NEGATIVE_MAXIMUM);
+                    return MinMaxTree<Value_t>(y._max, Value_t(NEGATIVE_MAXIMUM));
             }
         } else
-            return MinMaxTree();
+            return MinMaxTree<Value_t>();
     }
     case cPow: {
         if (GetParam(1).IsImmed() && GetParam(1).GetImmed() == 0.0) {
             // Note: This makes 0^0 evaluate into 1.
-            return MinMaxTree(1.0, 1.0); // x^0 = 1
+            return MinMaxTree<Value_t>(Value_t(1), Value_t(1)); // x^0 = 1
         }
         if (GetParam(0).IsImmed() && GetParam(0).GetImmed() == 0.0) {
             // Note: This makes 0^0 evaluate into 0.
-            return MinMaxTree(0.0, 0.0); // 0^x = 0
+            return MinMaxTree<Value_t>(Value_t(0), Value_t(0)); // 0^x = 0
         }
-        if (GetParam(0).IsImmed() && FloatEqual(GetParam(0).GetImmed(), 1.0)) {
-            return MinMaxTree(1.0, 1.0); // 1^x = 1
+        if (GetParam(0).IsImmed() && FloatEqual(GetParam(0).GetImmed(), Value_t(1))) {
+            return MinMaxTree<Value_t>(Value_t(1), Value_t(1)); // 1^x = 1
         }
 
-        MinMaxTree p0 = GetParam(0).CalculateResultBoundaries();
-        MinMaxTree p1 = GetParam(1).CalculateResultBoundaries();
+        MinMaxTree<Value_t> p0 = GetParam(0).CalculateResultBoundaries();
+        MinMaxTree<Value_t> p1 = GetParam(1).CalculateResultBoundaries();
         TriTruthValue p0_positivity = (p0._has_min && p0._min >= 0.0) ? IsAlways : (p0._has_max && p0._max < 0.0 ? IsNever : Unknown);
         TriTruthValue p1_evenness = GetParam(1).GetEvennessInfo();
 
@@ -2241,24 +2258,24 @@ MinMaxTree CodeTree::CalculateResultBoundaries_do() const
         case IsAlways: {
             /* The result is always positive.
                          * Figure out whether we know the minimum value. */
-            double min = 0.0;
+            Value_t min = 0.0;
             if (p0._has_min && p1._has_min) {
-                min = pow(p0._min, p1._min);
+                min = std::pow(p0._min, p1._min);
                 if (p0._min < 0.0 && (!p1._has_max || p1._max >= 0.0) && min >= 0.0)
                     min = 0.0;
             }
             if (p0._has_min && p0._min >= 0.0 && p0._has_max && p1._has_max) {
-                double max = pow(p0._max, p1._max);
+                Value_t max = std::pow(p0._max, p1._max);
                 if (min > max) std::swap(min, max);
-                return MinMaxTree(min, max);
+                return MinMaxTree<Value_t>(min, max);
             }
-            return MinMaxTree(min, false);
+            return MinMaxTree<Value_t>(min, false);
         }
         case IsNever: {
             /* The result is always negative.
                          * TODO: Figure out whether we know the maximum value.
                          */
-            return MinMaxTree(false, NEGATIVE_MAXIMUM);
+            return MinMaxTree<Value_t>(false, Value_t(NEGATIVE_MAXIMUM));
         }
         default: {
             /* It can be negative or positive.
@@ -2297,6 +2314,7 @@ MinMaxTree CodeTree::CalculateResultBoundaries_do() const
     case cDup:
     case cFetch:
     case cPopNMov:
+    case cSelect:
     case cNop:
     case cJump:
     case VarBegin:
@@ -2312,8 +2330,23 @@ MinMaxTree CodeTree::CalculateResultBoundaries_do() const
         //default:
         break;
     }
-    return MinMaxTree(); /* Cannot deduce */
+    return MinMaxTree<Value_t>(); /* Cannot deduce */
 }
 } // namespace FPoptimizer_CodeTree
 
+namespace FPoptimizer_CodeTree {
+#define FP_INSTANTIATE(type)                                                        \
+    template void CodeTree<type>::ConstantFolding();                                \
+    template void CodeTree<type>::ConstantFolding_FromLogicalParent();              \
+    template bool CodeTree<type>::ConstantFolding_AndLogic();                       \
+    template bool CodeTree<type>::ConstantFolding_OrLogic();                        \
+    template bool CodeTree<type>::ConstantFolding_LogicCommon(bool is_or);          \
+    template bool CodeTree<type>::ConstantFolding_MulGrouping();                    \
+    template bool CodeTree<type>::ConstantFolding_AddGrouping();                    \
+    template bool CodeTree<type>::ConstantFolding_Assimilate();                     \
+    template MinMaxTree<type> CodeTree<type>::CalculateResultBoundaries() const;
+FP_INSTANTIATE_OPTIMIZER_TYPES(FP_INSTANTIATE)
+#undef FP_INSTANTIATE
+} // namespace FPoptimizer_CodeTree
+
 #endif
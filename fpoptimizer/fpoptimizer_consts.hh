@@ -6,30 +6,29 @@
 |* Copyright: Joel Yliluoma                                                *|
 \***************************************************************************/
 // #line 1 "fpoptimizer/fpoptimizer_consts.hh"
-#ifndef M_PI
-#define M_PI 3.1415926535897932384626433832795
-#endif
-
-#define CONSTANT_E 2.71828182845904509080 // exp(1)
-#define CONSTANT_EI 0.3678794411714423215955 // exp(-1)
-#define CONSTANT_2E 7.3890560989306502272304 // exp(2)
-#define CONSTANT_2EI 0.135335283236612691894 // exp(-2)
-#define CONSTANT_PI M_PI // atan2(0,-1)
-#define CONSTANT_L10 2.30258509299404590109 // log(10)
-#define CONSTANT_L2 0.69314718055994530943 // log(2)
-#define CONSTANT_L10I 0.43429448190325176116 // 1/log(10)
-#define CONSTANT_L2I 1.4426950408889634074 // 1/log(2)
+/* The constants are long double literals, so that they keep
+ * their precision in the long double instantiation of the optimizer.
+ */
+#define CONSTANT_E 2.71828182845904523536028747135266250L // exp(1)
+#define CONSTANT_EI 0.367879441171442321595523770161460867L // exp(-1)
+#define CONSTANT_2E 7.38905609893065022723042746057500781L // exp(2)
+#define CONSTANT_2EI 0.135335283236612691893999494972484403L // exp(-2)
+#define CONSTANT_PI 3.14159265358979323846264338327950288L // atan2(0,-1)
+#define CONSTANT_L10 2.30258509299404568401799145468436421L // log(10)
+#define CONSTANT_L2 0.693147180559945309417232121458176568L // log(2)
+#define CONSTANT_L10I 0.434294481903251827651128918916605082L // 1/log(10)
+#define CONSTANT_L2I 1.44269504088896340735992468100189214L // 1/log(2)
 #define CONSTANT_L10E CONSTANT_L10I // log10(e)
 #define CONSTANT_L10EI CONSTANT_L10 // 1/log10(e)
-#define CONSTANT_L10B 0.3010299956639811952137 // log10(2)
-#define CONSTANT_L10BI 3.3219280948873623478703 // 1/log10(2)
+#define CONSTANT_L10B 0.301029995663981195213738894724493027L // log10(2)
+#define CONSTANT_L10BI 3.32192809488736234787031942948939018L // 1/log10(2)
 #define CONSTANT_LB10 CONSTANT_L10BI // log2(10)
 #define CONSTANT_LB10I CONSTANT_L10B // 1/log2(10)
 #define CONSTANT_L2E CONSTANT_L2I // log2(e)
 #define CONSTANT_L2EI CONSTANT_L2 // 1/log2(e)
-#define CONSTANT_DR (180.0 / M_PI) // 180/pi
-#define CONSTANT_RD (M_PI / 180.0) // pi/180
+#define CONSTANT_DR 57.2957795130823208767981548141051703L // 180/pi
+#define CONSTANT_RD 0.0174532925199432957692369076848861271L // pi/180
 
 #define CONSTANT_POS_INF HUGE_VAL // positive infinity, from math.h
 #define CONSTANT_NEG_INF (-HUGE_VAL) // negative infinity
-#define CONSTANT_PIHALF (M_PI / 2)
+#define CONSTANT_PIHALF 1.57079632679489661923132169163975144L // pi/2
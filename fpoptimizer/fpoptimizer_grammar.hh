@@ -16,6 +16,7 @@
 #define FPOPT_NAN_CONST (-1712345.25) /* Would use 0.0 / 0.0 here, but some compilers don't accept it. */
 
 namespace FPoptimizer_CodeTree {
+template<typename Value_t>
 class CodeTree;
 }
 
@@ -110,7 +111,7 @@ struct ParamSpec_ParamHolder {
 } PACKED_GRAMMAR_ATTRIBUTE;
 
 struct ParamSpec_NumConstant {
-    double constvalue; // the value
+    long double constvalue; // the value, as precise as the widest value type
 } PACKED_GRAMMAR_ATTRIBUTE;
 
 struct ParamSpec_SubFunctionData {
@@ -197,8 +198,9 @@ struct Grammar {
     unsigned rule_count;
 };
 
+template<typename Value_t>
 bool ApplyGrammar(const Grammar& grammar,
-                  FPoptimizer_CodeTree::CodeTree& tree,
+                  FPoptimizer_CodeTree::CodeTree<Value_t>& tree,
                   bool recurse = true);
 
 /* GrammarPack is the structure which contains all
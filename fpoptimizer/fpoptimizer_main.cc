@@ -22,14 +22,9 @@ using namespace FUNCTIONPARSERTYPES;
 using namespace FPoptimizer_CodeTree;
 using namespace FPoptimizer_Grammar;
 
-void FunctionParser::Optimize() {
-    CopyOnWrite();
-
-    //PrintByteCode(std::cout);
-
-    CodeTree tree;
-    tree.GenerateFrom(data->ByteCode, data->Immed, *data);
-
+namespace {
+template<typename Value_t>
+void ApplyGrammars(CodeTree<Value_t>& tree) {
     while (ApplyGrammar(pack.glist[0], tree)) {
         // intermediate
         //std::cout << "Rerunning 1\n";
@@ -47,26 +42,97 @@ void FunctionParser::Optimize() {
         //std::cout << "Rerunning 3\n";
         FixIncompleteHashes(tree);
     }
+}
+
+#ifndef FP_DISABLE_EVAL
+bool UsesEval(const std::vector<unsigned>& byteCode) {
+    for (unsigned i = 0; i < byteCode.size(); ++i) {
+        switch (byteCode[i]) {
+        case cEval: return true;
+        case cIf:
+        case cJump: i += 2; break;
+        case cFCall:
+        case cPCall:
+        case cFetch: i += 1; break;
+        case cPopNMov: i += 2; break;
+        }
+    }
+    return false;
+}
+#endif
+} // namespace
+
+template<typename Value_t>
+void FunctionParserBase<Value_t>::Optimize() {
+    CopyOnWrite();
+
+    //PrintByteCode(std::cout);
+
+    CodeTree<Value_t> tree;
+    tree.GenerateFrom(data->ByteCode, data->Immed, *data);
+    ApplyGrammars(tree);
 
     std::vector<unsigned> byteCode;
-    std::vector<double> immed;
+    std::vector<Value_t> immed;
     size_t stacktop_max = 0;
-    tree.SynthesizeByteCode(byteCode, immed, stacktop_max);
+    tree.SynthesizeByteCode(byteCode, immed, stacktop_max, data->useBranchlessIfs);
 
     /*std::cout << std::flush;
     std::cerr << std::flush;
     fprintf(stderr, "Estimated stacktop %u\n", (unsigned)stacktop_max);
     fflush(stderr);*/
 
-    if (data->StackSize != stacktop_max) {
-        data->StackSize = stacktop_max; // note: gcc warning is meaningful
-        data->Stack.resize(stacktop_max);
-    }
+    data->StackSize = stacktop_max; // note: gcc warning is meaningful
 
     data->ByteCode.swap(byteCode);
     data->Immed.swap(immed);
+    data->ReleaseCompiledCode();
+#ifdef FP_USE_THREADED_DISPATCH
+    EvalByteCode<false>(evalContext, 0, 0, true);
+#endif
+    TranslateToRegisterCode();
 
     //PrintByteCode(std::cout);
 }
 
+template void FunctionParserBase<double>::Optimize();
+template void FunctionParserBase<float>::Optimize();
+template void FunctionParserBase<long double>::Optimize();
+
+/* Optimizes the functions of the bundle like Optimize() and synthesizes
+   them into one bytecode, sharing their common subtrees. The bytecode is
+   only run by EvalByteCode(), since the other engines keep only the final
+   result.
+*/
+bool FunctionBundle::Merge() {
+    std::vector<CodeTree<double> > trees(parsers.size());
+    for (size_t i = 0; i < parsers.size(); ++i) {
+        const FunctionParser::Data& data = *parsers[i].data;
+#ifndef FP_DISABLE_EVAL
+        // eval() would evaluate the whole bundle instead of the function.
+        if (UsesEval(data.ByteCode))
+            return false;
+#endif
+        trees[i].GenerateFrom(data.ByteCode, data.Immed, data);
+        ApplyGrammars(trees[i]);
+    }
+
+    std::vector<unsigned> byteCode;
+    std::vector<double> immed;
+    size_t stacktop_max = 0;
+    CodeTree<double>::SynthesizeByteCode(trees, byteCode, immed, stacktop_max, outputs);
+
+    combined.CopyOnWrite();
+    FunctionParser::Data& data = *combined.data;
+    data.StackSize = stacktop_max;
+    data.ByteCode.swap(byteCode);
+    data.Immed.swap(immed);
+    data.ReleaseCompiledCode();
+    data.RegisterCode.clear();
+#ifdef FP_USE_THREADED_DISPATCH
+    combined.EvalByteCode<false>(context, 0, 0, true);
+#endif
+    return true;
+}
+
 #endif
@@ -227,6 +227,9 @@ const std::string FP_GetOpcodeName(FUNCTIONPARSERTYPES::OPCODE opcode, bool pad)
     case cPopNMov:
         p = "cPopNMov";
         break;
+    case cSelect:
+        p = "cSelect";
+        break;
 #endif
     case cDup:
         p = "cDup";
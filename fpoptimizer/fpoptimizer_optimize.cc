@@ -99,7 +99,8 @@ MyEqualRange(It first, It last, const T& val, Comp comp) {
 
 /* A helper for std::equal_range */
 struct OpcodeRuleCompare {
-    bool operator()(const CodeTree& tree, const Rule& rule) const {
+    template<typename Value_t>
+    bool operator()(const CodeTree<Value_t>& tree, const Rule& rule) const {
         /* If this function returns true, len=half.
              */
 
@@ -112,7 +113,8 @@ struct OpcodeRuleCompare {
         }
         return false;
     }
-    bool operator()(const Rule& rule, const CodeTree& tree) const {
+    template<typename Value_t>
+    bool operator()(const Rule& rule, const CodeTree<Value_t>& tree) const {
         /* If this function returns true, rule will be excluded from the equal_range
              */
 
@@ -134,10 +136,11 @@ struct OpcodeRuleCompare {
 };
 
 /* Test and apply a rule to a given CodeTree */
+template<typename Value_t>
 bool TestRuleAndApplyIfMatch(
     const Rule& rule,
-    CodeTree& tree) {
-    MatchInfo info;
+    CodeTree<Value_t>& tree) {
+    MatchInfo<Value_t> info;
 
     MatchResultType found(false, MatchPositionSpecBaseP());
 
@@ -167,9 +170,10 @@ bool TestRuleAndApplyIfMatch(
 
 namespace FPoptimizer_Grammar {
 /* Apply the grammar to a given CodeTree */
+template<typename Value_t>
 bool ApplyGrammar(
     const Grammar& grammar,
-    CodeTree& tree,
+    CodeTree<Value_t>& tree,
     bool recurse) {
     if (tree.GetOptimizedUsing() == &grammar) {
 #ifdef DEBUG_SUBSTITUTIONS
@@ -249,4 +253,13 @@ bool ApplyGrammar(
 }
 } // namespace FPoptimizer_Grammar
 
+namespace FPoptimizer_Grammar {
+#define FP_INSTANTIATE(type)                                               \
+    template bool ApplyGrammar(const Grammar& grammar,                     \
+                               FPoptimizer_CodeTree::CodeTree<type>& tree, \
+                               bool recurse);
+FP_INSTANTIATE_OPTIMIZER_TYPES(FP_INSTANTIATE)
+#undef FP_INSTANTIATE
+} // namespace FPoptimizer_Grammar
+
 #endif
@@ -26,20 +26,21 @@ using namespace FPoptimizer_CodeTree;
 using namespace FUNCTIONPARSERTYPES;
 
 /* This struct collects information regarding the matching process so far */
+template<typename Value_t>
 class MatchInfo {
 public:
-    std::multimap<unsigned, CodeTree> restholder_matches;
-    std::map<unsigned, CodeTree> paramholder_matches;
+    std::multimap<unsigned, CodeTree<Value_t> > restholder_matches;
+    std::map<unsigned, CodeTree<Value_t> > paramholder_matches;
     std::vector<unsigned> matched_params;
 
 public:
     /* These functions save data from matching */
-    void SaveRestHolderMatch(unsigned restholder_index, const CodeTree& treeptr) {
+    void SaveRestHolderMatch(unsigned restholder_index, const CodeTree<Value_t>& treeptr) {
         restholder_matches.insert(std::make_pair(restholder_index, treeptr));
     }
 
-    bool SaveOrTestParamHolder(unsigned paramholder_index, const CodeTree& treeptr) {
-        std::map<unsigned, CodeTree>::iterator i = paramholder_matches.lower_bound(paramholder_index);
+    bool SaveOrTestParamHolder(unsigned paramholder_index, const CodeTree<Value_t>& treeptr) {
+        typename std::map<unsigned, CodeTree<Value_t> >::iterator i = paramholder_matches.lower_bound(paramholder_index);
         if (i == paramholder_matches.end() || i->first != paramholder_index) {
             paramholder_matches.insert(i, std::make_pair(paramholder_index, treeptr));
             return true;
@@ -54,20 +55,20 @@ public:
     /* These functions retrieve the data from matching
          * for use when synthesizing the resulting tree.
          */
-    const CodeTree& GetParamHolderValueIfFound(unsigned paramholder_index) const {
-        std::map<unsigned, CodeTree>::const_iterator i = paramholder_matches.find(paramholder_index);
+    const CodeTree<Value_t>& GetParamHolderValueIfFound(unsigned paramholder_index) const {
+        typename std::map<unsigned, CodeTree<Value_t> >::const_iterator i = paramholder_matches.find(paramholder_index);
         if (i == paramholder_matches.end() || i->first != paramholder_index) {
-            static const CodeTree dummytree;
+            static const CodeTree<Value_t> dummytree;
             return dummytree;
         }
         return i->second;
     }
 
-    const CodeTree& GetParamHolderValue(unsigned paramholder_index) const { return paramholder_matches.find(paramholder_index)->second; }
+    const CodeTree<Value_t>& GetParamHolderValue(unsigned paramholder_index) const { return paramholder_matches.find(paramholder_index)->second; }
 
-    std::vector<CodeTree> GetRestHolderValues(unsigned restholder_index) const {
-        std::vector<CodeTree> result;
-        for (std::multimap<unsigned, CodeTree>::const_iterator i = restholder_matches.lower_bound(restholder_index); i != restholder_matches.end() && i->first == restholder_index; ++i)
+    std::vector<CodeTree<Value_t> > GetRestHolderValues(unsigned restholder_index) const {
+        std::vector<CodeTree<Value_t> > result;
+        for (typename std::multimap<unsigned, CodeTree<Value_t> >::const_iterator i = restholder_matches.lower_bound(restholder_index); i != restholder_matches.end() && i->first == restholder_index; ++i)
             result.push_back(i->second);
         return result;
     }
@@ -111,34 +112,41 @@ struct MatchResultType {
 };
 
 /* Synthesize the given grammatic rule's replacement into the codetree */
+template<typename Value_t>
 void SynthesizeRule(
     const Rule& rule,
-    CodeTree& tree,
-    MatchInfo& info);
+    CodeTree<Value_t>& tree,
+    MatchInfo<Value_t>& info);
 
 /* Test the given parameter to a given CodeTree */
+template<typename Value_t>
 MatchResultType TestParam(
     const ParamSpec& parampair,
-    const CodeTree& tree,
+    const CodeTree<Value_t>& tree,
     const MatchPositionSpecBaseP& start_at,
-    MatchInfo& info);
+    MatchInfo<Value_t>& info);
 
 /* Test the list of parameters to a given CodeTree */
+template<typename Value_t>
 MatchResultType TestParams(
     const ParamSpec_SubFunctionData& model_tree,
-    const CodeTree& tree,
+    const CodeTree<Value_t>& tree,
     const MatchPositionSpecBaseP& start_at,
-    MatchInfo& info,
+    MatchInfo<Value_t>& info,
     bool TopLevel);
 } // namespace FPoptimizer_Optimize
 
 namespace FPoptimizer_Grammar {
-void DumpTree(const FPoptimizer_CodeTree::CodeTree& tree, std::ostream& o = std::cout);
-void DumpTreeWithIndent(const FPoptimizer_CodeTree::CodeTree& tree, std::ostream& o = std::cout, const std::string& indent = "\\");
-void DumpHashes(const FPoptimizer_CodeTree::CodeTree& tree, std::ostream& o = std::cout);
+template<typename Value_t>
+void DumpTree(const FPoptimizer_CodeTree::CodeTree<Value_t>& tree, std::ostream& o = std::cout);
+template<typename Value_t>
+void DumpTreeWithIndent(const FPoptimizer_CodeTree::CodeTree<Value_t>& tree, std::ostream& o = std::cout, const std::string& indent = "\\");
+template<typename Value_t>
+void DumpHashes(const FPoptimizer_CodeTree::CodeTree<Value_t>& tree, std::ostream& o = std::cout);
+template<typename Value_t>
 void DumpMatch(const Rule& rule,
-               const FPoptimizer_CodeTree::CodeTree& tree,
-               const FPoptimizer_Optimize::MatchInfo& info,
+               const FPoptimizer_CodeTree::CodeTree<Value_t>& tree,
+               const FPoptimizer_Optimize::MatchInfo<Value_t>& info,
                bool DidMatch,
                std::ostream& o = std::cout);
 } // namespace FPoptimizer_Grammar
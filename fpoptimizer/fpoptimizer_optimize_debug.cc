@@ -19,9 +19,10 @@ using namespace FPoptimizer_CodeTree;
 using namespace FPoptimizer_Optimize;
 
 namespace FPoptimizer_Grammar {
+template<typename Value_t>
 void DumpMatch(const Rule& rule,
-               const CodeTree& tree,
-               const MatchInfo& info,
+               const CodeTree<Value_t>& tree,
+               const MatchInfo<Value_t>& info,
                bool DidMatch,
                std::ostream& o) {
     static const char ParamHolderNames[][2] = {"%", "&", "x", "y", "z", "a", "b", "c"};
@@ -46,7 +47,7 @@ void DumpMatch(const Rule& rule,
     o << "\n";
     if (DidMatch) DumpHashes(tree, o);
 
-    for (std::map<unsigned, CodeTree>::const_iterator
+    for (typename std::map<unsigned, CodeTree<Value_t> >::const_iterator
              i = info.paramholder_matches.begin();
          i != info.paramholder_matches.end();
          ++i) {
@@ -55,7 +56,7 @@ void DumpMatch(const Rule& rule,
         o << "\n";
     }
 
-    for (std::multimap<unsigned, CodeTree>::const_iterator
+    for (typename std::multimap<unsigned, CodeTree<Value_t> >::const_iterator
              i = info.restholder_matches.begin();
          i != info.restholder_matches.end();
          ++i) {
@@ -66,7 +67,8 @@ void DumpMatch(const Rule& rule,
     o << std::flush;
 }
 
-void DumpHashes(const CodeTree& tree,
+template<typename Value_t>
+void DumpHashes(const CodeTree<Value_t>& tree,
                 std::map<fphash_t, std::set<std::string> >& done,
                 std::ostream& o) {
     for (size_t a = 0; a < tree.GetParamCount(); ++a)
@@ -76,7 +78,8 @@ void DumpHashes(const CodeTree& tree,
     DumpTree(tree, buf);
     done[tree.GetHash()].insert(buf.str());
 }
-void DumpHashes(const CodeTree& tree, std::ostream& o) {
+template<typename Value_t>
+void DumpHashes(const CodeTree<Value_t>& tree, std::ostream& o) {
     std::map<fphash_t, std::set<std::string> > done;
     DumpHashes(tree, done, o);
 
@@ -97,7 +100,8 @@ void DumpHashes(const CodeTree& tree, std::ostream& o) {
         }
     }
 }
-void DumpTree(const CodeTree& tree, std::ostream& o) {
+template<typename Value_t>
+void DumpTree(const CodeTree<Value_t>& tree, std::ostream& o) {
     //o << "/*" << tree.Depth << "*/";
     const char* sep2 = "";
     /*
@@ -130,7 +134,8 @@ void DumpTree(const CodeTree& tree, std::ostream& o) {
     o << ')';
 }
 
-void DumpTreeWithIndent(const CodeTree& tree, std::ostream& o, const std::string& indent) {
+template<typename Value_t>
+void DumpTreeWithIndent(const CodeTree<Value_t>& tree, std::ostream& o, const std::string& indent) {
     o << '[' << std::hex << (void*)(&tree.GetParams())
       << std::dec
       << ',' << tree.GetRefCount()
@@ -163,4 +168,19 @@ void DumpTreeWithIndent(const CodeTree& tree, std::ostream& o, const std::string
     o << std::flush;
 }
 } // namespace FPoptimizer_Grammar
+
+namespace FPoptimizer_Grammar {
+#define FP_INSTANTIATE(type)                                                       \
+    template void DumpMatch(const Rule& rule,                                      \
+                            const CodeTree<type>& tree,                            \
+                            const MatchInfo<type>& info,                           \
+                            bool DidMatch,                                         \
+                            std::ostream& o);                                      \
+    template void DumpHashes(const CodeTree<type>& tree, std::ostream& o);         \
+    template void DumpTree(const CodeTree<type>& tree, std::ostream& o);           \
+    template void DumpTreeWithIndent(const CodeTree<type>& tree, std::ostream& o,  \
+                                     const std::string& indent);
+FP_INSTANTIATE_OPTIMIZER_TYPES(FP_INSTANTIATE)
+#undef FP_INSTANTIATE
+} // namespace FPoptimizer_Grammar
 #endif
@@ -29,16 +29,17 @@ using namespace FPoptimizer_Optimize;
 
 namespace {
 /* Test the given constraints to a given CodeTree */
-bool TestImmedConstraints(unsigned bitmask, const CodeTree& tree) {
+template<typename Value_t>
+bool TestImmedConstraints(unsigned bitmask, const CodeTree<Value_t>& tree) {
     switch (bitmask & ValueMask) {
     case Value_AnyNum:
     case ValueMask: break;
     case Value_EvenInt:
-        if (tree.GetEvennessInfo() != CodeTree::IsAlways)
+        if (tree.GetEvennessInfo() != CodeTree<Value_t>::IsAlways)
             return false;
         break;
     case Value_OddInt:
-        if (tree.GetEvennessInfo() != CodeTree::IsNever)
+        if (tree.GetEvennessInfo() != CodeTree<Value_t>::IsNever)
             return false;
         break;
     case Value_IsInteger:
@@ -78,13 +79,13 @@ bool TestImmedConstraints(unsigned bitmask, const CodeTree& tree) {
     case Oneness_One:
         if (!tree.IsImmed())
             return false;
-        if (!FloatEqual(fabs(tree.GetImmed()), 1.0))
+        if (!FloatEqual(std::fabs(tree.GetImmed()), Value_t(1)))
             return false;
         break;
     case Oneness_NotOne:
         if (!tree.IsImmed())
             return false;
-        if (FloatEqual(fabs(tree.GetImmed()), 1.0))
+        if (FloatEqual(std::fabs(tree.GetImmed()), Value_t(1)))
             return false;
         break;
     }
@@ -104,9 +105,10 @@ bool TestImmedConstraints(unsigned bitmask, const CodeTree& tree) {
      * basic shape of the tree matches what we are expecting
      * i.e. given number of numeric constants, etc.
      */
+template<typename Value_t>
 bool IsLogisticallyPlausibleParamsMatch(
     const ParamSpec_SubFunctionData& params,
-    const CodeTree& tree) {
+    const CodeTree<Value_t>& tree) {
     /* First, check if the tree has any chances of matching... */
     /* Figure out what we need. */
     struct Needs {
@@ -191,19 +193,20 @@ bool IsLogisticallyPlausibleParamsMatch(
 }
 
 /* Construct CodeTree from a GroupFunction, hopefully evaluating to a constant value */
-CodeTree CalculateGroupFunction(
+template<typename Value_t>
+CodeTree<Value_t> CalculateGroupFunction(
     const ParamSpec& parampair,
-    const MatchInfo& info) {
+    const MatchInfo<Value_t>& info) {
     using namespace std;
 
     switch (parampair.first) {
     case NumConstant: {
         const ParamSpec_NumConstant& param = *(const ParamSpec_NumConstant*)parampair.second;
-        return CodeTree(param.constvalue); // Note: calculates hash too.
+        return CodeTree<Value_t>(Value_t(param.constvalue)); // Note: calculates hash too.
     }
     case ParamHolder: {
         const ParamSpec_ParamHolder& param = *(const ParamSpec_ParamHolder*)parampair.second;
-        CodeTree result(info.GetParamHolderValueIfFound(param.index));
+        CodeTree<Value_t> result(info.GetParamHolderValueIfFound(param.index));
         if (result.IsDefined())
             return result;
         break; // The immed is not defined
@@ -214,7 +217,7 @@ CodeTree CalculateGroupFunction(
                  * constant-folding our expression. It will also
                  * indicate whether the result is, in fact,
                  * a constant at all. */
-        CodeTree result;
+        CodeTree<Value_t> result;
         result.SetOpcode(param.data.subfunc_opcode);
         for (unsigned a = 0; a < param.data.param_count; ++a)
             result.AddParam(
@@ -225,23 +228,24 @@ CodeTree CalculateGroupFunction(
     }
     }
     // Issue an un-calculatable tree.
-    return CodeTree(999, CodeTree::VarTag());
+    return CodeTree<Value_t>(999, typename CodeTree<Value_t>::VarTag());
 }
 } // namespace
 
 namespace FPoptimizer_Optimize {
 /* Test the given parameter to a given CodeTree */
+template<typename Value_t>
 MatchResultType TestParam(
     const ParamSpec& parampair,
-    const CodeTree& tree,
+    const CodeTree<Value_t>& tree,
     const MatchPositionSpecBaseP& start_at,
-    MatchInfo& info) {
+    MatchInfo<Value_t>& info) {
     /* What kind of param are we expecting */
     switch (parampair.first) {
     case NumConstant: { /* A particular numeric value */
         const ParamSpec_NumConstant& param = *(const ParamSpec_NumConstant*)parampair.second;
         if (!tree.IsImmed()) return false;
-        return FloatEqual(tree.GetImmed(), param.constvalue);
+        return FloatEqual(tree.GetImmed(), Value_t(param.constvalue));
     }
     case ParamHolder: { /* Any arbitrary node */
         const ParamSpec_ParamHolder& param = *(const ParamSpec_ParamHolder*)parampair.second;
@@ -255,7 +259,7 @@ MatchResultType TestParam(
             if (!TestImmedConstraints(param.constraints, tree))
                 return false;
             /* Construct the formula */
-            CodeTree grammar_func = CalculateGroupFunction(parampair, info);
+            CodeTree<Value_t> grammar_func = CalculateGroupFunction(parampair, info);
             /* Evaluate it and compare */
             return grammar_func.IsIdenticalTo(tree);
         } else { /* A subtree conforming these specs */
@@ -272,19 +276,21 @@ MatchResultType TestParam(
     return false;
 }
 
+template<typename Value_t>
 struct PositionalParams_Rec {
     MatchPositionSpecBaseP start_at; /* child's start_at */
-    MatchInfo info; /* backup of "info" at start */
+    MatchInfo<Value_t> info; /* backup of "info" at start */
 
     PositionalParams_Rec() : start_at(), info() {}
 };
+template<typename Value_t>
 class MatchPositionSpec_PositionalParams
     : public MatchPositionSpecBase,
-      public std::vector<PositionalParams_Rec> {
+      public std::vector<PositionalParams_Rec<Value_t> > {
 public:
     explicit MatchPositionSpec_PositionalParams(size_t n)
         : MatchPositionSpecBase(),
-          std::vector<PositionalParams_Rec>(n) {}
+          std::vector<PositionalParams_Rec<Value_t> >(n) {}
 };
 
 struct AnyWhere_Rec {
@@ -303,11 +309,12 @@ public:
           trypos(0) {}
 };
 
+template<typename Value_t>
 MatchResultType TestParam_AnyWhere(
     const ParamSpec& parampair,
-    const CodeTree& tree,
+    const CodeTree<Value_t>& tree,
     const MatchPositionSpecBaseP& start_at,
-    MatchInfo& info,
+    MatchInfo<Value_t>& info,
     std::vector<bool>& used,
     bool TopLevel) {
     FPOPT_autoptr<MatchPositionSpec_AnyWhere> position;
@@ -350,29 +357,32 @@ MatchResultType TestParam_AnyWhere(
     return false;
 }
 
+template<typename Value_t>
 struct AnyParams_Rec {
     MatchPositionSpecBaseP start_at; /* child's start_at */
-    MatchInfo info; /* backup of "info" at start */
+    MatchInfo<Value_t> info; /* backup of "info" at start */
     std::vector<bool> used; /* which params are remaining */
 
     explicit AnyParams_Rec(size_t nparams)
         : start_at(), info(), used(nparams) {}
 };
+template<typename Value_t>
 class MatchPositionSpec_AnyParams
     : public MatchPositionSpecBase,
-      public std::vector<AnyParams_Rec> {
+      public std::vector<AnyParams_Rec<Value_t> > {
 public:
     explicit MatchPositionSpec_AnyParams(size_t n, size_t m)
         : MatchPositionSpecBase(),
-          std::vector<AnyParams_Rec>(n, AnyParams_Rec(m)) {}
+          std::vector<AnyParams_Rec<Value_t> >(n, AnyParams_Rec<Value_t>(m)) {}
 };
 
 /* Test the list of parameters to a given CodeTree */
+template<typename Value_t>
 MatchResultType TestParams(
     const ParamSpec_SubFunctionData& model_tree,
-    const CodeTree& tree,
+    const CodeTree<Value_t>& tree,
     const MatchPositionSpecBaseP& start_at,
-    MatchInfo& info,
+    MatchInfo<Value_t>& info,
     bool TopLevel) {
     /* When PositionalParams or SelectedParams, verify that
          * the number of parameters is exactly as expected.
@@ -392,14 +402,14 @@ MatchResultType TestParams(
     switch (model_tree.match_type) {
     case PositionalParams: {
         /* Simple: Test all given parameters in succession. */
-        FPOPT_autoptr<MatchPositionSpec_PositionalParams> position;
+        FPOPT_autoptr<MatchPositionSpec_PositionalParams<Value_t> > position;
         unsigned a;
         if (&*start_at) {
-            position = (MatchPositionSpec_PositionalParams*)&*start_at;
+            position = (MatchPositionSpec_PositionalParams<Value_t>*)&*start_at;
             a = model_tree.param_count - 1;
             goto retry_positionalparams_2;
         } else {
-            position = new MatchPositionSpec_PositionalParams(model_tree.param_count);
+            position = new MatchPositionSpec_PositionalParams<Value_t>(model_tree.param_count);
             a = 0;
         }
 
@@ -444,7 +454,7 @@ MatchResultType TestParams(
     case AnyParams: {
         /* Ensure that all given parameters are found somewhere, in any order */
 
-        FPOPT_autoptr<MatchPositionSpec_AnyParams> position;
+        FPOPT_autoptr<MatchPositionSpec_AnyParams<Value_t> > position;
         std::vector<bool> used(tree.GetParamCount());
         std::vector<unsigned> depcodes(model_tree.param_count);
         std::vector<unsigned> test_order(model_tree.param_count);
@@ -464,11 +474,11 @@ MatchResultType TestParams(
 
         unsigned a;
         if (&*start_at) {
-            position = (MatchPositionSpec_AnyParams*)&*start_at;
+            position = (MatchPositionSpec_AnyParams<Value_t>*)&*start_at;
             a = model_tree.param_count - 1;
             goto retry_anyparams_2;
         } else {
-            position = new MatchPositionSpec_AnyParams(model_tree.param_count, tree.GetParamCount());
+            position = new MatchPositionSpec_AnyParams<Value_t>(model_tree.param_count, tree.GetParamCount());
             a = 0;
             if (model_tree.param_count != 0) {
                 (*position)[0].info = info;
@@ -533,4 +543,16 @@ MatchResultType TestParams(
 }
 } // namespace FPoptimizer_Optimize
 
+namespace FPoptimizer_Optimize {
+#define FP_INSTANTIATE(type)                                       \
+    template MatchResultType TestParams(                           \
+        const ParamSpec_SubFunctionData& model_tree,               \
+        const CodeTree<type>& tree,                                \
+        const MatchPositionSpecBaseP& start_at,                    \
+        MatchInfo<type>& info,                                     \
+        bool TopLevel);
+FP_INSTANTIATE_OPTIMIZER_TYPES(FP_INSTANTIATE)
+#undef FP_INSTANTIATE
+} // namespace FPoptimizer_Optimize
+
 #endif
@@ -23,15 +23,16 @@
 
 namespace FPoptimizer_Optimize {
 /* Synthesize the given grammatic parameter into the codetree */
+template<typename Value_t>
 void SynthesizeParam(
     const ParamSpec& parampair,
-    CodeTree& tree,
-    MatchInfo& info,
+    CodeTree<Value_t>& tree,
+    MatchInfo<Value_t>& info,
     bool inner = true) {
     switch (parampair.first) {
     case NumConstant: {
         const ParamSpec_NumConstant& param = *(const ParamSpec_NumConstant*)parampair.second;
-        tree.SetImmed(param.constvalue);
+        tree.SetImmed(Value_t(param.constvalue));
         if (inner) tree.Rehash(false);
         break;
     }
@@ -44,12 +45,12 @@ void SynthesizeParam(
         const ParamSpec_SubFunction& param = *(const ParamSpec_SubFunction*)parampair.second;
         tree.SetOpcode(param.data.subfunc_opcode);
         for (unsigned a = 0; a < param.data.param_count; ++a) {
-            CodeTree nparam;
+            CodeTree<Value_t> nparam;
             SynthesizeParam(ParamSpec_Extract(param.data.param_list, a), nparam, info, true);
             tree.AddParamMove(nparam);
         }
         if (param.data.restholder_index != 0) {
-            std::vector<CodeTree> trees(info.GetRestHolderValues(param.data.restholder_index));
+            std::vector<CodeTree<Value_t> > trees(info.GetRestHolderValues(param.data.restholder_index));
             tree.AddParamsMove(trees);
             // ^note: this fails if the same restholder is synth'd twice
             if (tree.GetParamCount() == 1) {
@@ -68,10 +69,11 @@ void SynthesizeParam(
     }
 }
 
+template<typename Value_t>
 void SynthesizeRule(
     const Rule& rule,
-    CodeTree& tree,
-    MatchInfo& info) {
+    CodeTree<Value_t>& tree,
+    MatchInfo<Value_t>& info) {
     switch (rule.ruletype) {
     case ProduceNewTree: {
         tree.DelParams();
@@ -88,7 +90,7 @@ void SynthesizeRule(
 
         /* Synthesize the replacement params */
         for (unsigned a = 0; a < rule.repl_param_count; ++a) {
-            CodeTree nparam;
+            CodeTree<Value_t> nparam;
             SynthesizeParam(ParamSpec_Extract(rule.repl_param_list, a), nparam, info, true);
             tree.AddParamMove(nparam);
         }
@@ -98,4 +100,14 @@ void SynthesizeRule(
 }
 } // namespace FPoptimizer_Optimize
 
+namespace FPoptimizer_Optimize {
+#define FP_INSTANTIATE(type)                     \
+    template void SynthesizeRule(                \
+        const Rule& rule,                        \
+        CodeTree<type>& tree,                    \
+        MatchInfo<type>& info);
+FP_INSTANTIATE_OPTIMIZER_TYPES(FP_INSTANTIATE)
+#undef FP_INSTANTIATE
+} // namespace FPoptimizer_Optimize
+
 #endif
@@ -0,0 +1,279 @@
+// Accuracy test of UseVectorMath()
+// ================================
+
+/* Evaluates each vectorized function with EvalMany() on a large random
+   sample of arguments, in double and in single precision, and measures the
+   largest error in ulps against the long double functions of the standard
+   library. It then evaluates every combination of a list of special
+   arguments (zeros, infinities, NaNs, subnormals, the overflow and
+   underflow thresholds...) with and without UseVectorMath(), which must
+   give the same results and evaluation errors.
+   The program prints the errors and exits with status 1 if one of them is
+   larger than the bound documented in fparser.html. The kernels tested are
+   those EvalMany() selects for the processor running it (SSE2, AVX2 or
+   AVX-512), so run it on each kind of processor to be covered. Compile it
+   with the library, eg.
+
+   g++ -O2 -I. test_vmath.cc fparser*.cc ascii.cc fpoptimizer/fpoptimizer_*.cc
+
+   The optional argument is the number of random rows per function
+   (default 1000000).
+*/
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "fparser.hh"
+
+namespace {
+typedef long double LongDouble;
+
+std::mt19937_64 generator(12345);
+
+double Uniform(double min, double max) {
+    return min + (max - min) * double(generator() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// A finite double with random bits, so that all exponents are covered.
+double RandomBits(bool negative) {
+    while (true) {
+        unsigned long long bits = generator();
+        if (!negative)
+            bits &= ~(1ULL << 63);
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        if (std::isfinite(value) && value != 0)
+            return value;
+    }
+}
+
+// The error of result in units of the last place of the correct value.
+template<typename Value_t>
+double Ulps(Value_t result, LongDouble correct) {
+    if (std::isnan(correct) || std::isnan(result))
+        return std::isnan(correct) && std::isnan(result) ? 0 : 1e9;
+    if (std::isinf(correct) || std::isinf(result))
+        return Value_t(correct) == result ? 0 : 1e9;
+    const Value_t magnitude = Value_t(std::fabs(correct));
+    Value_t ulp = std::numeric_limits<Value_t>::denorm_min();
+    if (magnitude >= std::numeric_limits<Value_t>::min())
+        ulp = std::nextafter(magnitude, std::numeric_limits<Value_t>::infinity()) - magnitude;
+    return double(std::fabs(LongDouble(result) - correct) / ulp);
+}
+
+struct Function {
+    const char* expression;
+    double maxUlps; // the bound in fparser.html
+    LongDouble (*reference)(LongDouble, LongDouble);
+    void (*generate)(double& x, double& y);
+};
+
+LongDouble Exp(LongDouble x, LongDouble) { return std::exp(x); }
+LongDouble Exp2(LongDouble x, LongDouble) { return std::exp2(x); }
+LongDouble Log(LongDouble x, LongDouble) { return std::log(x); }
+LongDouble Log2(LongDouble x, LongDouble) { return std::log2(x); }
+LongDouble Log10(LongDouble x, LongDouble) { return std::log10(x); }
+LongDouble Sin(LongDouble x, LongDouble) { return std::sin(x); }
+LongDouble Cos(LongDouble x, LongDouble) { return std::cos(x); }
+LongDouble Tan(LongDouble x, LongDouble) { return std::tan(x); }
+LongDouble Atan(LongDouble x, LongDouble) { return std::atan(x); }
+LongDouble Pow(LongDouble x, LongDouble y) { return std::pow(x, y); }
+LongDouble Atan2(LongDouble x, LongDouble y) { return std::atan2(x, y); }
+
+/* The arguments are drawn from a few ranges per function: around the
+   polynomial interval, the whole range without overflow, and for the
+   logarithms and atan() all finite values. */
+void ExpArgs(double& x, double&) {
+    switch (generator() % 3) {
+    case 0: x = Uniform(-1, 1); break;
+    case 1: x = Uniform(-20, 20); break;
+    default: x = Uniform(-745, 709.7); break;
+    }
+}
+
+void Exp2Args(double& x, double&) {
+    switch (generator() % 3) {
+    case 0: x = Uniform(-1, 1); break;
+    case 1: x = Uniform(-30, 30); break;
+    default: x = Uniform(-1074, 1023.9); break;
+    }
+}
+
+void LogArgs(double& x, double&) {
+    switch (generator() % 3) {
+    case 0: x = RandomBits(false); break;
+    case 1: x = Uniform(0.5, 2); break;
+    default: x = Uniform(0.999, 1.001); break;
+    }
+}
+
+void TrigArgs(double& x, double&) {
+    switch (generator() % 4) {
+    case 0: x = Uniform(-4, 4); break;
+    case 1: x = Uniform(-1e3, 1e3); break;
+    case 2: x = Uniform(-1.6e6, 1.6e6); break;
+    default: x = Uniform(-1e-5, 1e-5); break;
+    }
+}
+
+void AtanArgs(double& x, double&) {
+    x = generator() % 2 ? RandomBits(true) : Uniform(-4, 4);
+}
+
+void PowArgs(double& x, double& y) {
+    switch (generator() % 3) {
+    case 0: x = Uniform(0, 10); y = Uniform(-30, 30); break;
+    case 1: x = RandomBits(false); y = Uniform(-1, 1); break;
+    default: x = Uniform(0.5, 2); y = Uniform(-1000, 1000); break;
+    }
+}
+
+void Atan2Args(double& x, double& y) {
+    if (generator() % 2) {
+        x = RandomBits(true);
+        y = RandomBits(true);
+    } else {
+        x = Uniform(-5, 5);
+        y = Uniform(-5, 5);
+    }
+}
+
+const Function functions[] = {
+    {"exp(x)", 1.5, Exp, ExpArgs},
+    {"exp2(x)", 1.5, Exp2, Exp2Args},
+    {"log(x)", 1, Log, LogArgs},
+    {"log2(x)", 1, Log2, LogArgs},
+    {"log10(x)", 1, Log10, LogArgs},
+    {"sin(x)", 1, Sin, TrigArgs},
+    {"cos(x)", 1, Cos, TrigArgs},
+    {"tan(x)", 2.5, Tan, TrigArgs},
+    {"atan(x)", 1, Atan, AtanArgs},
+    {"x^y", 1.5, Pow, PowArgs},
+    {"atan2(x,y)", 2, Atan2, Atan2Args},
+};
+
+const double specials[] = {
+    0.0, -0.0, 1.0, -1.0, 2.0, -2.0, 0.5, -0.5, 3.0, -3.0, 0.25, 1e-20, -1e-20,
+    4.9e-324, -4.9e-324, 1e-310, 2.2250738585072014e-308, 1e300, 1e308, -1e308,
+    709.78, 710, -745, -746, 1024, -1074, -1075, -1076, 1e6, 1647099.0, 1647100.0,
+    -1e22, 1.5707963267948966, 3.141592653589793,
+    std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(),
+    std::numeric_limits<double>::quiet_NaN()
+};
+
+/* Whether the vectorized result of a special row agrees with the standard
+   library: zeros, infinities and NaNs must be identical, other values need
+   only be within the bound. */
+bool Agrees(const Function& function, double x, double y, double vectorized, double scalar) {
+    if (std::isnan(scalar))
+        return std::isnan(vectorized);
+    if (scalar == 0 || std::isinf(scalar))
+        return vectorized == scalar && std::signbit(vectorized) == std::signbit(scalar);
+    return Ulps(vectorized, function.reference(x, y)) <= function.maxUlps;
+}
+
+// The largest error in ulps of vectorized EvalMany(), for double and float.
+void RandomErrors(const Function& function, unsigned rows, double& maxUlps, double& maxFloatUlps) {
+    std::vector<double> vars(2 * rows), results(rows);
+    std::vector<float> floatVars(2 * rows), floatResults(rows);
+    for (unsigned i = 0; i < rows; ++i) {
+        function.generate(vars[2 * i], vars[2 * i + 1]);
+        floatVars[2 * i] = float(vars[2 * i]);
+        floatVars[2 * i + 1] = float(vars[2 * i + 1]);
+    }
+
+    FunctionParser parser;
+    parser.UseVectorMath();
+    parser.Parse(function.expression, "x,y");
+    parser.EvalMany(&vars[0], rows, 2, &results[0]);
+    parser.EvalMany(&floatVars[0], rows, 2, &floatResults[0]);
+
+    maxUlps = maxFloatUlps = 0;
+    for (unsigned i = 0; i < rows; ++i) {
+        const LongDouble correct = function.reference(vars[2 * i], vars[2 * i + 1]);
+        const LongDouble floatCorrect = function.reference(floatVars[2 * i], floatVars[2 * i + 1]);
+        // Rows whose float arguments overflow or hit an evaluation error get
+        // no meaningful result; the special arguments cover those.
+        if (std::isfinite(correct)) {
+            const double error = Ulps(results[i], correct);
+            if (error > maxUlps)
+                maxUlps = error;
+        }
+        if (std::isfinite(floatCorrect) && std::fabs(floatCorrect) <= std::numeric_limits<float>::max()) {
+            const double error = Ulps(floatResults[i], floatCorrect);
+            if (error > maxFloatUlps)
+                maxFloatUlps = error;
+        }
+    }
+}
+
+// The number of special rows on which UseVectorMath() disagrees.
+unsigned SpecialDifferences(const Function& function) {
+    const unsigned count = sizeof(specials) / sizeof(specials[0]);
+    std::vector<double> vars;
+    for (unsigned i = 0; i < count; ++i)
+        for (unsigned j = 0; j < count; ++j) {
+            vars.push_back(specials[i]);
+            vars.push_back(specials[j]);
+        }
+    const unsigned rows = unsigned(vars.size() / 2);
+
+    FunctionParser scalar, vectorized;
+    vectorized.UseVectorMath();
+    scalar.Parse(function.expression, "x,y");
+    vectorized.Parse(function.expression, "x,y");
+
+    unsigned differences = 0;
+    for (unsigned row = 0; row < rows; ++row) {
+        // One row at a time, so that EvalError() belongs to it. A vector of
+        // identical rows still goes through the SIMD code.
+        std::vector<double> block, vectorResults(16), scalarResults(16);
+        for (unsigned k = 0; k < 16; ++k) {
+            block.push_back(vars[2 * row]);
+            block.push_back(vars[2 * row + 1]);
+        }
+        scalar.EvalMany(&block[0], 16, 2, &scalarResults[0]);
+        vectorized.EvalMany(&block[0], 16, 2, &vectorResults[0]);
+        bool agrees = scalar.EvalError() == vectorized.EvalError();
+        for (unsigned k = 0; k < 16; ++k)
+            agrees = agrees && Agrees(function, block[0], block[1], vectorResults[k], scalarResults[k]);
+        if (!agrees) {
+            if (differences < 5)
+                std::printf("  %s with x=%.17g, y=%.17g: %.17g (error %d), without vector math %.17g (error %d)\n",
+                            function.expression, block[0], block[1], vectorResults[0], vectorized.EvalError(),
+                            scalarResults[0], scalar.EvalError());
+            ++differences;
+        }
+    }
+    return differences;
+}
+} // namespace
+
+int main(int argc, char* argv[]) {
+    const unsigned rows = argc > 1 ? unsigned(std::atoi(argv[1])) : 1000000;
+    if (rows == 0) {
+        std::printf("Usage: %s [rows]\n", argv[0]);
+        return 2;
+    }
+
+    bool failed = false;
+    std::printf("%-12s %8s %8s %6s %s\n", "function", "double", "float", "bound", "special differences");
+    for (unsigned i = 0; i < sizeof(functions) / sizeof(functions[0]); ++i) {
+        const Function& function = functions[i];
+        double maxUlps, maxFloatUlps;
+        RandomErrors(function, rows, maxUlps, maxFloatUlps);
+        const unsigned differences = SpecialDifferences(function);
+        // float results are rounded from double precision: 1 ulp of a float.
+        const bool ok = maxUlps <= function.maxUlps && maxFloatUlps <= 1 && differences == 0;
+        std::printf("%-12s %8.3f %8.3f %6.1f %u%s\n", function.expression, maxUlps, maxFloatUlps,
+                    function.maxUlps, differences, ok ? "" : "  FAILED");
+        failed = failed || !ok;
+    }
+    std::printf(failed ? "FAILED\n" : "OK\n");
+    return failed ? 1 : 0;
+}